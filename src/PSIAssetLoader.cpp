@@ -0,0 +1,300 @@
+#include "PSIAssetLoader.h"
+
+#include "PSITextureBaker.h"
+
+#include <cfloat>
+#include <cstdint>
+
+const GLfloat PSIAssetLoader::DEFAULT_UPLOAD_MS = 4.0f;
+const size_t PSIAssetLoader::DEFAULT_UPLOAD_BYTES = 32 * 1024 * 1024;
+
+// Mip levels add a third to the texture size.
+static size_t get_texture_bytes(const PSIGLTexture::image_data &image) {
+	return (size_t)image.width * image.height * image.channels * 4 / 3;
+}
+
+static size_t get_cube_map_bytes(const std::vector<PSIGLTexture::image_data> &faces) {
+	size_t bytes = 0;
+	for (const auto &face : faces) {
+		bytes += get_texture_bytes(face);
+	}
+
+	return bytes;
+}
+
+static GLTextureSharedPtr upload_cube_map(std::vector<PSIGLTexture::image_data> &faces) {
+	GLTextureSharedPtr texture = PSIGLTexture::create();
+	texture->upload_cube_map(faces);
+
+	return texture;
+}
+
+// Read one byte of each page of mapped data, so the file is read from disk on the
+// worker instead of during the upload.
+static void prefault(const unsigned char *data, size_t size) {
+	static const size_t PREFAULT_STRIDE = 4096;
+	volatile unsigned char sum = 0;
+	for (size_t offset = 0; offset < size; offset += PREFAULT_STRIDE) {
+		sum += data[offset];
+	}
+}
+
+static void prefault_buffers(const PSIGLTFLoader::GLTFDocumentSharedPtr &doc) {
+	for (const auto &buffer : doc->buffers) {
+		prefault(buffer.data, buffer.byte_length);
+	}
+}
+
+static size_t get_buffer_bytes(const PSIGLTFLoader::gltf_document &doc) {
+	size_t bytes = 0;
+	for (const auto &view : doc.buffer_views) {
+		bytes += view.byte_length;
+	}
+	for (const auto &image : doc.decoded_images) {
+		bytes += get_texture_bytes(image);
+	}
+
+	return bytes;
+}
+
+PSIAssetLoader::PSIAssetLoader(const WorkerPoolSharedPtr &pool) : _pool(pool) {
+	if (_pool == nullptr) {
+		_pool = PSIWorkerPool::create();
+	}
+	_queue = make_shared<upload_queue>();
+}
+
+void PSIAssetLoader::upload_queue::push(upload_job job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uploads.push_back(std::move(job));
+	}
+	cond.notify_one();
+}
+
+std::shared_future<GLTextureSharedPtr> PSIAssetLoader::load_texture(std::string path) {
+	typedef PSIGLTexture::image_data image_data;
+
+	return load<GLTextureSharedPtr, image_data>(
+		[path]() -> shared_ptr<image_data> {
+			auto image = make_shared<image_data>();
+			if (PSIGLTexture::decode_image(path, *image) == false) {
+				return nullptr;
+			}
+			PSIGLTexture::gen_cpu_mipmaps(*image);
+			return image;
+		},
+		get_texture_bytes,
+		[](image_data &image) {
+			GLTextureSharedPtr texture = PSIGLTexture::create();
+			texture->upload_image(image);
+			return texture;
+		});
+}
+
+std::shared_future<GLTextureSharedPtr> PSIAssetLoader::load_cube_map(std::vector<std::string> texture_paths) {
+	typedef PSIGLTexture::image_data image_data;
+
+	// Shared by the face tasks. Only the uploads touch the texture and count, and
+	// they all run on the render thread.
+	struct cube_map_load {
+		std::promise<GLTextureSharedPtr> promise;
+		GLTextureSharedPtr texture;
+		size_t remaining;
+	};
+
+	auto cube_map = make_shared<cube_map_load>();
+	cube_map->remaining = texture_paths.size();
+	std::shared_future<GLTextureSharedPtr> future = cube_map->promise.get_future().share();
+	shared_ptr<upload_queue> queue = _queue;
+
+	if (texture_paths.empty() == true) {
+		cube_map->promise.set_value(nullptr);
+		return future;
+	}
+	queue->pending++;
+
+	// Each face is decoded in its own task and its upload queued as soon as it is
+	// decoded. Failed faces are queued too, so the last face to upload finishes the map.
+	for (GLuint i = 0; i < texture_paths.size(); i++) {
+		std::string path = texture_paths[i];
+		_pool->submit([queue, cube_map, path, i]() {
+			auto face = make_shared<image_data>();
+			if (PSIGLTexture::decode_image(path, *face, 3) == false) {
+				psilog_err("Failed loading image from '%s'", path.c_str());
+			}
+
+			queue->push({ [queue, cube_map, face, i]() {
+				if (cube_map->texture == nullptr) {
+					cube_map->texture = PSIGLTexture::create();
+					cube_map->texture->begin_cube_map();
+				}
+				cube_map->texture->upload_cube_face(i, *face);
+
+				if (--cube_map->remaining == 0) {
+					cube_map->texture->end_cube_map();
+					cube_map->promise.set_value(cube_map->texture);
+					queue->pending--;
+				}
+			}, get_texture_bytes(*face) });
+		});
+	}
+
+	return future;
+}
+
+std::shared_future<GLTextureSharedPtr> PSIAssetLoader::load_cube_map_image(std::string path) {
+	typedef std::vector<PSIGLTexture::image_data> face_data;
+
+	return load<GLTextureSharedPtr, face_data>(
+		[path]() -> shared_ptr<face_data> {
+			PSIGLTexture::image_data image;
+			auto faces = make_shared<face_data>();
+			if (PSIGLTexture::decode_image(path, image, 3) == false ||
+			    PSIGLTexture::split_cube_image(image, *faces) == false) {
+				return nullptr;
+			}
+			return faces;
+		},
+		get_cube_map_bytes,
+		upload_cube_map);
+}
+
+std::shared_future<GLTextureSharedPtr> PSIAssetLoader::load_baked_texture(std::string path) {
+	typedef PSIFileUtils::mapped_file mapped_file;
+
+	return load<GLTextureSharedPtr, mapped_file>(
+		[path]() {
+			PSIFileUtils::MappedFileSharedPtr file = PSITextureBaker::open(path);
+			if (file != nullptr) {
+				prefault(file->data, file->size);
+			}
+			return file;
+		},
+		[](const mapped_file &file) {
+			return file.size;
+		},
+		[](mapped_file &file) {
+			// The file is only referenced for the duration of the upload.
+			return PSITextureBaker::upload(PSIFileUtils::MappedFileSharedPtr(&file, [](mapped_file *) {}));
+		});
+}
+
+std::shared_future<RenderModelSharedPtr> PSIAssetLoader::load_model(const GLMaterialSharedPtr &material,
+                                                                    std::string path) {
+	typedef PSIGLTFLoader::gltf_document gltf_document;
+
+	return load<RenderModelSharedPtr, gltf_document>(
+		[path]() -> shared_ptr<gltf_document> {
+			auto doc = PSIGLTFLoader::load_document(path);
+			if (doc != nullptr) {
+				prefault_buffers(doc);
+				PSIGLTFLoader::decode_images(doc);
+			}
+			return doc;
+		},
+		get_buffer_bytes,
+		[material](gltf_document &doc) {
+			// The document is only referenced for the duration of the upload.
+			PSIGLTFLoader::GLTFDocumentSharedPtr doc_ptr(&doc, [](gltf_document *) {});
+			return PSIGLTFLoader::create()->create_model(material, doc_ptr);
+		});
+}
+
+std::shared_future<GLMeshSharedPtr> PSIAssetLoader::load_gl_mesh(const ShaderSharedPtr &shader, std::string path) {
+	typedef PSIGLTFLoader::gltf_document gltf_document;
+
+	return load<GLMeshSharedPtr, gltf_document>(
+		[path]() -> shared_ptr<gltf_document> {
+			auto doc = PSIGLTFLoader::load_document(path);
+			if (doc != nullptr) {
+				prefault_buffers(doc);
+			}
+			return doc;
+		},
+		get_buffer_bytes,
+		[shader](gltf_document &doc) -> GLMeshSharedPtr {
+			PSIGLTFLoader::GLTFDocumentSharedPtr doc_ptr(&doc, [](gltf_document *) {});
+			GLint mesh_index = PSIGLTFLoader::find_first_mesh(doc_ptr);
+			if (mesh_index < 0) {
+				return nullptr;
+			}
+			return PSIGLTFLoader::create()->create_gl_mesh(shader, doc_ptr, mesh_index);
+		});
+}
+
+std::shared_future<ShaderSharedPtr> PSIAssetLoader::load_shader(PSIResourceManager &resources, std::string name,
+                                                                std::string vert_shader_path,
+                                                                std::string frag_shader_path,
+                                                                std::string geom_shader_path) {
+	typedef PSIResourceManager::shader_sources shader_sources;
+	PSIResourceManager *resources_ptr = &resources;
+
+	return load<ShaderSharedPtr, shader_sources>(
+		[vert_shader_path, frag_shader_path, geom_shader_path]() -> shared_ptr<shader_sources> {
+			auto sources = make_shared<shader_sources>();
+			if (PSIResourceManager::read_shader_sources(vert_shader_path, frag_shader_path, geom_shader_path,
+			                                            *sources) == false) {
+				return nullptr;
+			}
+			return sources;
+		},
+		[](const shader_sources &sources) {
+			return sources.vert.size() + sources.frag.size() + sources.geom.size();
+		},
+		[resources_ptr, name](shader_sources &sources) {
+			return resources_ptr->create_shader(name, sources);
+		});
+}
+
+GLint PSIAssetLoader::update(GLfloat budget_ms, size_t budget_bytes) {
+	auto start = std::chrono::steady_clock::now();
+	size_t bytes = 0;
+	GLint count = 0;
+
+	while (true) {
+		upload_job job;
+		{
+			std::lock_guard<std::mutex> lock(_queue->mutex);
+			if (_queue->uploads.empty()) {
+				break;
+			}
+
+			// Past the first upload, stop before going over the byte budget.
+			if (count > 0 && bytes + _queue->uploads.front().bytes > budget_bytes) {
+				break;
+			}
+
+			job = std::move(_queue->uploads.front());
+			_queue->uploads.pop_front();
+		}
+
+		job.upload();
+		bytes += job.bytes;
+		count++;
+
+		std::chrono::duration<GLfloat, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budget_ms) {
+			break;
+		}
+	}
+
+	if (count > 0) {
+		psilog(PSILog::LOAD, "Uploaded %d assets, %zu bytes, %zu loads pending", count, bytes, (size_t)_queue->pending);
+	}
+
+	return count;
+}
+
+void PSIAssetLoader::finish() {
+	while (_queue->pending > 0) {
+		if (update(FLT_MAX, SIZE_MAX) == 0) {
+			// Wait for the workers to decode more. Failed decodes finish without an upload,
+			// so wake up now and then to check the pending count.
+			std::unique_lock<std::mutex> lock(_queue->mutex);
+			_queue->cond.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+				return _queue->uploads.empty() == false;
+			});
+		}
+	}
+}
@@ -0,0 +1,127 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Asynchronous asset loading. Files are read and decoded on worker threads,
+// and the GL objects are created on the render thread in update(), within a
+// time and byte budget per frame so loading does not stall the output.
+//
+// Loads return shared futures that become ready after the GL upload. Never
+// wait on them from the render thread, uploads only happen in update() and
+// finish(). Poll with is_ready() instead.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <future>
+
+#include "PSIGlobals.h"
+#include "PSIWorkerPool.h"
+#include "PSIGLTexture.h"
+#include "PSIGLTFLoader.h"
+#include "PSIResourceManager.h"
+
+class PSIAssetLoader;
+typedef shared_ptr<PSIAssetLoader> AssetLoaderSharedPtr;
+
+class PSIAssetLoader {
+	public:
+		// Default GL upload budget per update.
+		static const GLfloat DEFAULT_UPLOAD_MS;
+		static const size_t DEFAULT_UPLOAD_BYTES;
+
+		// Uses pool for decoding, or creates its own.
+		PSIAssetLoader(const WorkerPoolSharedPtr &pool = nullptr);
+		~PSIAssetLoader() = default;
+
+		static AssetLoaderSharedPtr create(const WorkerPoolSharedPtr &pool = nullptr) {
+			return make_shared<PSIAssetLoader>(pool);
+		}
+
+		// Load texture image file.
+		std::shared_future<GLTextureSharedPtr> load_texture(std::string path);
+		// Load the faces of a cube map.
+		std::shared_future<GLTextureSharedPtr> load_cube_map(std::vector<std::string> texture_paths);
+		// Load cube map from a single cross or strip layout image.
+		std::shared_future<GLTextureSharedPtr> load_cube_map_image(std::string path);
+		// Load texture baked with PSITextureBaker, uploading its compressed levels.
+		std::shared_future<GLTextureSharedPtr> load_baked_texture(std::string path);
+		// Load glTF file as a render model, see PSIGLTFLoader::load_model.
+		std::shared_future<RenderModelSharedPtr> load_model(const GLMaterialSharedPtr &material, std::string path);
+		// Load the first mesh of a glTF file, see PSIGLTFLoader::load_gl_mesh.
+		std::shared_future<GLMeshSharedPtr> load_gl_mesh(const ShaderSharedPtr &shader, std::string path);
+		// Load shader and add it to resources, which has to outlive the load.
+		std::shared_future<ShaderSharedPtr> load_shader(PSIResourceManager &resources, std::string name,
+		                                                std::string vert_shader_path, std::string frag_shader_path,
+		                                                std::string geom_shader_path = "");
+
+		// Run decoded uploads on the render thread until budget_ms or budget_bytes is used up.
+		// Always runs at least one upload if any are ready, so large assets still make progress.
+		// Returns the number of uploads run.
+		GLint update(GLfloat budget_ms = DEFAULT_UPLOAD_MS, size_t budget_bytes = DEFAULT_UPLOAD_BYTES);
+		// Block until every load has finished, uploading without a budget. For loading screens.
+		void finish();
+
+		// Loads decoding or waiting for upload.
+		size_t get_pending_count() {
+			return _queue->pending;
+		}
+
+		template <typename T>
+		static bool is_ready(const std::shared_future<T> &future) {
+			return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+	private:
+		// Decoded asset waiting for its GL upload.
+		struct upload_job {
+			std::function<void()> upload;
+			// Estimated bytes uploaded, for the budget.
+			size_t bytes;
+		};
+
+		// Uploads waiting for the render thread. Shared with the worker tasks, so tasks
+		// finishing after the loader is gone have somewhere to go.
+		struct upload_queue {
+			std::mutex mutex;
+			// Signaled when uploads are queued.
+			std::condition_variable cond;
+			std::deque<upload_job> uploads;
+			std::atomic<size_t> pending;
+
+			upload_queue() : pending(0) {
+			}
+
+			void push(upload_job job);
+		};
+
+		// Run decode on a worker, then upload on the render thread with its result.
+		// A null decode result completes the load with a null asset without uploading.
+		template <typename Asset, typename Decoded>
+		std::shared_future<Asset> load(std::function<shared_ptr<Decoded>()> decode,
+		                               std::function<size_t(const Decoded &)> get_bytes,
+		                               std::function<Asset(Decoded &)> upload) {
+			auto promise = make_shared<std::promise<Asset>>();
+			std::shared_future<Asset> future = promise->get_future().share();
+			shared_ptr<upload_queue> queue = _queue;
+			queue->pending++;
+
+			_pool->submit([queue, promise, decode, get_bytes, upload]() {
+				shared_ptr<Decoded> decoded = decode();
+				if (decoded == nullptr) {
+					promise->set_value(nullptr);
+					queue->pending--;
+					return;
+				}
+
+				queue->push({ [queue, promise, decoded, upload]() {
+					promise->set_value(upload(*decoded));
+					queue->pending--;
+				}, get_bytes(*decoded) });
+			});
+
+			return future;
+		}
+
+		WorkerPoolSharedPtr _pool;
+		shared_ptr<upload_queue> _queue;
+};
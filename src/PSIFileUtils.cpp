@@ -1,5 +1,13 @@
 #include "PSIFileUtils.h"
 
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace PSIFileUtils {
 
 std::string read_file_to_string(const std::string path) {
@@ -32,4 +40,57 @@ std::vector<unsigned char> read_file(const std::string path) {
 	return bytes;
 }
 
+mapped_file::~mapped_file() {
+#ifndef _WIN32
+	if (data != nullptr && fallback.empty()) {
+		munmap(const_cast<unsigned char *>(data), size);
+	}
+#endif
+}
+
+MappedFileSharedPtr map_file(const std::string path) {
+	auto file = std::make_shared<mapped_file>();
+
+#ifdef _WIN32
+	file->fallback = read_file(path);
+	if (file->fallback.empty()) {
+		return nullptr;
+	}
+	file->data = file->fallback.data();
+	file->size = file->fallback.size();
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return nullptr;
+	}
+
+	void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after closing.
+	close(fd);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+
+	file->data = static_cast<const unsigned char *>(data);
+	file->size = st.st_size;
+#endif
+
+	return file;
+}
+
+int64_t get_modified_time(const std::string path) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		return -1;
+	}
+
+	return st.st_mtime;
+}
+
 } // PSIFileUtils
@@ -9,7 +9,25 @@
 #include <fstream>
 #include <vector>
 
+#include <cstdint>
+#include <memory>
+
 namespace PSIFileUtils {
+	// Read-only memory mapping of a whole file, unmapped when destroyed.
+	struct mapped_file {
+		const unsigned char *data = nullptr;
+		size_t size = 0;
+		// Platforms without mmap read the file here instead.
+		std::vector<unsigned char> fallback;
+
+		~mapped_file();
+	};
+	typedef std::shared_ptr<mapped_file> MappedFileSharedPtr;
+
 	std::string read_file_to_string(const std::string path);
 	std::vector<unsigned char> read_file(const std::string path);
+	// Memory map a file for reading. Returns nullptr on failure.
+	MappedFileSharedPtr map_file(const std::string path);
+	// File modification time in seconds since epoch, -1 if the file does not exist.
+	int64_t get_modified_time(const std::string path);
 }
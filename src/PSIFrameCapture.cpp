@@ -0,0 +1,226 @@
+#include "PSIFrameCapture.h"
+
+#include "PSIImageCodec.h"
+
+#include <cstring>
+
+// How long to wait for a fence at a time, in nanoseconds.
+static const GLuint64 FENCE_TIMEOUT = 100000000;
+
+PSIFrameCapture::PSIFrameCapture(GLint ring_size, size_t max_pending_encodes, size_t encode_threads) {
+	_failed_count = 0;
+
+	_ring.resize(std::max(ring_size, 1));
+	for (auto &slot : _ring) {
+		glGenBuffers(1, &slot.pbo);
+	}
+
+	_encoders = PSIWorkerPool::create(encode_threads);
+	_max_pending_encodes = max_pending_encodes;
+	if (_max_pending_encodes == 0) {
+		_max_pending_encodes = _encoders->get_thread_count() * 2;
+	}
+}
+
+PSIFrameCapture::~PSIFrameCapture() {
+	finish();
+
+	for (auto &slot : _ring) {
+		glDeleteBuffers(1, &slot.pbo);
+	}
+}
+
+void PSIFrameCapture::capture(const std::string &path, GLint format, glm::ivec2 size, GLenum read_buffer) {
+	readback &slot = _ring[_next];
+
+	// Ring is full, the slot still holds our oldest read.
+	if (slot.fence != nullptr) {
+		collect(slot, true);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+
+	// Reallocate only when the frame grows, smaller frames use part of the buffer.
+	size_t bytes = (size_t)size.x * size.y * 3;
+	if (bytes > slot.capacity) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+		slot.capacity = bytes;
+	}
+
+	// Tightly packed rows, the encoders expect no row padding.
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(read_buffer);
+	// With a pack buffer bound, this only queues the read and returns.
+	glReadPixels(0, 0, size.x, size.y, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.path = path;
+	slot.format = format;
+	slot.size = size;
+
+	_next = (_next + 1) % _ring.size();
+
+	update();
+}
+
+void PSIFrameCapture::update() {
+	// Collect in capture order, starting from the oldest slot, and stop at the first
+	// read still in flight so the frames are queued for encoding in order.
+	for (size_t i = 0; i < _ring.size(); i++) {
+		readback &slot = _ring[(_next + i) % _ring.size()];
+		if (slot.fence == nullptr) {
+			continue;
+		}
+
+		if (collect(slot, false) == false) {
+			break;
+		}
+	}
+}
+
+void PSIFrameCapture::finish() {
+	for (size_t i = 0; i < _ring.size(); i++) {
+		readback &slot = _ring[(_next + i) % _ring.size()];
+		if (slot.fence != nullptr) {
+			collect(slot, true);
+		}
+	}
+
+	_encoders->wait_idle();
+}
+
+size_t PSIFrameCapture::get_pending_count() {
+	size_t count = _encoders->get_pending_count();
+	for (const auto &slot : _ring) {
+		if (slot.fence != nullptr) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+bool PSIFrameCapture::collect(readback &slot, bool wait) {
+	// The first wait flushes, so the fence is sure to be signaled eventually.
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	GLenum status;
+	do {
+		status = glClientWaitSync(slot.fence, flags, wait == true ? FENCE_TIMEOUT : 0);
+		flags = 0;
+	} while (wait == true && status == GL_TIMEOUT_EXPIRED);
+
+	if (status == GL_TIMEOUT_EXPIRED) {
+		return false;
+	}
+
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	if (status == GL_WAIT_FAILED) {
+		psilog_err("Waiting for frame read failed, dropping %s", slot.path.c_str());
+		_failed_count++;
+		if (_written_func != nullptr) {
+			_written_func(slot.path, false);
+		}
+		return true;
+	}
+
+	size_t bytes = (size_t)slot.size.x * slot.size.y * 3;
+
+	// Backpressure, don't let the encoders fall further behind than the limit.
+	_encoders->wait_pending(_max_pending_encodes - 1);
+
+	std::vector<unsigned char> pixels = acquire_buffer();
+	pixels.resize(bytes);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+	bool mapped_ok = mapped != nullptr;
+	if (mapped_ok == true) {
+		memcpy(pixels.data(), mapped, bytes);
+		mapped_ok = glUnmapBuffer(GL_PIXEL_PACK_BUFFER) == GL_TRUE;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (mapped_ok == false) {
+		psilog_err("Could not map frame read buffer, dropping %s", slot.path.c_str());
+		_failed_count++;
+		recycle_buffer(std::move(pixels));
+		if (_written_func != nullptr) {
+			_written_func(slot.path, false);
+		}
+		return true;
+	}
+
+	// The pixels are moved into a shared buffer, as std::function needs a copyable task.
+	auto frame = make_shared<std::vector<unsigned char>>(std::move(pixels));
+	std::string path = slot.path;
+	GLint format = slot.format;
+	glm::ivec2 size = slot.size;
+
+	_encoders->submit([this, frame, path, format, size]() {
+		bool written = encode_image(path, format, frame->data(), size.x, size.y);
+		if (written == true) {
+			psilog(PSILog::EXPORT, "Wrote screen frame to %s", path.c_str());
+		} else {
+			psilog_err("Could not write screen frame to %s", path.c_str());
+			_failed_count++;
+		}
+
+		recycle_buffer(std::move(*frame));
+
+		if (_written_func != nullptr) {
+			_written_func(path, written);
+		}
+	});
+
+	return true;
+}
+
+std::vector<unsigned char> PSIFrameCapture::acquire_buffer() {
+	std::lock_guard<std::mutex> lock(_buffer_mutex);
+	if (_free_buffers.empty() == true) {
+		return std::vector<unsigned char>();
+	}
+
+	std::vector<unsigned char> buffer = std::move(_free_buffers.back());
+	_free_buffers.pop_back();
+
+	return buffer;
+}
+
+void PSIFrameCapture::recycle_buffer(std::vector<unsigned char> &&buffer) {
+	std::lock_guard<std::mutex> lock(_buffer_mutex);
+	_free_buffers.push_back(std::move(buffer));
+}
+
+std::string PSIFrameCapture::get_file_extension(GLint format) {
+	if (format == ImageFormat::PNG) {
+		return ".png";
+	} else if (format == ImageFormat::QOI) {
+		return ".qoi";
+	}
+
+	return "";
+}
+
+bool PSIFrameCapture::encode_image(const std::string &path, GLint format,
+                                   const unsigned char *pixels, GLint width, GLint height) {
+	// Flipped while encoding, the files are top row first.
+	PSIImageCodec::encode_options options;
+	options.src_channels = 3;
+	options.channels = 3;
+	options.flip_y = true;
+
+	bool retval = false;
+
+	if (format == ImageFormat::PNG) {
+		retval = PSIImageCodec::write_png(path, pixels, width, height, options);
+	// QOI, a lossless format that compresses better and quicker than PNG.
+	} else if (format == ImageFormat::QOI) {
+		retval = PSIImageCodec::write_qoi(path, pixels, width, height, options);
+	}
+
+	return retval;
+}
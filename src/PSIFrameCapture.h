@@ -0,0 +1,118 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Asynchronous frame capture. Frames are read into a ring of pixel pack buffers,
+// and once the GPU has finished a read the pixels are copied out and encoded to
+// PNG or QOI files on worker threads, so capturing does not stall the render loop.
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIOpenGL.h"
+#include "PSIMath.h"
+#include "PSIWorkerPool.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class PSIFrameCapture;
+typedef shared_ptr<PSIFrameCapture> FrameCaptureSharedPtr;
+
+class PSIFrameCapture {
+	public:
+		enum ImageFormat {
+			PNG = 0,
+			QOI = 1
+		};
+
+		// Called on an encoder thread when a frame has been written, or failed to be.
+		typedef std::function<void(const std::string &path, bool written)> written_func;
+
+		// Reads in flight before capture() has to wait for the oldest one.
+		static const GLint DEFAULT_RING_SIZE = 3;
+
+		// With max_pending_encodes 0, allows two frames per encoder thread to be queued
+		// before capture() waits for the encoders to catch up. encode_threads 0 uses the
+		// PSIWorkerPool default.
+		PSIFrameCapture(GLint ring_size = DEFAULT_RING_SIZE, size_t max_pending_encodes = 0,
+		                size_t encode_threads = 0);
+		// Finishes all captures and deletes the buffers.
+		~PSIFrameCapture();
+
+		PSIFrameCapture(const PSIFrameCapture &) = delete;
+		PSIFrameCapture &operator=(const PSIFrameCapture &) = delete;
+
+		static FrameCaptureSharedPtr create(GLint ring_size = DEFAULT_RING_SIZE, size_t max_pending_encodes = 0,
+		                                    size_t encode_threads = 0) {
+			return make_shared<PSIFrameCapture>(ring_size, max_pending_encodes, encode_threads);
+		}
+
+		// Start reading size pixels of read_buffer from the current read framebuffer,
+		// to be written to path in format once the read is done. Waits for the oldest
+		// read when all buffers in the ring are in flight.
+		void capture(const std::string &path, GLint format, glm::ivec2 size, GLenum read_buffer = GL_BACK);
+
+		// Hand finished reads over to the encoders, without waiting for the GPU.
+		// Called by capture(), call once per frame when not capturing every frame.
+		void update();
+
+		// Wait for all reads and encodes to finish.
+		void finish();
+
+		// Set before capturing, the encoders call this without locking.
+		void set_written_func(written_func func) {
+			_written_func = func;
+		}
+
+		// Captures read or encoded right now.
+		size_t get_pending_count();
+		// Frames that failed to encode or write.
+		size_t get_failed_count() {
+			return _failed_count;
+		}
+
+		// File extension including the dot for format, or empty for unknown formats.
+		static std::string get_file_extension(GLint format);
+
+		// Encode width * height tightly packed RGB pixels to path. Rows are bottom first,
+		// as returned by glReadPixels, and written top first. Bands of rows are encoded
+		// in parallel, see PSIImageCodec.
+		static bool encode_image(const std::string &path, GLint format,
+		                         const unsigned char *pixels, GLint width, GLint height);
+
+	private:
+		// One pixel pack buffer in the ring, and the capture being read into it.
+		struct readback {
+			GLuint pbo = 0;
+			// Buffer size allocated for the pbo.
+			size_t capacity = 0;
+			// Fence for the read into pbo, nullptr when the slot is free.
+			GLsync fence = nullptr;
+			std::string path;
+			GLint format = ImageFormat::PNG;
+			glm::ivec2 size = glm::ivec2(0, 0);
+		};
+
+		// Copy the pixels out of slot and queue the encode. Waits for the read if
+		// wait is set, otherwise returns false if the read is not done yet.
+		bool collect(readback &slot, bool wait);
+
+		std::vector<unsigned char> acquire_buffer();
+		void recycle_buffer(std::vector<unsigned char> &&buffer);
+
+		std::vector<readback> _ring;
+		// Next slot to read into, which is also the oldest slot in flight.
+		GLint _next = 0;
+
+		WorkerPoolSharedPtr _encoders;
+		size_t _max_pending_encodes = 0;
+
+		// Pixel buffers returned by finished encodes, reused for the next frames.
+		std::vector<std::vector<unsigned char>> _free_buffers;
+		std::mutex _buffer_mutex;
+
+		std::atomic<size_t> _failed_count;
+		written_func _written_func;
+};
@@ -0,0 +1,376 @@
+#include "PSIFrameGraph.h"
+
+#include <algorithm>
+
+const GLint PSIFrameGraph::INVALID_ID = -1;
+
+PSIFrameGraph::resource_id PSIFrameGraph::create_target(const std::string &name,
+                                                        const PSIRenderTarget::target_desc &desc) {
+	resource res;
+	res.name = name;
+	res.desc = desc;
+	_resources.push_back(res);
+	_compiled = false;
+
+	return _resources.size() - 1;
+}
+
+PSIFrameGraph::resource_id PSIFrameGraph::import_target(const std::string &name, const RenderTargetSharedPtr &target) {
+	if (target == nullptr) {
+		psilog_err("Importing empty render target '%s'", name.c_str());
+		return INVALID_ID;
+	}
+
+	resource res;
+	res.name = name;
+	res.desc = target->get_desc();
+	res.imported = true;
+	res.target = target;
+	_resources.push_back(res);
+	_compiled = false;
+
+	return _resources.size() - 1;
+}
+
+PSIFrameGraph::resource_id PSIFrameGraph::import_screen(const std::string &name, glm::ivec2 size) {
+	resource res;
+	res.name = name;
+	res.desc.size = size;
+	res.imported = true;
+	_resources.push_back(res);
+	_compiled = false;
+
+	return _resources.size() - 1;
+}
+
+PSIFrameGraph::pass_id PSIFrameGraph::add_pass(const std::string &name, execute_func execute) {
+	pass p;
+	p.name = name;
+	p.execute = execute;
+	_passes.push_back(p);
+	_compiled = false;
+
+	return _passes.size() - 1;
+}
+
+PSIFrameGraph::pass_id PSIFrameGraph::add_scene_pass(const std::string &name, const GLRendererSharedPtr &renderer,
+                                                     const RenderSceneSharedPtr &scene,
+                                                     const CameraSharedPtr &camera, resource_id output) {
+	pass_id id = add_pass(name, [renderer, scene, camera, output](PSIFrameGraph &graph) {
+		RenderTargetSharedPtr target = graph.get_target(output);
+		if (target != nullptr) {
+			renderer->set_render_target(target->get_fbo(), target->get_size());
+		}
+		renderer->render(scene, renderer->get_context(), camera);
+		renderer->reset_render_target();
+	});
+	write(id, output);
+
+	return id;
+}
+
+void PSIFrameGraph::read(pass_id pass, resource_id resource) {
+	if (valid_pass(pass) == false || valid_resource(resource) == false) {
+		psilog_err("Invalid frame graph pass %d or resource %d", pass, resource);
+		return;
+	}
+
+	_passes[pass].reads.push_back(resource);
+	_compiled = false;
+}
+
+void PSIFrameGraph::write(pass_id pass, resource_id resource) {
+	if (valid_pass(pass) == false || valid_resource(resource) == false) {
+		psilog_err("Invalid frame graph pass %d or resource %d", pass, resource);
+		return;
+	}
+
+	_passes[pass].writes.push_back(resource);
+	_compiled = false;
+}
+
+void PSIFrameGraph::set_side_effect(pass_id pass) {
+	if (valid_pass(pass) == true) {
+		_passes[pass].side_effect = true;
+		_compiled = false;
+	}
+}
+
+GLint PSIFrameGraph::sort_passes() {
+	GLint pass_count = _passes.size();
+	std::vector<std::vector<pass_id>> dependents(pass_count);
+	std::vector<GLint> dependencies(pass_count, 0);
+
+	// Writers of a resource run in the order they were added, and its readers after
+	// all of them. A pass reading what it writes is a writer, blending onto it.
+	for (resource_id r = 0; r < (resource_id)_resources.size(); r++) {
+		std::vector<pass_id> writers;
+		for (pass_id p = 0; p < pass_count; p++) {
+			const auto &writes = _passes[p].writes;
+			if (std::find(writes.begin(), writes.end(), r) != writes.end()) {
+				if (writers.empty() == false) {
+					dependents[writers.back()].push_back(p);
+					dependencies[p]++;
+				}
+				writers.push_back(p);
+			}
+		}
+
+		for (pass_id p = 0; p < pass_count; p++) {
+			const auto &reads = _passes[p].reads;
+			if (std::find(reads.begin(), reads.end(), r) == reads.end() ||
+			    std::find(writers.begin(), writers.end(), p) != writers.end()) {
+				continue;
+			}
+
+			for (pass_id writer : writers) {
+				dependents[writer].push_back(p);
+				dependencies[p]++;
+			}
+		}
+	}
+
+	// Kahn's algorithm, taking the earliest added pass that is ready, so independent
+	// passes keep the order they were added in.
+	_order.clear();
+	std::vector<bool> done(pass_count, false);
+	while ((GLint)_order.size() < pass_count) {
+		pass_id next = INVALID_ID;
+		for (pass_id p = 0; p < pass_count; p++) {
+			if (done[p] == false && dependencies[p] == 0) {
+				next = p;
+				break;
+			}
+		}
+
+		if (next == INVALID_ID) {
+			psilog_err("Frame graph passes depend on each other in a cycle");
+			_order.clear();
+			return -1;
+		}
+
+		done[next] = true;
+		_order.push_back(next);
+		for (pass_id dependent : dependents[next]) {
+			dependencies[dependent]--;
+		}
+	}
+
+	return 0;
+}
+
+void PSIFrameGraph::cull_passes() {
+	// Walk back from the passes writing imported targets. A pass is needed when a
+	// needed pass after it reads something it writes.
+	std::vector<bool> needed(_resources.size(), false);
+	for (auto it = _order.rbegin(); it != _order.rend(); it++) {
+		pass &p = _passes[*it];
+
+		bool live = p.side_effect;
+		for (resource_id r : p.writes) {
+			live = live || _resources[r].imported == true || needed[r] == true;
+		}
+
+		p.culled = (live == false);
+		if (live == true) {
+			for (resource_id r : p.reads) {
+				needed[r] = true;
+			}
+		}
+	}
+
+	_order.erase(std::remove_if(_order.begin(), _order.end(), [this](pass_id id) {
+		return _passes[id].culled == true;
+	}), _order.end());
+}
+
+void PSIFrameGraph::assign_slots() {
+	GLint resource_count = _resources.size();
+	std::vector<GLint> first(resource_count, INVALID_ID);
+	std::vector<GLint> last(resource_count, INVALID_ID);
+
+	for (GLint i = 0; i < (GLint)_order.size(); i++) {
+		const pass &p = _passes[_order[i]];
+		for (const auto *list : { &p.reads, &p.writes }) {
+			for (resource_id r : *list) {
+				if (first[r] == INVALID_ID) {
+					first[r] = i;
+				}
+				last[r] = i;
+			}
+		}
+	}
+
+	for (auto &res : _resources) {
+		res.slot = INVALID_ID;
+	}
+	_slot_descs.clear();
+
+	// Slots freed by targets whose last pass has run, reused by targets with the
+	// same description starting in a later pass.
+	std::vector<GLint> free_slots;
+	for (GLint i = 0; i < (GLint)_order.size(); i++) {
+		const pass &p = _passes[_order[i]];
+		for (resource_id r = 0; r < resource_count; r++) {
+			resource &res = _resources[r];
+			if (res.imported == true || first[r] != i) {
+				continue;
+			}
+
+			if (std::find(p.writes.begin(), p.writes.end(), r) == p.writes.end()) {
+				psilog_err("Frame graph target '%s' is read by '%s' before it is written",
+				           res.name.c_str(), p.name.c_str());
+			}
+
+			auto it = std::find_if(free_slots.begin(), free_slots.end(), [this, &res](GLint slot) {
+				return _slot_descs[slot] == res.desc;
+			});
+			if (it != free_slots.end()) {
+				res.slot = *it;
+				free_slots.erase(it);
+			} else {
+				res.slot = _slot_descs.size();
+				_slot_descs.push_back(res.desc);
+			}
+		}
+
+		for (resource_id r = 0; r < resource_count; r++) {
+			if (_resources[r].imported == false && last[r] == i) {
+				free_slots.push_back(_resources[r].slot);
+			}
+		}
+	}
+
+	_stats.transient_count = 0;
+	_stats.transient_bytes = 0;
+	for (const auto &res : _resources) {
+		if (res.slot != INVALID_ID) {
+			_stats.transient_count++;
+			_stats.transient_bytes += PSIRenderTarget::estimate_bytes(res.desc);
+		}
+	}
+
+	_stats.physical_count = _slot_descs.size();
+	_stats.physical_bytes = 0;
+	for (const auto &desc : _slot_descs) {
+		_stats.physical_bytes += PSIRenderTarget::estimate_bytes(desc);
+	}
+}
+
+GLint PSIFrameGraph::compile() {
+	_compiled = false;
+	_stats = graph_stats();
+
+	if (sort_passes() != 0) {
+		return -1;
+	}
+	cull_passes();
+	assign_slots();
+
+	_stats.pass_count = _order.size();
+	_stats.culled_count = _passes.size() - _order.size();
+	_compiled = true;
+
+	return 0;
+}
+
+GLint PSIFrameGraph::execute() {
+	if (_compiled == false && compile() != 0) {
+		return -1;
+	}
+
+	// Hold the framebuffers for the whole run, the pool hands out each once.
+	_slot_targets.resize(_slot_descs.size());
+	GLint retval = 0;
+	for (size_t i = 0; i < _slot_descs.size(); i++) {
+		_slot_targets[i] = _pool->acquire(_slot_descs[i]);
+		if (_slot_targets[i] == nullptr) {
+			retval = -1;
+		}
+	}
+
+	if (retval == 0) {
+		for (auto &res : _resources) {
+			if (res.imported == false && res.slot != INVALID_ID) {
+				res.target = _slot_targets[res.slot];
+			}
+		}
+
+		for (pass_id id : _order) {
+			pass &p = _passes[id];
+			if (p.writes.empty() == false) {
+				const resource &output = _resources[p.writes.front()];
+				if (output.target != nullptr) {
+					output.target->bind();
+				} else {
+					glBindFramebuffer(GL_FRAMEBUFFER, 0);
+					glViewport(0, 0, output.desc.size.x, output.desc.size.y);
+				}
+			}
+
+			if (p.execute != nullptr) {
+				p.execute(*this);
+			}
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Back to the pool for the next frame.
+	for (auto &res : _resources) {
+		if (res.imported == false) {
+			res.target = nullptr;
+		}
+	}
+	_slot_targets.clear();
+
+	return retval;
+}
+
+void PSIFrameGraph::clear() {
+	_resources.clear();
+	_passes.clear();
+	_order.clear();
+	_slot_descs.clear();
+	_slot_targets.clear();
+	_compiled = false;
+	_stats = graph_stats();
+}
+
+RenderTargetSharedPtr PSIFrameGraph::get_target(resource_id resource) {
+	if (valid_resource(resource) == false) {
+		return nullptr;
+	}
+
+	return _resources[resource].target;
+}
+
+GLTextureSharedPtr PSIFrameGraph::get_texture(resource_id resource) {
+	RenderTargetSharedPtr target = get_target(resource);
+	return (target != nullptr) ? target->get_texture() : nullptr;
+}
+
+void PSIFrameGraph::log_graph() {
+	for (pass_id id : _order) {
+		const pass &p = _passes[id];
+		std::string targets;
+		for (resource_id r : p.writes) {
+			const resource &res = _resources[r];
+			targets += " " + res.name;
+			if (res.imported == false) {
+				targets += "(" + std::to_string(res.slot) + ")";
+			}
+		}
+		psilog(PSILog::OPENGL, "Pass '%s' writes%s", p.name.c_str(), targets.c_str());
+	}
+
+	for (const auto &p : _passes) {
+		if (p.culled == true) {
+			psilog(PSILog::OPENGL, "Pass '%s' culled", p.name.c_str());
+		}
+	}
+
+	psilog(PSILog::OPENGL, "%d passes, %d culled, %d transient targets in %d framebuffers, %zu of %zu bytes",
+	       _stats.pass_count, _stats.culled_count, _stats.transient_count, _stats.physical_count,
+	       _stats.physical_bytes, _stats.transient_bytes);
+}
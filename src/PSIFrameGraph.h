@@ -0,0 +1,159 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Frame graph of render passes. Passes declare the render targets they read
+// and write, and the graph runs them in dependency order. Passes whose output
+// nobody reads are culled. Transient targets only live from the first pass
+// using them to the last one, and targets with the same description whose
+// lifetimes don't overlap share one framebuffer from the render target pool,
+// so a blur chain needs two intermediates however long it is.
+//
+// Targets that outlive the frame, such as the screen or a feedback texture
+// read on the next frame, are imported. Writing an imported target, or being
+// marked with set_side_effect(), keeps a pass from being culled.
+//
+//   PSIFrameGraph::resource_id scene = graph->create_target("scene", desc);
+//   PSIFrameGraph::resource_id blur = graph->create_target("blur", desc);
+//   PSIFrameGraph::resource_id screen = graph->import_screen("screen", viewport_size);
+//   graph->add_scene_pass("scene", renderer, scene_objs, camera, scene);
+//   PSIFrameGraph::pass_id pass = graph->add_pass("blur", [&](PSIFrameGraph &graph) { ... });
+//   graph->read(pass, scene);
+//   graph->write(pass, blur);
+//   ...
+//   graph->execute();
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIOpenGL.h"
+#include "PSIRenderTargetPool.h"
+#include "PSIGLRenderer.h"
+#include "PSIRenderScene.h"
+#include "PSICamera.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class PSIFrameGraph;
+typedef shared_ptr<PSIFrameGraph> FrameGraphSharedPtr;
+
+class PSIFrameGraph {
+	public:
+		typedef GLint resource_id;
+		typedef GLint pass_id;
+
+		static const GLint INVALID_ID;
+
+		// Called to run a pass, with the first target it writes bound for drawing.
+		// Get the targets of its resources with get_target().
+		typedef std::function<void(PSIFrameGraph &graph)> execute_func;
+
+		// Result of the last compile.
+		struct graph_stats {
+			GLint pass_count = 0;
+			GLint culled_count = 0;
+			// Transient targets used by the passes run, and framebuffers they got.
+			GLint transient_count = 0;
+			GLint physical_count = 0;
+			// Estimated GPU memory of the transient targets, without and with aliasing.
+			size_t transient_bytes = 0;
+			size_t physical_bytes = 0;
+		};
+
+		PSIFrameGraph(const RenderTargetPoolSharedPtr &pool) {
+			_pool = pool;
+		}
+		~PSIFrameGraph() = default;
+
+		static FrameGraphSharedPtr create(const RenderTargetPoolSharedPtr &pool) {
+			return make_shared<PSIFrameGraph>(pool);
+		}
+
+		// Transient target, only valid while the passes using it run.
+		resource_id create_target(const std::string &name, const PSIRenderTarget::target_desc &desc);
+		// Target owned outside the graph. Its contents are kept after the frame.
+		resource_id import_target(const std::string &name, const RenderTargetSharedPtr &target);
+		// The default framebuffer, with the viewport size.
+		resource_id import_screen(const std::string &name, glm::ivec2 size);
+
+		pass_id add_pass(const std::string &name, execute_func execute);
+		// Pass rendering scene with renderer into the target output.
+		pass_id add_scene_pass(const std::string &name, const GLRendererSharedPtr &renderer,
+		                       const RenderSceneSharedPtr &scene, const CameraSharedPtr &camera,
+		                       resource_id output);
+
+		void read(pass_id pass, resource_id resource);
+		void write(pass_id pass, resource_id resource);
+		// Never cull pass, for passes with effects outside their targets.
+		void set_side_effect(pass_id pass);
+
+		// Order the passes, cull the unused ones and assign the transient targets to
+		// framebuffers. Done by execute() when the graph has changed. Returns -1 if the
+		// passes depend on each other in a cycle.
+		GLint compile();
+		// Run the passes. The transient framebuffers are taken from the pool for the
+		// run and returned to it afterwards. Returns -1 if the graph did not compile.
+		GLint execute();
+
+		// Remove all passes and resources, to build the graph again. Graphs that stay the
+		// same can be executed every frame without rebuilding.
+		void clear();
+
+		// Target of resource, valid while executing a pass that uses it. nullptr for the screen.
+		RenderTargetSharedPtr get_target(resource_id resource);
+		// Color texture of a single sampled resource, for reading it in a pass.
+		GLTextureSharedPtr get_texture(resource_id resource);
+
+		const graph_stats &get_stats() {
+			return _stats;
+		}
+
+		// Log the pass order and the target assignments of the last compile.
+		void log_graph();
+
+	private:
+		struct resource {
+			std::string name;
+			PSIRenderTarget::target_desc desc;
+			// Imported targets, nullptr with imported set for the screen.
+			bool imported = false;
+			RenderTargetSharedPtr target;
+			// Framebuffer slot of transient targets, -1 if no pass run uses it.
+			GLint slot = -1;
+		};
+
+		struct pass {
+			std::string name;
+			execute_func execute;
+			std::vector<resource_id> reads;
+			std::vector<resource_id> writes;
+			bool side_effect = false;
+			bool culled = false;
+		};
+
+		bool valid_pass(pass_id id) {
+			return id >= 0 && id < (pass_id)_passes.size();
+		}
+		bool valid_resource(resource_id id) {
+			return id >= 0 && id < (resource_id)_resources.size();
+		}
+
+		// Passes in declaration order, topologically sorted into _order.
+		GLint sort_passes();
+		void cull_passes();
+		void assign_slots();
+
+		RenderTargetPoolSharedPtr _pool;
+
+		std::vector<resource> _resources;
+		std::vector<pass> _passes;
+
+		// Passes to run, in order.
+		std::vector<pass_id> _order;
+		// Description of each framebuffer slot, and its target while executing.
+		std::vector<PSIRenderTarget::target_desc> _slot_descs;
+		std::vector<RenderTargetSharedPtr> _slot_targets;
+
+		bool _compiled = false;
+		graph_stats _stats;
+};
@@ -27,6 +27,7 @@ class PSIGLMaterial {
 				_lit(rhs._lit),
 				_textured(rhs._textured),
 				_texture(rhs._texture),
+				_texture_layer(rhs._texture_layer),
 				_shader(rhs._shader) {
 		}
 
@@ -85,6 +86,15 @@ class PSIGLMaterial {
 			return _texture;
 		}
 
+		// Layer of an array texture to sample, passed to the shader as u_texture_layer.
+		// -1 for plain 2D textures.
+		void set_texture_layer(GLint texture_layer) {
+			_texture_layer = texture_layer;
+		}
+		GLint get_texture_layer() {
+			return _texture_layer;
+		}
+
 		void set_textured(GLboolean textured) {
 			_textured = textured;
 		}
@@ -112,6 +122,8 @@ class PSIGLMaterial {
 		GLboolean _needs_update = false;
 		// Texture for this material.
 		GLTextureSharedPtr _texture;
+		// Array texture layer, -1 if not an array texture.
+		GLint _texture_layer = -1;
 		// Shader that is used to render this material.
 		ShaderSharedPtr _shader;
 };
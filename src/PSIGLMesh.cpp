@@ -7,6 +7,9 @@ PSIGLMesh::PSIGLMesh(GLuint vao, GLsizei draw_count, GLuint draw_mode) :
 PSIGLMesh::~PSIGLMesh() {
 	glDeleteVertexArrays(1, &_vao);
 	glDeleteBuffers(BufferName::BufferName_MAX + 1, _buffer_name_ids);
+	if (_extra_buffer_ids.empty() == false) {
+		glDeleteBuffers(_extra_buffer_ids.size(), _extra_buffer_ids.data());
+	}
 }
 
 void PSIGLMesh::gen_vao() {
@@ -77,7 +80,7 @@ void PSIGLMesh::draw_indexed() {
 	// We do not need to bind the buffers, as the buffer has already been bound in the vertex state
 	// when we enable vertexAttribPointer.
 	glBindVertexArray(_vao);
-	glDrawElements(_draw_mode, _draw_count, _index_type, (void *)0);
+	glDrawElements(_draw_mode, _draw_count, _index_type, reinterpret_cast<void*>(_index_offset));
 }
 
 void PSIGLMesh::draw_indexed(GLuint offset, GLuint count) {
@@ -85,3 +88,23 @@ void PSIGLMesh::draw_indexed(GLuint offset, GLuint count) {
 	glBindVertexArray(_vao);
 	glDrawElements(_draw_mode, count, _index_type, reinterpret_cast<void*>(offset * sizeof(GLuint)));
 }
+
+size_t PSIGLMesh::get_buffer_bytes() {
+	std::vector<GLuint> buffer_ids(_extra_buffer_ids);
+	buffer_ids.insert(buffer_ids.end(), std::begin(_buffer_name_ids), std::end(_buffer_name_ids));
+
+	// Binding the array buffer does not change the vao state.
+	size_t bytes = 0;
+	for (GLuint buffer_id : buffer_ids) {
+		if (buffer_id == 0) {
+			continue;
+		}
+		GLint size = 0;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+		glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+		bytes += size;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return bytes;
+}
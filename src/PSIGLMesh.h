@@ -90,11 +90,27 @@ class PSIGLMesh {
 			glBufferSubData(target, offset, size, data);
 		}
 
+		// Read back buffer subdata.
+		void get_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, GLvoid *data) {
+			glGetBufferSubData(target, offset, size, data);
+		}
+
 		// Update buffer data.
 		void buffer_data(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage) {
 			glBufferData(target, size, data, usage);
 		}
 
+		// Generate an extra buffer owned by this mesh, for data outside the named buffers.
+		GLuint add_buffer() {
+			GLuint buffer_id = 0;
+			glGenBuffers(1, &buffer_id);
+			_extra_buffer_ids.push_back(buffer_id);
+			return buffer_id;
+		}
+
+		// Bytes in the GL buffers owned by this mesh.
+		size_t get_buffer_bytes();
+
 		// Get current buffer id.
 		GLuint get_buffer_id(GLuint buffer_name_id) {
 			return _buffer_name_ids[buffer_name_id];
@@ -114,6 +130,14 @@ class PSIGLMesh {
 			return _draw_mode;
 		}
 
+		// Byte offset of the first index in the index buffer.
+		void set_index_offset(GLsizeiptr index_offset) {
+			_index_offset = index_offset;
+		}
+		GLsizeiptr get_index_offset() {
+			return _index_offset;
+		}
+
 		void set_index_type(GLenum type) {
 			_index_type = type;
 		}
@@ -130,6 +154,10 @@ class PSIGLMesh {
 		GLuint _draw_mode = GL_TRIANGLES;
 		// The index component type.
 		GLenum _index_type = GL_UNSIGNED_INT;
+		// Byte offset of the first index.
+		GLsizeiptr _index_offset = 0;
 		// Reference to vertex buffer object.
-		GLuint _buffer_name_ids[BufferName::BufferName_MAX + 1];
+		GLuint _buffer_name_ids[BufferName::BufferName_MAX + 1] = {};
+		// Buffers outside the named ones.
+		std::vector<GLuint> _extra_buffer_ids;
 };
@@ -1,35 +1,32 @@
 #include "PSIGLRenderer.h"
 
-#include "ext/qoi.h"
-#include "ext/fpng.h"
+#include "PSIFrameCapture.h"
 
 using namespace std::chrono;
 
 //#define PROFILE_SAVE_IMAGE true
 
 void PSIGLRenderer::shutdown() {
-	glDeleteFramebuffers(1, &_ctx->main_fbo);
-	glDeleteFramebuffers(1, &_ctx->msaa_fbo);
+	// Write out frames still being read or encoded.
+	finish_captures();
+	_frame_capture = nullptr;
+
+	_offscreen_target = nullptr;
+	_offscreen_msaa_target = nullptr;
+	if (_target_pool != nullptr) {
+		_target_pool->clear();
+	}
 }
 
-enum ImageFormat {
-	PNG = 0,
-	QOI = 1
-};
-
-bool write_image(const char *filepath, ImageFormat format, GLFWwindow *window) {
+bool write_image(const char *filepath, GLint format, GLFWwindow *window) {
 	GLint width;
 	GLint height;
 	glfwGetFramebufferSize(window, &width, &height);
 
-	GLsizei nrChannels = 3;
-	GLsizei stride = nrChannels * width;
-	stride += (stride % 4) ? (4 - stride % 4) : 0;
+	// Tightly packed rows, the encoders don't take a row stride.
+	std::vector<unsigned char> buffer((size_t)width * height * 3);
 
-	GLsizei bufferSize = stride * height;
-	std::vector<char> buffer(bufferSize);
-
-	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	glReadBuffer(GL_FRONT);
 
  #ifdef PROFILE_SAVE_IMAGE
@@ -47,18 +44,7 @@ bool write_image(const char *filepath, ImageFormat format, GLFWwindow *window) {
 	start = high_resolution_clock::now();
 #endif
 
-	// Use PNG or QOI target file format ? 
-
-	bool retval = false;
-
-	// PNG with alpha support.
-	if (format == ImageFormat::PNG) {
-		retval = fpng::fpng_encode_image_to_file(filepath, buffer.data(), (unsigned int)width, (unsigned int)height, 3, 0);
-	// QOI, a lossless format that compresses better and quicker than PNG.
-	} else if (format == ImageFormat::QOI) {
-		qoi_desc desc = {(unsigned int)width, (unsigned int)height, 3, QOI_SRGB};
-		retval = qoi_write(filepath, buffer.data(), &desc) > 0 ? true : false;
-	}
+	bool retval = PSIFrameCapture::encode_image(filepath, format, buffer.data(), width, height);
 
  #ifdef PROFILE_SAVE_IMAGE
 	stop = high_resolution_clock::now();
@@ -70,18 +56,10 @@ bool write_image(const char *filepath, ImageFormat format, GLFWwindow *window) {
 }
 
 bool PSIGLRenderer::write_screen_to_file(std::string path_basename, int format) {
-	std::string path;
-	std::string file_ext = "";
+	std::string file_ext = PSIFrameCapture::get_file_extension(format);
+	std::string path = path_basename + file_ext;
 
-	if (format == ImageFormat::PNG) {
-		file_ext = ".png";
-	} else if (format == ImageFormat::QOI) {
-		file_ext = ".qoi";
-	}
-
-	path = path_basename + file_ext;
-
-	bool retval = write_image(path.c_str(), (ImageFormat)format, _video->get_window());
+	bool retval = write_image(path.c_str(), format, _video->get_window());
 	if (retval == true) {
 		psilog(PSILog::EXPORT, "Wrote screen frame to %s, format = %s", path.c_str(), file_ext.c_str());
 	}
@@ -89,6 +67,25 @@ bool PSIGLRenderer::write_screen_to_file(std::string path_basename, int format)
 	return retval;
 }
 
+void PSIGLRenderer::capture_screen_to_file(std::string path_basename, int format) {
+	if (_frame_capture == nullptr) {
+		_frame_capture = PSIFrameCapture::create();
+	}
+
+	GLint width;
+	GLint height;
+	glfwGetFramebufferSize(_video->get_window(), &width, &height);
+
+	std::string path = path_basename + PSIFrameCapture::get_file_extension(format);
+	_frame_capture->capture(path, format, glm::ivec2(width, height), GL_FRONT);
+}
+
+void PSIGLRenderer::finish_captures() {
+	if (_frame_capture != nullptr) {
+		_frame_capture->finish();
+	}
+}
+
 void PSIGLRenderer::setup_lights(const ShaderSharedPtr &shader, const RenderContextSharedPtr &ctx) {
 	GLint light_index = 0;
 	for (auto light : ctx->lights) {
@@ -121,40 +118,52 @@ void PSIGLRenderer::setup_lights(const ShaderSharedPtr &shader, const RenderCont
 }
 
 GLint PSIGLRenderer::init_offscreen_texture(glm::ivec2 size) {
-	// Generate the framebuffer object for the offscreen rendering.
-	glGenFramebuffers(1, &_offscreen_fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, _offscreen_fbo);
-
-	// Generate the texture we are going to render offscreen to.
-	_offscreen_texture = PSIGLTexture::create();
-	_offscreen_texture->set_format(GL_RGB);
-
-	// Set size and initialize.
-	_offscreen_texture->set_size(size);
-	_offscreen_texture->init();
-	_offscreen_texture->set_sample_mode(PSIGLTexture::TexSampleMode::NEAREST);
-
-	// Generate depth buffer.
-	glGenRenderbuffers(1, &_offscreen_depth_buffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, _offscreen_depth_buffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, size.x, size.y);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _offscreen_depth_buffer);
-
-	// Set texture as color attachment #0.
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _offscreen_texture->get_id(), 0);
-
-	// Set the list of draw buffers.
-	GLenum draw_buffers[1] = {GL_COLOR_ATTACHMENT0};
-	glDrawBuffers(1, draw_buffers); // "1" is the size of draw_buffers.
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		printf("Failed initializing offscreen framebuffer");
+	assert(_target_pool != nullptr);
+
+	// Drop the old targets first, so the pool can hand them back for the same size.
+	_offscreen_target = nullptr;
+	_offscreen_msaa_target = nullptr;
+
+	PSIRenderTarget::target_desc desc;
+	desc.size = size;
+	desc.color_format = GL_RGB8;
+	_offscreen_target = _target_pool->acquire(desc);
+	if (_offscreen_target == nullptr) {
+		psilog_err("Failed initializing offscreen framebuffer");
 		return -1;
 	}
 
+	GLTextureSharedPtr texture = _offscreen_target->get_texture();
+	texture->bind();
+	texture->set_sample_mode(PSIGLTexture::TexSampleMode::NEAREST);
+	texture->unbind();
+
+	if (_msaa_samples > 1) {
+		desc.samples = (GLint)_msaa_samples;
+		_offscreen_msaa_target = _target_pool->acquire(desc);
+		if (_offscreen_msaa_target == nullptr) {
+			psilog_err("Failed initializing offscreen framebuffer with %d samples", desc.samples);
+			_offscreen_target = nullptr;
+			return -1;
+		}
+	}
+
 	return 0;
 }
 
+void PSIGLRenderer::end_frame() {
+	if (_target_pool != nullptr) {
+		_target_pool->end_frame();
+	}
+}
+
+void PSIGLRenderer::set_viewport_size(glm::ivec2 size) {
+	if (size != _viewport_size && _target_pool != nullptr) {
+		_target_pool->trim();
+	}
+	_viewport_size = size;
+}
+
 GLint PSIGLRenderer::init() {
 	// Create our rendering context.
 	_ctx = PSIRenderContext::create();
@@ -179,9 +188,7 @@ GLint PSIGLRenderer::init() {
 	_ctx->model.push(glm::mat4(1.0f));
 	_ctx->view.push(glm::mat4(1.0f));
 
-	// Main and MSAA frame buffer objects.
-	glGenFramebuffers(1, &_ctx->main_fbo);
-	glGenFramebuffers(1, &_ctx->msaa_fbo);
+	_target_pool = PSIRenderTargetPool::create();
 
 	check_gl_error();
 
@@ -221,24 +228,76 @@ void PSIGLRenderer::draw_render_objs(const RenderSceneSharedPtr &scene,
 	}
 }
 
+void PSIGLRenderer::step_logic(const RenderSceneSharedPtr &scene, const RenderContextSharedPtr &ctx) {
+	for (const auto &obj : scene->m_render_objs) {
+		obj->logic(ctx);
+	}
+}
+
+GLint PSIGLRenderer::seek(const RenderSceneSharedPtr &scene, const RenderContextSharedPtr &ctx,
+                          GLfloat elapsed_time, GLfloat frametime, step_func step) {
+	GLfloat start_time = ctx->elapsed_time;
+	if (elapsed_time < start_time || frametime <= 0.0f) {
+		psilog_err("Can't seek from %.2f ms to %.2f ms", start_time, elapsed_time);
+		return -1;
+	}
+
+	// Frames before the one at elapsed_time, that one runs its logic when rendered.
+	GLint steps = (GLint)floor((elapsed_time - start_time) / frametime + 0.5f);
+	ctx->frametime = frametime;
+
+	for (GLint i = 0; i < steps; i++) {
+		// Time from the step index, so seeking matches rendering every frame.
+		ctx->elapsed_time = (GLfloat)(start_time + (double)i * frametime);
+
+		if (step != nullptr) {
+			step(ctx);
+		}
+		step_logic(scene, ctx);
+
+		ctx->elapsed_frames++;
+	}
+
+	ctx->elapsed_time = elapsed_time;
+
+	return steps;
+}
+
 void PSIGLRenderer::render(const RenderSceneSharedPtr &scene,
 			   const RenderContextSharedPtr &ctx, 
 			   const CameraSharedPtr &camera) {
 
 	// Render directly to the screen.
-	if (scene->get_render_to_texture() == true) {
-		assert(_offscreen_fbo != -1);
+	bool render_to_texture = scene->get_render_to_texture();
+	if (render_to_texture == true) {
+		assert(_offscreen_target != nullptr);
 
 		// In order for this to work, we need the viewport size.
 		// In case of the offscreen texture rendering, the viewport size can be the 
-		// size of the texture.
-		glm::ivec2 texture_size = _offscreen_texture->get_size();
-		glBindFramebuffer(GL_FRAMEBUFFER, _offscreen_fbo);
-		glViewport(0, 0, texture_size.x, texture_size.y);
+		// size of the texture. With MSAA draw to the multisampled target, it is
+		// resolved to the texture after drawing.
+		RenderTargetSharedPtr target = _offscreen_target;
+		if (_offscreen_msaa_target != nullptr) {
+			target = _offscreen_msaa_target;
+		}
+		target->bind();
+		ctx->viewport_size = target->get_size();
+		ctx->main_fbo = _offscreen_target->get_fbo();
+		ctx->msaa_fbo = (_offscreen_msaa_target != nullptr) ? _offscreen_msaa_target->get_fbo() : 0;
+	} else if (_target_fbo != 0) {
+		// Render to the framebuffer set as the render target.
+		glBindFramebuffer(GL_FRAMEBUFFER, _target_fbo);
+		glViewport(0, 0, _target_size.x, _target_size.y);
+		ctx->viewport_size = _target_size;
+		ctx->main_fbo = _target_fbo;
+		ctx->msaa_fbo = 0;
 	} else {
 		// Render to screen buffer.
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		glViewport(0, 0, _viewport_size.x, _viewport_size.y);
+		ctx->viewport_size = _viewport_size;
+		ctx->main_fbo = 0;
+		ctx->msaa_fbo = 0;
 	}
 
 	// Clear the screen.
@@ -284,6 +343,10 @@ void PSIGLRenderer::render(const RenderSceneSharedPtr &scene,
 		glDisable(GL_BLEND);
 	}
 
+	if (render_to_texture == true && _offscreen_msaa_target != nullptr) {
+		_offscreen_msaa_target->resolve(_offscreen_target);
+	}
+
 	//psilog(PSILog::FREQ, "Scene rendered");
 }
 
@@ -12,6 +12,10 @@
 #include "PSIGLTexture.h"
 #include "PSIVideo.h"
 #include "PSICamera.h"
+#include "PSIFrameCapture.h"
+#include "PSIRenderTargetPool.h"
+
+#include <functional>
 
 class PSIGLRenderer;
 typedef shared_ptr<PSIGLRenderer> GLRendererSharedPtr;
@@ -54,12 +58,34 @@ class PSIGLRenderer {
 		                      const RenderContextSharedPtr &ctx,
 		                      const CameraSharedPtr &camera);
 
+		// Called for each step when seeking, for application logic outside the render objects.
+		typedef std::function<void(const RenderContextSharedPtr &ctx)> step_func;
+
+		// Run logic for all objects in the scene once, as render() does, without drawing.
+		// Object logic must not issue GL calls for this to stay GL free.
+		void step_logic(const RenderSceneSharedPtr &scene, const RenderContextSharedPtr &ctx);
+
+		// Fast forward from ctx->elapsed_time to elapsed_time in fixed frametime steps,
+		// running step and the object logic for each, without drawing. On return ctx is
+		// at elapsed_time, and the frame there is drawn with render() as usual.
+		// Logic can't be run backwards, returns -1 if elapsed_time is in the past.
+		GLint seek(const RenderSceneSharedPtr &scene, const RenderContextSharedPtr &ctx,
+		           GLfloat elapsed_time, GLfloat frametime, step_func step = nullptr);
+
 		// Setup shader uniforms for lights.
 		void setup_lights(const ShaderSharedPtr &shader, const RenderContextSharedPtr &ctx);
 
 		// Initialize texture where we should render, if rendering scene to texture.
+		// The targets come from the render target pool, so calling this again with
+		// another size returns the old ones to the pool instead of leaking them.
+		// With MSAA the scene is drawn to a multisampled target and resolved to the
+		// texture after drawing.
 		GLint init_offscreen_texture(glm::ivec2 size);
 
+		// Recycle the render targets unused for a few frames. Call once per frame,
+		// after rendering all the scenes.
+		void end_frame();
+
 		GLint cycle_draw_mode();
 		GLint set_draw_mode(GLint draw_mode);
 
@@ -83,20 +109,36 @@ class PSIGLRenderer {
 			return _ctx;
 		}
 
-		void set_viewport_size(glm::ivec2 size) {
-			_viewport_size = size;
+		// Unused render targets are deleted on resize, as most are sized by the viewport.
+		void set_viewport_size(glm::ivec2 size);
+
+		// Render to fbo instead of the screen, for scenes not rendered to the offscreen texture.
+		void set_render_target(GLuint fbo, glm::ivec2 size) {
+			_target_fbo = fbo;
+			_target_size = size;
+		}
+		// Render to the screen again.
+		void reset_render_target() {
+			_target_fbo = 0;
+			_target_size = glm::ivec2(0, 0);
 		}
 
 		GLTextureSharedPtr get_offscreen_texture() {
-			return _offscreen_texture;
+			return (_offscreen_target != nullptr) ? _offscreen_target->get_texture() : nullptr;
 		}
 
+		// Framebuffer holding the offscreen texture, resolved with MSAA.
 		GLuint get_offscreen_fbo() {
-			return _offscreen_fbo;
+			return (_offscreen_target != nullptr) ? _offscreen_target->get_fbo() : 0;
 		}
 
 		GLuint get_offscreen_depth_buffer() {
-			return _offscreen_depth_buffer;
+			return (_offscreen_target != nullptr) ? _offscreen_target->get_depth_buffer() : 0;
+		}
+
+		// Pool for offscreen passes and post effects to take their targets from.
+		RenderTargetPoolSharedPtr get_target_pool() {
+			return _target_pool;
 		}
 
 		// Store reference to the PSIVideo instance.
@@ -107,6 +149,12 @@ class PSIGLRenderer {
 		// Write current OpenGL buffer to PNG file.
 		bool write_screen_to_file(std::string path, int format);
 
+		// Like write_screen_to_file(), but returns right after queuing the read of the
+		// front buffer. The frame is written on a worker thread a few frames later.
+		void capture_screen_to_file(std::string path_basename, int format);
+		// Wait for all frames queued with capture_screen_to_file() to be written.
+		void finish_captures();
+
 	private:
 		// Current drawing context. Contains all the context variables that we need to pass around while rendering.
 		RenderContextSharedPtr _ctx;
@@ -114,14 +162,20 @@ class PSIGLRenderer {
 		// The video instance reference for accessing the video data and so on.
 		shared_ptr<PSIVideo> _video;
 
-		// Offscreen framebuffer we are rendering to.
-		GLuint _offscreen_fbo = -1;
+		// Render targets of the offscreen framebuffers, created and recycled by the pool.
+		RenderTargetPoolSharedPtr _target_pool;
+
+		// Offscreen target with the texture we are rendering to.
+		RenderTargetSharedPtr _offscreen_target;
+		// Multisampled target drawn to and resolved to the offscreen target, with MSAA.
+		RenderTargetSharedPtr _offscreen_msaa_target;
 
-		// Offscreen texture we are rendering to.
-		GLTextureSharedPtr _offscreen_texture;
+		// Framebuffer set with set_render_target(), 0 when rendering to the screen.
+		GLuint _target_fbo = 0;
+		glm::ivec2 _target_size = glm::ivec2(0, 0);
 
-		// Offscreen depth buffer.
-		GLuint _offscreen_depth_buffer = -1;
+		// Readback ring and encoders for capture_screen_to_file(), created on first use.
+		FrameCaptureSharedPtr _frame_capture;
 
 		// Draw mode sets wireframe and blending together.
 		GLint _draw_mode = DrawMode::SHADED;
@@ -163,6 +163,113 @@ GLuint PSIGLShader::compile() {
 	return _program;
 }
 
+GLboolean PSIGLShader::add_source(ShaderType type, const std::string &source) {
+	assert(_program != ShaderDefs::INVALID_SHADER);
+
+	GLuint shader = glCreateShader(std::get<0>(get_shader_type_info(type)));
+	if (shader == 0) {
+		fprintf(stderr, "Failed creating shader\n");
+		return false;
+	}
+
+	const char *shader_buf = source.c_str();
+	glShaderSource(shader, 1, &shader_buf, NULL);
+	glCompileShader(shader);
+	glAttachShader(_program, shader);
+	_shader_objs.push_back(shader);
+
+	return true;
+}
+
+GLboolean PSIGLShader::is_link_complete() {
+	if (GLEW_KHR_parallel_shader_compile == false) {
+		return true;
+	}
+
+	GLint complete = GL_FALSE;
+	glGetProgramiv(_program, GL_COMPLETION_STATUS_KHR, &complete);
+
+	return complete == GL_TRUE;
+}
+
+GLuint PSIGLShader::finish_link() {
+	assert(_program != ShaderDefs::INVALID_SHADER);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(_program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		// Compile errors show up as a failed link, so look for them first.
+		for (GLuint shader : _shader_objs) {
+			GLint compiled = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+			if (compiled == GL_FALSE) {
+				GLint info_len = 0;
+				glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_len);
+				std::vector<GLchar> info_log(info_len + 1);
+				glGetShaderInfoLog(shader, info_len, NULL, info_log.data());
+				fprintf(stderr, "Shader program compile failure:\n%s\n", info_log.data());
+			}
+		}
+
+		GLint info_len = 0;
+		glGetProgramiv(_program, GL_INFO_LOG_LENGTH, &info_len);
+		std::vector<GLchar> info_log(info_len + 1);
+		glGetProgramInfoLog(_program, info_len, NULL, info_log.data());
+		fprintf(stderr, "%s", info_log.data());
+
+		PSI_G::log(PSILog::FAIL) << "Failed linking shader '"<< _name << "'!" << std::endl;
+	}
+
+	for (GLuint &shader_obj : _shader_objs) {
+		glDetachShader(_program, shader_obj);
+		glDeleteShader(shader_obj);
+	}
+	_shader_objs.clear();
+
+	if (status == GL_FALSE) {
+		return ShaderDefs::INVALID_SHADER;
+	}
+
+	PSI_G::log(PSILog::OPENGL) << "Shader '" << _name << "'"
+				   << "compiled with id = " << _program << std::endl;
+
+	return _program;
+}
+
+GLboolean PSIGLShader::get_binary(GLenum &format, std::vector<unsigned char> &binary) {
+	assert(_program != ShaderDefs::INVALID_SHADER);
+
+	GLint length = 0;
+	glGetProgramiv(_program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return false;
+	}
+
+	binary.resize(length);
+	GLsizei written = 0;
+	glGetProgramBinary(_program, length, &written, &format, binary.data());
+	binary.resize(written);
+
+	return written > 0;
+}
+
+GLboolean PSIGLShader::load_binary(GLenum format, const GLvoid *binary, GLsizei size) {
+	assert(_program != ShaderDefs::INVALID_SHADER);
+
+	glProgramBinary(_program, format, binary, size);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(_program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		psilog(PSILog::OPENGL, "Program binary for shader '%s' rejected", _name.c_str());
+		return false;
+	}
+
+	psilog(PSILog::OPENGL, "Shader '%s' loaded from binary with id = %d", _name.c_str(), _program);
+
+	return true;
+}
+
 GLuint PSIGLShader::link_program() {
 	GLint info_len;
 	GLint status;
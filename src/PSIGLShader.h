@@ -115,6 +115,19 @@ class PSIGLShader {
 			glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat[0]));
 		}
 
+		// Return vertex attribute location for name, or AttribLocation::INVALID.
+		// Locations are cached after the first query.
+		GLint get_attrib_location(const std::string &name) {
+			auto it = _attrib_locations.find(name);
+			if (it != _attrib_locations.end()) {
+				return it->second;
+			}
+
+			GLint location = glGetAttribLocation(_program, name.c_str());
+			_attrib_locations[name] = location;
+			return location;
+		}
+
 		// Vertex attribute setting.
 		void set_vertex_attrib(GLuint index, const glm::vec2 &vec) {
 			glVertexAttrib2f(index, vec.x, vec.y);
@@ -130,6 +143,13 @@ class PSIGLShader {
 		inline GLuint add_uniform(std::string name);
 		// Query active uniforms for the current program.
 		GLuint add_uniforms();
+		// Uniform locations by name, for restoring them without querying the program.
+		const std::unordered_map<std::string, GLuint>& get_uniforms() {
+			return _uniforms;
+		}
+		void set_uniforms(const std::unordered_map<std::string, GLuint> &uniforms) {
+			_uniforms = uniforms;
+		}
 		// Specify variable names to record in transform feedback buffers.
 		void add_transform_feedback_varyings(std::vector<std::string> varyings, GLboolean interleaved);
 
@@ -140,6 +160,28 @@ class PSIGLShader {
 
 		// Compiles the shader program from our read shaders.
 		GLuint compile();
+		// Compile shader from source and attach it, without waiting for the driver. Errors are
+		// reported by finish_link. Used for compiling many programs at once, so drivers with
+		// parallel shader compile can compile them in their own threads.
+		GLboolean add_source(ShaderType type, const std::string &source);
+		// Start linking the program from the added sources, without waiting for the driver.
+		void start_link() {
+			glLinkProgram(_program);
+		}
+		// Has the driver finished the link ? Always true without parallel shader compile.
+		GLboolean is_link_complete();
+		// Wait for the link started with start_link, logging compile and link errors.
+		// Returns our program, or INVALID_SHADER on failure.
+		GLuint finish_link();
+		// Ask the driver to keep the program binary retrievable, set before compile.
+		void set_binary_retrievable(GLboolean retrievable) {
+			glProgramParameteri(_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, retrievable ? GL_TRUE : GL_FALSE);
+		}
+		// Get the linked program binary, false if the driver gives none.
+		GLboolean get_binary(GLenum &format, std::vector<unsigned char> &binary);
+		// Link our program from a binary saved with get_binary. Fails if the driver rejects it,
+		// like after a driver update.
+		GLboolean load_binary(GLenum format, const GLvoid *binary, GLsizei size);
 		// Create and return shader program id.
 		GLuint create_program();
 
@@ -170,6 +212,8 @@ class PSIGLShader {
 		std::vector<GLuint> _shader_objs;
 		// Our uniform locations in the shader, mapped by name.
 		std::unordered_map <std::string, GLuint> _uniforms;
+		// Our vertex attribute locations, mapped by name.
+		std::unordered_map <std::string, GLint> _attrib_locations;
 		// Get shader type and shader name from shader type.
 		std::tuple<GLenum, std::string> get_shader_type_info(ShaderType type);
 		// Create shader with type from shader string.
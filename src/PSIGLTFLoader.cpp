@@ -1,220 +1,1034 @@
 #include "PSIGLTFLoader.h"
 
+#include "PSIJSONReader.h"
+
+#include <cstring>
+
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
-GLMeshSharedPtr PSIGLTFLoader::create_gl_mesh(const ShaderSharedPtr &shader, const tinygltf::Scene &scene) {
-	psilog(PSILog::OPENGL, "Creating mesh from glTF scene");
+typedef PSIGLTFLoader::GLTFDocumentSharedPtr GLTFDocumentSharedPtr;
 
-	// Create new mesh object.
-	GLMeshSharedPtr mesh_obj = PSIGLMesh::create();
-	mesh_obj->gen_vao();
-	mesh_obj->bind_vao();
+// GLB container.
+static const uint32_t GLB_MAGIC = 0x46546c67;      // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4e4f534a; // "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004e4942;  // "BIN\0"
+static const size_t GLB_HEADER_SIZE = 12;
+static const size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+static uint32_t read_u32(const unsigned char *p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static GLint get_draw_mode(GLint primitive_mode) {
+	GLint draw_mode;
+
+	switch(primitive_mode) {
+	case PSIGLTFLoader::PrimitiveMode::TRIANGLES:
+		draw_mode = GL_TRIANGLES;
+		break;
+	case PSIGLTFLoader::PrimitiveMode::TRIANGLE_STRIP:
+		draw_mode = GL_TRIANGLE_STRIP;
+		break;
+	case PSIGLTFLoader::PrimitiveMode::TRIANGLE_FAN:
+		draw_mode = GL_TRIANGLE_FAN;
+		break;
+	case PSIGLTFLoader::PrimitiveMode::POINTS:
+		draw_mode = GL_POINTS;
+		break;
+	case PSIGLTFLoader::PrimitiveMode::LINES:
+		draw_mode = GL_LINES;
+		break;
+	case PSIGLTFLoader::PrimitiveMode::LINE_LOOP:
+		draw_mode = GL_LINE_LOOP;
+		break;
+	case PSIGLTFLoader::PrimitiveMode::LINE_STRIP:
+		draw_mode = GL_LINE_STRIP;
+		break;
+	default:
+		draw_mode = GL_TRIANGLES;
+	}
+
+	return draw_mode;
+}
+
+static GLint get_attrib_location(const std::string &attr_name) {
+	GLint loc;
+	if (attr_name.compare("POSITION") == 0) {
+		loc = PSIGLShader::AttribLocation::POSITION;
+	} else if (attr_name.compare("NORMAL") == 0) {
+		loc = PSIGLShader::AttribLocation::NORMAL;
+	} else if (attr_name.compare("TEXCOORD_0") == 0) {
+		loc = PSIGLShader::AttribLocation::TEXCOORD;
+	} else if (attr_name.compare("COLOR_0") == 0) {
+		loc = PSIGLShader::AttribLocation::COLOR;
+	} else if (attr_name.compare("TANGENT") == 0) {
+		loc = PSIGLShader::AttribLocation::TANGENT;
+	} else {
+		loc = PSIGLShader::AttribLocation::INVALID;
+	}
+
+	return loc;
+}
+
+static GLint get_attrib_size(const std::string &type) {
+	if (type.compare("SCALAR") == 0) {
+		return 1;
+	} else if (type.compare("VEC2") == 0) {
+		return 2;
+	} else if (type.compare("VEC3") == 0) {
+		return 3;
+	} else if (type.compare("VEC4") == 0 || type.compare("MAT2") == 0) {
+		return 4;
+	} else if (type.compare("MAT3") == 0) {
+		return 9;
+	} else if (type.compare("MAT4") == 0) {
+		return 16;
+	}
+
+	return 1;
+}
+
+static size_t get_component_bytes(GLenum component_type) {
+	switch (component_type) {
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+static std::string get_path_dir(const std::string &path) {
+	size_t pos = path.find_last_of("/\\");
+	if (pos != std::string::npos) {
+		return path.substr(0, pos + 1);
+	}
+
+	return "";
+}
+
+static int get_base64_value(unsigned char c) {
+	if (c >= 'A' && c <= 'Z') return c - 'A';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+	if (c >= '0' && c <= '9') return c - '0' + 52;
+	if (c == '+' || c == '-') return 62;
+	if (c == '/' || c == '_') return 63;
+	return -1;
+}
+
+static bool decode_base64(const std::string &in, size_t start, std::vector<unsigned char> &out) {
+	out.clear();
+	out.reserve((in.size() - start) * 3 / 4);
+
+	uint32_t bits = 0;
+	int bit_count = 0;
+	for (size_t i = start; i < in.size(); i++) {
+		if (in[i] == '=') {
+			break;
+		}
+		int value = get_base64_value(in[i]);
+		if (value < 0) {
+			return false;
+		}
+		bits = (bits << 6) | value;
+		bit_count += 6;
+		if (bit_count >= 8) {
+			bit_count -= 8;
+			out.push_back((bits >> bit_count) & 0xff);
+		}
+	}
+
+	return true;
+}
+
+// Read array of indexes.
+static void read_index_array(PSIJSONReader &reader, std::vector<GLint> &out) {
+	if (reader.begin_array() == false) {
+		return;
+	}
+	while (reader.next_element()) {
+		GLint value = -1;
+		reader.read_number(value);
+		out.push_back(value);
+	}
+}
+
+// Call func for each element of an array.
+template <typename F>
+static void read_array(PSIJSONReader &reader, F func) {
+	if (reader.begin_array() == false) {
+		return;
+	}
+	while (reader.next_element()) {
+		func();
+	}
+}
+
+static void read_buffer(PSIJSONReader &reader, std::string &uri, size_t &byte_length) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "uri") {
+			reader.read_string(uri);
+		} else if (key == "byteLength") {
+			reader.read_number(byte_length);
+		} else {
+			reader.skip_value();
+		}
+	}
+}
+
+static void read_buffer_view(PSIJSONReader &reader, PSIGLTFLoader::gltf_buffer_view &view) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "buffer") {
+			reader.read_number(view.buffer);
+		} else if (key == "byteOffset") {
+			reader.read_number(view.byte_offset);
+		} else if (key == "byteLength") {
+			reader.read_number(view.byte_length);
+		} else if (key == "byteStride") {
+			reader.read_number(view.byte_stride);
+		} else if (key == "target") {
+			reader.read_number(view.target);
+		} else {
+			reader.skip_value();
+		}
+	}
+}
+
+static void read_accessor(PSIJSONReader &reader, PSIGLTFLoader::gltf_accessor &accessor) {
+	std::string key;
+	std::string type;
+	size_t min_count = 0;
+	size_t max_count = 0;
+
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "bufferView") {
+			reader.read_number(accessor.buffer_view);
+		} else if (key == "byteOffset") {
+			reader.read_number(accessor.byte_offset);
+		} else if (key == "componentType") {
+			reader.read_number(accessor.component_type);
+		} else if (key == "normalized") {
+			bool normalized = false;
+			reader.read_bool(normalized);
+			accessor.normalized = normalized ? GL_TRUE : GL_FALSE;
+		} else if (key == "count") {
+			reader.read_number(accessor.count);
+		} else if (key == "type") {
+			reader.read_string(type);
+			accessor.size = get_attrib_size(type);
+		} else if (key == "min") {
+			min_count = reader.read_numbers(accessor.min, 4);
+		} else if (key == "max") {
+			max_count = reader.read_numbers(accessor.max, 4);
+		} else {
+			// Sparse accessors are not supported, the base data is used as is.
+			reader.skip_value();
+		}
+	}
+
+	accessor.has_bounds = (min_count > 0 && min_count == max_count) ? GL_TRUE : GL_FALSE;
+}
+
+static void read_primitive(PSIJSONReader &reader, PSIGLTFLoader::gltf_primitive &primitive) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "attributes") {
+			PSIGLTFLoader::gltf_attribute attribute;
+			reader.begin_object();
+			while (reader.next_key(attribute.name)) {
+				reader.read_number(attribute.accessor);
+				primitive.attributes.push_back(attribute);
+			}
+		} else if (key == "indices") {
+			reader.read_number(primitive.indices);
+		} else if (key == "material") {
+			reader.read_number(primitive.material);
+		} else if (key == "mode") {
+			reader.read_number(primitive.mode);
+		} else {
+			// Morph targets are not supported.
+			reader.skip_value();
+		}
+	}
+}
+
+static void read_mesh(PSIJSONReader &reader, PSIGLTFLoader::gltf_mesh &mesh) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "name") {
+			reader.read_string(mesh.name);
+		} else if (key == "primitives") {
+			read_array(reader, [&]() {
+				mesh.primitives.emplace_back();
+				read_primitive(reader, mesh.primitives.back());
+			});
+		} else {
+			reader.skip_value();
+		}
+	}
+}
 
-	std::map<std::string, GLuint> buffer_ids;
-
-	for (const auto &it : scene.bufferViews) {
-		const tinygltf::BufferView &view = it.second;
-
-		if (view.target == 0) {
-			std::cout << "WARN: view.target is zero" << std::endl;
-			continue;  // Unsupported view.
-		}
-
-		const tinygltf::Buffer &buffer = scene.buffers.at(view.buffer);
-		assert((view.byteOffset + view.byteLength) <= buffer.data.size());
-
-		// We have one buffer per buffer view.
-		// Generate the buffer for that.
-		GLuint buffer_id;
-		glGenBuffers(1, &buffer_id);
-		glBindBuffer(view.target, buffer_id);
-		glBufferData(view.target, view.byteLength, &buffer.data.at(0) + view.byteOffset, GL_STATIC_DRAW);
-
-		psilog(PSILog::OPENGL, "view.target = %d .buffer = %s .byteOffset = %d .byteLength = %d", 
-					view.target, view.buffer.c_str(), view.byteOffset, view.byteLength);
-
-		// Store the id for later reference.
-		buffer_ids[it.first] = buffer_id;
-	}
-
-	/*
-	for (auto buffer_id : buffer_ids) {
-		plog_s("buffer_ids[%s] = %d", buffer_id.first.c_str(), buffer_id.second);
-	}
-	*/
-
-	// Setup the meshes.
-	for (const auto &node_it : scene.nodes ) {
-		const tinygltf::Node &node = node_it.second;
-
-		GLuint draw_count = 0;
-		GLint draw_mode = 0;
-		GLenum index_type = GL_UNSIGNED_SHORT;
-		for (const auto &mesh_name : node.meshes) {
-			auto mesh_it = scene.meshes.find(mesh_name);
-
-			// Initialize buffers, indexes and vertex attributes for this mesh.
-			if (mesh_it != scene.meshes.end()) {
-				psilog(PSILog::OPENGL, "Setting up mesh %s", mesh_it->first.c_str());
-
-				const tinygltf::Mesh &mesh = mesh_it->second;
-				for (const auto &primitive : mesh.primitives) {
-					//plog_s("primitive.indices_accessor = %s", primitive.indices.c_str());
-					// Get the indexes accessor 
-					auto indices_accessor_it = scene.accessors.find(primitive.indices);
-      				const tinygltf::Accessor &indices_accessor = indices_accessor_it->second;
-
-					draw_count = indices_accessor.count;
-					index_type = indices_accessor.componentType;
-
-					auto get_draw_mode = [](GLint primitive_mode) {
-						GLint draw_mode;
-
-						switch(primitive_mode) {
-						case TINYGLTF_MODE_TRIANGLES:
-							draw_mode = GL_TRIANGLES;
-							break;
-						case TINYGLTF_MODE_TRIANGLE_STRIP:
-							draw_mode = GL_TRIANGLE_STRIP;
-							break;
-						case TINYGLTF_MODE_TRIANGLE_FAN:
-							draw_mode = GL_TRIANGLE_FAN;
-							break;
-						case TINYGLTF_MODE_POINTS:
-							draw_mode = GL_POINTS;
-							break;
-						case TINYGLTF_MODE_LINE:
-							draw_mode = GL_LINES;
-							break;
-						case TINYGLTF_MODE_LINE_LOOP:
-							draw_mode = GL_LINE_LOOP;
-							break;
-						default:
-							draw_mode = GL_TRIANGLES;
-						}
-
-						return draw_mode;
-					};
-					draw_mode = get_draw_mode(primitive.mode);
-
-					//plog_s("indexes draw_count=%d draw_mode=%d index_type = %d", draw_count, draw_mode, index_type);
-					for (const auto &attribute : primitive.attributes) {
-						std::string attr_name = attribute.first;
-						std::string attr_accessor = attribute.second;
-
-						auto accessor_it = scene.accessors.find(attr_accessor);
-      					const tinygltf::Accessor &accessor = accessor_it->second;
-
-						// At this point we should have all the data to setup the vertex attributes
-						glBindBuffer(GL_ARRAY_BUFFER, buffer_ids[accessor.bufferView]);
-
-						auto get_attrib_location = [](std::string attr_name) {
-							GLuint loc;
-							if (attr_name.compare("POSITION") == 0) {
-								loc = PSIGLShader::AttribLocation::POSITION;
-							} else if (attr_name.compare("NORMAL") == 0) {
-								loc = PSIGLShader::AttribLocation::NORMAL;
-							} else if (attr_name.compare("TEXCOORD_0") == 0) {
-								loc = PSIGLShader::AttribLocation::TEXCOORD;
-							} else {
-								loc = PSIGLShader::AttribLocation::INVALID;
-							}
-
-							return loc;
-						};
-						GLuint loc = get_attrib_location(attr_name);
-
-						auto get_attrib_size = [](GLint type) {
-							GLint size;
-							switch (type) {
-							case TINYGLTF_TYPE_SCALAR:
-								size = 1;
-								break;
-							case TINYGLTF_TYPE_VEC2:
-								size = 2;
-								break;
-							case TINYGLTF_TYPE_VEC3:
-								size = 3;
-								break;
-							case TINYGLTF_TYPE_VEC4:
-								size = 4;
-								break;
-							default:
-								size = 1;
-								break;
-							}
-
-							return size;
-						};
-						GLint size = get_attrib_size(accessor.type);
-
-						glVertexAttribPointer(loc, size, accessor.componentType, GL_FALSE,
-								      accessor.byteStride, BUFFER_OFFSET(accessor.byteOffset));
-						glEnableVertexAttribArray(loc);
-
-						psilog(PSILog::OPENGL, 
-							"Enabled vertex attrib %s for location = %d, size = %d stride = %d offset = %d type = %d", 
-							accessor_it->first.c_str(), loc, size, 
-							accessor.byteStride, accessor.byteOffset, accessor.componentType);
+static void read_node(PSIJSONReader &reader, PSIGLTFLoader::gltf_node &node) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "name") {
+			reader.read_string(node.name);
+		} else if (key == "mesh") {
+			reader.read_number(node.mesh);
+		} else if (key == "children") {
+			read_index_array(reader, node.children);
+		} else if (key == "matrix") {
+			// Column major, same as glm.
+			GLfloat m[16];
+			if (reader.read_numbers(m, 16) == 16) {
+				node.matrix = glm::make_mat4(m);
+				node.has_matrix = GL_TRUE;
+			}
+		} else if (key == "translation") {
+			GLfloat t[3];
+			if (reader.read_numbers(t, 3) == 3) {
+				node.translation = glm::vec3(t[0], t[1], t[2]);
+			}
+		} else if (key == "rotation") {
+			// Stored as x, y, z, w.
+			GLfloat r[4];
+			if (reader.read_numbers(r, 4) == 4) {
+				node.rotation = glm::quat(r[3], r[0], r[1], r[2]);
+			}
+		} else if (key == "scale") {
+			GLfloat s[3];
+			if (reader.read_numbers(s, 3) == 3) {
+				node.scale = glm::vec3(s[0], s[1], s[2]);
+			}
+		} else {
+			reader.skip_value();
+		}
+	}
+}
+
+static void read_texture_info(PSIJSONReader &reader, GLint &texture) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "index") {
+			reader.read_number(texture);
+		} else {
+			reader.skip_value();
+		}
+	}
+}
+
+static void read_material(PSIJSONReader &reader, PSIGLTFLoader::gltf_material &material) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "name") {
+			reader.read_string(material.name);
+		} else if (key == "doubleSided") {
+			bool double_sided = false;
+			reader.read_bool(double_sided);
+			material.double_sided = double_sided ? GL_TRUE : GL_FALSE;
+		} else if (key == "pbrMetallicRoughness") {
+			reader.begin_object();
+			while (reader.next_key(key)) {
+				if (key == "baseColorFactor") {
+					GLfloat c[4];
+					if (reader.read_numbers(c, 4) == 4) {
+						material.base_color_factor = glm::vec4(c[0], c[1], c[2], c[3]);
 					}
+				} else if (key == "baseColorTexture") {
+					read_texture_info(reader, material.base_color_texture);
+				} else {
+					reader.skip_value();
 				}
 			}
+		} else {
+			reader.skip_value();
+		}
+	}
+}
 
-			// Set draw mode and count for indexed drawing
-			mesh_obj->set_draw_mode(draw_mode);
-			mesh_obj->set_draw_count(draw_count);
-			mesh_obj->set_index_type(index_type);
+static void read_texture(PSIJSONReader &reader, PSIGLTFLoader::gltf_texture &texture) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "source") {
+			reader.read_number(texture.source);
+		} else {
+			reader.skip_value();
+		}
+	}
+}
 
-			psilog(PSILog::OPENGL, "Created mesh with draw_count = %d", draw_count);	
+static void read_image(PSIJSONReader &reader, PSIGLTFLoader::gltf_image &image) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "uri") {
+			reader.read_string(image.uri);
+		} else if (key == "bufferView") {
+			reader.read_number(image.buffer_view);
+		} else {
+			reader.skip_value();
 		}
 	}
+}
 
-	return mesh_obj;
+static void read_scene(PSIJSONReader &reader, PSIGLTFLoader::gltf_scene &scene) {
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "name") {
+			reader.read_string(scene.name);
+		} else if (key == "nodes") {
+			read_index_array(reader, scene.nodes);
+		} else {
+			reader.skip_value();
+		}
+	}
 }
 
-static std::string get_path_ext(const std::string &path) {
-	if (path.find_last_of(".") != std::string::npos) {
-		return path.substr(path.find_last_of(".") + 1);
+// Resolve buffer uri to a byte range. Buffers without uri point to the GLB binary chunk.
+static bool resolve_buffer(const GLTFDocumentSharedPtr &doc, const std::string &path, const std::string &uri,
+                           size_t byte_length, const unsigned char *bin_chunk, size_t bin_chunk_size,
+                           PSIGLTFLoader::gltf_buffer &buffer) {
+	const unsigned char *data = nullptr;
+	size_t size = 0;
+
+	if (uri.empty()) {
+		data = bin_chunk;
+		size = bin_chunk_size;
+	} else if (uri.compare(0, 5, "data:") == 0) {
+		size_t comma = uri.find(',');
+		if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) {
+			psilog_err("Unsupported data uri in '%s'", path.c_str());
+			return false;
+		}
+
+		doc->owned_data.emplace_back();
+		if (decode_base64(uri, comma + 1, doc->owned_data.back()) == false) {
+			psilog_err("Broken base64 data uri in '%s'", path.c_str());
+			return false;
+		}
+		data = doc->owned_data.back().data();
+		size = doc->owned_data.back().size();
+	} else {
+		std::string buffer_path = doc->base_dir + uri;
+		PSIFileUtils::MappedFileSharedPtr file = PSIFileUtils::map_file(buffer_path);
+		if (file == nullptr) {
+			psilog_err("Could not map glTF buffer '%s'", buffer_path.c_str());
+			return false;
+		}
+		doc->mapped_files.push_back(file);
+		data = file->data;
+		size = file->size;
+	}
+
+	if (data == nullptr || size < byte_length) {
+		psilog_err("glTF buffer is smaller than its byteLength %zu in '%s'", byte_length, path.c_str());
+		return false;
 	}
 
-	return "";
+	buffer.data = data;
+	buffer.byte_length = byte_length;
+
+	return true;
 }
 
-GLMeshSharedPtr PSIGLTFLoader::load_gl_mesh(const ShaderSharedPtr &shader, std::string scene_path) {
-	tinygltf::Scene scene;
-	tinygltf::TinyGLTFLoader loader;
-
-	std::string err;
-	std::string ext = get_path_ext(scene_path);
-	bool ret = false;
-	if (ext.compare("glb") == 0) {
-		// assume binary glTF.
-		ret = loader.LoadBinaryFromFile(&scene, &err, scene_path.c_str());
+// Check that all indexes point inside the document, and that accessors fit their views.
+static bool validate_document(const GLTFDocumentSharedPtr &doc, const std::string &path) {
+	for (auto &view : doc->buffer_views) {
+		if (view.buffer < 0 || view.buffer >= (GLint)doc->buffers.size() ||
+		    view.byte_offset + view.byte_length > doc->buffers[view.buffer].byte_length) {
+			psilog_err("glTF buffer view is out of range in '%s'", path.c_str());
+			return false;
+		}
+	}
+
+	for (auto &accessor : doc->accessors) {
+		if (accessor.buffer_view < 0 || accessor.count == 0) {
+			continue;
+		}
+		if (accessor.buffer_view >= (GLint)doc->buffer_views.size()) {
+			psilog_err("glTF accessor buffer view is out of range in '%s'", path.c_str());
+			return false;
+		}
+
+		const PSIGLTFLoader::gltf_buffer_view &view = doc->buffer_views[accessor.buffer_view];
+		size_t element_size = get_component_bytes(accessor.component_type) * accessor.size;
+		size_t stride = view.byte_stride > 0 ? view.byte_stride : element_size;
+		if (accessor.byte_offset + stride * (accessor.count - 1) + element_size > view.byte_length) {
+			psilog_err("glTF accessor is out of range of its buffer view in '%s'", path.c_str());
+			return false;
+		}
+	}
+
+	GLint image_count = doc->images.size();
+	for (auto &texture : doc->textures) {
+		if (texture.source >= image_count) {
+			psilog_err("glTF texture source is out of range in '%s'", path.c_str());
+			return false;
+		}
+	}
+
+	GLint texture_count = doc->textures.size();
+	for (auto &material : doc->materials) {
+		if (material.base_color_texture >= texture_count) {
+			psilog_err("glTF material texture is out of range in '%s'", path.c_str());
+			return false;
+		}
+	}
+
+	GLint accessor_count = doc->accessors.size();
+	GLint material_count = doc->materials.size();
+	for (auto &mesh : doc->meshes) {
+		for (auto &primitive : mesh.primitives) {
+			if (primitive.indices >= accessor_count || primitive.material >= material_count) {
+				psilog_err("glTF primitive indices or material are out of range in '%s'", path.c_str());
+				return false;
+			}
+			for (auto &attribute : primitive.attributes) {
+				if (attribute.accessor < 0 || attribute.accessor >= accessor_count) {
+					psilog_err("glTF attribute %s is out of range in '%s'", attribute.name.c_str(), path.c_str());
+					return false;
+				}
+			}
+		}
+	}
+
+	GLint mesh_count = doc->meshes.size();
+	GLint node_count = doc->nodes.size();
+	for (auto &node : doc->nodes) {
+		if (node.mesh >= mesh_count) {
+			psilog_err("glTF node mesh is out of range in '%s'", path.c_str());
+			return false;
+		}
+		for (GLint child : node.children) {
+			if (child < 0 || child >= node_count) {
+				psilog_err("glTF node child is out of range in '%s'", path.c_str());
+				return false;
+			}
+		}
+	}
+
+	for (auto &scene : doc->scenes) {
+		for (GLint node : scene.nodes) {
+			if (node < 0 || node >= node_count) {
+				psilog_err("glTF scene node is out of range in '%s'", path.c_str());
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+GLTFDocumentSharedPtr PSIGLTFLoader::load_document(std::string path) {
+	PSIFileUtils::MappedFileSharedPtr file = PSIFileUtils::map_file(path);
+	if (file == nullptr) {
+		psilog_err("Could not open glTF file '%s'", path.c_str());
+		return nullptr;
+	}
+
+	const char *json = reinterpret_cast<const char *>(file->data);
+	size_t json_size = file->size;
+	const unsigned char *bin_chunk = nullptr;
+	size_t bin_chunk_size = 0;
+
+	// Binary glTF, find the JSON and binary chunks.
+	if (file->size >= GLB_HEADER_SIZE && read_u32(file->data) == GLB_MAGIC) {
+		size_t length = std::min((size_t)read_u32(file->data + 8), file->size);
+		json = nullptr;
+
+		size_t offset = GLB_HEADER_SIZE;
+		while (offset + GLB_CHUNK_HEADER_SIZE <= length) {
+			size_t chunk_size = read_u32(file->data + offset);
+			uint32_t chunk_type = read_u32(file->data + offset + 4);
+			offset += GLB_CHUNK_HEADER_SIZE;
+			if (offset + chunk_size > length) {
+				break;
+			}
+
+			if (chunk_type == GLB_CHUNK_JSON && json == nullptr) {
+				json = reinterpret_cast<const char *>(file->data + offset);
+				json_size = chunk_size;
+			} else if (chunk_type == GLB_CHUNK_BIN && bin_chunk == nullptr) {
+				bin_chunk = file->data + offset;
+				bin_chunk_size = chunk_size;
+			}
+			// Chunks are padded to 4 bytes.
+			offset += (chunk_size + 3) & ~(size_t)3;
+		}
+
+		if (json == nullptr) {
+			psilog_err("No JSON chunk in GLB file '%s'", path.c_str());
+			return nullptr;
+		}
+	}
+
+	GLTFDocumentSharedPtr doc = make_shared<gltf_document>();
+	doc->mapped_files.push_back(file);
+	doc->base_dir = get_path_dir(path);
+
+	std::vector<std::string> buffer_uris;
+	std::vector<size_t> buffer_lengths;
+	std::string version;
+
+	PSIJSONReader reader(json, json_size);
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "asset") {
+			reader.begin_object();
+			while (reader.next_key(key)) {
+				if (key == "version") {
+					reader.read_string(version);
+				} else {
+					reader.skip_value();
+				}
+			}
+		} else if (key == "buffers") {
+			read_array(reader, [&]() {
+				buffer_uris.emplace_back();
+				buffer_lengths.push_back(0);
+				read_buffer(reader, buffer_uris.back(), buffer_lengths.back());
+			});
+		} else if (key == "bufferViews") {
+			read_array(reader, [&]() {
+				doc->buffer_views.emplace_back();
+				read_buffer_view(reader, doc->buffer_views.back());
+			});
+		} else if (key == "accessors") {
+			read_array(reader, [&]() {
+				doc->accessors.emplace_back();
+				read_accessor(reader, doc->accessors.back());
+			});
+		} else if (key == "meshes") {
+			read_array(reader, [&]() {
+				doc->meshes.emplace_back();
+				read_mesh(reader, doc->meshes.back());
+			});
+		} else if (key == "nodes") {
+			read_array(reader, [&]() {
+				doc->nodes.emplace_back();
+				read_node(reader, doc->nodes.back());
+			});
+		} else if (key == "materials") {
+			read_array(reader, [&]() {
+				doc->materials.emplace_back();
+				read_material(reader, doc->materials.back());
+			});
+		} else if (key == "textures") {
+			read_array(reader, [&]() {
+				doc->textures.emplace_back();
+				read_texture(reader, doc->textures.back());
+			});
+		} else if (key == "images") {
+			read_array(reader, [&]() {
+				doc->images.emplace_back();
+				read_image(reader, doc->images.back());
+			});
+		} else if (key == "scenes") {
+			read_array(reader, [&]() {
+				doc->scenes.emplace_back();
+				read_scene(reader, doc->scenes.back());
+			});
+		} else if (key == "scene") {
+			reader.read_number(doc->scene);
+		} else {
+			reader.skip_value();
+		}
+	}
+
+	if (reader.has_error() == true) {
+		psilog_err("glTF JSON parse error at byte %zu in '%s'", reader.get_error_offset(), path.c_str());
+		return nullptr;
+	}
+
+	if (version.compare(0, 1, "2") != 0) {
+		psilog_err("Unsupported glTF version '%s' in '%s', only 2.0 is supported",
+		           version.c_str(), path.c_str());
+		return nullptr;
+	}
+
+	doc->buffers.resize(buffer_uris.size());
+	for (size_t i = 0; i < buffer_uris.size(); i++) {
+		// Only the first buffer may refer to the GLB binary chunk.
+		if (buffer_uris[i].empty() && (i > 0 || bin_chunk == nullptr)) {
+			psilog_err("glTF buffer %zu has no uri in '%s'", i, path.c_str());
+			return nullptr;
+		}
+		if (resolve_buffer(doc, path, buffer_uris[i], buffer_lengths[i], bin_chunk, bin_chunk_size,
+		                   doc->buffers[i]) == false) {
+			return nullptr;
+		}
+	}
+
+	if (validate_document(doc, path) == false) {
+		return nullptr;
+	}
+
+	if (doc->scene < 0 && doc->scenes.empty() == false) {
+		doc->scene = 0;
+	}
+	if (doc->scene >= (GLint)doc->scenes.size()) {
+		doc->scene = -1;
+	}
+
+	psilog(PSILog::LOAD, "Loaded glTF '%s' with %zu meshes, %zu nodes, %zu accessors", path.c_str(),
+	       doc->meshes.size(), doc->nodes.size(), doc->accessors.size());
+
+	return doc;
+}
+
+static bool is_indexed(const GLTFDocumentSharedPtr &doc, const PSIGLTFLoader::gltf_primitive &primitive) {
+	return primitive.indices >= 0 && doc->accessors[primitive.indices].buffer_view >= 0;
+}
+
+GLint PSIGLTFLoader::find_first_mesh(const GLTFDocumentSharedPtr &doc) {
+	if (doc->scene >= 0) {
+		std::vector<GLint> stack(doc->scenes[doc->scene].nodes.rbegin(), doc->scenes[doc->scene].nodes.rend());
+		// Guard against cycles in broken files.
+		size_t visited = 0;
+		while (stack.empty() == false && visited++ <= doc->nodes.size()) {
+			const PSIGLTFLoader::gltf_node &node = doc->nodes[stack.back()];
+			stack.pop_back();
+			if (node.mesh >= 0) {
+				return node.mesh;
+			}
+			stack.insert(stack.end(), node.children.rbegin(), node.children.rend());
+		}
+	}
+
+	return doc->meshes.empty() ? -1 : 0;
+}
+
+// Set up the vertex attributes and draw call of primitive in the bound VAO of mesh_obj.
+// Buffer views are uploaded on first use into buffers from gen_buffer, view_buffer_ids
+// keeps the ids of the views uploaded so far.
+static void setup_primitive(const GLMeshSharedPtr &mesh_obj, const GLTFDocumentSharedPtr &doc,
+                            const PSIGLTFLoader::gltf_primitive &primitive, std::vector<GLuint> &view_buffer_ids,
+                            const std::function<GLuint()> &gen_buffer) {
+	// One GL buffer per buffer view, uploaded straight from the mapped file.
+	auto bind_view_buffer = [&](GLint view_index, GLenum target) {
+		if (view_buffer_ids[view_index] == 0) {
+			const PSIGLTFLoader::gltf_buffer_view &view = doc->buffer_views[view_index];
+			const PSIGLTFLoader::gltf_buffer &buffer = doc->buffers[view.buffer];
+
+			view_buffer_ids[view_index] = gen_buffer();
+			glBindBuffer(target, view_buffer_ids[view_index]);
+			glBufferData(target, view.byte_length, buffer.data + view.byte_offset, GL_STATIC_DRAW);
+
+			psilog(PSILog::OPENGL, "Uploaded buffer view %d target = %d byteOffset = %zu byteLength = %zu",
+			       view_index, target, view.byte_offset, view.byte_length);
+		} else {
+			glBindBuffer(target, view_buffer_ids[view_index]);
+		}
+	};
+
+	GLuint vertex_count = 0;
+	for (const auto &attribute : primitive.attributes) {
+		const PSIGLTFLoader::gltf_accessor &accessor = doc->accessors[attribute.accessor];
+		GLint loc = get_attrib_location(attribute.name);
+		if (loc == PSIGLShader::AttribLocation::INVALID || accessor.buffer_view < 0) {
+			continue;
+		}
+
+		bind_view_buffer(accessor.buffer_view, GL_ARRAY_BUFFER);
+
+		const PSIGLTFLoader::gltf_buffer_view &view = doc->buffer_views[accessor.buffer_view];
+		glVertexAttribPointer(loc, accessor.size, accessor.component_type, accessor.normalized,
+		                      view.byte_stride, BUFFER_OFFSET(accessor.byte_offset));
+		glEnableVertexAttribArray(loc);
+
+		if (loc == PSIGLShader::AttribLocation::POSITION) {
+			vertex_count = accessor.count;
+		}
+
+		psilog(PSILog::OPENGL, "Enabled vertex attrib %s for location = %d, size = %d stride = %d offset = %zu type = %d",
+		       attribute.name.c_str(), loc, accessor.size, view.byte_stride, accessor.byte_offset,
+		       accessor.component_type);
+	}
+
+	// Set draw mode and count for indexed drawing, or plain vertex count if there are no indexes.
+	mesh_obj->set_draw_mode(get_draw_mode(primitive.mode));
+	if (is_indexed(doc, primitive) == true) {
+		const PSIGLTFLoader::gltf_accessor &indices_accessor = doc->accessors[primitive.indices];
+		bind_view_buffer(indices_accessor.buffer_view, GL_ELEMENT_ARRAY_BUFFER);
+
+		mesh_obj->set_draw_count(indices_accessor.count);
+		mesh_obj->set_index_type(indices_accessor.component_type);
+		mesh_obj->set_index_offset(indices_accessor.byte_offset);
 	} else {
-		// assume ascii glTF.
-		ret = loader.LoadASCIIFromFile(&scene, &err, scene_path.c_str());
+		mesh_obj->set_draw_count(vertex_count);
 	}
+}
 
-	if (!err.empty()) {
-		printf("Err: %s\n", err.c_str());
+GLMeshSharedPtr PSIGLTFLoader::create_gl_mesh(const ShaderSharedPtr &shader, const GLTFDocumentSharedPtr &doc,
+                                              GLuint mesh_index, GLuint primitive_index) {
+	if (mesh_index >= doc->meshes.size() || primitive_index >= doc->meshes[mesh_index].primitives.size()) {
+		psilog_err("No glTF mesh %d primitive %d", mesh_index, primitive_index);
 		return nullptr;
 	}
 
-	if (!ret) {
-		printf("Failed to parse glTF\n");
+	psilog(PSILog::OPENGL, "Creating mesh from glTF mesh %d primitive %d", mesh_index, primitive_index);
+
+	// Create new mesh object.
+	GLMeshSharedPtr mesh_obj = PSIGLMesh::create();
+	mesh_obj->gen_vao();
+	mesh_obj->bind_vao();
+
+	// The buffers are owned by the mesh.
+	std::vector<GLuint> view_buffer_ids(doc->buffer_views.size(), 0);
+	setup_primitive(mesh_obj, doc, doc->meshes[mesh_index].primitives[primitive_index], view_buffer_ids,
+	                [&mesh_obj]() { return mesh_obj->add_buffer(); });
+
+	psilog(PSILog::OPENGL, "Created mesh with draw_count = %d", mesh_obj->get_draw_count());
+
+	return mesh_obj;
+}
+
+GLMeshSharedPtr PSIGLTFLoader::load_gl_mesh(const ShaderSharedPtr &shader, std::string scene_path) {
+	GLTFDocumentSharedPtr doc = load_document(scene_path);
+	if (doc == nullptr) {
 		return nullptr;
 	}
 
-	/*
-	printf("Loaded glTF scene succesfully!\n");
-	for (auto &&node : scene.nodes) {
-		std::cout << "node.name : " << node.second.name << std::endl;
+	GLint mesh_index = find_first_mesh(doc);
+	if (mesh_index < 0) {
+		psilog_err("No meshes in glTF file '%s'", scene_path.c_str());
+		return nullptr;
 	}
-	*/
 
 	assert(shader != nullptr);
-	GLMeshSharedPtr mesh = create_gl_mesh(shader, scene);
+	GLMeshSharedPtr mesh = create_gl_mesh(shader, doc, mesh_index);
 
 	return mesh;
 }
 
+static bool is_image_file(const PSIGLTFLoader::gltf_image &image) {
+	return image.uri.empty() == false && image.uri.compare(0, 5, "data:") != 0;
+}
+
+void PSIGLTFLoader::decode_images(const GLTFDocumentSharedPtr &doc) {
+	doc->decoded_images.resize(doc->images.size());
+	for (size_t i = 0; i < doc->images.size(); i++) {
+		if (is_image_file(doc->images[i]) == true) {
+			PSIGLTexture::decode_image(doc->base_dir + doc->images[i].uri, doc->decoded_images[i]);
+		}
+	}
+}
+
+// Local transform of node.
+static glm::mat4 get_node_matrix(const PSIGLTFLoader::gltf_node &node) {
+	if (node.has_matrix == true) {
+		return node.matrix;
+	}
+
+	return glm::translate(glm::mat4(1.0f), node.translation) * glm::mat4_cast(node.rotation) *
+	       glm::scale(glm::mat4(1.0f), node.scale);
+}
+
+RenderModelSharedPtr PSIGLTFLoader::create_model(const GLMaterialSharedPtr &material, const GLTFDocumentSharedPtr &doc) {
+	assert(material != nullptr);
+
+	RenderModelSharedPtr model = PSIRenderModel::create();
+	model->set_material(material);
+
+	// Textures are loaded once per image, and materials created once per glTF material.
+	std::vector<GLTextureSharedPtr> textures(doc->images.size());
+	std::vector<GLMaterialSharedPtr> materials(doc->materials.size());
+	auto get_material = [&](GLint material_index) -> GLMaterialSharedPtr {
+		if (material_index < 0) {
+			return material;
+		}
+
+		if (materials[material_index] == nullptr) {
+			const gltf_material &gltf_mat = doc->materials[material_index];
+			GLMaterialSharedPtr batch_material = material->clone();
+			batch_material->set_color(gltf_mat.base_color_factor);
+
+			if (gltf_mat.base_color_texture >= 0) {
+				GLint image_index = doc->textures[gltf_mat.base_color_texture].source;
+				if (image_index >= 0 && textures[image_index] == nullptr) {
+					const gltf_image &image = doc->images[image_index];
+					if ((GLint)doc->decoded_images.size() > image_index && doc->decoded_images[image_index].pixels != nullptr) {
+						textures[image_index] = PSIGLTexture::create();
+						textures[image_index]->upload_image(doc->decoded_images[image_index]);
+					} else if (is_image_file(image) == true) {
+						textures[image_index] = PSIGLTexture::create();
+						textures[image_index]->load_from_file(doc->base_dir + image.uri);
+					} else {
+						psilog(PSILog::LOAD, "Skipping embedded glTF image %d, only image files are supported",
+						       image_index);
+					}
+				}
+				if (image_index >= 0 && textures[image_index] != nullptr) {
+					batch_material->set_texture(textures[image_index]);
+				}
+			}
+
+			materials[material_index] = batch_material;
+		}
+
+		return materials[material_index];
+	};
+
+	// Buffer views are shared by all batch meshes, and owned by the model.
+	std::vector<GLuint> view_buffer_ids(doc->buffer_views.size(), 0);
+	auto gen_buffer = [&model]() { return model->add_buffer(); };
+
+	// Walk the node hierarchy depth first, with the world matrix of each node.
+	std::vector<std::pair<GLint, glm::mat4>> stack;
+	if (doc->scene >= 0) {
+		for (GLint node : doc->scenes[doc->scene].nodes) {
+			stack.push_back({ node, glm::mat4(1.0f) });
+		}
+	}
+
+	// Guard against cycles in broken files.
+	size_t visited = 0;
+	while (stack.empty() == false && visited++ <= doc->nodes.size()) {
+		const gltf_node &node = doc->nodes[stack.back().first];
+		glm::mat4 node_matrix = stack.back().second * get_node_matrix(node);
+		stack.pop_back();
+
+		for (GLint child : node.children) {
+			stack.push_back({ child, node_matrix });
+		}
+
+		if (node.mesh < 0) {
+			continue;
+		}
+
+		for (const auto &primitive : doc->meshes[node.mesh].primitives) {
+			GLMeshSharedPtr mesh_obj = PSIGLMesh::create();
+			mesh_obj->gen_vao();
+			mesh_obj->bind_vao();
+			setup_primitive(mesh_obj, doc, primitive, view_buffer_ids, gen_buffer);
+
+			PSIRenderModel::draw_batch batch;
+			batch.mesh = mesh_obj;
+			batch.material = get_material(primitive.material);
+			batch.node_matrix = node_matrix;
+			batch.indexed = is_indexed(doc, primitive);
+			model->add_batch(batch);
+		}
+	}
+
+	glBindVertexArray(0);
+
+	psilog(PSILog::OPENGL, "Created model with %d batches", model->get_batch_count());
+
+	return model;
+}
+
+RenderModelSharedPtr PSIGLTFLoader::load_model(const GLMaterialSharedPtr &material, std::string scene_path) {
+	GLTFDocumentSharedPtr doc = load_document(scene_path);
+	if (doc == nullptr) {
+		return nullptr;
+	}
+
+	return create_model(material, doc);
+}
+
+GLboolean PSIGLTFLoader::bake_mesh_cache(std::string scene_path, std::string cache_path) {
+	GLTFDocumentSharedPtr doc = load_document(scene_path);
+	if (doc == nullptr) {
+		return false;
+	}
+
+	GLint mesh_index = find_first_mesh(doc);
+	if (mesh_index < 0 || doc->meshes[mesh_index].primitives.empty()) {
+		psilog_err("No meshes in glTF file '%s'", scene_path.c_str());
+		return false;
+	}
+
+	// Same mesh as load_gl_mesh, one blob per used buffer view.
+	const gltf_primitive &primitive = doc->meshes[mesh_index].primitives[0];
+	PSIMeshCache::mesh_desc desc;
+
+	std::vector<GLint> blob_indexes(doc->buffer_views.size(), -1);
+	auto get_view_blob = [&](GLint view_index, GLenum target) -> GLuint {
+		if (blob_indexes[view_index] < 0) {
+			const gltf_buffer_view &view = doc->buffer_views[view_index];
+			blob_indexes[view_index] = desc.blobs.size();
+			desc.blobs.push_back({ PSIMeshCache::UNNAMED_BLOB, target, GL_STATIC_DRAW,
+			                       doc->buffers[view.buffer].data + view.byte_offset, view.byte_length });
+		}
+
+		return blob_indexes[view_index];
+	};
+
+	for (const auto &attribute : primitive.attributes) {
+		const gltf_accessor &accessor = doc->accessors[attribute.accessor];
+		GLint loc = get_attrib_location(attribute.name);
+		if (loc == PSIGLShader::AttribLocation::INVALID || accessor.buffer_view < 0) {
+			continue;
+		}
+
+		GLuint blob = get_view_blob(accessor.buffer_view, GL_ARRAY_BUFFER);
+		desc.attributes.push_back({ attribute.name, loc, blob, accessor.size, accessor.component_type,
+		                            accessor.normalized, doc->buffer_views[accessor.buffer_view].byte_stride,
+		                            accessor.byte_offset });
+
+		// Bounds from the position accessor min and max.
+		if (loc == PSIGLShader::AttribLocation::POSITION) {
+			desc.vertex_count = accessor.count;
+			if (accessor.has_bounds == true && accessor.size >= 3) {
+				desc.bounds_min = glm::vec3(accessor.min[0], accessor.min[1], accessor.min[2]);
+				desc.bounds_max = glm::vec3(accessor.max[0], accessor.max[1], accessor.max[2]);
+				desc.bounds_center = (desc.bounds_min + desc.bounds_max) * 0.5f;
+				desc.bounds_radius = glm::length(desc.bounds_max - desc.bounds_center);
+			}
+		}
+	}
+
+	desc.draw_mode = get_draw_mode(primitive.mode);
+	if (is_indexed(doc, primitive) == true) {
+		const gltf_accessor &indices_accessor = doc->accessors[primitive.indices];
+		desc.index_blob = get_view_blob(indices_accessor.buffer_view, GL_ELEMENT_ARRAY_BUFFER);
+		desc.index_offset = indices_accessor.byte_offset;
+		desc.draw_count = indices_accessor.count;
+		desc.index_type = indices_accessor.component_type;
+	} else {
+		desc.draw_count = desc.vertex_count;
+	}
+
+	return PSIMeshCache::write(cache_path, desc);
+}
+
+GLMeshSharedPtr PSIGLTFLoader::load_cached_gl_mesh(const ShaderSharedPtr &shader, std::string scene_path,
+                                                   std::string cache_path) {
+	assert(shader != nullptr);
+
+	// Rebake when the scene has changed since the cache was written.
+	int64_t cache_time = PSIFileUtils::get_modified_time(cache_path);
+	if (cache_time < 0 || cache_time < PSIFileUtils::get_modified_time(scene_path)) {
+		if (bake_mesh_cache(scene_path, cache_path) == false) {
+			return load_gl_mesh(shader, scene_path);
+		}
+	}
+
+	PSIMeshCache::loaded_mesh loaded = PSIMeshCache::load_gl_mesh(cache_path, shader->get_program());
+	if (loaded.mesh == nullptr) {
+		// Old or broken cache, bake it again.
+		if (bake_mesh_cache(scene_path, cache_path) == false) {
+			return load_gl_mesh(shader, scene_path);
+		}
+		loaded = PSIMeshCache::load_gl_mesh(cache_path, shader->get_program());
+	}
+
+	return loaded.mesh;
+}
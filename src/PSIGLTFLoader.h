@@ -1,20 +1,141 @@
 // PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
 //
-// GLTF model loader. Interfaces tiny_gltf_loader.
+// glTF 2.0 model loader, for both .gltf with external or embedded buffers and
+// binary .glb. The files are memory mapped and the JSON is parsed in place into
+// index based arrays. Buffer views are uploaded to GL straight from the mapping.
 
 #pragma once
 
 #include "PSIGLMesh.h"
 #include "PSIGLShader.h"
+#include "PSIMeshCache.h"
+#include "PSIFileUtils.h"
+#include "PSIRenderModel.h"
 
-#include "ext/tiny_gltf_loader.h"
+#include <functional>
 
 class PSIGLTFLoader;
 typedef shared_ptr<PSIGLTFLoader> GLTFLoaderSharedPtr;
 
 class PSIGLTFLoader {
-	private:
 	public:
+		// glTF primitive modes.
+		enum PrimitiveMode {
+			POINTS         = 0,
+			LINES          = 1,
+			LINE_LOOP      = 2,
+			LINE_STRIP     = 3,
+			TRIANGLES      = 4,
+			TRIANGLE_STRIP = 5,
+			TRIANGLE_FAN   = 6
+		};
+
+		// Byte range of a buffer, pointing into a mapped file or owned data of the document.
+		struct gltf_buffer {
+			const unsigned char *data = nullptr;
+			size_t byte_length = 0;
+		};
+
+		struct gltf_buffer_view {
+			GLint buffer = -1;
+			size_t byte_offset = 0;
+			size_t byte_length = 0;
+			// Zero for tightly packed.
+			GLsizei byte_stride = 0;
+			// Zero when not given in the file, found from use then.
+			GLenum target = 0;
+		};
+
+		struct gltf_accessor {
+			// Accessors without a buffer view are all zeros, not supported.
+			GLint buffer_view = -1;
+			size_t byte_offset = 0;
+			GLenum component_type = GL_FLOAT;
+			GLboolean normalized = GL_FALSE;
+			GLuint count = 0;
+			// Components per element, 1 for SCALAR, 3 for VEC3 and so on.
+			GLint size = 1;
+			GLboolean has_bounds = GL_FALSE;
+			GLfloat min[4] = {};
+			GLfloat max[4] = {};
+		};
+
+		struct gltf_attribute {
+			std::string name;
+			GLint accessor = -1;
+		};
+
+		struct gltf_primitive {
+			std::vector<gltf_attribute> attributes;
+			// Accessor of the indexes, -1 for unindexed.
+			GLint indices = -1;
+			GLint material = -1;
+			GLint mode = PrimitiveMode::TRIANGLES;
+		};
+
+		struct gltf_mesh {
+			std::string name;
+			std::vector<gltf_primitive> primitives;
+		};
+
+		struct gltf_node {
+			std::string name;
+			GLint mesh = -1;
+			std::vector<GLint> children;
+			// Either the matrix, or the translation, rotation and scale.
+			GLboolean has_matrix = GL_FALSE;
+			glm::mat4 matrix = glm::mat4(1.0f);
+			glm::vec3 translation = glm::vec3(0.0f);
+			glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			glm::vec3 scale = glm::vec3(1.0f);
+		};
+
+		struct gltf_material {
+			std::string name;
+			glm::vec4 base_color_factor = glm::vec4(1.0f);
+			GLint base_color_texture = -1;
+			GLboolean double_sided = GL_FALSE;
+		};
+
+		struct gltf_texture {
+			GLint source = -1;
+		};
+
+		struct gltf_image {
+			std::string uri;
+			// Images embedded in a buffer view are not supported.
+			GLint buffer_view = -1;
+		};
+
+		struct gltf_scene {
+			std::string name;
+			std::vector<GLint> nodes;
+		};
+
+		// Parsed glTF file. Keeps the mapped files alive, so buffers stay valid as
+		// long as the document.
+		struct gltf_document {
+			std::vector<gltf_buffer> buffers;
+			std::vector<gltf_buffer_view> buffer_views;
+			std::vector<gltf_accessor> accessors;
+			std::vector<gltf_mesh> meshes;
+			std::vector<gltf_node> nodes;
+			std::vector<gltf_material> materials;
+			std::vector<gltf_texture> textures;
+			std::vector<gltf_image> images;
+			std::vector<gltf_scene> scenes;
+			GLint scene = -1;
+			// Directory of the file, for resolving relative uris.
+			std::string base_dir;
+
+			std::vector<PSIFileUtils::MappedFileSharedPtr> mapped_files;
+			// Decoded data uri buffers.
+			std::vector<std::vector<unsigned char>> owned_data;
+			// Images decoded ahead of time with decode_images, by image index.
+			std::vector<PSIGLTexture::image_data> decoded_images;
+		};
+		typedef shared_ptr<gltf_document> GLTFDocumentSharedPtr;
+
 		PSIGLTFLoader() = default;
 		~PSIGLTFLoader() = default;
 
@@ -22,8 +143,34 @@ class PSIGLTFLoader {
 			return make_shared<PSIGLTFLoader>();
 		}
 
-		// Create GLMesh from GLTF scene.
-		GLMeshSharedPtr create_gl_mesh(const ShaderSharedPtr &shader, const tinygltf::Scene &scene);
-		// Load GLTF scene from file and create GLMesh from that.
+		// Load and parse glTF or GLB file, binary or text depending on the file contents.
+		// Returns nullptr on failure.
+		static GLTFDocumentSharedPtr load_document(std::string path);
+		// Decode the image files of the document, so creating a model only has to upload them.
+		// Does not touch GL, so it can be run on any thread.
+		static void decode_images(const GLTFDocumentSharedPtr &doc);
+
+		// Index of the first mesh in the default scene, depth first. Falls back to the first mesh
+		// for files without scenes. Returns -1 when there are no meshes.
+		static GLint find_first_mesh(const GLTFDocumentSharedPtr &doc);
+
+		// Create GLMesh from one primitive of a mesh in the document.
+		GLMeshSharedPtr create_gl_mesh(const ShaderSharedPtr &shader, const GLTFDocumentSharedPtr &doc,
+		                               GLuint mesh_index, GLuint primitive_index = 0);
+		// Load glTF file and create GLMesh from the first mesh of the default scene.
 		GLMeshSharedPtr load_gl_mesh(const ShaderSharedPtr &shader, std::string scene_path);
+
+		// Create render model with every primitive of every node in the default scene as its
+		// own batch. Batch materials are copies of material with the glTF base color and texture.
+		// Buffer views are uploaded once and shared between the batch meshes.
+		RenderModelSharedPtr create_model(const GLMaterialSharedPtr &material, const GLTFDocumentSharedPtr &doc);
+		// Load glTF file and create render model from its default scene.
+		RenderModelSharedPtr load_model(const GLMaterialSharedPtr &material, std::string scene_path);
+
+		// Bake the GL mesh data of a glTF file to a binary mesh cache file.
+		GLboolean bake_mesh_cache(std::string scene_path, std::string cache_path);
+		// Load GLMesh from a mesh cache, baking it from the glTF file first if the cache
+		// is missing, older than the scene or from an older version.
+		GLMeshSharedPtr load_cached_gl_mesh(const ShaderSharedPtr &shader, std::string scene_path,
+		                                    std::string cache_path);
 };
@@ -2,6 +2,23 @@
 
 #include "PSIGLTexture.h"
 #include "PSIGLUtils.h"
+#include "PSIFileUtils.h"
+#include "PSIImageCodec.h"
+#include "PSIParallel.h"
+#include "PSITextureBaker.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+PSIGLTexture::~PSIGLTexture() {
+	if (_id != (GLuint)TexDefs::INVALID_TEX_ID) {
+		glDeleteTextures(1, &_id);
+	}
+}
 
 GLuint PSIGLTexture::init() {
 	assert(_size.x > 0);
@@ -19,6 +36,8 @@ GLuint PSIGLTexture::gen_texture_id(PSIGLTexture::TexType type) {
 		target = GL_TEXTURE_2D_MULTISAMPLE;
 	} else if (type == TexType::TEX_CUBEMAP) {
 		target = GL_TEXTURE_CUBE_MAP;
+	} else if (type == TexType::TEX_2D_ARRAY) {
+		target = GL_TEXTURE_2D_ARRAY;
 	}
 
 	// Set our target.
@@ -88,6 +107,21 @@ PSIGLTexture::TexFormatInfo PSIGLTexture::get_format_info(GLint format_flags) {
 	}
 
 	info.internal_format = info.format;
+	// Compressed sRGB formats.
+	if ((format_flags & TexFormat::SRGB) != 0) {
+		switch (format_flags & TexFormat::TYPE_MASK) {
+		case TexFormat::DXT1:
+			info.internal_format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+			break;
+		case TexFormat::DXT3:
+			info.internal_format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
+			break;
+		case TexFormat::DXT5:
+			info.internal_format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+			break;
+		}
+	}
+
 	if (is_srgb) {
 		info.internal_format = GL_SRGB8_ALPHA8;
 	} else if (is_depth) {
@@ -216,82 +250,437 @@ void PSIGLTexture::gen_mipmaps(GLboolean generate) {
 	}
 }
 
-void PSIGLTexture::load_from_file(std::string path) {
-	// Width and height from loaded image.
-	GLint width;
-	GLint height;
-	// Number of color channels from loaded image.
+GLboolean PSIGLTexture::decode_image(const std::string &path, image_data &image, GLint req_channels) {
+	psilog(PSILog::TEXTURE, "Loading '%s'", path.c_str());
+
+	PSIFileUtils::MappedFileSharedPtr file = PSIFileUtils::map_file(path);
+	if (file == nullptr || file->size > INT_MAX) {
+		psilog(PSILog::TEXTURE, "Failed loading image from '%s'", path.c_str());
+		return false;
+	}
+
+	// QOI is recognized from the header, stb_image handles the rest.
 	GLint channels;
+	if (PSIImageCodec::read_qoi_header(file->data, file->size, image.width, image.height, channels) == true) {
+		image.channels = (req_channels != 0) ? req_channels : channels;
+		unsigned char *pixels = (unsigned char *)malloc((size_t)image.width * image.height * image.channels);
+		if (pixels == nullptr || PSIImageCodec::decode_qoi(file->data, file->size, pixels, image.channels) == false) {
+			psilog(PSILog::TEXTURE, "Failed loading image from '%s'", path.c_str());
+			free(pixels);
+			return false;
+		}
 
-	psilog(PSILog::TEXTURE, "Loading '%s'", path.c_str());
+		image.pixels = shared_ptr<unsigned char>(pixels, [](unsigned char *data) {
+			free(data);
+		});
 
-	// Load the image data.
-	unsigned char *image = stbi_load(path.c_str(), &width, &height, &channels, STBI_default);
+		return true;
+	}
 
-	// Set the texture image data
-	if (image != nullptr) {
-		GLuint id = gen_texture_id(TexType::TEX_2D);
+	unsigned char *pixels = stbi_load_from_memory(file->data, (int)file->size, &image.width, &image.height,
+	                                              &image.channels, req_channels);
+	if (pixels == nullptr) {
+		psilog(PSILog::TEXTURE, "Failed loading image from '%s'", path.c_str());
+		return false;
+	}
+
+	// Channels in the decoded data, not in the file.
+	if (req_channels != 0) {
+		image.channels = req_channels;
+	}
+	image.pixels = shared_ptr<unsigned char>(pixels, [](unsigned char *data) {
+		stbi_image_free(data);
+	});
+
+	return true;
+}
+
+GLboolean PSIGLTexture::upload_qoi(const unsigned char *data, size_t size) {
+	GLint width, height, channels;
+	if (PSIImageCodec::read_qoi_header(data, size, width, height, channels) == false) {
+		return false;
+	}
+
+	// Decode straight into a pixel unpack buffer, so the pixels are written once
+	// and the driver takes them from there. Falls back to client memory if the
+	// buffer can not be mapped.
+	size_t buffer_size = (size_t)width * height * channels;
+	GLuint pbo;
+	glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_size, NULL, GL_STREAM_DRAW);
+	unsigned char *mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, buffer_size,
+	                                                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	std::vector<unsigned char> fallback;
+	const GLvoid *pixels = NULL;
+	GLboolean decoded;
+	if (mapped != nullptr) {
+		decoded = PSIImageCodec::decode_qoi(data, size, mapped, channels);
+		// The contents are lost if the buffer got corrupted while mapped.
+		decoded = (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE) && decoded;
+	} else {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		fallback.resize(buffer_size);
+		decoded = PSIImageCodec::decode_qoi(data, size, fallback.data(), channels);
+		pixels = fallback.data();
+	}
+
+	if (decoded == true) {
+		gen_texture_id(TexType::TEX_2D);
 		bind();
-		if (id != TexDefs::INVALID_TEX_ID) {
-			// Does the image loaded have RGB or RGBA data in it ?
-			// The generated texture depends on the data format.
-			TexFormat fmt;
-			if (channels == 3) {
-				fmt = TexFormat::RGB;
-			} else {
-				fmt = TexFormat::RGBA;
-			}
-			// Get more detailed info based on channel format.
-			TexFormatInfo fmt_info = get_format_info(fmt);
-			GLenum target = get_target();
-			// Generate 2D texture.
-			glTexImage2D(target, 0, fmt_info.internal_format, width, height, 0, fmt_info.format, fmt_info.type, image);
 
-			psilog(PSILog::TEXTURE, "Loaded '%s' [%dx%d c=%d], id = %d", path.c_str(), width, height, channels, id);
-		} else {
-			stbi_image_free(image);
-			psilog(PSILog::TEXTURE, "Failed allocating texture for file '%s'", path.c_str());
+		TexFormatInfo fmt_info = get_format_info((channels == 3) ? TexFormat::RGB : TexFormat::RGBA);
+		// RGB rows are not 4 byte aligned.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(get_target(), 0, fmt_info.internal_format, width, height, 0, fmt_info.format, fmt_info.type,
+		             pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		set_size(glm::vec2(width, height));
+
+		set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::ANISOTROPIC);
+		gen_mipmaps(true);
+		unbind();
+
+		psilog(PSILog::TEXTURE, "Uploaded QOI image [%dx%d c=%d], id = %d", width, height, channels, get_id());
+	}
+
+	// The upload has its own copy, the buffer can go.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &pbo);
+	check_gl_error();
+
+	return decoded;
+}
+
+void PSIGLTexture::upload_image(const image_data &image) {
+	if (image.pixels == nullptr) {
+		return;
+	}
+
+	GLuint id = gen_texture_id(TexType::TEX_2D);
+	bind();
+	if (id == TexDefs::INVALID_TEX_ID) {
+		psilog(PSILog::TEXTURE, "Failed allocating texture");
+		return;
+	}
+
+	// Does the image loaded have RGB or RGBA data in it ?
+	// The generated texture depends on the data format.
+	TexFormat fmt;
+	if (image.channels == 3) {
+		fmt = TexFormat::RGB;
+	} else {
+		fmt = TexFormat::RGBA;
+	}
+	// Get more detailed info based on channel format.
+	TexFormatInfo fmt_info = get_format_info(fmt);
+	GLenum target = get_target();
+	// Rows of RGB images and of the smaller levels are not 4 byte aligned.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Generate 2D texture.
+	glTexImage2D(target, 0, fmt_info.internal_format, image.width, image.height, 0, fmt_info.format, fmt_info.type,
+	             image.pixels.get());
+	set_size(glm::vec2(image.width, image.height));
+
+	psilog(PSILog::TEXTURE, "Uploaded image [%dx%d c=%d], id = %d", image.width, image.height, image.channels, id);
+
+	set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::ANISOTROPIC);
+	if (image.mipmaps.empty() == true) {
+		gen_mipmaps(true);
+	} else {
+		for (size_t i = 0; i < image.mipmaps.size(); i++) {
+			const PSIMipGenerator::mip_level &level = image.mipmaps[i];
+			glTexImage2D(target, i + 1, fmt_info.internal_format, level.width, level.height, 0, fmt_info.format,
+			             fmt_info.type, level.pixels.data());
+		}
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, image.mipmaps.size());
+		psilog(PSILog::TEXTURE, "Uploaded %d mipmap levels", (int)image.mipmaps.size());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	unbind();
+}
+
+void PSIGLTexture::upload_array(const std::vector<image_data> &layers) {
+	if (layers.empty() == true) {
+		return;
+	}
+
+	const image_data &first = layers.front();
+	bool upload_mipmaps = true;
+	for (const auto &layer : layers) {
+		if (layer.pixels == nullptr || layer.width != first.width || layer.height != first.height ||
+		    layer.channels != first.channels) {
+			psilog_err("Array texture layers must all have the same size and channels");
 			return;
 		}
+		upload_mipmaps = upload_mipmaps && layer.mipmaps.empty() == false &&
+		                 layer.mipmaps.size() == first.mipmaps.size();
+	}
+
+	GLuint id = gen_texture_id(TexType::TEX_2D_ARRAY);
+	bind();
+
+	TexFormatInfo fmt_info = get_format_info((first.channels == 3) ? TexFormat::RGB : TexFormat::RGBA);
+	GLenum target = get_target();
+	GLsizei level_count = (upload_mipmaps == true) ? first.mipmaps.size() + 1 : 1;
+	GLsizei layer_count = layers.size();
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (GLsizei level = 0; level < level_count; level++) {
+		GLint width = (level == 0) ? first.width : first.mipmaps[level - 1].width;
+		GLint height = (level == 0) ? first.height : first.mipmaps[level - 1].height;
+		glTexImage3D(target, level, fmt_info.internal_format, width, height, layer_count, 0, fmt_info.format,
+		             fmt_info.type, NULL);
+		for (GLsizei i = 0; i < layer_count; i++) {
+			const GLvoid *pixels = (level == 0) ? (const GLvoid *)layers[i].pixels.get() :
+			                                      (const GLvoid *)layers[i].mipmaps[level - 1].pixels.data();
+			glTexSubImage3D(target, level, 0, 0, i, width, height, 1, fmt_info.format, fmt_info.type, pixels);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	set_size(glm::vec2(first.width, first.height));
+
+	psilog(PSILog::TEXTURE, "Uploaded array texture [%dx%d c=%d] with %d layers, id = %d", first.width,
+	       first.height, first.channels, layer_count, id);
+
+	set_sample_mode(PSIGLTexture::TexSampleMode::REPEAT | PSIGLTexture::TexSampleMode::ANISOTROPIC);
+	if (upload_mipmaps == true) {
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, level_count - 1);
 	} else {
+		gen_mipmaps(true);
+	}
+	check_gl_error();
+	unbind();
+}
+
+void PSIGLTexture::gen_cpu_mipmaps(image_data &image, const PSIMipGenerator::mip_options &options) {
+	if (image.pixels == nullptr) {
+		return;
+	}
+
+	image.mipmaps = PSIMipGenerator::generate(image.pixels.get(), image.width, image.height, image.channels, options);
+}
+
+void PSIGLTexture::load_from_file(std::string path) {
+	PSIFileUtils::MappedFileSharedPtr file = PSIFileUtils::map_file(path);
+	if (file == nullptr) {
 		psilog(PSILog::TEXTURE, "Failed loading image from '%s'", path.c_str());
 		return;
 	}
 
-	stbi_image_free(image);
-	set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::ANISOTROPIC);
-	gen_mipmaps(true);
-	unbind();
+	// Baked textures have all their levels ready to upload.
+	if (file->size >= sizeof(PSITextureBaker::MAGIC) &&
+	    memcmp(file->data, PSITextureBaker::MAGIC, sizeof(PSITextureBaker::MAGIC)) == 0) {
+		PSITextureBaker::upload(PSITextureBaker::open(path), *this);
+		return;
+	}
+
+	GLint width, height, channels;
+	if (PSIImageCodec::read_qoi_header(file->data, file->size, width, height, channels) == true) {
+		if (upload_qoi(file->data, file->size) == false) {
+			psilog(PSILog::TEXTURE, "Failed loading image from '%s'", path.c_str());
+		}
+		return;
+	}
+
+	image_data image;
+	if (decode_image(path, image) == false) {
+		return;
+	}
+
+	gen_cpu_mipmaps(image);
+	upload_image(image);
 }
 
-void PSIGLTexture::load_cube_map(std::vector<std::string> texture_paths) {
-	GLuint id = gen_texture_id(TexType::TEX_CUBEMAP);
+void PSIGLTexture::begin_cube_map() {
+	gen_texture_id(TexType::TEX_CUBEMAP);
+}
+
+void PSIGLTexture::upload_cube_face(GLuint face, const image_data &image) {
+	if (image.pixels == nullptr) {
+		return;
+	}
+
 	bind();
+	// For cubemap textures always use GL_RGB.
+	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, image.width, image.height, 0, GL_RGB,
+	             GL_UNSIGNED_BYTE, image.pixels.get());
+	set_size(glm::vec2(image.width, image.height));
+}
 
-	// Width and height from loaded image.
-	GLint width;
-	GLint height;
-	// Number of color channels from loaded image.
-	GLint channels;
+void PSIGLTexture::end_cube_map() {
+	bind();
+	set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::LINEAR_MIPMAP);
+	gen_mipmaps(true);
+	unbind();
+
+	psilog(PSILog::TEXTURE, "Loaded cubemap texture with id = %d", get_id());
+}
 
-	// Load all the cube map textures.
-	for(GLuint i=0; i<texture_paths.size(); i++) {
-		psilog(PSILog::TEXTURE, "Loading '%s'", texture_paths[i].c_str());
-		unsigned char *image = stbi_load(texture_paths[i].c_str(), &width, &height, &channels, STBI_rgb);
+void PSIGLTexture::upload_cube_map(const std::vector<image_data> &faces) {
+	begin_cube_map();
+	for (GLuint i = 0; i < faces.size(); i++) {
+		upload_cube_face(i, faces[i]);
+	}
+	end_cube_map();
+}
+
+void PSIGLTexture::load_cube_map(std::vector<std::string> texture_paths, const WorkerPoolSharedPtr &pool) {
+	GLuint face_count = texture_paths.size();
+	std::vector<image_data> faces(face_count);
+	std::vector<GLboolean> results(face_count, false);
 
-		if (image != nullptr) {
-			// For cubemap textures always use GL_RGB.
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-			stbi_image_free(image);
-			psilog(PSILog::TEXTURE, "Loaded '%s' [%dx%d c=%d]", texture_paths[i].c_str(), width, height, channels);
+	auto upload_face = [this, &texture_paths, &faces, &results](GLuint i) {
+		if (results[i] == true) {
+			upload_cube_face(i, faces[i]);
+			psilog(PSILog::TEXTURE, "Loaded '%s' [%dx%d c=%d]", texture_paths[i].c_str(),
+			       faces[i].width, faces[i].height, faces[i].channels);
 		} else {
 			psilog_err("Failed loading image from '%s'", texture_paths[i].c_str());
 		}
+		// Release the decoded pixels right away.
+		faces[i] = image_data();
+	};
+
+	begin_cube_map();
+
+	if (pool == nullptr) {
+		for (GLuint i = 0; i < face_count; i++) {
+			results[i] = decode_image(texture_paths[i], faces[i], STBI_rgb);
+			upload_face(i);
+		}
+	} else {
+		// Faces decoded by the workers, uploaded here in the order they finish.
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::deque<GLuint> decoded;
+
+		for (GLuint i = 0; i < face_count; i++) {
+			pool->submit([&texture_paths, &faces, &results, &mutex, &cond, &decoded, i]() {
+				GLboolean result = decode_image(texture_paths[i], faces[i], STBI_rgb);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					results[i] = result;
+					decoded.push_back(i);
+				}
+				cond.notify_one();
+			});
+		}
+
+		for (GLuint uploaded = 0; uploaded < face_count; uploaded++) {
+			GLuint face;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&decoded]() {
+					return decoded.empty() == false;
+				});
+				face = decoded.front();
+				decoded.pop_front();
+			}
+			upload_face(face);
+		}
 	}
 
-	set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::LINEAR_MIPMAP);
-	gen_mipmaps(true);
-	unbind();
+	end_cube_map();
+}
+
+GLint PSIGLTexture::get_cube_layout(GLint width, GLint height) {
+	if (width * 3 == height * 4) {
+		return CubeLayout::CUBE_HORIZONTAL_CROSS;
+	} else if (width * 4 == height * 3) {
+		return CubeLayout::CUBE_VERTICAL_CROSS;
+	} else if (width == height * 6) {
+		return CubeLayout::CUBE_HORIZONTAL_STRIP;
+	} else if (width * 6 == height) {
+		return CubeLayout::CUBE_VERTICAL_STRIP;
+	}
 
-	psilog(PSILog::TEXTURE, "Loaded cubemap texture with id = %d", id);
-}  
+	return CubeLayout::CUBE_INVALID_LAYOUT;
+}
+
+// Face cell positions in the image, in face size units, for each layout in GL face order.
+struct cube_face_cell {
+	GLint x;
+	GLint y;
+	// Is the face stored upside down ?
+	bool flipped;
+};
+
+static const cube_face_cell CUBE_FACE_CELLS[4][6] = {
+	// Horizontal cross.
+	{ { 2, 1, false }, { 0, 1, false }, { 1, 0, false }, { 1, 2, false }, { 1, 1, false }, { 3, 1, false } },
+	// Vertical cross.
+	{ { 2, 1, false }, { 0, 1, false }, { 1, 0, false }, { 1, 2, false }, { 1, 1, false }, { 1, 3, true } },
+	// Horizontal strip.
+	{ { 0, 0, false }, { 1, 0, false }, { 2, 0, false }, { 3, 0, false }, { 4, 0, false }, { 5, 0, false } },
+	// Vertical strip.
+	{ { 0, 0, false }, { 0, 1, false }, { 0, 2, false }, { 0, 3, false }, { 0, 4, false }, { 0, 5, false } }
+};
+
+GLboolean PSIGLTexture::split_cube_image(const image_data &image, std::vector<image_data> &faces) {
+	GLint layout = get_cube_layout(image.width, image.height);
+	if (layout == CubeLayout::CUBE_INVALID_LAYOUT || image.pixels == nullptr) {
+		psilog_err("Image of size %dx%d is not a cube map cross or strip", image.width, image.height);
+		return false;
+	}
+
+	GLint face_size = (layout == CubeLayout::CUBE_HORIZONTAL_CROSS) ? image.width / 4 :
+	                  (layout == CubeLayout::CUBE_VERTICAL_CROSS) ? image.width / 3 :
+	                  (layout == CubeLayout::CUBE_HORIZONTAL_STRIP) ? image.height : image.width;
+	size_t pixel_size = image.channels;
+	size_t image_pitch = image.width * pixel_size;
+	size_t face_pitch = face_size * pixel_size;
+
+	faces.resize(6);
+	for (auto &face : faces) {
+		face.width = face_size;
+		face.height = face_size;
+		face.channels = image.channels;
+		face.pixels = shared_ptr<unsigned char>(new unsigned char[face_pitch * face_size],
+		                                        std::default_delete<unsigned char[]>());
+	}
+
+	// Faces are independent, so copy them in parallel. Rows are contiguous in both images
+	// and copied whole, upside down faces are copied pixel by pixel.
+	const unsigned char *src = image.pixels.get();
+	PSIParallel::for_range(6, 1, [&](size_t begin, size_t end) {
+		for (size_t f = begin; f < end; f++) {
+			const cube_face_cell &cell = CUBE_FACE_CELLS[layout][f];
+			const unsigned char *face_src = src + cell.y * face_size * image_pitch + cell.x * face_pitch;
+			unsigned char *dst = faces[f].pixels.get();
+
+			for (GLint y = 0; y < face_size; y++) {
+				if (cell.flipped == false) {
+					memcpy(dst + y * face_pitch, face_src + y * image_pitch, face_pitch);
+					continue;
+				}
+
+				const unsigned char *src_row = face_src + (face_size - 1 - y) * image_pitch;
+				unsigned char *dst_row = dst + y * face_pitch;
+				for (GLint x = 0; x < face_size; x++) {
+					memcpy(dst_row + x * pixel_size, src_row + (face_size - 1 - x) * pixel_size, pixel_size);
+				}
+			}
+		}
+	});
+
+	return true;
+}
+
+void PSIGLTexture::load_cube_map_image(std::string path) {
+	image_data image;
+	if (decode_image(path, image, STBI_rgb) == false) {
+		return;
+	}
+
+	std::vector<image_data> faces;
+	if (split_cube_image(image, faces) == false) {
+		return;
+	}
+	image = image_data();
+
+	upload_cube_map(faces);
+}
@@ -9,8 +9,10 @@
 
 #include "PSIGlobals.h"
 #include "PSIMath.h"
+#include "PSIMipGenerator.h"
 #include "PSIOpenGL.h"
 #include "PSITypes.h"
+#include "PSIWorkerPool.h"
 
 class PSIGLTexture;
 typedef shared_ptr<PSIGLTexture> GLTextureSharedPtr;
@@ -54,7 +56,19 @@ class PSIGLTexture {
 
 	enum TexType {
 		TEX_2D		= 0,
-		TEX_CUBEMAP	= 1
+		TEX_CUBEMAP	= 1,
+		TEX_2D_ARRAY	= 2
+	};
+
+	// Layouts of cube maps stored in a single image. Cross layouts have +Y above and -Y
+	// below +Z, with -X and +X on its sides. The vertical cross has -Z at the bottom, upside
+	// down. Strips have the faces in GL face order, +X, -X, +Y, -Y, +Z, -Z.
+	enum CubeLayout {
+		CUBE_INVALID_LAYOUT = -1,
+		CUBE_HORIZONTAL_CROSS = 0,
+		CUBE_VERTICAL_CROSS,
+		CUBE_HORIZONTAL_STRIP,
+		CUBE_VERTICAL_STRIP
 	};
 
 	// Format info for generated texture.
@@ -64,6 +78,18 @@ class PSIGLTexture {
 		GLenum type;
 	};
 
+	// Decoded image pixels, as loaded by decode_image.
+	struct image_data {
+		GLint width = 0;
+		GLint height = 0;
+		GLint channels = 0;
+		// Freed by the decoder's deleter.
+		shared_ptr<unsigned char> pixels;
+		// Levels below the image from gen_cpu_mipmaps, uploaded instead of generating
+		// the mipmaps with GL.
+		std::vector<PSIMipGenerator::mip_level> mipmaps;
+	};
+
 	// General texture definitions.
 	enum TexDefs {
 		INVALID_TEX_ID	= -1,
@@ -72,7 +98,10 @@ class PSIGLTexture {
 	};
 
 	PSIGLTexture() = default;
-	~PSIGLTexture() = default;
+	~PSIGLTexture();
+
+	// Owns the GL texture, so it is not copyable.
+	PSIGLTexture(const PSIGLTexture &rhs) = delete;
 
 	static GLTextureSharedPtr create() {
 		return make_shared<PSIGLTexture>();
@@ -113,16 +142,52 @@ class PSIGLTexture {
 	void set_sample_mode(GLint sample_mode);
 	void set_data(const GLvoid *data);
 
-	// Load texture image from file and generate texture.
+	// Load texture image from file and generate texture. Baked textures upload their
+	// levels from the mapped file and QOI images are decoded straight into the
+	// upload buffer, with the mipmaps generated by GL. Other images are decoded with
+	// stb_image and get CPU mipmaps.
 	void load_from_file(std::string path);
-	// Load all the faces of a cube map and generate cubemap texture.
-	void load_cube_map(std::vector<std::string> texture_paths);
+	// Load all the faces of a cube map and generate cubemap texture. With a pool the
+	// faces are decoded on its workers, and each is uploaded as soon as it is decoded.
+	// Don't call with the pool from one of its own workers. Without a pool the faces
+	// are decoded one at a time.
+	void load_cube_map(std::vector<std::string> texture_paths, const WorkerPoolSharedPtr &pool = nullptr);
+	// Load cube map from a single cross or strip layout image, found from the image size.
+	void load_cube_map_image(std::string path);
+
+	// Decode QOI or stb_image supported image from file, with req_channels channels or
+	// as in the file when 0. Does not touch GL, so it can be run on any thread.
+	static GLboolean decode_image(const std::string &path, image_data &image, GLint req_channels = 0);
+	// Generate texture from decoded image.
+	void upload_image(const image_data &image);
+	// Generate the image mipmaps on the CPU, filtering in linear space. Does not touch GL,
+	// so it can be run on any thread before upload_image.
+	static void gen_cpu_mipmaps(image_data &image,
+	                            const PSIMipGenerator::mip_options &options = PSIMipGenerator::mip_options());
+	// Generate 2D array texture from decoded images of the same size and channels, one per layer.
+	// The CPU mipmaps of the layers are uploaded if they all have them.
+	void upload_array(const std::vector<image_data> &layers);
+	// Generate cube map texture from decoded RGB faces, in GL face order.
+	void upload_cube_map(const std::vector<image_data> &faces);
+	// Generate empty cube map texture to upload faces to with upload_cube_face.
+	void begin_cube_map();
+	// Upload face of a cube map started with begin_cube_map.
+	void upload_cube_face(GLuint face, const image_data &image);
+	// Finish cube map, generating the mipmaps.
+	void end_cube_map();
+
+	// Cube map layout of an image with size, CUBE_INVALID_LAYOUT if it is not one of them.
+	static GLint get_cube_layout(GLint width, GLint height);
+	// Split single image cube map into the six faces, in GL face order.
+	static GLboolean split_cube_image(const image_data &image, std::vector<image_data> &faces);
 	// Generate texture id and set active.
 	GLuint gen_texture_id(PSIGLTexture::TexType type);
 
 	private:
 	// Generates a default 2d texture with sane defaults.
 	GLuint gen_2d_texture(GLint format, GLint width, GLint height);
+	// Decode QOI data into a pixel unpack buffer and generate texture from it.
+	GLboolean upload_qoi(const unsigned char *data, size_t size);
 	// Set texture mipmaps. Mipmaps are generated if generate set to true.
 	void gen_mipmaps(GLboolean generate);
 	// Get the OpenGL texture format information from the format flags.
@@ -159,6 +159,9 @@ GeometryDataSharedPtr cube_inverted() {
 
 GeometryDataSharedPtr plane(GLint rows, GLboolean repeat_texture) {
 	GeometryDataSharedPtr geom = PSIGeometry::Plane::uniform_plane(rows, repeat_texture);
+	if (geom == nullptr) {
+		return nullptr;
+	}
 	add_buffer_defaults(geom);
 
 	return geom;
@@ -166,6 +169,30 @@ GeometryDataSharedPtr plane(GLint rows, GLboolean repeat_texture) {
 
 GeometryDataSharedPtr icosahedron(GLint recursion) {
 	GeometryDataSharedPtr geom = PSIGeometry::Icosahedron::icosahedron(recursion);
+	if (geom == nullptr) {
+		return nullptr;
+	}
+	add_buffer_defaults(geom);
+
+	return geom;
+}
+
+GeometryDataSharedPtr surface(const Surface::surface_func &func, GLint cols, GLint rows) {
+	GeometryDataSharedPtr geom = PSIGeometry::Surface::grid(func, cols, rows);
+	if (geom == nullptr) {
+		return nullptr;
+	}
+	add_buffer_defaults(geom);
+
+	return geom;
+}
+
+GeometryDataSharedPtr patch_surface(const Surface::surface_func &func, GLint patches_x, GLint patches_y,
+                                    GLint patch_quads, const std::vector<GLint> &lod_levels) {
+	GeometryDataSharedPtr geom = PSIGeometry::Surface::patch_grid(func, patches_x, patches_y, patch_quads, lod_levels);
+	if (geom == nullptr) {
+		return nullptr;
+	}
 	add_buffer_defaults(geom);
 
 	return geom;
@@ -18,6 +18,7 @@
 #include "PSICubeGeometry.h"
 #include "PSICuboidGeometry.h"
 #include "PSIPlaneGeometry.h"
+#include "PSISurfaceGeometry.h"
 #include "PSIQuadGeometry.h"
 #include "PSIIcosahedronGeometry.h"
 #include "PSITetrahedronGeometry.h"
@@ -33,6 +34,9 @@ namespace PSIGeometry {
 	GeometryDataSharedPtr cuboid(GLfloat width, GLfloat height, GLfloat depth);
 	GeometryDataSharedPtr plane(GLint rows, GLboolean repeat_texture);
 	GeometryDataSharedPtr icosahedron(GLint recursion);
+	GeometryDataSharedPtr surface(const Surface::surface_func &func, GLint cols, GLint rows);
+	GeometryDataSharedPtr patch_surface(const Surface::surface_func &func, GLint patches_x, GLint patches_y,
+	                                    GLint patch_quads, const std::vector<GLint> &lod_levels);
 
 	std::array<glm::vec3, 4> quad(glm::vec2 origin, glm::vec2 radius);
 	std::vector<glm::vec3> create_poly(GLint num_points, GLfloat angle_offset, GLfloat radius);
@@ -8,3 +8,81 @@ void PSIGeometryData::print_data() {
 	PSIGLUtils::print_vectors_of_glm("texcoords", texcoords);
 	PSIGLUtils::print_vectors("indexes", indexes);
 }
+
+void PSIGeometryData::calc_bounds() {
+	if (positions.empty()) {
+		bounds_center = glm::vec3(0.0f);
+		bounds_radius = 0.0f;
+		return;
+	}
+
+	// Center of the bounding box, then the furthest position from it.
+	glm::vec3 min = positions[0];
+	glm::vec3 max = positions[0];
+	for (const auto &p : positions) {
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+	bounds_center = (min + max) * 0.5f;
+
+	GLfloat radius_sq = 0.0f;
+	for (const auto &p : positions) {
+		glm::vec3 d = p - bounds_center;
+		radius_sq = std::max(radius_sq, glm::dot(d, d));
+	}
+	bounds_radius = sqrtf(radius_sq);
+}
+
+template <typename T>
+static void free_vector(std::vector<T> &v) {
+	std::vector<T>().swap(v);
+}
+
+void PSIGeometryData::release_cpu_data() {
+	if (cpu_released == true) {
+		return;
+	}
+
+	// Bounds are needed for LOD selection after the positions are gone.
+	if (bounds_radius <= 0.0f) {
+		calc_bounds();
+	}
+
+	released_vertex_count = positions.size();
+	released_index_count = indexes.size();
+
+	free_vector(positions);
+	free_vector(colors);
+	free_vector(texcoords);
+	free_vector(normals);
+	free_vector(indexes);
+
+	cpu_released = true;
+}
+
+template <typename T>
+static uint64_t hash_vector(const std::vector<T> &v, uint64_t seed) {
+	// Hash the size too, so data moving between the vectors changes the hash.
+	uint64_t size = v.size();
+	seed = fnv1a_64(&size, sizeof(size), seed);
+	return v.empty() ? seed : fnv1a_64(v.data(), v.size() * sizeof(T), seed);
+}
+
+uint64_t PSIGeometryData::calc_content_hash() {
+	uint64_t hash = FNV1A_64_SEED;
+	hash = hash_vector(positions, hash);
+	hash = hash_vector(colors, hash);
+	hash = hash_vector(texcoords, hash);
+	hash = hash_vector(normals, hash);
+	hash = hash_vector(indexes, hash);
+
+	return hash;
+}
+
+bool PSIGeometryData::content_equals(const PSIGeometryData &other) {
+	return positions == other.positions &&
+	       colors    == other.colors &&
+	       texcoords == other.texcoords &&
+	       normals   == other.normals &&
+	       indexes   == other.indexes;
+}
@@ -37,7 +37,37 @@ class PSIGeometryData {
 		std::vector<PSIGLMesh::gl_buffer_info> buffers;
 		std::vector<PSIGLMesh::gl_vertex_attribute> attributes;
 
+		// Set when the typed data has been released after uploading it to the GPU.
+		// Buffer and attribute descriptions, counts and bounds are kept.
+		GLboolean cpu_released = false;
+		// Vertex and index counts at the time the typed data was released.
+		GLsizei released_vertex_count = 0;
+		GLsizei released_index_count = 0;
+
+		// Shared between render objects, so per object data like colors must not be written here.
+		GLboolean shared = false;
+
+		// Bounding sphere around the positions, in model space.
+		glm::vec3 bounds_center = glm::vec3(0.0f);
+		GLfloat bounds_radius = 0.0f;
+
 		// Methods
 		void print_data();
+		// Calculate the bounding sphere from positions.
+		void calc_bounds();
+		// Free the typed data, keeping the metadata needed for drawing and bounds.
+		void release_cpu_data();
+
+		GLsizei get_vertex_count() {
+			return (cpu_released == true) ? released_vertex_count : positions.size();
+		}
+		GLsizei get_index_count() {
+			return (cpu_released == true) ? released_index_count : indexes.size();
+		}
+
+		// Hash of the typed data, for finding identical geometry.
+		uint64_t calc_content_hash();
+		// Does this have the same typed data as other ?
+		bool content_equals(const PSIGeometryData &other);
 
 }; // PSIGeometryData
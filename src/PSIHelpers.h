@@ -5,6 +5,7 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 
 #define STACK_PUSH(x) (x.push(x.top()))
 
@@ -26,3 +27,17 @@ template <typename E>
 constexpr auto to_underlying(E e) noexcept {
     return static_cast<std::underlying_type_t<E>>(e);
 }
+
+// 64-bit FNV-1a hash of size bytes. Pass the previous hash as seed to continue hashing.
+static const uint64_t FNV1A_64_SEED = 0xcbf29ce484222325ULL;
+
+inline uint64_t fnv1a_64(const void *data, size_t size, uint64_t seed = FNV1A_64_SEED) {
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
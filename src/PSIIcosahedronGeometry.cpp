@@ -3,7 +3,38 @@
 namespace PSIGeometry {
 namespace Icosahedron {
 
+// Split vertex and triangle work between threads only after this many items.
+// Levels below this are created faster on a single thread.
+static const size_t PARALLEL_MIN_BATCH = 8192;
+
+// Same key for both directions of an edge.
+static inline uint64_t edge_key(GLint v1, GLint v2) {
+	if (v1 > v2) {
+		std::swap(v1, v2);
+	}
+
+	return ((uint64_t)v1 << 32) | (uint32_t)v2;
+}
+
+GLsizei icosahedron_face_count(GLint recursion) {
+	// Each level splits every face into 4. Clamped, as shifting by a negative or
+	// too large amount is undefined.
+	recursion = std::min(std::max(recursion, 0), MAX_RECURSION);
+	return 20 << (2 * recursion);
+}
+
+GLsizei icosahedron_vertex_count(GLint recursion) {
+	// With shared edges, each level adds one vertex per edge.
+	// For a closed triangle mesh this gives V = F / 2 + 2.
+	return icosahedron_face_count(recursion) / 2 + 2;
+}
+
 GeometryDataSharedPtr icosahedron(GLint recursion) {
+	if (recursion < 0 || recursion > MAX_RECURSION) {
+		psilog_err("Invalid icosahedron recursion %d, must be 0 to %d", recursion, MAX_RECURSION);
+		return nullptr;
+	}
+
 	GeometryDataSharedPtr geom = PSIGeometryData::create();
 	if (geom == nullptr) {
 		return nullptr;
@@ -16,7 +47,8 @@ GeometryDataSharedPtr icosahedron(GLint recursion) {
 
 	// Corners of three orthogonal rectangles, with
 	// side length of len, form the icosahedron 12 points.
-	geom->positions.reserve(vertex_count);
+	// Reserve room for all the vertices we will be creating while recursing.
+	geom->positions.reserve(icosahedron_vertex_count(recursion));
 
 	geom->positions.push_back(glm::normalize(glm::vec3(-1,  len,  0)));
 	geom->positions.push_back(glm::normalize(glm::vec3( 1,  len,  0)));
@@ -35,6 +67,32 @@ GeometryDataSharedPtr icosahedron(GLint recursion) {
 
 	// create 20 triangle faces of the icosahedron.
 	std::vector<PSI::tri_indexes> tri_indexes;
+	std::vector<PSI::tri_indexes> split_tri_indexes;
+	tri_indexes.reserve(icosahedron_face_count(recursion));
+	split_tri_indexes.reserve(icosahedron_face_count(recursion));
+
+	// Midpoint vertex indexes for each side of a triangle.
+	std::vector<PSI::tri_indexes> tri_midpoints;
+	// Edge vertex pairs of the midpoints created on the current level.
+	std::vector<std::pair<GLint, GLint>> midpoint_edges;
+	// Midpoint vertex index cache, keyed by the edge.
+	std::unordered_map<uint64_t, GLint> midpoints;
+
+	// Find the vertex in the middle of the edge between vertexes v1 and v2,
+	// or add a new one if the edge has not been split yet.
+	auto get_midpoint = [&](GLint v1, GLint v2) {
+		uint64_t key = edge_key(v1, v2);
+		auto it = midpoints.find(key);
+		if (it != midpoints.end()) {
+			return it->second;
+		}
+
+		GLint index = vertex_count++;
+		midpoints.emplace(key, index);
+		midpoint_edges.emplace_back(v1, v2);
+
+		return index;
+	};
 
 	// 5 tri_indexes around center point
 	// in counter clockwise order.
@@ -67,103 +125,113 @@ GeometryDataSharedPtr icosahedron(GLint recursion) {
 
 	// Refine triangles by recursing onto the tri_indexes and splitting
 	// each triangle face to 4 individual triangles.
+	//
+	// Neighbouring triangles share their edges, so the middle point of each edge
+	// is only created once and looked up from the midpoint cache after that.
 	for (int i = 0; i<recursion; i++) {
-		std::vector<PSI::tri_indexes> split_tri_indexes;
-		for (auto tri : tri_indexes) {
-			// Split one triangle into 4.
-			//
-			// Calculate three middle points, for each side
-			// noted a, b, c.
-			//
-			//       0
-			//       . 
-			//      / \
-			//   a .   . c
-			//    /     \
-			//   .___.___.
-			//  1    b    2
-			//
-			//
-			// We need to store these triangles for normal processing .. 
-			// We will be pushing 3 normals, as we are pushing 3 positions.
-		
-			// Calculate the middle points for side a.
-			glm::vec3 p1_1 = geom->positions.at(tri[0]);
-			glm::vec3 p1_2 = geom->positions.at(tri[1]);
-			glm::vec3 mid1 = (p1_1 + p1_2) / 2.0f;
-			geom->positions.push_back(glm::normalize(mid1));
-			GLint a = vertex_count++;
-
-			// Calculate the middle points for side b.
-			glm::vec3 p2_1 = geom->positions.at(tri[1]);
-			glm::vec3 p2_2 = geom->positions.at(tri[2]);
-			glm::vec3 mid2 = (p2_1 + p2_2) / 2.0f;
-			geom->positions.push_back(glm::normalize(mid2));
-			GLint b = vertex_count++;
-
-			// Calculate the middle points for side c.
-			glm::vec3 p3_1 = geom->positions.at(tri[2]);
-			glm::vec3 p3_2 = geom->positions.at(tri[0]);
-			glm::vec3 mid3 = (p3_1 + p3_2) / 2.0f;
-			geom->positions.push_back(glm::normalize(mid3));
-			GLint c = vertex_count++;
-
-			// Create the new triangle, with 4 faces
-			// Using the previously calculated indexes.
-
-			// Start pushing from the top triangle.
-			//
-			//       0
-			//       . 
-			//      /.\
-			//   a ..... c
-			//    /     \
-			//   .___.___.
-			//  1    b    2
-			PSI::tri_indexes t0ac = {{ tri[0], a, c }};
-			split_tri_indexes.push_back(t0ac);
-
-			//       0
-			//       . 
-			//      / \
-			//   a /   \ c
-			//    /.    \
-			//   .:::.___.
-			//  1    b    2
-			PSI::tri_indexes t1ab = {{ tri[1], b, a }};
-			split_tri_indexes.push_back(t1ab);
-
-			//       0
-			//       . 
-			//      / \
-			//   a /   \ c
-			//    /    :\
-			//   .___.'::.
-			//  1    b    2
-			PSI::tri_indexes t2cb = {{ tri[2], c, b }};
-			split_tri_indexes.push_back(t2cb);
-
-			// The base formation, in the middle.
-			// We will be calculating normals based on this and the side triangles.
-			//       0
-			//       . 
-			//      / \
-			//   a _____ c
-			//    /\.o./\
-			//   .__\:/__.
-			//  1    b    2
-			PSI::tri_indexes t3abc = {{ a, b, c }};
-			split_tri_indexes.push_back(t3abc);
+		GLsizei tri_count = tri_indexes.size();
+
+		// Every edge is shared by two triangles.
+		midpoints.clear();
+		midpoints.reserve(tri_count * 3 / 2);
+		midpoint_edges.clear();
+		midpoint_edges.reserve(tri_count * 3 / 2);
+		tri_midpoints.resize(tri_count);
+
+		// Calculate three middle points, for each side
+		// noted a, b, c.
+		//
+		//       0
+		//       . 
+		//      / \
+		//   a .   . c
+		//    /     \
+		//   .___.___.
+		//  1    b    2
+		//
+		// The cache lookup is serial, the actual vertex math is done below.
+		for (GLsizei t = 0; t < tri_count; t++) {
+			const PSI::tri_indexes &tri = tri_indexes[t];
+			tri_midpoints[t] = {{
+				get_midpoint(tri[0], tri[1]),
+				get_midpoint(tri[1], tri[2]),
+				get_midpoint(tri[2], tri[0])
+			}};
 		}
 
-		tri_indexes = split_tri_indexes;
+		// Calculate the new middle point positions, pushed onto the unit sphere.
+		GLsizei first_new = geom->positions.size();
+		geom->positions.resize(vertex_count);
+		PSIParallel::for_range(midpoint_edges.size(), PARALLEL_MIN_BATCH, [&](size_t begin, size_t end) {
+			for (size_t m = begin; m < end; m++) {
+				const glm::vec3 &p1 = geom->positions[midpoint_edges[m].first];
+				const glm::vec3 &p2 = geom->positions[midpoint_edges[m].second];
+				geom->positions[first_new + m] = glm::normalize((p1 + p2) / 2.0f);
+			}
+		});
+
+		// Create the new triangles, with 4 faces for each triangle.
+		split_tri_indexes.resize(4 * tri_count);
+		PSIParallel::for_range(tri_count, PARALLEL_MIN_BATCH, [&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				const PSI::tri_indexes &tri = tri_indexes[t];
+				GLint a = tri_midpoints[t][0];
+				GLint b = tri_midpoints[t][1];
+				GLint c = tri_midpoints[t][2];
+				PSI::tri_indexes *split = &split_tri_indexes[4 * t];
+
+				// Start from the top triangle.
+				//
+				//       0
+				//       . 
+				//      /.\
+				//   a ..... c
+				//    /     \
+				//   .___.___.
+				//  1    b    2
+				split[0] = {{ tri[0], a, c }};
+
+				//       0
+				//       . 
+				//      / \
+				//   a /   \ c
+				//    /.    \
+				//   .:::.___.
+				//  1    b    2
+				split[1] = {{ tri[1], b, a }};
+
+				//       0
+				//       . 
+				//      / \
+				//   a /   \ c
+				//    /    :\
+				//   .___.'::.
+				//  1    b    2
+				split[2] = {{ tri[2], c, b }};
+
+				// The base formation, in the middle.
+				//       0
+				//       . 
+				//      / \
+				//   a _____ c
+				//    /\.o./\
+				//   .__\:/__.
+				//  1    b    2
+				split[3] = {{ a, b, c }};
+			}
+		});
+
+		tri_indexes.swap(split_tri_indexes);
 	}
 
+	assert((GLsizei)geom->positions.size() == icosahedron_vertex_count(recursion));
+
 	// Add indexes..
-	for (auto tri : tri_indexes) {
-		geom->indexes.push_back((GLuint)tri[0]);
-		geom->indexes.push_back((GLuint)tri[1]);
-		geom->indexes.push_back((GLuint)tri[2]);
+	geom->indexes.resize(3 * tri_indexes.size());
+	for (size_t t = 0; t < tri_indexes.size(); t++) {
+		geom->indexes[3 * t + 0] = (GLuint)tri_indexes[t][0];
+		geom->indexes[3 * t + 1] = (GLuint)tri_indexes[t][1];
+		geom->indexes[3 * t + 2] = (GLuint)tri_indexes[t][2];
 	}
 
 	// We can just use the positions as the normals, 
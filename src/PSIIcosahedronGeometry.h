@@ -6,11 +6,22 @@
 
 #include "PSIGeometryData.h"
 #include "PSIMath.h"
+#include "PSIParallel.h"
 #include <algorithm>
+#include <unordered_map>
 
 namespace PSIGeometry {
 	namespace Icosahedron {
-		// Create icosahedron with levels of recursion.
+		// Deepest level of recursion, whose face count still fits a GLsizei.
+		const GLint MAX_RECURSION = 13;
+
+		// Create icosahedron with levels of recursion, 0 to MAX_RECURSION.
+		// Returns nullptr for other levels.
 		GeometryDataSharedPtr icosahedron(GLint recursion);
+
+		// Number of triangle faces for icosahedron with levels of recursion.
+		GLsizei icosahedron_face_count(GLint recursion);
+		// Number of vertexes for icosahedron with levels of recursion.
+		GLsizei icosahedron_vertex_count(GLint recursion);
 	}
 }
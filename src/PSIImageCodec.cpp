@@ -0,0 +1,1167 @@
+#include "PSIImageCodec.h"
+#include "PSIParallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace PSIImageCodec {
+
+// Bands are not split smaller than this many rows, as each band restarts compression.
+static const GLint MIN_BAND_ROWS = 32;
+
+// Largest image side we accept, keeps the byte counts well inside 32 bits per row.
+static const GLint MAX_SIDE = 1 << 16;
+
+static bool valid_input(const unsigned char *pixels, GLint width, GLint height, const encode_options &options) {
+	return pixels != nullptr && width > 0 && height > 0 && width <= MAX_SIDE && height <= MAX_SIDE &&
+	       (options.src_channels == 3 || options.src_channels == 4) &&
+	       (options.channels == 3 || options.channels == 4);
+}
+
+static GLint get_band_count(GLint height, const encode_options &options) {
+	if (options.band_count > 0) {
+		return std::min(options.band_count, height);
+	}
+
+	GLint count = (GLint)PSIParallel::get_thread_count();
+	return std::max(std::min(count, height / MIN_BAND_ROWS), 1);
+}
+
+// Source row y of the output image, taking the flip into account.
+static const unsigned char *get_src_row(const unsigned char *pixels, GLint width, GLint height,
+                                        GLint y, const encode_options &options) {
+	size_t stride = options.src_stride != 0 ? options.src_stride : (size_t)width * options.src_channels;
+	GLint src_y = options.flip_y == true ? height - 1 - y : y;
+
+	return pixels + stride * src_y;
+}
+
+// Copy one row of pixels, converting between RGB and RGBA.
+static void convert_row(const unsigned char *src, unsigned char *dst, GLint width,
+                        GLint src_channels, GLint channels) {
+	if (src_channels == channels) {
+		memcpy(dst, src, (size_t)width * channels);
+		return;
+	}
+
+	GLint x = 0;
+	if (src_channels == 4) {
+#if defined(__SSSE3__)
+		// Four pixels at a time, packing RGBA into 12 bytes of RGB.
+		const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		for (; x + 4 <= width; x += 4) {
+			__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + x * 4)), pack);
+			_mm_storel_epi64((__m128i *)(dst + x * 3), v);
+			int last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+			memcpy(dst + x * 3 + 8, &last, 4);
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 16 <= width; x += 16) {
+			uint8x16x4_t v = vld4q_u8(src + x * 4);
+			uint8x16x3_t rgb = { { v.val[0], v.val[1], v.val[2] } };
+			vst3q_u8(dst + x * 3, rgb);
+		}
+#endif
+		for (; x < width; x++) {
+			dst[x * 3 + 0] = src[x * 4 + 0];
+			dst[x * 3 + 1] = src[x * 4 + 1];
+			dst[x * 3 + 2] = src[x * 4 + 2];
+		}
+	} else {
+#if defined(__SSSE3__)
+		// Reads 16 bytes for the 12 used, so stop while two pixels are left over.
+		const __m128i unpack = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		for (; x + 6 <= width; x += 4) {
+			__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + x * 3)), unpack);
+			_mm_storeu_si128((__m128i *)(dst + x * 4), _mm_or_si128(v, alpha));
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 16 <= width; x += 16) {
+			uint8x16x3_t v = vld3q_u8(src + x * 3);
+			uint8x16x4_t rgba = { { v.val[0], v.val[1], v.val[2], vdupq_n_u8(255) } };
+			vst4q_u8(dst + x * 4, rgba);
+		}
+#endif
+		for (; x < width; x++) {
+			dst[x * 4 + 0] = src[x * 3 + 0];
+			dst[x * 4 + 1] = src[x * 3 + 1];
+			dst[x * 4 + 2] = src[x * 3 + 2];
+			dst[x * 4 + 3] = 255;
+		}
+	}
+}
+
+static void put_u32_be(std::vector<unsigned char> &out, uint32_t value) {
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static bool write_file(const std::string &path, const std::vector<unsigned char> &data) {
+	FILE *fp = fopen(path.c_str(), "wb");
+	if (fp == NULL) {
+		psilog_err("Failed opening '%s' for writing", path.c_str());
+		return false;
+	}
+
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	ok = (fclose(fp) == 0) && ok;
+	if (ok == false) {
+		psilog_err("Failed writing '%s'", path.c_str());
+	}
+
+	return ok;
+}
+
+//
+// Checksums.
+//
+
+static const uint32_t *get_crc_table() {
+	static uint32_t table[256];
+	static bool initialized = [] {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return true;
+	}();
+	(void)initialized;
+
+	return table;
+}
+
+static uint32_t crc32(uint32_t crc, const unsigned char *data, size_t size) {
+	const uint32_t *table = get_crc_table();
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+static const uint32_t ADLER_BASE = 65521;
+
+static uint32_t adler32(const unsigned char *data, size_t size) {
+	uint32_t a = 1;
+	uint32_t b = 0;
+	while (size > 0) {
+		// Largest block that can't overflow b before the modulo.
+		size_t block = std::min<size_t>(size, 5552);
+		for (size_t i = 0; i < block; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+		data += block;
+		size -= block;
+	}
+
+	return (b << 16) | a;
+}
+
+// Adler-32 of two blocks joined, from their checksums and the size of the second.
+static uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t size2) {
+	uint32_t rem = (uint32_t)(size2 % ADLER_BASE);
+	uint32_t sum1 = adler1 & 0xffff;
+	uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % ADLER_BASE);
+	sum1 += (adler2 & 0xffff) + ADLER_BASE - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+	if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+	if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+	if (sum2 >= (ADLER_BASE << 1)) sum2 -= (ADLER_BASE << 1);
+	if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+
+	return (sum2 << 16) | sum1;
+}
+
+//
+// Deflate.
+//
+
+static const GLint WINDOW_SIZE = 32768;
+static const GLint HASH_BITS = 15;
+static const GLint MAX_CHAIN = 8;
+static const GLint MIN_MATCH = 3;
+static const GLint MAX_MATCH = 258;
+// Symbols per block, each block gets its own Huffman tables.
+static const size_t BLOCK_SYMBOLS = 1 << 15;
+
+static const GLint LITLEN_CODES = 286;
+static const GLint DIST_CODES = 30;
+static const GLint CODELEN_CODES = 19;
+
+static const unsigned short LENGTH_BASE[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char LENGTH_EXTRA[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short DIST_BASE[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const unsigned char DIST_EXTRA[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// Order the code length code lengths are stored in.
+static const unsigned char CODELEN_ORDER[CODELEN_CODES] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Length and distance code lookups.
+struct code_tables {
+	unsigned char length_code[MAX_MATCH + 1];
+	// Distances 1 - 256 by distance - 1, larger by 256 + ((distance - 1) >> 7).
+	unsigned char dist_code[512];
+};
+
+static const code_tables &get_code_tables() {
+	static code_tables tables;
+	static bool initialized = [] {
+		for (GLint code = 0; code < 29; code++) {
+			GLint end = code + 1 < 29 ? LENGTH_BASE[code + 1] : MAX_MATCH + 1;
+			for (GLint len = LENGTH_BASE[code]; len < end; len++) {
+				tables.length_code[len] = code;
+			}
+		}
+
+		for (GLint code = 0; code < DIST_CODES; code++) {
+			GLint end = code + 1 < DIST_CODES ? DIST_BASE[code + 1] : WINDOW_SIZE + 1;
+			for (GLint dist = DIST_BASE[code]; dist < end; dist++) {
+				if (dist <= 256) {
+					tables.dist_code[dist - 1] = code;
+				} else {
+					tables.dist_code[256 + ((dist - 1) >> 7)] = code;
+				}
+			}
+		}
+		return true;
+	}();
+	(void)initialized;
+
+	return tables;
+}
+
+static inline GLint get_dist_code(const code_tables &tables, GLint dist) {
+	return dist <= 256 ? tables.dist_code[dist - 1] : tables.dist_code[256 + ((dist - 1) >> 7)];
+}
+
+// LZ77 output, a literal when dist is 0.
+struct lz_symbol {
+	unsigned short value;
+	unsigned short dist;
+};
+
+// LSB first bit writer.
+struct bit_writer {
+	std::vector<unsigned char> &out;
+	uint64_t bits = 0;
+	GLint count = 0;
+
+	bit_writer(std::vector<unsigned char> &out) : out(out) {}
+
+	void put(uint32_t value, GLint bit_count) {
+		bits |= (uint64_t)value << count;
+		count += bit_count;
+		while (count >= 8) {
+			out.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void align() {
+		if (count > 0) {
+			put(0, 8 - count);
+		}
+	}
+};
+
+// Moffat and Katajainen in place minimum redundancy code lengths. a holds the
+// frequencies sorted ascending, and gets the code lengths.
+static void calculate_code_lengths(GLint *a, GLint n) {
+	if (n == 1) {
+		a[0] = 1;
+		return;
+	}
+
+	GLint root = 0;
+	GLint leaf = 2;
+	a[0] += a[1];
+	for (GLint next = 1; next < n - 1; next++) {
+		if (leaf >= n || a[root] < a[leaf]) {
+			a[next] = a[root];
+			a[root++] = next;
+		} else {
+			a[next] = a[leaf++];
+		}
+		if (leaf >= n || (root < next && a[root] < a[leaf])) {
+			a[next] += a[root];
+			a[root++] = next;
+		} else {
+			a[next] += a[leaf++];
+		}
+	}
+
+	a[n - 2] = 0;
+	for (GLint next = n - 3; next >= 0; next--) {
+		a[next] = a[a[next]] + 1;
+	}
+
+	GLint avail = 1;
+	GLint used = 0;
+	GLint depth = 0;
+	root = n - 2;
+	GLint next = n - 1;
+	while (avail > 0) {
+		while (root >= 0 && a[root] == depth) {
+			used++;
+			root--;
+		}
+		while (avail > used) {
+			a[next--] = depth;
+			avail--;
+		}
+		avail = 2 * used;
+		depth++;
+		used = 0;
+	}
+}
+
+// Huffman code lengths of at most max_length bits for the symbols in freqs. Symbols
+// not used get length 0. Needs at least two used symbols.
+static void build_code_lengths(const uint32_t *freqs, GLint count, GLint max_length, unsigned char *lengths) {
+	std::vector<std::pair<uint32_t, GLint>> used;
+	for (GLint i = 0; i < count; i++) {
+		lengths[i] = 0;
+		if (freqs[i] > 0) {
+			used.push_back(std::make_pair(freqs[i], i));
+		}
+	}
+	std::sort(used.begin(), used.end());
+
+	std::vector<GLint> a(used.size());
+	for (size_t i = 0; i < used.size(); i++) {
+		a[i] = (GLint)std::min<uint32_t>(used[i].first, 0x3fffffff);
+	}
+	calculate_code_lengths(a.data(), (GLint)a.size());
+
+	// Clamp to max_length and fix up the Kraft sum by lengthening shorter codes.
+	GLint length_counts[33] = { 0 };
+	for (GLint length : a) {
+		length_counts[std::min(length, 32)]++;
+	}
+	for (GLint i = max_length + 1; i <= 32; i++) {
+		length_counts[max_length] += length_counts[i];
+	}
+
+	uint32_t total = 0;
+	for (GLint i = max_length; i > 0; i--) {
+		total += (uint32_t)length_counts[i] << (max_length - i);
+	}
+	while (total != (1u << max_length)) {
+		length_counts[max_length]--;
+		for (GLint i = max_length - 1; i > 0; i--) {
+			if (length_counts[i] != 0) {
+				length_counts[i]--;
+				length_counts[i + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	// Least frequent symbols get the longest codes.
+	size_t index = 0;
+	for (GLint length = max_length; length > 0; length--) {
+		for (GLint i = 0; i < length_counts[length]; i++) {
+			lengths[used[index++].second] = length;
+		}
+	}
+}
+
+// Canonical codes for lengths, bit reversed for the LSB first writer.
+static void build_codes(const unsigned char *lengths, GLint count, unsigned short *codes) {
+	GLint length_counts[16] = { 0 };
+	for (GLint i = 0; i < count; i++) {
+		length_counts[lengths[i]]++;
+	}
+	length_counts[0] = 0;
+
+	GLint next_code[16] = { 0 };
+	GLint code = 0;
+	for (GLint bits = 1; bits < 16; bits++) {
+		code = (code + length_counts[bits - 1]) << 1;
+		next_code[bits] = code;
+	}
+
+	for (GLint i = 0; i < count; i++) {
+		GLint length = lengths[i];
+		if (length == 0) {
+			continue;
+		}
+
+		GLint value = next_code[length]++;
+		GLint reversed = 0;
+		for (GLint b = 0; b < length; b++) {
+			reversed = (reversed << 1) | ((value >> b) & 1);
+		}
+		codes[i] = reversed;
+	}
+}
+
+// Deflate wants at least two codes in a tree to keep it complete.
+static void ensure_two_codes(uint32_t *freqs, GLint count) {
+	GLint used = 0;
+	for (GLint i = 0; i < count; i++) {
+		used += freqs[i] > 0 ? 1 : 0;
+	}
+	for (GLint i = 0; i < count && used < 2; i++) {
+		if (freqs[i] == 0) {
+			freqs[i] = 1;
+			used++;
+		}
+	}
+}
+
+// Write symbols as one non-final block with dynamic Huffman codes.
+static void write_block(bit_writer &writer, const std::vector<lz_symbol> &symbols) {
+	const code_tables &tables = get_code_tables();
+
+	uint32_t lit_freqs[LITLEN_CODES] = { 0 };
+	uint32_t dist_freqs[DIST_CODES] = { 0 };
+	for (const auto &symbol : symbols) {
+		if (symbol.dist == 0) {
+			lit_freqs[symbol.value]++;
+		} else {
+			lit_freqs[257 + tables.length_code[symbol.value]]++;
+			dist_freqs[get_dist_code(tables, symbol.dist)]++;
+		}
+	}
+	lit_freqs[256] = 1;
+	ensure_two_codes(lit_freqs, LITLEN_CODES);
+	ensure_two_codes(dist_freqs, DIST_CODES);
+
+	unsigned char lit_lengths[LITLEN_CODES];
+	unsigned char dist_lengths[DIST_CODES];
+	build_code_lengths(lit_freqs, LITLEN_CODES, 15, lit_lengths);
+	build_code_lengths(dist_freqs, DIST_CODES, 15, dist_lengths);
+
+	GLint lit_count = LITLEN_CODES;
+	while (lit_count > 257 && lit_lengths[lit_count - 1] == 0) {
+		lit_count--;
+	}
+	GLint dist_count = DIST_CODES;
+	while (dist_count > 1 && dist_lengths[dist_count - 1] == 0) {
+		dist_count--;
+	}
+	// The literal and distance lengths are run length coded as one sequence.
+	unsigned char lengths[LITLEN_CODES + DIST_CODES];
+	memcpy(lengths, lit_lengths, lit_count);
+	memcpy(lengths + lit_count, dist_lengths, dist_count);
+	GLint length_count = lit_count + dist_count;
+
+	// Run length code the lengths, with code length symbols 16 - 18 for repeats.
+	std::vector<std::pair<unsigned char, unsigned char>> runs;
+	uint32_t codelen_freqs[CODELEN_CODES] = { 0 };
+	for (GLint i = 0; i < length_count;) {
+		GLint length = lengths[i];
+		GLint run = 1;
+		while (i + run < length_count && lengths[i + run] == length) {
+			run++;
+		}
+		i += run;
+
+		if (length == 0) {
+			while (run >= 11) {
+				GLint n = std::min(run, 138);
+				runs.push_back(std::make_pair(18, n - 11));
+				run -= n;
+			}
+			if (run >= 3) {
+				runs.push_back(std::make_pair(17, run - 3));
+				run = 0;
+			}
+		} else {
+			runs.push_back(std::make_pair(length, 0));
+			run--;
+			while (run >= 3) {
+				GLint n = std::min(run, 6);
+				runs.push_back(std::make_pair(16, n - 3));
+				run -= n;
+			}
+		}
+		for (; run > 0; run--) {
+			runs.push_back(std::make_pair(length, 0));
+		}
+	}
+	for (const auto &run : runs) {
+		codelen_freqs[run.first]++;
+	}
+	ensure_two_codes(codelen_freqs, CODELEN_CODES);
+
+	unsigned char codelen_lengths[CODELEN_CODES];
+	build_code_lengths(codelen_freqs, CODELEN_CODES, 7, codelen_lengths);
+	unsigned short codelen_codes[CODELEN_CODES] = { 0 };
+	build_codes(codelen_lengths, CODELEN_CODES, codelen_codes);
+
+	GLint codelen_count = CODELEN_CODES;
+	while (codelen_count > 4 && codelen_lengths[CODELEN_ORDER[codelen_count - 1]] == 0) {
+		codelen_count--;
+	}
+
+	unsigned short lit_codes[LITLEN_CODES] = { 0 };
+	unsigned short dist_codes[DIST_CODES] = { 0 };
+	build_codes(lit_lengths, LITLEN_CODES, lit_codes);
+	build_codes(dist_lengths, DIST_CODES, dist_codes);
+
+	// Block header, not final, dynamic Huffman.
+	writer.put(0, 1);
+	writer.put(2, 2);
+	writer.put(lit_count - 257, 5);
+	writer.put(dist_count - 1, 5);
+	writer.put(codelen_count - 4, 4);
+	for (GLint i = 0; i < codelen_count; i++) {
+		writer.put(codelen_lengths[CODELEN_ORDER[i]], 3);
+	}
+
+	static const unsigned char REPEAT_EXTRA[3] = { 2, 3, 7 };
+	for (const auto &run : runs) {
+		writer.put(codelen_codes[run.first], codelen_lengths[run.first]);
+		if (run.first >= 16) {
+			writer.put(run.second, REPEAT_EXTRA[run.first - 16]);
+		}
+	}
+
+	for (const auto &symbol : symbols) {
+		if (symbol.dist == 0) {
+			writer.put(lit_codes[symbol.value], lit_lengths[symbol.value]);
+			continue;
+		}
+
+		GLint length_code = tables.length_code[symbol.value];
+		writer.put(lit_codes[257 + length_code], lit_lengths[257 + length_code]);
+		writer.put(symbol.value - LENGTH_BASE[length_code], LENGTH_EXTRA[length_code]);
+
+		GLint dist_code = get_dist_code(tables, symbol.dist);
+		writer.put(dist_codes[dist_code], dist_lengths[dist_code]);
+		writer.put(symbol.dist - DIST_BASE[dist_code], DIST_EXTRA[dist_code]);
+	}
+
+	writer.put(lit_codes[256], lit_lengths[256]);
+}
+
+static inline uint32_t hash3(const unsigned char *p) {
+	uint32_t value = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Compress data into out as non-final deflate blocks, ending with an empty stored
+// block so the output ends on a byte boundary and can be followed by more blocks.
+static void deflate_band(const unsigned char *data, size_t size, std::vector<unsigned char> &out) {
+	bit_writer writer(out);
+
+	std::vector<int32_t> head(1 << HASH_BITS, -1);
+	std::vector<int32_t> prev(WINDOW_SIZE, -1);
+	std::vector<lz_symbol> symbols;
+	symbols.reserve(BLOCK_SYMBOLS);
+
+	auto insert = [&](size_t pos) {
+		uint32_t hash = hash3(data + pos);
+		prev[pos & (WINDOW_SIZE - 1)] = head[hash];
+		head[hash] = (int32_t)pos;
+	};
+
+	size_t pos = 0;
+	while (pos < size) {
+		GLint best_length = 0;
+		GLint best_dist = 0;
+
+		if (pos + MIN_MATCH <= size) {
+			GLint max_length = (GLint)std::min<size_t>(MAX_MATCH, size - pos);
+			int32_t candidate = head[hash3(data + pos)];
+			for (GLint chain = 0; chain < MAX_CHAIN && candidate >= 0; chain++) {
+				if (pos - candidate > (size_t)WINDOW_SIZE) {
+					break;
+				}
+
+				const unsigned char *a = data + candidate;
+				const unsigned char *b = data + pos;
+				if (a[best_length] == b[best_length] && a[0] == b[0]) {
+					GLint length = 0;
+					while (length < max_length && a[length] == b[length]) {
+						length++;
+					}
+					if (length > best_length) {
+						best_length = length;
+						best_dist = (GLint)(pos - candidate);
+						if (length == max_length) {
+							break;
+						}
+					}
+				}
+
+				// Slots overwritten by newer positions would lead forward, stop there.
+				int32_t next = prev[candidate & (WINDOW_SIZE - 1)];
+				if (next >= candidate) {
+					break;
+				}
+				candidate = next;
+			}
+			insert(pos);
+		}
+
+		if (best_length >= MIN_MATCH) {
+			symbols.push_back({ (unsigned short)best_length, (unsigned short)best_dist });
+			for (size_t i = pos + 1; i < pos + best_length && i + MIN_MATCH <= size; i++) {
+				insert(i);
+			}
+			pos += best_length;
+		} else {
+			symbols.push_back({ data[pos], 0 });
+			pos++;
+		}
+
+		if (symbols.size() >= BLOCK_SYMBOLS) {
+			write_block(writer, symbols);
+			symbols.clear();
+		}
+	}
+
+	if (symbols.empty() == false) {
+		write_block(writer, symbols);
+	}
+
+	// Empty stored block, not final.
+	writer.put(0, 3);
+	writer.align();
+	out.push_back(0x00);
+	out.push_back(0x00);
+	out.push_back(0xff);
+	out.push_back(0xff);
+}
+
+//
+// PNG.
+//
+
+// Sum of the filtered bytes as signed magnitudes, the usual filter choice heuristic.
+static inline uint32_t filter_cost(const unsigned char *filtered, size_t size) {
+	uint32_t cost = 0;
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(filtered + i));
+		__m128i magnitude = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(magnitude, zero));
+	}
+	cost = (uint32_t)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#endif
+	for (; i < size; i++) {
+		cost += std::min<uint32_t>(filtered[i], 256 - filtered[i]);
+	}
+
+	return cost;
+}
+
+static void filter_sub(const unsigned char *row, unsigned char *out, size_t size, GLint bpp) {
+	size_t i = 0;
+	for (; i < (size_t)bpp; i++) {
+		out[i] = row[i];
+	}
+#if defined(__SSE2__)
+	for (; i + 16 <= size; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(row + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(row + i - bpp));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(a, b));
+	}
+#endif
+	for (; i < size; i++) {
+		out[i] = row[i] - row[i - bpp];
+	}
+}
+
+static void filter_up(const unsigned char *row, const unsigned char *above, unsigned char *out, size_t size) {
+	size_t i = 0;
+#if defined(__SSE2__)
+	for (; i + 16 <= size; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(row + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(above + i));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(a, b));
+	}
+#endif
+	for (; i < size; i++) {
+		out[i] = row[i] - above[i];
+	}
+}
+
+static void filter_paeth(const unsigned char *row, const unsigned char *above, unsigned char *out,
+                         size_t size, GLint bpp) {
+	for (size_t i = 0; i < (size_t)bpp; i++) {
+		out[i] = row[i] - above[i];
+	}
+	for (size_t i = bpp; i < size; i++) {
+		GLint a = row[i - bpp];
+		GLint b = above[i];
+		GLint c = above[i - bpp];
+		GLint pa = abs(b - c);
+		GLint pb = abs(a - c);
+		GLint pc = abs(a + b - 2 * c);
+		GLint predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+		out[i] = row[i] - predictor;
+	}
+}
+
+// One band of rows as a complete IDAT chunk, and the Adler-32 of its filtered rows.
+struct png_band {
+	std::vector<unsigned char> chunk;
+	uint32_t adler = 1;
+	size_t filtered_size = 0;
+};
+
+static void encode_png_band(const unsigned char *pixels, GLint width, GLint height, GLint first_row, GLint end_row,
+                            bool zlib_header, const encode_options &options, png_band &band) {
+	GLint bpp = options.channels;
+	size_t row_size = (size_t)width * bpp;
+
+	std::vector<unsigned char> above(row_size, 0);
+	std::vector<unsigned char> row(row_size);
+	std::vector<unsigned char> candidates[3];
+	for (auto &candidate : candidates) {
+		candidate.resize(row_size);
+	}
+
+	// The rows above the band are only read, so each band filters on its own.
+	if (first_row > 0) {
+		convert_row(get_src_row(pixels, width, height, first_row - 1, options), above.data(),
+		            width, options.src_channels, options.channels);
+	}
+
+	std::vector<unsigned char> filtered;
+	filtered.reserve((row_size + 1) * (end_row - first_row));
+	for (GLint y = first_row; y < end_row; y++) {
+		convert_row(get_src_row(pixels, width, height, y, options), row.data(),
+		            width, options.src_channels, options.channels);
+
+		filter_sub(row.data(), candidates[0].data(), row_size, bpp);
+		filter_up(row.data(), above.data(), candidates[1].data(), row_size);
+		filter_paeth(row.data(), above.data(), candidates[2].data(), row_size, bpp);
+
+		static const unsigned char FILTER_TYPES[3] = { 1, 2, 4 };
+		GLint best = 0;
+		uint32_t best_cost = filter_cost(candidates[0].data(), row_size);
+		for (GLint i = 1; i < 3; i++) {
+			uint32_t cost = filter_cost(candidates[i].data(), row_size);
+			if (cost < best_cost) {
+				best = i;
+				best_cost = cost;
+			}
+		}
+
+		filtered.push_back(FILTER_TYPES[best]);
+		filtered.insert(filtered.end(), candidates[best].begin(), candidates[best].end());
+		std::swap(row, above);
+	}
+
+	band.filtered_size = filtered.size();
+	band.adler = adler32(filtered.data(), filtered.size());
+
+	// Chunk length is filled in once the data is compressed.
+	std::vector<unsigned char> &chunk = band.chunk;
+	chunk = { 0, 0, 0, 0, 'I', 'D', 'A', 'T' };
+	if (zlib_header == true) {
+		// Deflate with a 32K window, no preset dictionary.
+		chunk.push_back(0x78);
+		chunk.push_back(0x01);
+	}
+	deflate_band(filtered.data(), filtered.size(), chunk);
+
+	uint32_t length = (uint32_t)(chunk.size() - 8);
+	chunk[0] = (unsigned char)(length >> 24);
+	chunk[1] = (unsigned char)(length >> 16);
+	chunk[2] = (unsigned char)(length >> 8);
+	chunk[3] = (unsigned char)length;
+	put_u32_be(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+}
+
+static void put_chunk(std::vector<unsigned char> &out, const char *type, const std::vector<unsigned char> &data) {
+	put_u32_be(out, (uint32_t)data.size());
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	put_u32_be(out, crc32(0, out.data() + start, out.size() - start));
+}
+
+bool encode_png(std::vector<unsigned char> &out, const unsigned char *pixels, GLint width, GLint height,
+                const encode_options &options) {
+	if (valid_input(pixels, width, height, options) == false) {
+		psilog_err("Unsupported image for PNG, %dx%d, %d -> %d channels", width, height,
+		           options.src_channels, options.channels);
+		return false;
+	}
+
+	GLint band_count = get_band_count(height, options);
+	std::vector<png_band> bands(band_count);
+	PSIParallel::for_range(band_count, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			GLint first_row = (GLint)((int64_t)height * i / band_count);
+			GLint end_row = (GLint)((int64_t)height * (i + 1) / band_count);
+			encode_png_band(pixels, width, height, first_row, end_row, i == 0, options, bands[i]);
+		}
+	});
+
+	static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	out.assign(SIGNATURE, SIGNATURE + 8);
+
+	std::vector<unsigned char> header;
+	put_u32_be(header, width);
+	put_u32_be(header, height);
+	// 8 bits per channel, RGB or RGBA, deflate, adaptive filtering, no interlace.
+	header.push_back(8);
+	header.push_back(options.channels == 4 ? 6 : 2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	put_chunk(out, "IHDR", header);
+
+	uint32_t adler = 1;
+	for (const auto &band : bands) {
+		out.insert(out.end(), band.chunk.begin(), band.chunk.end());
+		adler = adler32_combine(adler, band.adler, band.filtered_size);
+	}
+
+	// Empty final block with fixed codes, then the zlib checksum.
+	std::vector<unsigned char> tail = { 0x03, 0x00 };
+	put_u32_be(tail, adler);
+	put_chunk(out, "IDAT", tail);
+	put_chunk(out, "IEND", std::vector<unsigned char>());
+
+	return true;
+}
+
+//
+// QOI.
+//
+
+static const unsigned char QOI_OP_INDEX = 0x00;
+static const unsigned char QOI_OP_DIFF = 0x40;
+static const unsigned char QOI_OP_LUMA = 0x80;
+static const unsigned char QOI_OP_RUN = 0xc0;
+static const unsigned char QOI_OP_RGB = 0xfe;
+static const unsigned char QOI_OP_RGBA = 0xff;
+static const GLint QOI_MAX_RUN = 62;
+static const size_t QOI_HEADER_SIZE = 14;
+// Seven zero bytes and a one after the last op.
+static const size_t QOI_END_SIZE = 8;
+
+union qoi_pixel {
+	struct {
+		unsigned char r, g, b, a;
+	} rgba;
+	uint32_t value;
+};
+
+static inline GLint qoi_hash(const qoi_pixel &px) {
+	return (px.rgba.r * 3 + px.rgba.g * 5 + px.rgba.b * 7 + px.rgba.a * 11) % 64;
+}
+
+// Converted pixels of one band, and the decoder state the band starts from.
+struct qoi_band {
+	std::vector<unsigned char> pixels;
+	size_t pixel_count = 0;
+	// Last pixel of the band for each index slot, and which slots it has.
+	qoi_pixel last[64];
+	uint64_t last_mask = 0;
+	// Decoder index and previous pixel at the start of the band.
+	qoi_pixel index[64];
+	qoi_pixel prev;
+	std::vector<unsigned char> out;
+};
+
+static inline qoi_pixel read_qoi_pixel(const unsigned char *p, GLint channels) {
+	qoi_pixel px;
+	px.rgba.r = p[0];
+	px.rgba.g = p[1];
+	px.rgba.b = p[2];
+	px.rgba.a = channels == 4 ? p[3] : 255;
+
+	return px;
+}
+
+static void encode_qoi_band(qoi_band &band, GLint channels) {
+	std::vector<unsigned char> &out = band.out;
+	out.reserve(band.pixel_count * (channels + 1) / 2);
+
+	qoi_pixel prev = band.prev;
+	GLint run = 0;
+	for (size_t i = 0; i < band.pixel_count; i++) {
+		qoi_pixel px = read_qoi_pixel(band.pixels.data() + i * channels, channels);
+
+		if (px.value == prev.value) {
+			run++;
+			if (run == QOI_MAX_RUN || i + 1 == band.pixel_count) {
+				out.push_back(QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0) {
+			out.push_back(QOI_OP_RUN | (run - 1));
+			run = 0;
+		}
+
+		GLint hash = qoi_hash(px);
+		if (band.index[hash].value == px.value) {
+			out.push_back(QOI_OP_INDEX | hash);
+		} else {
+			band.index[hash] = px;
+
+			if (px.rgba.a == prev.rgba.a) {
+				signed char vr = px.rgba.r - prev.rgba.r;
+				signed char vg = px.rgba.g - prev.rgba.g;
+				signed char vb = px.rgba.b - prev.rgba.b;
+				signed char vg_r = vr - vg;
+				signed char vg_b = vb - vg;
+
+				if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+					out.push_back(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+				} else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+					out.push_back(QOI_OP_LUMA | (vg + 32));
+					out.push_back((vg_r + 8) << 4 | (vg_b + 8));
+				} else {
+					out.push_back(QOI_OP_RGB);
+					out.push_back(px.rgba.r);
+					out.push_back(px.rgba.g);
+					out.push_back(px.rgba.b);
+				}
+			} else {
+				out.push_back(QOI_OP_RGBA);
+				out.push_back(px.rgba.r);
+				out.push_back(px.rgba.g);
+				out.push_back(px.rgba.b);
+				out.push_back(px.rgba.a);
+			}
+		}
+
+		prev = px;
+	}
+}
+
+bool encode_qoi(std::vector<unsigned char> &out, const unsigned char *pixels, GLint width, GLint height,
+                const encode_options &options) {
+	if (valid_input(pixels, width, height, options) == false) {
+		psilog_err("Unsupported image for QOI, %dx%d, %d -> %d channels", width, height,
+		           options.src_channels, options.channels);
+		return false;
+	}
+
+	GLint channels = options.channels;
+	GLint band_count = get_band_count(height, options);
+	std::vector<qoi_band> bands(band_count);
+
+	// Convert the rows and note the last pixel in each index slot. The decoder
+	// index at any pixel holds the last earlier pixel hashed to each slot.
+	PSIParallel::for_range(band_count, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			GLint first_row = (GLint)((int64_t)height * i / band_count);
+			GLint end_row = (GLint)((int64_t)height * (i + 1) / band_count);
+
+			qoi_band &band = bands[i];
+			size_t row_size = (size_t)width * channels;
+			band.pixel_count = (size_t)width * (end_row - first_row);
+			band.pixels.resize(row_size * (end_row - first_row));
+			for (GLint y = first_row; y < end_row; y++) {
+				convert_row(get_src_row(pixels, width, height, y, options),
+				            band.pixels.data() + row_size * (y - first_row),
+				            width, options.src_channels, channels);
+			}
+
+			for (size_t p = 0; p < band.pixel_count; p++) {
+				qoi_pixel px = read_qoi_pixel(band.pixels.data() + p * channels, channels);
+				GLint hash = qoi_hash(px);
+				band.last[hash] = px;
+				band.last_mask |= (uint64_t)1 << hash;
+			}
+		}
+	});
+
+	// Start state of each band from the bands before it.
+	qoi_pixel index[64];
+	memset(index, 0, sizeof(index));
+	qoi_pixel prev;
+	prev.rgba.r = 0;
+	prev.rgba.g = 0;
+	prev.rgba.b = 0;
+	prev.rgba.a = 255;
+	for (auto &band : bands) {
+		memcpy(band.index, index, sizeof(index));
+		band.prev = prev;
+
+		for (GLint slot = 0; slot < 64; slot++) {
+			if (band.last_mask & ((uint64_t)1 << slot)) {
+				index[slot] = band.last[slot];
+			}
+		}
+		prev = read_qoi_pixel(band.pixels.data() + (band.pixel_count - 1) * channels, channels);
+	}
+
+	PSIParallel::for_range(band_count, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			encode_qoi_band(bands[i], channels);
+			// The pixels are not needed anymore.
+			std::vector<unsigned char>().swap(bands[i].pixels);
+		}
+	});
+
+	out.clear();
+	out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+	put_u32_be(out, width);
+	put_u32_be(out, height);
+	out.push_back(channels);
+	// sRGB with linear alpha.
+	out.push_back(0);
+	for (const auto &band : bands) {
+		out.insert(out.end(), band.out.begin(), band.out.end());
+	}
+	out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+
+	return true;
+}
+
+static inline uint32_t get_u32_be(const unsigned char *p) {
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+bool read_qoi_header(const unsigned char *data, size_t size, GLint &width, GLint &height, GLint &channels) {
+	if (data == nullptr || size < QOI_HEADER_SIZE + QOI_END_SIZE || memcmp(data, "qoif", 4) != 0) {
+		return false;
+	}
+
+	uint32_t w = get_u32_be(data + 4);
+	uint32_t h = get_u32_be(data + 8);
+	if (w == 0 || h == 0 || w > (uint32_t)MAX_SIDE || h > (uint32_t)MAX_SIDE || (data[12] != 3 && data[12] != 4)) {
+		return false;
+	}
+
+	width = w;
+	height = h;
+	channels = data[12];
+
+	return true;
+}
+
+bool decode_qoi(const unsigned char *data, size_t size, unsigned char *out, GLint channels) {
+	GLint width, height, file_channels;
+	if (read_qoi_header(data, size, width, height, file_channels) == false || out == nullptr ||
+	    (channels != 3 && channels != 4)) {
+		psilog_err("Invalid QOI data or channel count %d", channels);
+		return false;
+	}
+
+	qoi_pixel index[64];
+	memset(index, 0, sizeof(index));
+	qoi_pixel px;
+	px.rgba.r = 0;
+	px.rgba.g = 0;
+	px.rgba.b = 0;
+	px.rgba.a = 255;
+
+	// The longest op is 5 bytes, ops starting before the end marker are read whole.
+	const unsigned char *p = data + QOI_HEADER_SIZE;
+	const unsigned char *end = data + size - QOI_END_SIZE;
+	unsigned char *dst = out;
+	unsigned char *dst_end = out + (size_t)width * height * channels;
+	while (dst < dst_end) {
+		if (p >= end) {
+			psilog_err("QOI data ends before the last pixel");
+			return false;
+		}
+
+		GLint run = 1;
+		unsigned char op = *p++;
+		if (op == QOI_OP_RGB) {
+			px.rgba.r = p[0];
+			px.rgba.g = p[1];
+			px.rgba.b = p[2];
+			p += 3;
+		} else if (op == QOI_OP_RGBA) {
+			px.rgba.r = p[0];
+			px.rgba.g = p[1];
+			px.rgba.b = p[2];
+			px.rgba.a = p[3];
+			p += 4;
+		} else if ((op & 0xc0) == QOI_OP_INDEX) {
+			px = index[op];
+		} else if ((op & 0xc0) == QOI_OP_DIFF) {
+			px.rgba.r += ((op >> 4) & 0x03) - 2;
+			px.rgba.g += ((op >> 2) & 0x03) - 2;
+			px.rgba.b += (op & 0x03) - 2;
+		} else if ((op & 0xc0) == QOI_OP_LUMA) {
+			GLint vg = (op & 0x3f) - 32;
+			px.rgba.r += vg - 8 + ((p[0] >> 4) & 0x0f);
+			px.rgba.g += vg;
+			px.rgba.b += vg - 8 + (p[0] & 0x0f);
+			p++;
+		} else {
+			run = (op & 0x3f) + 1;
+		}
+
+		index[qoi_hash(px)] = px;
+
+		// Runs past the last pixel are cut off.
+		size_t count = std::min<size_t>(run, (dst_end - dst) / channels);
+		if (channels == 4) {
+			for (size_t i = 0; i < count; i++, dst += 4) {
+				memcpy(dst, &px, 4);
+			}
+		} else {
+			for (size_t i = 0; i < count; i++, dst += 3) {
+				dst[0] = px.rgba.r;
+				dst[1] = px.rgba.g;
+				dst[2] = px.rgba.b;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool write_png(const std::string &path, const unsigned char *pixels, GLint width, GLint height,
+               const encode_options &options) {
+	std::vector<unsigned char> data;
+	return encode_png(data, pixels, width, height, options) == true && write_file(path, data) == true;
+}
+
+bool write_qoi(const std::string &path, const unsigned char *pixels, GLint width, GLint height,
+               const encode_options &options) {
+	std::vector<unsigned char> data;
+	return encode_qoi(data, pixels, width, height, options) == true && write_file(path, data) == true;
+}
+
+} // namespace PSIImageCodec
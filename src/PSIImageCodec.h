@@ -0,0 +1,55 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// PNG and QOI encoding, split into row bands encoded on separate threads.
+//
+// PNG bands are filtered and deflated independently, each ending on a byte
+// boundary with an empty stored block, and written as their own IDAT chunks.
+// QOI bands start from the decoder state at their first pixel, found with a
+// parallel pass over the bands, so the output is a standard QOI stream.
+// The y-flip and the RGB / RGBA conversion are done while reading the rows in.
+//
+// QOI decoding writes straight into a caller buffer, such as a mapped pixel
+// unpack buffer, so textures load without an intermediate copy.
+
+#pragma once
+
+#include "PSIGlobals.h"
+
+#include <string>
+#include <vector>
+
+namespace PSIImageCodec {
+	struct encode_options {
+		// Channels in the source pixels, 3 for RGB or 4 for RGBA.
+		GLint src_channels = 3;
+		// Channels written, 3 or 4. Alpha is 255 when the source has none.
+		GLint channels = 3;
+		// Bytes from one source row to the next, 0 for tightly packed rows.
+		size_t src_stride = 0;
+		// Source rows are bottom first, as read with glReadPixels.
+		GLboolean flip_y = false;
+		// Bands encoded in parallel, 0 for one per thread.
+		GLint band_count = 0;
+	};
+
+	// Encode width x height 8 bit pixels into out. Return false for unsupported sizes
+	// or channel counts.
+	bool encode_png(std::vector<unsigned char> &out, const unsigned char *pixels, GLint width, GLint height,
+	                const encode_options &options = encode_options());
+	bool encode_qoi(std::vector<unsigned char> &out, const unsigned char *pixels, GLint width, GLint height,
+	                const encode_options &options = encode_options());
+
+	// Encode and write to path. Return false on failure.
+	bool write_png(const std::string &path, const unsigned char *pixels, GLint width, GLint height,
+	               const encode_options &options = encode_options());
+	bool write_qoi(const std::string &path, const unsigned char *pixels, GLint width, GLint height,
+	               const encode_options &options = encode_options());
+
+	// Read the size and channels of QOI data. Returns false if data is not QOI or has
+	// an unsupported size. Does not log, so it can be used to sniff the format.
+	bool read_qoi_header(const unsigned char *data, size_t size, GLint &width, GLint &height, GLint &channels);
+	// Decode QOI data into out, width x height tightly packed pixels with channels 3
+	// or 4, top row first. Alpha is dropped or set to 255 when the file has other
+	// channels. Returns false on broken or truncated data.
+	bool decode_qoi(const unsigned char *data, size_t size, unsigned char *out, GLint channels);
+} // namespace PSIImageCodec
@@ -0,0 +1,293 @@
+#include "PSIJSONReader.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+PSIJSONReader::PSIJSONReader(const char *data, size_t size) : _begin(data), _pos(data), _end(data + size) {
+}
+
+bool PSIJSONReader::fail() {
+	if (_error == false) {
+		_error = true;
+		_error_offset = _pos - _begin;
+	}
+
+	return false;
+}
+
+void PSIJSONReader::skip_whitespace() {
+	while (_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\n' || *_pos == '\r')) {
+		_pos++;
+	}
+}
+
+bool PSIJSONReader::expect(char c) {
+	skip_whitespace();
+	if (_pos >= _end || *_pos != c) {
+		return fail();
+	}
+
+	_pos++;
+	return true;
+}
+
+PSIJSONReader::ValueType PSIJSONReader::peek() {
+	if (_error == true) {
+		return ValueType::INVALID;
+	}
+
+	skip_whitespace();
+	if (_pos >= _end) {
+		return ValueType::INVALID;
+	}
+
+	switch (*_pos) {
+	case '{':
+		return ValueType::OBJECT;
+	case '[':
+		return ValueType::ARRAY;
+	case '"':
+		return ValueType::STRING;
+	case 't':
+	case 'f':
+		return ValueType::BOOLEAN;
+	case 'n':
+		return ValueType::NUL;
+	default:
+		if (*_pos == '-' || (*_pos >= '0' && *_pos <= '9')) {
+			return ValueType::NUMBER;
+		}
+		return ValueType::INVALID;
+	}
+}
+
+bool PSIJSONReader::begin_object() {
+	if (_error == true || expect('{') == false) {
+		return false;
+	}
+
+	_first.push_back(true);
+	return true;
+}
+
+bool PSIJSONReader::begin_array() {
+	if (_error == true || expect('[') == false) {
+		return false;
+	}
+
+	_first.push_back(true);
+	return true;
+}
+
+bool PSIJSONReader::next_item(char close) {
+	if (_error == true || _first.empty()) {
+		return fail();
+	}
+
+	skip_whitespace();
+	if (_pos < _end && *_pos == close) {
+		_pos++;
+		_first.pop_back();
+		return false;
+	}
+
+	if (_first.back() == true) {
+		_first.back() = false;
+	} else if (expect(',') == false) {
+		return false;
+	}
+
+	return true;
+}
+
+bool PSIJSONReader::next_key(std::string &key) {
+	if (next_item('}') == false) {
+		return false;
+	}
+
+	return read_string(key) && expect(':');
+}
+
+bool PSIJSONReader::next_element() {
+	return next_item(']');
+}
+
+// Append code point as UTF-8.
+static void append_utf8(std::string &out, uint32_t cp) {
+	if (cp < 0x80) {
+		out += (char)cp;
+	} else if (cp < 0x800) {
+		out += (char)(0xc0 | (cp >> 6));
+		out += (char)(0x80 | (cp & 0x3f));
+	} else if (cp < 0x10000) {
+		out += (char)(0xe0 | (cp >> 12));
+		out += (char)(0x80 | ((cp >> 6) & 0x3f));
+		out += (char)(0x80 | (cp & 0x3f));
+	} else {
+		out += (char)(0xf0 | (cp >> 18));
+		out += (char)(0x80 | ((cp >> 12) & 0x3f));
+		out += (char)(0x80 | ((cp >> 6) & 0x3f));
+		out += (char)(0x80 | (cp & 0x3f));
+	}
+}
+
+static bool parse_hex4(const char *p, uint32_t &out) {
+	out = 0;
+	for (int i = 0; i < 4; i++) {
+		char c = p[i];
+		out <<= 4;
+		if (c >= '0' && c <= '9') {
+			out |= c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			out |= c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			out |= c - 'A' + 10;
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool PSIJSONReader::read_string(std::string &out) {
+	if (_error == true || expect('"') == false) {
+		return false;
+	}
+
+	out.clear();
+	while (_pos < _end) {
+		// Copy runs without escapes at once.
+		const char *run = _pos;
+		while (_pos < _end && *_pos != '"' && *_pos != '\\') {
+			_pos++;
+		}
+		out.append(run, _pos - run);
+
+		if (_pos >= _end) {
+			break;
+		}
+		if (*_pos == '"') {
+			_pos++;
+			return true;
+		}
+
+		// Escape sequence.
+		if (_end - _pos < 2) {
+			break;
+		}
+		char c = _pos[1];
+		_pos += 2;
+		switch (c) {
+		case '"':  out += '"';  break;
+		case '\\': out += '\\'; break;
+		case '/':  out += '/';  break;
+		case 'b':  out += '\b'; break;
+		case 'f':  out += '\f'; break;
+		case 'n':  out += '\n'; break;
+		case 'r':  out += '\r'; break;
+		case 't':  out += '\t'; break;
+		case 'u': {
+			uint32_t cp;
+			if (_end - _pos < 4 || parse_hex4(_pos, cp) == false) {
+				return fail();
+			}
+			_pos += 4;
+
+			// Surrogate pair.
+			uint32_t low;
+			if (cp >= 0xd800 && cp < 0xdc00 && _end - _pos >= 6 && _pos[0] == '\\' && _pos[1] == 'u' &&
+			    parse_hex4(_pos + 2, low) && low >= 0xdc00 && low < 0xe000) {
+				cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+				_pos += 6;
+			}
+			append_utf8(out, cp);
+			break;
+		}
+		default:
+			return fail();
+		}
+	}
+
+	return fail();
+}
+
+bool PSIJSONReader::read_number(double &out) {
+	if (peek() != ValueType::NUMBER) {
+		return fail();
+	}
+
+	// The data is not null terminated, so copy the number out for strtod.
+	char buf[64];
+	size_t len = 0;
+	while (_pos + len < _end && len < sizeof(buf) - 1 && strchr("+-0123456789.eE", _pos[len]) != nullptr) {
+		len++;
+	}
+	memcpy(buf, _pos, len);
+	buf[len] = '\0';
+
+	char *num_end = nullptr;
+	out = strtod(buf, &num_end);
+	if (num_end == buf) {
+		return fail();
+	}
+
+	_pos += num_end - buf;
+	return true;
+}
+
+bool PSIJSONReader::read_bool(bool &out) {
+	skip_whitespace();
+	if (_end - _pos >= 4 && memcmp(_pos, "true", 4) == 0) {
+		_pos += 4;
+		out = true;
+		return true;
+	}
+	if (_end - _pos >= 5 && memcmp(_pos, "false", 5) == 0) {
+		_pos += 5;
+		out = false;
+		return true;
+	}
+
+	return fail();
+}
+
+bool PSIJSONReader::skip_value() {
+	std::string str;
+	double num;
+	bool b;
+
+	switch (peek()) {
+	case ValueType::OBJECT:
+		if (begin_object() == false) {
+			return false;
+		}
+		while (next_key(str)) {
+			skip_value();
+		}
+		return _error == false;
+	case ValueType::ARRAY:
+		if (begin_array() == false) {
+			return false;
+		}
+		while (next_element()) {
+			skip_value();
+		}
+		return _error == false;
+	case ValueType::STRING:
+		return read_string(str);
+	case ValueType::NUMBER:
+		return read_number(num);
+	case ValueType::BOOLEAN:
+		return read_bool(b);
+	case ValueType::NUL:
+		if (_end - _pos >= 4 && memcmp(_pos, "null", 4) == 0) {
+			_pos += 4;
+			return true;
+		}
+		return fail();
+	default:
+		return fail();
+	}
+}
@@ -0,0 +1,124 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Streaming pull parser for JSON. Reads values in place from a memory range,
+// without building a document tree. Used for parsing glTF.
+//
+// Objects and arrays are walked with loops:
+//
+//   reader.begin_object();
+//   while (reader.next_key(key)) {
+//       if (key == "count") reader.read_number(count);
+//       else reader.skip_value();
+//   }
+//
+// After an error every call returns false, so the loops always end.
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class PSIJSONReader {
+	public:
+		enum ValueType {
+			INVALID = 0,
+			OBJECT,
+			ARRAY,
+			STRING,
+			NUMBER,
+			BOOLEAN,
+			NUL
+		};
+
+		PSIJSONReader(const char *data, size_t size);
+		~PSIJSONReader() = default;
+
+		// Type of the next value, without reading it.
+		ValueType peek();
+
+		// Enter an object, then call next_key until it returns false at the end of the object.
+		bool begin_object();
+		bool next_key(std::string &key);
+		// Enter an array, then call next_element until it returns false at the end of the array.
+		bool begin_array();
+		bool next_element();
+
+		bool read_string(std::string &out);
+		bool read_number(double &out);
+		bool read_bool(bool &out);
+		// Read any number type, converting from double. Fails like a parse error when the
+		// number does not fit T, or is not a whole number for integer types.
+		template <typename T>
+		bool read_number(T &out) {
+			double value;
+			if (read_number(value) == false) {
+				return false;
+			}
+			if (fits<T>(value) == false) {
+				return fail();
+			}
+			out = static_cast<T>(value);
+			return true;
+		}
+		// Read an array of numbers into out, up to max_count. Returns the number of values read.
+		template <typename T>
+		size_t read_numbers(T *out, size_t max_count) {
+			size_t count = 0;
+			if (begin_array() == false) {
+				return 0;
+			}
+			while (next_element()) {
+				if (count < max_count) {
+					read_number(out[count++]);
+				} else {
+					skip_value();
+				}
+			}
+			return count;
+		}
+
+		// Skip the next value, including everything inside objects and arrays.
+		bool skip_value();
+
+		bool has_error() {
+			return _error;
+		}
+		// Byte offset where parsing failed.
+		size_t get_error_offset() {
+			return _error_offset;
+		}
+
+	private:
+		const char *_begin;
+		const char *_pos;
+		const char *_end;
+
+		bool _error = false;
+		size_t _error_offset = 0;
+		// Is the next element the first one, for each open object and array.
+		std::vector<bool> _first;
+
+		void skip_whitespace();
+		bool expect(char c);
+		bool fail();
+		// Can value be converted to T without leaving its range ?
+		template <typename T>
+		static bool fits(double value) {
+			if (std::isfinite(value) == false) {
+				return false;
+			}
+			if (std::is_integral<T>::value == true) {
+				// The max of 64 bit types rounds up to 2^64 as a double, so compare against
+				// max + 1, which is exact.
+				return value == std::trunc(value) &&
+				       value >= (double)std::numeric_limits<T>::lowest() &&
+				       value < (double)std::numeric_limits<T>::max() + 1.0;
+			}
+			return std::fabs(value) <= (double)std::numeric_limits<T>::max();
+		}
+		// Separator handling shared by objects and arrays.
+		bool next_item(char close);
+};
@@ -0,0 +1,373 @@
+#include "PSIMeshCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "PSIFileUtils.h"
+#include "PSIGeometry.h"
+
+namespace PSIMeshCache {
+
+static_assert(sizeof(file_header) == 96, "Mesh cache header layout changed");
+static_assert(sizeof(blob_entry) == 32, "Mesh cache blob entry layout changed");
+static_assert(sizeof(attribute_entry) == 64, "Mesh cache attribute entry layout changed");
+
+static inline uint64_t align_up(uint64_t offset) {
+	return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+}
+
+bool write(const std::string &path, const mesh_desc &desc) {
+	if (desc.index_blob >= (GLint)desc.blobs.size()) {
+		psilog_err("Invalid index blob %d for mesh cache '%s'", desc.index_blob, path.c_str());
+		return false;
+	}
+
+	file_header header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.blob_count = desc.blobs.size();
+	header.attribute_count = desc.attributes.size();
+	header.index_blob = desc.index_blob;
+	header.draw_mode = desc.draw_mode;
+	header.index_type = desc.index_type;
+	header.draw_count = desc.draw_count;
+	header.index_offset = desc.index_offset;
+	header.vertex_count = desc.vertex_count;
+	for (int i = 0; i < 3; i++) {
+		header.bounds_min[i] = desc.bounds_min[i];
+		header.bounds_max[i] = desc.bounds_max[i];
+		header.bounds_center[i] = desc.bounds_center[i];
+	}
+	header.bounds_radius = desc.bounds_radius;
+
+	// Lay out the blobs after the tables.
+	uint64_t offset = sizeof(file_header) + header.blob_count * sizeof(blob_entry) +
+	                  header.attribute_count * sizeof(attribute_entry);
+
+	std::vector<blob_entry> blobs(desc.blobs.size());
+	for (size_t i = 0; i < desc.blobs.size(); i++) {
+		offset = align_up(offset);
+		blobs[i] = {};
+		blobs[i].name_id = desc.blobs[i].name_id;
+		blobs[i].target = desc.blobs[i].target;
+		blobs[i].usage = desc.blobs[i].usage;
+		blobs[i].offset = offset;
+		blobs[i].size = desc.blobs[i].size;
+		offset += desc.blobs[i].size;
+	}
+	header.file_size = offset;
+
+	std::vector<attribute_entry> attributes(desc.attributes.size());
+	for (size_t i = 0; i < desc.attributes.size(); i++) {
+		const attribute_desc &attrib = desc.attributes[i];
+		if (attrib.name.size() >= MAX_ATTRIBUTE_NAME || attrib.blob >= desc.blobs.size()) {
+			psilog_err("Invalid attribute '%s' for mesh cache '%s'", attrib.name.c_str(), path.c_str());
+			return false;
+		}
+
+		attributes[i] = {};
+		strncpy(attributes[i].name, attrib.name.c_str(), MAX_ATTRIBUTE_NAME - 1);
+		attributes[i].location = attrib.location;
+		attributes[i].blob = attrib.blob;
+		attributes[i].size = attrib.size;
+		attributes[i].type = attrib.type;
+		attributes[i].normalized = attrib.normalized;
+		attributes[i].stride = attrib.stride;
+		attributes[i].offset = attrib.offset;
+	}
+
+	std::string tmp_path = path + ".tmp";
+	FILE *fp = fopen(tmp_path.c_str(), "wb");
+	if (fp == NULL) {
+		psilog_err("Failed opening mesh cache '%s' for writing", tmp_path.c_str());
+		return false;
+	}
+
+	static const unsigned char padding[BLOB_ALIGNMENT] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (ok && blobs.empty() == false) {
+		ok = fwrite(blobs.data(), sizeof(blob_entry), blobs.size(), fp) == blobs.size();
+	}
+	if (ok && attributes.empty() == false) {
+		ok = fwrite(attributes.data(), sizeof(attribute_entry), attributes.size(), fp) == attributes.size();
+	}
+
+	uint64_t written = sizeof(file_header) + blobs.size() * sizeof(blob_entry) +
+	                   attributes.size() * sizeof(attribute_entry);
+	for (size_t i = 0; ok && i < blobs.size(); i++) {
+		uint64_t pad = blobs[i].offset - written;
+		ok = (pad == 0 || fwrite(padding, 1, pad, fp) == pad) &&
+		     (blobs[i].size == 0 || fwrite(desc.blobs[i].data, 1, blobs[i].size, fp) == blobs[i].size);
+		written = blobs[i].offset + blobs[i].size;
+	}
+
+	ok = (fclose(fp) == 0) && ok;
+	if (ok == false || rename(tmp_path.c_str(), path.c_str()) != 0) {
+		psilog_err("Failed writing mesh cache '%s'", path.c_str());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+	psilog(PSILog::EXPORT, "Wrote mesh cache '%s', %d blobs, %llu bytes",
+	       path.c_str(), header.blob_count, (unsigned long long)header.file_size);
+
+	return true;
+}
+
+bool write_geometry(const std::string &path, const GeometryDataSharedPtr &geom) {
+	assert(geom != nullptr);
+
+	if (geom->cpu_released == true || geom->positions.empty()) {
+		psilog_err("No geometry data to write to mesh cache '%s'", path.c_str());
+		return false;
+	}
+
+	if (geom->bounds_radius <= 0.0f) {
+		geom->calc_bounds();
+	}
+
+	mesh_desc desc;
+	desc.vertex_count = geom->positions.size();
+	desc.bounds_center = geom->bounds_center;
+	desc.bounds_radius = geom->bounds_radius;
+	desc.bounds_min = geom->bounds_center - glm::vec3(geom->bounds_radius);
+	desc.bounds_max = geom->bounds_center + glm::vec3(geom->bounds_radius);
+
+	for (const auto &buffer : geom->buffers) {
+		const void *data = nullptr;
+		size_t size = 0;
+		switch (buffer.name_id) {
+		case PSIGLMesh::BufferName::POSITION:
+			data = geom->positions.data();
+			size = geom->positions.size() * sizeof(glm::vec3);
+			break;
+		case PSIGLMesh::BufferName::NORMAL:
+			data = geom->normals.data();
+			size = geom->normals.size() * sizeof(glm::vec3);
+			break;
+		case PSIGLMesh::BufferName::TEXCOORD:
+			data = geom->texcoords.data();
+			size = geom->texcoords.size() * sizeof(glm::vec2);
+			break;
+		case PSIGLMesh::BufferName::INDEX:
+			data = geom->indexes.data();
+			size = geom->indexes.size() * sizeof(GLuint);
+			desc.index_blob = desc.blobs.size();
+			desc.draw_count = geom->indexes.size();
+			break;
+		}
+
+		if (size == 0) {
+			if (buffer.name_id == PSIGLMesh::BufferName::INDEX) {
+				desc.index_blob = -1;
+			}
+			continue;
+		}
+
+		desc.blobs.push_back({ buffer.name_id, buffer.target, buffer.usage, data, size });
+	}
+
+	for (const auto &attrib : geom->attributes) {
+		auto blob = std::find_if(desc.blobs.begin(), desc.blobs.end(), [&attrib](const blob_desc &b) {
+			return b.name_id == attrib.buffer_name_id;
+		});
+		if (blob == desc.blobs.end()) {
+			continue;
+		}
+
+		desc.attributes.push_back({ attrib.name, NAMED_LOCATION, (GLuint)(blob - desc.blobs.begin()),
+		                            attrib.size, attrib.type, attrib.normalized, attrib.stride,
+		                            (size_t)attrib.pointer });
+	}
+
+	if (desc.index_blob < 0) {
+		desc.draw_count = desc.vertex_count;
+	}
+
+	return write(path, desc);
+}
+
+// Bytes of an index, 0 for types that can not be drawn with glDrawElements.
+static uint64_t get_index_bytes(GLenum index_type) {
+	switch (index_type) {
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_UNSIGNED_SHORT:
+		return 2;
+	case GL_UNSIGNED_INT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+// Check the tables and blob ranges against the mapped file size, and the draw range
+// against the indexes or vertexes it draws.
+static bool validate(const std::string &path, const PSIFileUtils::MappedFileSharedPtr &file) {
+	if (file->size < sizeof(file_header)) {
+		psilog_err("Mesh cache '%s' is too small", path.c_str());
+		return false;
+	}
+
+	const file_header *header = reinterpret_cast<const file_header *>(file->data);
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION) {
+		psilog(PSILog::LOAD, "Mesh cache '%s' has unknown format or version", path.c_str());
+		return false;
+	}
+
+	uint64_t tables_size = sizeof(file_header) + (uint64_t)header->blob_count * sizeof(blob_entry) +
+	                       (uint64_t)header->attribute_count * sizeof(attribute_entry);
+	if (header->file_size != file->size || tables_size > file->size ||
+	    header->index_blob >= (int32_t)header->blob_count) {
+		psilog_err("Mesh cache '%s' is truncated or corrupted", path.c_str());
+		return false;
+	}
+
+	const blob_entry *blobs = reinterpret_cast<const blob_entry *>(file->data + sizeof(file_header));
+	for (uint32_t i = 0; i < header->blob_count; i++) {
+		if (blobs[i].offset > file->size || blobs[i].size > file->size - blobs[i].offset ||
+		    (blobs[i].name_id != UNNAMED_BLOB && blobs[i].name_id > PSIGLMesh::BufferName::BufferName_MAX)) {
+			psilog_err("Mesh cache '%s' has an invalid blob %d", path.c_str(), i);
+			return false;
+		}
+	}
+
+	const attribute_entry *attributes = reinterpret_cast<const attribute_entry *>(blobs + header->blob_count);
+	for (uint32_t i = 0; i < header->attribute_count; i++) {
+		if (attributes[i].blob >= header->blob_count ||
+		    memchr(attributes[i].name, 0, MAX_ATTRIBUTE_NAME) == nullptr) {
+			psilog_err("Mesh cache '%s' has an invalid attribute %d", path.c_str(), i);
+			return false;
+		}
+	}
+
+	bool draw_range_valid;
+	if (header->index_blob >= 0) {
+		uint64_t index_bytes = get_index_bytes(header->index_type);
+		uint64_t blob_size = blobs[header->index_blob].size;
+		draw_range_valid = index_bytes > 0 && header->index_offset <= blob_size &&
+		                   (uint64_t)header->draw_count * index_bytes <= blob_size - header->index_offset;
+	} else {
+		draw_range_valid = header->draw_count <= header->vertex_count;
+	}
+	if (draw_range_valid == false) {
+		psilog_err("Mesh cache '%s' draws past its %s", path.c_str(),
+		           (header->index_blob >= 0) ? "indexes" : "vertexes");
+		return false;
+	}
+
+	return true;
+}
+
+loaded_mesh load_gl_mesh(const std::string &path, GLuint program) {
+	loaded_mesh loaded;
+
+	auto file = PSIFileUtils::map_file(path);
+	if (file == nullptr || validate(path, file) == false) {
+		return loaded;
+	}
+
+	const file_header *header = reinterpret_cast<const file_header *>(file->data);
+	const blob_entry *blobs = reinterpret_cast<const blob_entry *>(file->data + sizeof(file_header));
+	const attribute_entry *attributes = reinterpret_cast<const attribute_entry *>(blobs + header->blob_count);
+
+	GLMeshSharedPtr mesh = PSIGLMesh::create();
+	if (mesh->init() == false) {
+		psilog_err("Failed creating GL mesh!");
+		return loaded;
+	}
+	mesh->bind_vao();
+
+	// Metadata for the released geometry data, so bounds, counts and read back work as usual.
+	// It has the same named buffer table and attributes as generated geometry, as cloning and
+	// generating colors look buffers up by name. Buffers not cached, like colors, stay empty.
+	GeometryDataSharedPtr geom = PSIGeometryData::create();
+	PSIGeometry::add_buffer_defaults(geom);
+
+	// Upload straight from the mapping.
+	std::vector<GLuint> buffer_ids(header->blob_count);
+	for (uint32_t i = 0; i < header->blob_count; i++) {
+		const blob_entry &blob = blobs[i];
+		if (blob.name_id != UNNAMED_BLOB) {
+			buffer_ids[i] = mesh->get_buffer_id(blob.name_id);
+
+			PSIGLMesh::gl_buffer_info info = { blob.name_id, blob.target, (GLsizeiptr)blob.size, blob.usage, nullptr };
+			auto it = std::find_if(geom->buffers.begin(), geom->buffers.end(), [&blob](const PSIGLMesh::gl_buffer_info &b) {
+				return b.name_id == blob.name_id;
+			});
+			if (it != geom->buffers.end()) {
+				*it = info;
+			} else {
+				geom->buffers.push_back(info);
+			}
+		} else {
+			buffer_ids[i] = mesh->add_buffer();
+		}
+
+		glBindBuffer(blob.target, buffer_ids[i]);
+		mesh->buffer_data(blob.target, blob.size, file->data + blob.offset, blob.usage);
+	}
+	check_gl_error();
+
+	for (uint32_t i = 0; i < header->attribute_count; i++) {
+		const attribute_entry &attrib = attributes[i];
+
+		// Keep the cached layout for the attribute. The names point into the mapping, so
+		// the default attribute of the same name keeps its own.
+		auto it = std::find_if(geom->attributes.begin(), geom->attributes.end(),
+		                       [&attrib](const PSIGLMesh::gl_vertex_attribute &a) {
+			return strcmp(a.name, attrib.name) == 0;
+		});
+		if (it != geom->attributes.end() && blobs[attrib.blob].name_id != UNNAMED_BLOB) {
+			it->buffer_name_id = blobs[attrib.blob].name_id;
+			it->size = attrib.size;
+			it->type = attrib.type;
+			it->normalized = attrib.normalized;
+			it->stride = attrib.stride;
+			it->pointer = reinterpret_cast<const GLvoid *>(attrib.offset);
+		}
+
+		GLint location = attrib.location;
+		if (location == NAMED_LOCATION) {
+			location = glGetAttribLocation(program, attrib.name);
+		}
+		if (location < 0) {
+			psilog(PSILog::OPENGL, "Warning: Shader attribute with name '%s' not found in program = %d",
+			       attrib.name, program);
+			continue;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer_ids[attrib.blob]);
+		glVertexAttribPointer(location, attrib.size, attrib.type, attrib.normalized, attrib.stride,
+		                      reinterpret_cast<const GLvoid *>(attrib.offset));
+		glEnableVertexAttribArray(location);
+	}
+	check_gl_error();
+
+	// The element buffer binding is part of the vao, so bind it last for it to stick.
+	if (header->index_blob >= 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_ids[header->index_blob]);
+	}
+
+	mesh->set_draw_mode(header->draw_mode);
+	mesh->set_draw_count(header->draw_count);
+	mesh->set_index_type(header->index_type);
+	mesh->set_index_offset(header->index_offset);
+
+	geom->cpu_released = true;
+	geom->released_vertex_count = header->vertex_count;
+	geom->released_index_count = (header->index_blob >= 0) ? header->draw_count : 0;
+	geom->bounds_center = glm::vec3(header->bounds_center[0], header->bounds_center[1], header->bounds_center[2]);
+	geom->bounds_radius = header->bounds_radius;
+
+	loaded.mesh = mesh;
+	loaded.geometry_data = geom;
+
+	psilog(PSILog::LOAD, "Loaded mesh cache '%s', %d blobs, draw_count = %d",
+	       path.c_str(), header->blob_count, header->draw_count);
+
+	return loaded;
+}
+
+} // namespace PSIMeshCache
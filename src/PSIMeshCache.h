@@ -0,0 +1,122 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Binary baked mesh cache. Stores GL ready vertex and index data, so meshes
+// load by memory mapping the file and uploading straight to GL buffers.
+//
+// File layout, little endian:
+//   file_header
+//   blob_entry[blob_count]
+//   attribute_entry[attribute_count]
+//   blob data, each blob aligned to BLOB_ALIGNMENT bytes.
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIGLMesh.h"
+#include "PSIGeometryData.h"
+
+namespace PSIMeshCache {
+	static const char MAGIC[4] = { 'P', 'S', 'I', 'M' };
+	// Bump when the layout changes, older files are then rejected.
+	static const uint32_t VERSION = 1;
+	static const uint64_t BLOB_ALIGNMENT = 16;
+	// Blob that is not one of the PSIGLMesh named buffers.
+	static const uint32_t UNNAMED_BLOB = 0xffffffff;
+	// Attribute found by name from the shader program, instead of a fixed location.
+	static const int32_t NAMED_LOCATION = -1;
+	static const size_t MAX_ATTRIBUTE_NAME = 32;
+
+	struct file_header {
+		char magic[4];
+		uint32_t version;
+		uint32_t blob_count;
+		uint32_t attribute_count;
+		// Index blob, or -1 for unindexed drawing.
+		int32_t index_blob;
+		uint32_t draw_mode;
+		uint32_t index_type;
+		uint32_t draw_count;
+		uint64_t index_offset;
+		uint32_t vertex_count;
+		uint32_t reserved;
+		float bounds_min[3];
+		float bounds_max[3];
+		float bounds_center[3];
+		float bounds_radius;
+		uint64_t file_size;
+	};
+
+	struct blob_entry {
+		// PSIGLMesh::BufferName, or UNNAMED_BLOB.
+		uint32_t name_id;
+		uint32_t target;
+		uint32_t usage;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct attribute_entry {
+		char name[MAX_ATTRIBUTE_NAME];
+		// Fixed location, or NAMED_LOCATION.
+		int32_t location;
+		uint32_t blob;
+		int32_t size;
+		uint32_t type;
+		uint32_t normalized;
+		uint32_t stride;
+		uint64_t offset;
+	};
+
+	// Mesh to write, pointing to data owned by the caller.
+	struct blob_desc {
+		uint32_t name_id;
+		GLenum target;
+		GLenum usage;
+		const void *data;
+		size_t size;
+	};
+
+	struct attribute_desc {
+		std::string name;
+		GLint location;
+		GLuint blob;
+		GLint size;
+		GLenum type;
+		GLboolean normalized;
+		GLsizei stride;
+		size_t offset;
+	};
+
+	struct mesh_desc {
+		std::vector<blob_desc> blobs;
+		std::vector<attribute_desc> attributes;
+		GLint index_blob = -1;
+		GLenum draw_mode = GL_TRIANGLES;
+		GLenum index_type = GL_UNSIGNED_INT;
+		GLsizei draw_count = 0;
+		size_t index_offset = 0;
+		GLsizei vertex_count = 0;
+		glm::vec3 bounds_min = glm::vec3(0.0f);
+		glm::vec3 bounds_max = glm::vec3(0.0f);
+		glm::vec3 bounds_center = glm::vec3(0.0f);
+		GLfloat bounds_radius = 0.0f;
+	};
+
+	// Loaded GL mesh, with released geometry data holding the buffer descriptions,
+	// counts and bounds.
+	struct loaded_mesh {
+		GLMeshSharedPtr mesh;
+		GeometryDataSharedPtr geometry_data;
+	};
+
+	// Write mesh to path. The file is written next to path first and moved in place,
+	// so a failed write never leaves a broken cache behind.
+	bool write(const std::string &path, const mesh_desc &desc);
+	// Write typed geometry data to path. Colors are left out, they come from the material.
+	bool write_geometry(const std::string &path, const GeometryDataSharedPtr &geom);
+
+	// Load mesh from path and upload it. Named attributes are looked up from program.
+	// Returns an empty mesh if the file is missing, from another version or broken.
+	loaded_mesh load_gl_mesh(const std::string &path, GLuint program);
+}
@@ -0,0 +1,149 @@
+#include "PSIMeshRegistry.h"
+#include "PSIGeometry.h"
+
+#include <cstring>
+
+// Float parameters as exact bits in the keys, so nearby values don't collide.
+static std::string float_key(GLfloat value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return std::to_string(bits);
+}
+
+void PSIMeshRegistry::prepare_shared(const GeometryDataSharedPtr &geom) {
+	geom->shared = true;
+	geom->colors.clear();
+	geom->colors.shrink_to_fit();
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::get_geometry(const std::string &key, const geometry_func &func) {
+	auto it = _keyed_geometry.find(key);
+	if (it != _keyed_geometry.end()) {
+		GeometryDataSharedPtr geom = it->second.lock();
+		if (geom != nullptr) {
+			return geom;
+		}
+	}
+
+	GeometryDataSharedPtr geom = func();
+	if (geom == nullptr) {
+		return nullptr;
+	}
+
+	prepare_shared(geom);
+	_keyed_geometry[key] = geom;
+
+	psilog(PSILog::INIT, "Registered shared geometry '%s'", key.c_str());
+
+	return geom;
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::share_geometry(const GeometryDataSharedPtr &geom) {
+	assert(geom != nullptr);
+
+	if (geom->shared == true) {
+		return geom;
+	}
+
+	// Colors are not shared, so leave them out of the comparison.
+	std::vector<glm::vec4> colors;
+	colors.swap(geom->colors);
+	uint64_t hash = geom->calc_content_hash();
+
+	auto range = _hashed_geometry.equal_range(hash);
+	for (auto it = range.first; it != range.second; it++) {
+		GeometryDataSharedPtr existing = it->second.lock();
+		if (existing != nullptr && existing->content_equals(*geom)) {
+			colors.swap(geom->colors);
+			return existing;
+		}
+	}
+
+	prepare_shared(geom);
+	_hashed_geometry.emplace(hash, geom);
+
+	return geom;
+}
+
+GLMeshSharedPtr PSIMeshRegistry::get_mesh(const GeometryDataSharedPtr &geom, GLuint program, const mesh_func &func) {
+	assert(geom != nullptr);
+
+	mesh_key key(geom.get(), program);
+	auto it = _meshes.find(key);
+	if (it != _meshes.end() && it->second.geometry.lock() == geom) {
+		GLMeshSharedPtr mesh = it->second.mesh.lock();
+		if (mesh != nullptr) {
+			return mesh;
+		}
+	}
+
+	GLMeshSharedPtr mesh = func();
+	if (mesh == nullptr) {
+		return nullptr;
+	}
+
+	_meshes[key] = { geom, mesh };
+
+	psilog(PSILog::OPENGL, "Registered shared mesh for program %d, draw_count = %d", program, mesh->get_draw_count());
+
+	return mesh;
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::cube() {
+	return get_geometry("cube", []() { return PSIGeometry::cube(); });
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::cube_inverted() {
+	return get_geometry("cube_inverted", []() { return PSIGeometry::cube_inverted(); });
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::cube_tetrahedron() {
+	return get_geometry("cube_tetrahedron", []() { return PSIGeometry::cube_tetrahedron(); });
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::tetrahedron() {
+	return get_geometry("tetrahedron", []() { return PSIGeometry::tetrahedron(); });
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::prism(GLfloat radius, GLfloat depth) {
+	std::string key = "prism:" + float_key(radius) + ":" + float_key(depth);
+	return get_geometry(key, [radius, depth]() { return PSIGeometry::prism(radius, depth); });
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::cuboid(GLfloat width, GLfloat height, GLfloat depth) {
+	std::string key = "cuboid:" + float_key(width) + ":" + float_key(height) + ":" + float_key(depth);
+	return get_geometry(key, [width, height, depth]() { return PSIGeometry::cuboid(width, height, depth); });
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::plane(GLint rows, GLboolean repeat_texture) {
+	std::string key = "plane:" + std::to_string(rows) + ":" + std::to_string(repeat_texture);
+	return get_geometry(key, [rows, repeat_texture]() { return PSIGeometry::plane(rows, repeat_texture); });
+}
+
+GeometryDataSharedPtr PSIMeshRegistry::icosahedron(GLint recursion) {
+	std::string key = "icosahedron:" + std::to_string(recursion);
+	return get_geometry(key, [recursion]() { return PSIGeometry::icosahedron(recursion); });
+}
+
+void PSIMeshRegistry::purge() {
+	for (auto it = _keyed_geometry.begin(); it != _keyed_geometry.end(); ) {
+		it = it->second.expired() ? _keyed_geometry.erase(it) : std::next(it);
+	}
+	for (auto it = _hashed_geometry.begin(); it != _hashed_geometry.end(); ) {
+		it = it->second.expired() ? _hashed_geometry.erase(it) : std::next(it);
+	}
+	for (auto it = _meshes.begin(); it != _meshes.end(); ) {
+		bool expired = it->second.geometry.expired() || it->second.mesh.expired();
+		it = expired ? _meshes.erase(it) : std::next(it);
+	}
+}
+
+size_t PSIMeshRegistry::get_geometry_count() {
+	purge();
+	return _keyed_geometry.size() + _hashed_geometry.size();
+}
+
+size_t PSIMeshRegistry::get_mesh_count() {
+	purge();
+	return _meshes.size();
+}
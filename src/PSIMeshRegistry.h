@@ -0,0 +1,82 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Registry of shared geometry and GL meshes, so identical geometry is only
+// created and uploaded once.
+//
+// Geometry is found by a generator key, like "icosahedron:3", or by a hash of its content.
+// GL meshes are shared per geometry and shader program, as the vertex attribute locations
+// come from the program. The registry only holds weak references, so entries are freed
+// when the last render object using them is gone.
+//
+// Shared geometry has no per vertex colors. Render objects using it draw with
+// the material color as a constant color attribute instead. The mesh draw mode
+// is shared too.
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+#include "PSIGlobals.h"
+#include "PSIGLMesh.h"
+#include "PSIGeometryData.h"
+
+class PSIMeshRegistry;
+typedef shared_ptr<PSIMeshRegistry> MeshRegistrySharedPtr;
+
+class PSIMeshRegistry {
+	public:
+		typedef std::function<GeometryDataSharedPtr()> geometry_func;
+		typedef std::function<GLMeshSharedPtr()> mesh_func;
+
+		PSIMeshRegistry() = default;
+		~PSIMeshRegistry() = default;
+
+		static MeshRegistrySharedPtr create() {
+			return make_shared<PSIMeshRegistry>();
+		}
+
+		// Get the geometry registered with key, or create and register it with func.
+		GeometryDataSharedPtr get_geometry(const std::string &key, const geometry_func &func);
+		// Get registered geometry with the same content as geom, or register geom itself.
+		GeometryDataSharedPtr share_geometry(const GeometryDataSharedPtr &geom);
+		// Get the GL mesh for shared geometry drawn with shader program,
+		// or create and register it with func.
+		GLMeshSharedPtr get_mesh(const GeometryDataSharedPtr &geom, GLuint program, const mesh_func &func);
+
+		// Shared versions of the PSIGeometry primitives.
+		GeometryDataSharedPtr cube();
+		GeometryDataSharedPtr cube_inverted();
+		GeometryDataSharedPtr cube_tetrahedron();
+		GeometryDataSharedPtr tetrahedron();
+		GeometryDataSharedPtr prism(GLfloat radius, GLfloat depth);
+		GeometryDataSharedPtr cuboid(GLfloat width, GLfloat height, GLfloat depth);
+		GeometryDataSharedPtr plane(GLint rows, GLboolean repeat_texture);
+		GeometryDataSharedPtr icosahedron(GLint recursion);
+
+		// Remove entries no longer used by anyone.
+		void purge();
+
+		// How many live geometries and meshes we are sharing.
+		size_t get_geometry_count();
+		size_t get_mesh_count();
+
+	private:
+		struct mesh_entry {
+			// Checked on lookup, as the key address can be reused by new geometry.
+			std::weak_ptr<PSIGeometryData> geometry;
+			std::weak_ptr<PSIGLMesh> mesh;
+		};
+		typedef std::pair<const PSIGeometryData *, GLuint> mesh_key;
+
+		// Mark geometry as shared and drop its per vertex colors.
+		void prepare_shared(const GeometryDataSharedPtr &geom);
+
+		// Geometry by generator key.
+		std::unordered_map<std::string, std::weak_ptr<PSIGeometryData>> _keyed_geometry;
+		// Geometry by content hash.
+		std::unordered_multimap<uint64_t, std::weak_ptr<PSIGeometryData>> _hashed_geometry;
+		// Meshes by geometry and shader program.
+		std::map<mesh_key, mesh_entry> _meshes;
+};
@@ -0,0 +1,438 @@
+#include "PSIMeshSimplifier.h"
+#include "PSIGeometry.h"
+
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+
+namespace PSIGeometry {
+namespace Simplifier {
+
+// Boundary edge planes are weighted by this, so open borders are kept in place.
+static const double BOUNDARY_WEIGHT = 1000.0;
+// Reject collapses that turn a triangle more than this, as cosine of the angle.
+static const double MIN_NORMAL_DOT = 0.2;
+
+// Symmetric 4x4 plane quadric, upper triangle only.
+struct quadric {
+	double a[10] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	void add_plane(double nx, double ny, double nz, double d, double weight) {
+		a[0] += weight * nx * nx;
+		a[1] += weight * nx * ny;
+		a[2] += weight * nx * nz;
+		a[3] += weight * nx * d;
+		a[4] += weight * ny * ny;
+		a[5] += weight * ny * nz;
+		a[6] += weight * ny * d;
+		a[7] += weight * nz * nz;
+		a[8] += weight * nz * d;
+		a[9] += weight * d * d;
+	}
+
+	void add(const quadric &q) {
+		for (int i = 0; i < 10; i++) {
+			a[i] += q.a[i];
+		}
+	}
+
+	// Sum of weighted squared distances from p to the planes.
+	double error(const glm::vec3 &p) const {
+		double x = p.x;
+		double y = p.y;
+		double z = p.z;
+
+		return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+		     + a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+		     + a[7] * z * z + 2.0 * a[8] * z
+		     + a[9];
+	}
+};
+
+// Candidate collapse of vertex from onto vertex to.
+struct collapse {
+	double cost;
+	GLuint from;
+	GLuint to;
+	// Vertex versions when the cost was calculated, to skip outdated candidates.
+	GLuint from_version;
+	GLuint to_version;
+
+	bool operator>(const collapse &rhs) const {
+		return cost > rhs.cost;
+	}
+};
+
+// Working state of one simplification.
+struct mesh_state {
+	std::vector<glm::vec3> positions;
+	std::vector<GLuint> indexes;
+	std::vector<bool> tri_alive;
+	std::vector<std::vector<GLuint>> vertex_tris;
+	std::vector<quadric> quadrics;
+	std::vector<GLuint> versions;
+	std::vector<bool> removed;
+	std::vector<bool> locked;
+	std::vector<bool> boundary;
+	std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse>> queue;
+};
+
+static inline bool tri_has_vertex(const mesh_state &m, GLuint tri, GLuint v) {
+	const GLuint *i = &m.indexes[3 * tri];
+	return i[0] == v || i[1] == v || i[2] == v;
+}
+
+static inline glm::vec3 tri_normal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2) {
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+// How many live triangles share the edge between a and b.
+static GLint edge_tri_count(const mesh_state &m, GLuint a, GLuint b) {
+	GLint count = 0;
+	for (GLuint tri : m.vertex_tris[a]) {
+		if (m.tri_alive[tri] && tri_has_vertex(m, tri, b)) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+// Vertexes connected to v by an edge.
+static void vertex_neighbours(const mesh_state &m, GLuint v, std::vector<GLuint> &out) {
+	out.clear();
+	for (GLuint tri : m.vertex_tris[v]) {
+		if (m.tri_alive[tri] == false) {
+			continue;
+		}
+		for (int k = 0; k < 3; k++) {
+			GLuint n = m.indexes[3 * tri + k];
+			if (n != v) {
+				out.push_back(n);
+			}
+		}
+	}
+
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+static void push_collapse(mesh_state &m, GLuint from, GLuint to) {
+	if (m.locked[from] == true) {
+		return;
+	}
+	// Border vertexes can only slide along the border.
+	if (m.boundary[from] == true && edge_tri_count(m, from, to) != 1) {
+		return;
+	}
+
+	quadric q = m.quadrics[from];
+	q.add(m.quadrics[to]);
+
+	collapse c;
+	c.cost = q.error(m.positions[to]);
+	c.from = from;
+	c.to = to;
+	c.from_version = m.versions[from];
+	c.to_version = m.versions[to];
+
+	m.queue.push(c);
+}
+
+// Check that collapsing from onto to keeps the mesh manifold and doesn't flip triangles.
+static bool can_collapse(const mesh_state &m, GLuint from, GLuint to,
+                         std::vector<GLuint> &from_neighbours, std::vector<GLuint> &to_neighbours) {
+	// Link condition: the only shared neighbours are the ones on the triangles of the edge.
+	vertex_neighbours(m, from, from_neighbours);
+	vertex_neighbours(m, to, to_neighbours);
+
+	size_t shared = 0;
+	auto i = from_neighbours.begin();
+	auto j = to_neighbours.begin();
+	while (i != from_neighbours.end() && j != to_neighbours.end()) {
+		if (*i < *j) {
+			i++;
+		} else if (*j < *i) {
+			j++;
+		} else {
+			shared++;
+			i++;
+			j++;
+		}
+	}
+
+	if ((GLint)shared != edge_tri_count(m, from, to)) {
+		return false;
+	}
+
+	const glm::vec3 &p = m.positions[to];
+	for (GLuint tri : m.vertex_tris[from]) {
+		if (m.tri_alive[tri] == false || tri_has_vertex(m, tri, to)) {
+			continue;
+		}
+
+		const GLuint *idx = &m.indexes[3 * tri];
+		glm::vec3 old_p[3] = { m.positions[idx[0]], m.positions[idx[1]], m.positions[idx[2]] };
+		glm::vec3 new_p[3] = { old_p[0], old_p[1], old_p[2] };
+		for (int k = 0; k < 3; k++) {
+			if (idx[k] == from) {
+				new_p[k] = p;
+			}
+		}
+
+		glm::vec3 n0 = tri_normal(old_p[0], old_p[1], old_p[2]);
+		glm::vec3 n1 = tri_normal(new_p[0], new_p[1], new_p[2]);
+		double l0 = glm::length(n0);
+		double l1 = glm::length(n1);
+		if (l1 <= 0.0 || l0 <= 0.0 || glm::dot(n0, n1) < MIN_NORMAL_DOT * l0 * l1) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void do_collapse(mesh_state &m, GLuint from, GLuint to, GLsizei &live_tris) {
+	std::vector<GLuint> &to_tris = m.vertex_tris[to];
+
+	for (GLuint tri : m.vertex_tris[from]) {
+		if (m.tri_alive[tri] == false) {
+			continue;
+		}
+
+		if (tri_has_vertex(m, tri, to)) {
+			m.tri_alive[tri] = false;
+			live_tris--;
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			if (m.indexes[3 * tri + k] == from) {
+				m.indexes[3 * tri + k] = to;
+			}
+		}
+		to_tris.push_back(tri);
+	}
+
+	// Drop the dead triangles from the kept vertex.
+	to_tris.erase(std::remove_if(to_tris.begin(), to_tris.end(), [&m](GLuint tri) {
+		return m.tri_alive[tri] == false;
+	}), to_tris.end());
+
+	m.vertex_tris[from].clear();
+	m.removed[from] = true;
+	m.quadrics[to].add(m.quadrics[from]);
+	m.versions[to]++;
+}
+
+GeometryDataSharedPtr simplify(const GeometryDataSharedPtr &geom, GLfloat target_ratio, GLfloat max_error) {
+	if (geom == nullptr || geom->positions.empty() || geom->indexes.size() < 3 || geom->indexes.size() % 3 != 0) {
+		psilog_err("Simplifying needs indexed triangle geometry");
+		return nullptr;
+	}
+
+	GLsizei vertex_count = geom->positions.size();
+	GLsizei tri_count = geom->indexes.size() / 3;
+
+	mesh_state m;
+	m.positions = geom->positions;
+	m.indexes = geom->indexes;
+	m.tri_alive.assign(tri_count, true);
+	m.vertex_tris.resize(vertex_count);
+	m.quadrics.resize(vertex_count);
+	m.versions.assign(vertex_count, 0);
+	m.removed.assign(vertex_count, false);
+	m.locked.assign(vertex_count, false);
+	m.boundary.assign(vertex_count, false);
+
+	for (GLuint idx : m.indexes) {
+		if (idx >= (GLuint)vertex_count) {
+			psilog_err("Index %u out of range, vertex count %d", idx, vertex_count);
+			return nullptr;
+		}
+	}
+
+	// Triangle plane quadrics, weighted by area.
+	for (GLsizei t = 0; t < tri_count; t++) {
+		const GLuint *idx = &m.indexes[3 * t];
+		glm::vec3 n = tri_normal(m.positions[idx[0]], m.positions[idx[1]], m.positions[idx[2]]);
+		GLfloat len = glm::length(n);
+
+		for (int k = 0; k < 3; k++) {
+			m.vertex_tris[idx[k]].push_back(t);
+		}
+
+		if (len <= 0.0f) {
+			continue;
+		}
+
+		n /= len;
+		double d = -glm::dot(n, m.positions[idx[0]]);
+		for (int k = 0; k < 3; k++) {
+			m.quadrics[idx[k]].add_plane(n.x, n.y, n.z, d, 0.5 * len);
+		}
+	}
+
+	// Find open edges, these only have one triangle.
+	std::unordered_map<uint64_t, GLint> edge_counts;
+	edge_counts.reserve(3 * tri_count);
+	for (GLsizei t = 0; t < tri_count; t++) {
+		for (int k = 0; k < 3; k++) {
+			GLuint a = m.indexes[3 * t + k];
+			GLuint b = m.indexes[3 * t + (k + 1) % 3];
+			uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			edge_counts[key]++;
+		}
+	}
+
+	// Planes perpendicular to open edges keep the borders from shrinking.
+	for (GLsizei t = 0; t < tri_count; t++) {
+		const GLuint *idx = &m.indexes[3 * t];
+		glm::vec3 n = tri_normal(m.positions[idx[0]], m.positions[idx[1]], m.positions[idx[2]]);
+		if (glm::length(n) <= 0.0f) {
+			continue;
+		}
+		n = glm::normalize(n);
+
+		for (int k = 0; k < 3; k++) {
+			GLuint a = idx[k];
+			GLuint b = idx[(k + 1) % 3];
+			uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			if (edge_counts[key] != 1) {
+				continue;
+			}
+
+			m.boundary[a] = true;
+			m.boundary[b] = true;
+
+			glm::vec3 edge = m.positions[b] - m.positions[a];
+			glm::vec3 plane_n = glm::cross(edge, n);
+			GLfloat len = glm::length(plane_n);
+			if (len <= 0.0f) {
+				continue;
+			}
+			plane_n /= len;
+
+			double d = -glm::dot(plane_n, m.positions[a]);
+			double weight = BOUNDARY_WEIGHT * glm::dot(edge, edge);
+			m.quadrics[a].add_plane(plane_n.x, plane_n.y, plane_n.z, d, weight);
+			m.quadrics[b].add_plane(plane_n.x, plane_n.y, plane_n.z, d, weight);
+		}
+	}
+
+	// Lock vertexes that share a position with another vertex, these are seams
+	// between texture coordinates or normals that would crack open if moved.
+	std::vector<GLuint> by_position(vertex_count);
+	for (GLsizei v = 0; v < vertex_count; v++) {
+		by_position[v] = v;
+	}
+
+	std::sort(by_position.begin(), by_position.end(), [&m](GLuint a, GLuint b) {
+		const glm::vec3 &pa = m.positions[a];
+		const glm::vec3 &pb = m.positions[b];
+		return (pa.x != pb.x) ? (pa.x < pb.x) : (pa.y != pb.y) ? (pa.y < pb.y) : (pa.z < pb.z);
+	});
+
+	for (GLsizei i = 1; i < vertex_count; i++) {
+		if (m.positions[by_position[i]] == m.positions[by_position[i - 1]]) {
+			m.locked[by_position[i]] = true;
+			m.locked[by_position[i - 1]] = true;
+		}
+	}
+
+	for (GLsizei t = 0; t < tri_count; t++) {
+		for (int k = 0; k < 3; k++) {
+			push_collapse(m, m.indexes[3 * t + k], m.indexes[3 * t + (k + 1) % 3]);
+			push_collapse(m, m.indexes[3 * t + (k + 1) % 3], m.indexes[3 * t + k]);
+		}
+	}
+
+	GLsizei target_tris = std::max<GLsizei>(1, tri_count * glm::clamp(target_ratio, 0.0f, 1.0f));
+	GLsizei live_tris = tri_count;
+	std::vector<GLuint> from_neighbours;
+	std::vector<GLuint> to_neighbours;
+
+	while (live_tris > target_tris && m.queue.empty() == false) {
+		collapse c = m.queue.top();
+		m.queue.pop();
+
+		if (c.cost > max_error) {
+			break;
+		}
+		if (m.removed[c.from] || m.removed[c.to] ||
+		    c.from_version != m.versions[c.from] || c.to_version != m.versions[c.to]) {
+			continue;
+		}
+		if (can_collapse(m, c.from, c.to, from_neighbours, to_neighbours) == false) {
+			continue;
+		}
+
+		do_collapse(m, c.from, c.to, live_tris);
+
+		// Costs around the kept vertex changed.
+		vertex_neighbours(m, c.to, to_neighbours);
+		for (GLuint n : to_neighbours) {
+			push_collapse(m, c.to, n);
+			push_collapse(m, n, c.to);
+		}
+	}
+
+	// Compact the remaining vertexes and triangles.
+	std::vector<GLint> remap(vertex_count, -1);
+	GeometryDataSharedPtr out = PSIGeometryData::create();
+	bool has_normals = geom->normals.size() == (size_t)vertex_count;
+	bool has_texcoords = geom->texcoords.size() == (size_t)vertex_count;
+	bool has_colors = geom->colors.size() == (size_t)vertex_count;
+
+	out->indexes.reserve(3 * live_tris);
+	for (GLsizei t = 0; t < tri_count; t++) {
+		if (m.tri_alive[t] == false) {
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			GLuint v = m.indexes[3 * t + k];
+			if (remap[v] < 0) {
+				remap[v] = out->positions.size();
+				out->positions.push_back(geom->positions[v]);
+				if (has_normals) {
+					out->normals.push_back(geom->normals[v]);
+				}
+				if (has_texcoords) {
+					out->texcoords.push_back(geom->texcoords[v]);
+				}
+				if (has_colors) {
+					out->colors.push_back(geom->colors[v]);
+				}
+			}
+			out->indexes.push_back(remap[v]);
+		}
+	}
+
+	add_buffer_defaults(out);
+
+	psilog(PSILog::INIT, "Simplified geometry from %d to %d triangles, %d to %zu vertexes",
+	       tri_count, live_tris, vertex_count, out->positions.size());
+
+	return out;
+}
+
+std::vector<GeometryDataSharedPtr> lod_chain(const GeometryDataSharedPtr &geom, GLint levels, GLfloat ratio) {
+	std::vector<GeometryDataSharedPtr> chain;
+	GeometryDataSharedPtr previous = geom;
+
+	for (GLint i = 0; i < levels; i++) {
+		GeometryDataSharedPtr level = simplify(previous, ratio);
+		if (level == nullptr || level->indexes.size() >= previous->indexes.size()) {
+			break;
+		}
+
+		chain.push_back(level);
+		previous = level;
+	}
+
+	return chain;
+}
+
+} // namespace Simplifier
+} // namespace PSIGeometry
@@ -0,0 +1,29 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Quadric error mesh simplifier, for generating LOD levels from geometry data.
+
+#pragma once
+
+#include <cfloat>
+
+#include "PSIGeometryData.h"
+
+namespace PSIGeometry {
+	namespace Simplifier {
+		// Simplify indexed triangle geometry down to target_ratio of its triangles, by collapsing
+		// the edges that move the surface the least. Vertexes are collapsed onto existing ones,
+		// so normals, texcoords and colors are kept as is. Open borders and texture seams
+		// (vertexes sharing a position) are kept in place.
+		//
+		// Stops early when the next collapse would cost more than max_error, the sum of squared
+		// distances to the original triangle planes weighted by their area.
+		// Returns nullptr if the geometry can't be simplified.
+		GeometryDataSharedPtr simplify(const GeometryDataSharedPtr &geom, GLfloat target_ratio,
+		                               GLfloat max_error = FLT_MAX);
+
+		// Simplify geometry repeatedly by ratio, returning up to levels progressively coarser copies.
+		// Stops when a level no longer reduces the triangle count.
+		std::vector<GeometryDataSharedPtr> lod_chain(const GeometryDataSharedPtr &geom, GLint levels,
+		                                             GLfloat ratio);
+	}
+}
@@ -0,0 +1,305 @@
+#include "PSIMipGenerator.h"
+#include "PSIParallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace PSIMipGenerator {
+
+// Four floats, one RGBA pixel.
+#if defined(__SSE2__)
+typedef __m128 vec4;
+static inline vec4 vec4_zero() { return _mm_setzero_ps(); }
+static inline vec4 vec4_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void vec4_store(float *p, vec4 v) { _mm_storeu_ps(p, v); }
+static inline vec4 vec4_madd(vec4 acc, vec4 v, float w) { return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w))); }
+#elif defined(__ARM_NEON)
+typedef float32x4_t vec4;
+static inline vec4 vec4_zero() { return vdupq_n_f32(0.0f); }
+static inline vec4 vec4_load(const float *p) { return vld1q_f32(p); }
+static inline void vec4_store(float *p, vec4 v) { vst1q_f32(p, v); }
+static inline vec4 vec4_madd(vec4 acc, vec4 v, float w) { return vmlaq_n_f32(acc, v, w); }
+#else
+struct vec4 {
+	float v[4];
+};
+static inline vec4 vec4_zero() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+static inline vec4 vec4_load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void vec4_store(float *p, vec4 v) { p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+static inline vec4 vec4_madd(vec4 acc, vec4 v, float w) {
+	for (int i = 0; i < 4; i++) {
+		acc.v[i] += v.v[i] * w;
+	}
+	return acc;
+}
+#endif
+
+// Rows per thread batch.
+static const size_t ROW_BATCH = 16;
+// Kaiser filter radius in destination pixels, and window shape.
+static const float KAISER_RADIUS = 3.0f;
+static const float KAISER_ALPHA = 4.0f;
+// Entries in the linear to sRGB table, enough for under a quarter level of error.
+static const int LINEAR_TO_SRGB_SIZE = 16384;
+
+// Float RGBA level, linear when the image is sRGB.
+struct float_level {
+	GLint width;
+	GLint height;
+	std::vector<float> pixels;
+};
+
+// Source pixels and weights of each destination pixel along one axis.
+struct filter_taps {
+	std::vector<GLint> first;
+	std::vector<GLint> count;
+	std::vector<float> weights;
+	GLint max_count = 0;
+};
+
+GLint get_level_count(GLint width, GLint height) {
+	GLint size = std::max(width, height);
+	GLint count = 1;
+	while (size > 1) {
+		size /= 2;
+		count++;
+	}
+
+	return count;
+}
+
+static float srgb_to_linear(float c) {
+	return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float c) {
+	return (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static const std::vector<unsigned char> &get_linear_to_srgb_table() {
+	static const std::vector<unsigned char> table = []() {
+		std::vector<unsigned char> t(LINEAR_TO_SRGB_SIZE + 1);
+		for (int i = 0; i <= LINEAR_TO_SRGB_SIZE; i++) {
+			t[i] = (unsigned char)(linear_to_srgb((float)i / LINEAR_TO_SRGB_SIZE) * 255.0f + 0.5f);
+		}
+		return t;
+	}();
+
+	return table;
+}
+
+static float bessel_i0(float x) {
+	// Power series, converges quickly for the small arguments of the window.
+	float sum = 1.0f;
+	float term = 1.0f;
+	for (int k = 1; k < 16; k++) {
+		term *= (x / (2.0f * k)) * (x / (2.0f * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static float kaiser_sinc(float t) {
+	if (fabsf(t) >= KAISER_RADIUS) {
+		return 0.0f;
+	}
+
+	float sinc = (fabsf(t) < 1e-5f) ? 1.0f : sinf((float)M_PI * t) / ((float)M_PI * t);
+	float r = t / KAISER_RADIUS;
+	float window = bessel_i0(KAISER_ALPHA * sqrtf(1.0f - r * r)) / bessel_i0(KAISER_ALPHA);
+
+	return sinc * window;
+}
+
+// Build the taps for scaling src_size pixels down to dst_size. Pixels outside the
+// image repeat the edge pixel.
+static filter_taps build_taps(GLint src_size, GLint dst_size, GLint filter) {
+	filter_taps taps;
+	taps.first.resize(dst_size);
+	taps.count.resize(dst_size);
+
+	float scale = (float)src_size / dst_size;
+	std::vector<float> row_weights;
+	for (GLint x = 0; x < dst_size; x++) {
+		float begin = x * scale;
+		float end = (x + 1) * scale;
+
+		GLint first;
+		GLint last;
+		row_weights.clear();
+		if (filter == Filter::KAISER) {
+			float center = (x + 0.5f) * scale;
+			float support = KAISER_RADIUS * scale;
+			first = (GLint)floorf(center - support);
+			last = (GLint)ceilf(center + support);
+			for (GLint i = first; i <= last; i++) {
+				row_weights.push_back(kaiser_sinc((i + 0.5f - center) / scale));
+			}
+		} else {
+			// Coverage of each source pixel by the destination pixel.
+			first = (GLint)floorf(begin);
+			last = std::min((GLint)ceilf(end) - 1, src_size - 1);
+			for (GLint i = first; i <= last; i++) {
+				row_weights.push_back(std::min(end, i + 1.0f) - std::max(begin, (float)i));
+			}
+		}
+
+		// Fold the taps outside the image onto the edge pixels.
+		GLint clamped_first = std::max(first, 0);
+		GLint clamped_last = std::min(last, src_size - 1);
+		std::vector<float> folded(clamped_last - clamped_first + 1, 0.0f);
+		float sum = 0.0f;
+		for (GLint i = first; i <= last; i++) {
+			GLint src = std::min(std::max(i, 0), src_size - 1);
+			folded[src - clamped_first] += row_weights[i - first];
+			sum += row_weights[i - first];
+		}
+
+		taps.first[x] = clamped_first;
+		taps.count[x] = folded.size();
+		for (float w : folded) {
+			taps.weights.push_back(w / sum);
+		}
+		taps.max_count = std::max(taps.max_count, (GLint)folded.size());
+	}
+
+	return taps;
+}
+
+// Scale level down to width x height, separably, horizontal pass first.
+static float_level resample(const float_level &src, GLint width, GLint height, GLint filter) {
+	filter_taps taps_x = build_taps(src.width, width, filter);
+	filter_taps taps_y = build_taps(src.height, height, filter);
+
+	// Offsets of each destination pixel into the weights.
+	std::vector<size_t> offsets_x(width);
+	std::vector<size_t> offsets_y(height);
+	for (GLint x = 1; x < width; x++) {
+		offsets_x[x] = offsets_x[x - 1] + taps_x.count[x - 1];
+	}
+	for (GLint y = 1; y < height; y++) {
+		offsets_y[y] = offsets_y[y - 1] + taps_y.count[y - 1];
+	}
+
+	std::vector<float> tmp((size_t)width * src.height * 4);
+	PSIParallel::for_range(src.height, ROW_BATCH, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			const float *src_row = &src.pixels[y * src.width * 4];
+			float *tmp_row = &tmp[y * width * 4];
+			for (GLint x = 0; x < width; x++) {
+				const float *w = &taps_x.weights[offsets_x[x]];
+				const float *p = src_row + taps_x.first[x] * 4;
+				vec4 acc = vec4_zero();
+				for (GLint i = 0; i < taps_x.count[x]; i++) {
+					acc = vec4_madd(acc, vec4_load(p + i * 4), w[i]);
+				}
+				vec4_store(tmp_row + x * 4, acc);
+			}
+		}
+	});
+
+	float_level dst;
+	dst.width = width;
+	dst.height = height;
+	dst.pixels.resize((size_t)width * height * 4);
+	PSIParallel::for_range(height, ROW_BATCH, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			const float *w = &taps_y.weights[offsets_y[y]];
+			const float *column = &tmp[(size_t)taps_y.first[y] * width * 4];
+			float *dst_row = &dst.pixels[y * width * 4];
+			for (GLint x = 0; x < width; x++) {
+				vec4 acc = vec4_zero();
+				for (GLint i = 0; i < taps_y.count[y]; i++) {
+					acc = vec4_madd(acc, vec4_load(column + ((size_t)i * width + x) * 4), w[i]);
+				}
+				vec4_store(dst_row + x * 4, acc);
+			}
+		}
+	});
+
+	return dst;
+}
+
+static float_level to_float_level(const unsigned char *pixels, GLint width, GLint height, GLint channels, bool srgb) {
+	float lut[256];
+	for (int i = 0; i < 256; i++) {
+		lut[i] = srgb ? srgb_to_linear(i / 255.0f) : i / 255.0f;
+	}
+
+	float_level level;
+	level.width = width;
+	level.height = height;
+	level.pixels.resize((size_t)width * height * 4);
+	PSIParallel::for_range(height, ROW_BATCH, [&](size_t begin, size_t end) {
+		for (size_t i = begin * width; i < end * width; i++) {
+			const unsigned char *p = pixels + i * channels;
+			float *out = &level.pixels[i * 4];
+			// Missing channels are expanded like GL does, gray to RGB and opaque alpha.
+			// Alpha is always linear.
+			out[0] = lut[p[0]];
+			out[1] = (channels >= 3) ? lut[p[1]] : out[0];
+			out[2] = (channels >= 3) ? lut[p[2]] : out[0];
+			out[3] = (channels == 4) ? p[3] / 255.0f : (channels == 2) ? p[1] / 255.0f : 1.0f;
+		}
+	});
+
+	return level;
+}
+
+static void to_8bit(const float_level &level, GLint channels, bool srgb, std::vector<unsigned char> &out) {
+	const std::vector<unsigned char> &srgb_table = get_linear_to_srgb_table();
+	// Channel of the float pixel for each output channel.
+	static const int channel_map[4][4] = { { 0 }, { 0, 3 }, { 0, 1, 2 }, { 0, 1, 2, 3 } };
+	const int *map = channel_map[channels - 1];
+
+	out.resize((size_t)level.width * level.height * channels);
+	PSIParallel::for_range(level.height, ROW_BATCH, [&](size_t begin, size_t end) {
+		for (size_t i = begin * level.width; i < end * level.width; i++) {
+			const float *p = &level.pixels[i * 4];
+			for (GLint c = 0; c < channels; c++) {
+				float v = std::min(std::max(p[map[c]], 0.0f), 1.0f);
+				if (srgb && map[c] != 3) {
+					out[i * channels + c] = srgb_table[(int)(v * LINEAR_TO_SRGB_SIZE + 0.5f)];
+				} else {
+					out[i * channels + c] = (unsigned char)(v * 255.0f + 0.5f);
+				}
+			}
+		}
+	});
+}
+
+std::vector<mip_level> generate(const unsigned char *pixels, GLint width, GLint height, GLint channels,
+                                const mip_options &options) {
+	std::vector<mip_level> levels;
+	if (pixels == nullptr || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+		return levels;
+	}
+
+	GLint level_count = get_level_count(width, height) - 1;
+	if (options.max_levels > 0) {
+		level_count = std::min(level_count, options.max_levels);
+	}
+	levels.resize(level_count);
+
+	// Each level is filtered from the float level above it, so rounding does not
+	// build up down the chain.
+	float_level level = to_float_level(pixels, width, height, channels, options.srgb);
+	for (GLint i = 0; i < level_count; i++) {
+		level = resample(level, std::max(level.width / 2, 1), std::max(level.height / 2, 1), options.filter);
+
+		levels[i].width = level.width;
+		levels[i].height = level.height;
+		to_8bit(level, channels, options.srgb, levels[i].pixels);
+	}
+
+	return levels;
+}
+
+} // namespace PSIMipGenerator
@@ -0,0 +1,42 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// CPU mipmap generation. Filters in linear space for sRGB images, with a box
+// or Kaiser windowed sinc filter, for any image size. Levels are filtered from
+// the float level above them, with rows split over threads and pixels
+// filtered as 4 wide SIMD vectors (SSE2 or NEON when available).
+
+#pragma once
+
+#include "PSIGlobals.h"
+
+namespace PSIMipGenerator {
+	enum Filter {
+		// Area weighted average, exact for odd sizes too.
+		BOX = 0,
+		// Kaiser windowed sinc, sharper mips at some extra cost.
+		KAISER
+	};
+
+	struct mip_options {
+		GLint filter = Filter::BOX;
+		// Are the color channels sRGB encoded ? Alpha is always linear.
+		GLboolean srgb = true;
+		// Maximum number of levels to generate below the image, 0 for the full chain.
+		GLint max_levels = 0;
+	};
+
+	// One generated level, with the channel count of the source image.
+	struct mip_level {
+		GLint width = 0;
+		GLint height = 0;
+		std::vector<unsigned char> pixels;
+	};
+
+	// Levels in the full chain of a width x height image, including the image itself.
+	GLint get_level_count(GLint width, GLint height);
+
+	// Generate the mip levels below an 8 bit image with 1 to 4 channels. The image itself
+	// is not included. Does not touch GL, so it can be run on any thread.
+	std::vector<mip_level> generate(const unsigned char *pixels, GLint width, GLint height, GLint channels,
+	                                const mip_options &options = mip_options());
+} // namespace PSIMipGenerator
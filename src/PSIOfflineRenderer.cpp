@@ -0,0 +1,296 @@
+#include "PSIOfflineRenderer.h"
+#include "PSIFileUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+using namespace std::chrono;
+
+static double elapsed_ms(steady_clock::time_point start) {
+	return duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+static std::string get_frame_file_name(const PSIOfflineRenderer::render_options &options, GLint frame) {
+	char number[16];
+	snprintf(number, sizeof(number), "%06d", frame);
+
+	return options.basename + number + PSIFrameCapture::get_file_extension(options.format);
+}
+
+std::string PSIOfflineRenderer::get_frame_path(const render_options &options, GLint frame) {
+	return options.output_dir + "/" + get_frame_file_name(options, frame);
+}
+
+std::string PSIOfflineRenderer::get_manifest_path(const render_options &options) {
+	return options.output_dir + "/" + options.basename + ".manifest";
+}
+
+std::string PSIOfflineRenderer::get_settings_line(const render_options &options) {
+	std::ostringstream line;
+	line << "settings " << options.size.x << " " << options.size.y << " "
+	     << std::setprecision(9) << options.frametime << " "
+	     << options.format << " " << options.basename;
+
+	return line.str();
+}
+
+GLint PSIOfflineRenderer::render(const RenderSceneSharedPtr &scene, const CameraSharedPtr &camera,
+                                 update_func update, const render_options &options) {
+	_stats = render_stats();
+
+	if (options.frame_count <= 0 || options.size.x <= 0 || options.size.y <= 0 ||
+	    options.first_frame < 0 || options.frametime <= 0.0f) {
+		psilog_err("Invalid frame range, size or frametime");
+		return -1;
+	}
+
+	auto total_start = steady_clock::now();
+
+	std::string manifest_path = options.manifest_path;
+	if (manifest_path.empty() == true) {
+		manifest_path = get_manifest_path(options);
+	}
+	std::string resume_path = options.resume_manifest_path;
+	if (resume_path.empty() == true) {
+		resume_path = manifest_path;
+	}
+
+	// Frames already written by an earlier render with the same settings.
+	std::set<GLint> written;
+	bool resumed = options.resume == true && read_manifest(resume_path, options, written) == true;
+	// Append only to the manifest we resumed from, others get a new header.
+	if (open_manifest(manifest_path, options, resumed == true && resume_path == manifest_path) != 0) {
+		return -1;
+	}
+
+	if (init_framebuffers(options) != 0) {
+		_manifest.close();
+		return -1;
+	}
+
+	FrameCaptureSharedPtr capture = PSIFrameCapture::create(options.ring_size, 0, options.encode_threads);
+	capture->set_written_func([this, options](const std::string &path, bool written) {
+		std::lock_guard<std::mutex> lock(_manifest_mutex);
+		auto it = _pending_frames.find(path);
+		if (it == _pending_frames.end()) {
+			return;
+		}
+
+		if (written == true) {
+			// Flushed per frame, so a killed render loses at most the frames in flight.
+			_manifest << "frame " << it->second << " " << get_frame_file_name(options, it->second) << std::endl;
+		} else {
+			_stats.frames_failed++;
+		}
+		_pending_frames.erase(it);
+	});
+
+	// With MSAA, the frames are read from the resolved framebuffer.
+	RenderTargetSharedPtr read_target = (_resolve_target != nullptr) ? _resolve_target : _target;
+	_renderer->set_render_target(_target->get_fbo(), options.size);
+
+	RenderContextSharedPtr ctx = _renderer->get_context();
+	GLint last_frame = options.first_frame + options.frame_count;
+	GLint start_frame = options.step_skipped_frames == true ? 0 : options.first_frame;
+
+	for (GLint frame = start_frame; frame < last_frame; frame++) {
+		bool draw = frame >= options.first_frame && written.count(frame) == 0;
+		if (frame >= options.first_frame && draw == false) {
+			_stats.frames_skipped++;
+		}
+		if (draw == false && options.step_skipped_frames == false) {
+			continue;
+		}
+
+		// Elapsed time from the frame index instead of summing frametimes, so a
+		// resumed render sees exactly the same times as an uninterrupted one.
+		GLfloat elapsed_time = (GLfloat)((double)frame * options.frametime);
+
+		ctx->elapsed_time = elapsed_time;
+		ctx->elapsed_frames = frame;
+		ctx->frametime = options.frametime;
+
+		auto start = steady_clock::now();
+		if (update != nullptr) {
+			update(frame, elapsed_time, options.frametime);
+		}
+
+		// Frames not drawn still run the object logic, without any GL work.
+		if (draw == false) {
+			_renderer->step_logic(scene, ctx);
+			_stats.update_ms += elapsed_ms(start);
+			continue;
+		}
+		_stats.update_ms += elapsed_ms(start);
+
+		start = steady_clock::now();
+		_renderer->render(scene, ctx, camera);
+		_stats.draw_ms += elapsed_ms(start);
+
+		if (_resolve_target != nullptr) {
+			start = steady_clock::now();
+			_target->resolve(_resolve_target);
+			_stats.resolve_ms += elapsed_ms(start);
+		}
+
+		start = steady_clock::now();
+		std::string path = get_frame_path(options, frame);
+		{
+			std::lock_guard<std::mutex> lock(_manifest_mutex);
+			_pending_frames[path] = frame;
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, read_target->get_fbo());
+		capture->capture(path, options.format, options.size, GL_COLOR_ATTACHMENT0);
+		_stats.capture_ms += elapsed_ms(start);
+
+		_stats.frames_rendered++;
+		_renderer->end_frame();
+	}
+
+	auto start = steady_clock::now();
+	capture->finish();
+	capture = nullptr;
+	_stats.finish_ms = elapsed_ms(start);
+
+	_renderer->reset_render_target();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	release_framebuffers();
+
+	_manifest.close();
+	_pending_frames.clear();
+
+	_stats.total_ms = elapsed_ms(total_start);
+	log_stats();
+
+	return _stats.frames_failed == 0 ? 0 : -1;
+}
+
+void PSIOfflineRenderer::log_stats() {
+	psilog(PSILog::EXPORT, "Rendered %d frames in %.2f s, %.2f fps, %d skipped, %d failed",
+	       _stats.frames_rendered, _stats.total_ms / 1000.0, _stats.get_fps(),
+	       _stats.frames_skipped, _stats.frames_failed);
+
+	if (_stats.frames_rendered == 0) {
+		return;
+	}
+
+	// Per frame averages.
+	double frames = _stats.frames_rendered;
+	psilog(PSILog::EXPORT, "Per frame: update %.2f ms, draw %.2f ms, resolve %.2f ms, capture %.2f ms, finish %.2f ms",
+	       _stats.update_ms / frames, _stats.draw_ms / frames, _stats.resolve_ms / frames,
+	       _stats.capture_ms / frames, _stats.finish_ms / frames);
+}
+
+GLint PSIOfflineRenderer::init_framebuffers(const render_options &options) {
+	RenderTargetPoolSharedPtr pool = _renderer->get_target_pool();
+
+	PSIRenderTarget::target_desc desc;
+	desc.size = options.size;
+	desc.samples = std::max(options.msaa_samples, 1);
+	_target = pool->acquire(desc);
+
+	if (_target != nullptr && desc.samples > 1) {
+		// Only the color is read back.
+		desc.samples = 1;
+		desc.depth_format = 0;
+		_resolve_target = pool->acquire(desc);
+	}
+
+	if (_target == nullptr || (options.msaa_samples > 1 && _resolve_target == nullptr)) {
+		psilog_err("Failed initializing %dx%d framebuffer with %d samples",
+		           options.size.x, options.size.y, options.msaa_samples);
+		release_framebuffers();
+		return -1;
+	}
+
+	return 0;
+}
+
+void PSIOfflineRenderer::release_framebuffers() {
+	// Back to the renderer's pool, deleted when it is done with them.
+	_target = nullptr;
+	_resolve_target = nullptr;
+}
+
+bool PSIOfflineRenderer::read_manifest(const std::string &path, const render_options &options, std::set<GLint> &written) {
+	std::ifstream file(path);
+	if (file.is_open() == false) {
+		return false;
+	}
+
+	std::string line;
+	std::ostringstream header;
+	header << "psiframes " << MANIFEST_VERSION;
+	if (std::getline(file, line).fail() == true || line != header.str()) {
+		psilog_err("Unknown manifest '%s', rendering all frames", path.c_str());
+		return false;
+	}
+	if (std::getline(file, line).fail() == true || line != get_settings_line(options)) {
+		psilog(PSILog::EXPORT, "Manifest '%s' has other settings, rendering all frames", path.c_str());
+		return false;
+	}
+
+	while (std::getline(file, line)) {
+		std::istringstream entry(line);
+		std::string tag;
+		GLint frame;
+		if ((entry >> tag >> frame).fail() == true || tag != "frame") {
+			continue;
+		}
+
+		std::string file_name;
+		std::getline(entry >> std::ws, file_name);
+
+		// Frames deleted since are rendered again.
+		if (PSIFileUtils::get_modified_time(options.output_dir + "/" + file_name) != -1) {
+			written.insert(frame);
+		}
+	}
+
+	psilog(PSILog::EXPORT, "Read manifest '%s', %d frames written", path.c_str(), (GLint)written.size());
+
+	return true;
+}
+
+GLint PSIOfflineRenderer::write_manifest(const std::string &path, const render_options &options, const std::set<GLint> &written) {
+	// Written next to the old one and renamed over it, so a failed write keeps the old one.
+	std::string tmp_path = path + ".tmp";
+	std::ofstream file(tmp_path, std::ios::trunc);
+	if (file.is_open() == false) {
+		psilog_err("Failed opening manifest '%s' for writing", tmp_path.c_str());
+		return -1;
+	}
+
+	file << "psiframes " << MANIFEST_VERSION << "\n";
+	file << get_settings_line(options) << "\n";
+	for (GLint frame : written) {
+		file << "frame " << frame << " " << get_frame_file_name(options, frame) << "\n";
+	}
+	file.close();
+
+	if (file.fail() == true || rename(tmp_path.c_str(), path.c_str()) != 0) {
+		psilog_err("Failed writing manifest '%s'", path.c_str());
+		remove(tmp_path.c_str());
+		return -1;
+	}
+
+	return 0;
+}
+
+GLint PSIOfflineRenderer::open_manifest(const std::string &path, const render_options &options, bool append) {
+	_manifest.open(path, append == true ? std::ios::app : std::ios::trunc);
+	if (_manifest.is_open() == false) {
+		psilog_err("Failed opening manifest '%s' for writing", path.c_str());
+		return -1;
+	}
+
+	if (append == false) {
+		_manifest << "psiframes " << MANIFEST_VERSION << "\n";
+		_manifest << get_settings_line(options) << std::endl;
+	}
+
+	return 0;
+}
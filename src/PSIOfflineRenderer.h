@@ -0,0 +1,149 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Batch renderer for exporting frame sequences. Steps the scene with a fixed
+// timestep, renders each frame to an offscreen framebuffer of any size and
+// writes it to PNG or QOI through the asynchronous frame capture. Written frames
+// are recorded in a manifest, so an interrupted render resumes where it stopped.
+//
+// Manifest, one entry per line:
+//   psiframes <version>
+//   settings <width> <height> <frametime> <format> <basename>
+//   frame <index> <file name>
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIOpenGL.h"
+#include "PSIGLRenderer.h"
+#include "PSIFrameCapture.h"
+#include "PSIRenderScene.h"
+#include "PSICamera.h"
+
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+class PSIOfflineRenderer;
+typedef shared_ptr<PSIOfflineRenderer> OfflineRendererSharedPtr;
+
+class PSIOfflineRenderer {
+	public:
+		static const GLint MANIFEST_VERSION = 1;
+
+		struct render_options {
+			// Size of the rendered frames. Set the camera aspect ratio to match.
+			glm::ivec2 size = glm::ivec2(1920, 1080);
+			// Fixed frametime in ms, as with PSIFrameTimer::end_frame_fixed().
+			GLfloat frametime = 1000.0f / 60.0f;
+			// Frames first_frame .. first_frame + frame_count - 1 are written.
+			GLint first_frame = 0;
+			GLint frame_count = 0;
+			// Multisampled rendering, resolved before reading. 0 or 1 disables.
+			GLint msaa_samples = 0;
+			GLint format = PSIFrameCapture::ImageFormat::PNG;
+			// Frames are written to output_dir/basename000123.png, the manifest
+			// to output_dir/basename.manifest. The directory must exist.
+			std::string output_dir = ".";
+			std::string basename = "frame_";
+			// Skip frames the manifest lists as written and still found on disk.
+			bool resume = true;
+			// Run the update and object logic for the frames before first_frame too,
+			// without drawing them, for scenes whose state depends on every earlier
+			// frame, not only the elapsed time.
+			bool step_skipped_frames = false;
+			// Reads in flight, see PSIFrameCapture.
+			GLint ring_size = PSIFrameCapture::DEFAULT_RING_SIZE;
+			// Encoder threads, 0 for the PSIWorkerPool default.
+			size_t encode_threads = 0;
+			// Manifest written to, empty for get_manifest_path().
+			std::string manifest_path;
+			// Manifest the written frames are read from when resuming, empty for the
+			// one written to.
+			std::string resume_manifest_path;
+		};
+
+		// Where the time went. Draw is the time to submit the frame, the GPU time
+		// shows up as capture time waiting for the reads to finish.
+		struct render_stats {
+			GLint frames_rendered = 0;
+			// Frames skipped when resuming.
+			GLint frames_skipped = 0;
+			GLint frames_failed = 0;
+			double total_ms = 0.0;
+			double update_ms = 0.0;
+			double draw_ms = 0.0;
+			double resolve_ms = 0.0;
+			// Queuing the reads, waiting for the ring and the encoders.
+			double capture_ms = 0.0;
+			// Waiting for the last frames to be written.
+			double finish_ms = 0.0;
+
+			double get_fps() const {
+				return total_ms > 0.0 ? frames_rendered * 1000.0 / total_ms : 0.0;
+			}
+		};
+
+		// Called before drawing each frame, with the frame index and the elapsed time
+		// in ms at the start of it, also set in the renderer context. Update the scene
+		// and camera here.
+		typedef std::function<void(GLint frame, GLfloat elapsed_time, GLfloat frametime)> update_func;
+
+		PSIOfflineRenderer(const GLRendererSharedPtr &renderer) {
+			_renderer = renderer;
+		}
+		~PSIOfflineRenderer() = default;
+
+		static OfflineRendererSharedPtr create(const GLRendererSharedPtr &renderer) {
+			return make_shared<PSIOfflineRenderer>(renderer);
+		}
+
+		// Render and write the frames. Returns 0 when all frames were written, -1 on
+		// failure. The stats are kept for get_stats() either way.
+		GLint render(const RenderSceneSharedPtr &scene, const CameraSharedPtr &camera,
+		             update_func update, const render_options &options);
+
+		const render_stats &get_stats() {
+			return _stats;
+		}
+
+		// Log the stats of the last render.
+		void log_stats();
+
+		// Path of frame with options.
+		static std::string get_frame_path(const render_options &options, GLint frame);
+		// Default manifest path, output_dir/basename.manifest.
+		static std::string get_manifest_path(const render_options &options);
+
+		// Add the frames listed in the manifest at path that are still on disk to
+		// written. Returns false if there is no manifest or it was written with
+		// other settings.
+		static bool read_manifest(const std::string &path, const render_options &options, std::set<GLint> &written);
+		// Write a manifest listing the frames in written. Returns -1 on failure.
+		static GLint write_manifest(const std::string &path, const render_options &options, const std::set<GLint> &written);
+
+	private:
+		GLint init_framebuffers(const render_options &options);
+		void release_framebuffers();
+
+		GLint open_manifest(const std::string &path, const render_options &options, bool append);
+
+		static std::string get_settings_line(const render_options &options);
+
+		GLRendererSharedPtr _renderer;
+
+		// Target rendered to, and with MSAA the single sampled one resolved to, from
+		// the renderer's target pool.
+		RenderTargetSharedPtr _target;
+		RenderTargetSharedPtr _resolve_target;
+
+		// Manifest written from the encoder threads.
+		std::ofstream _manifest;
+		std::mutex _manifest_mutex;
+		// Frame indices of the paths being captured.
+		std::unordered_map<std::string, GLint> _pending_frames;
+
+		render_stats _stats;
+};
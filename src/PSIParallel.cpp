@@ -0,0 +1,43 @@
+#include "PSIParallel.h"
+
+#include <algorithm>
+
+namespace PSIParallel {
+
+size_t get_thread_count() {
+	// hardware_concurrency() can return 0 if it can't be determined.
+	size_t count = std::thread::hardware_concurrency();
+	return (count > 0) ? count : 1;
+}
+
+void for_range(size_t count, size_t min_batch, const range_func &func) {
+	if (count == 0) {
+		return;
+	}
+
+	min_batch = std::max<size_t>(min_batch, 1);
+	size_t thread_count = std::min(get_thread_count(), count / min_batch);
+
+	// Not worth spawning threads for.
+	if (thread_count <= 1) {
+		func(0, count);
+		return;
+	}
+
+	size_t batch = (count + thread_count - 1) / thread_count;
+
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count - 1);
+	for (size_t begin = batch; begin < count; begin += batch) {
+		threads.emplace_back(func, begin, std::min(begin + batch, count));
+	}
+
+	// Process the first batch ourselves.
+	func(0, std::min(batch, count));
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+} // namespace PSIParallel
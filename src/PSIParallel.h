@@ -0,0 +1,22 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Helpers for splitting CPU heavy loops over multiple threads.
+
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace PSIParallel {
+	// Range function, called with [begin, end) of the items it should process.
+	typedef std::function<void(size_t begin, size_t end)> range_func;
+
+	// How many threads we are able to run concurrently.
+	size_t get_thread_count();
+
+	// Split count items into batches of at least min_batch items and run func for
+	// each batch on its own thread. The calling thread processes the first batch.
+	// Runs inline when the work does not fill more than one batch.
+	void for_range(size_t count, size_t min_batch, const range_func &func);
+}
@@ -40,7 +40,11 @@ class PSIRenderContext {
 
 		// Force wireframe drawing ?
 		GLboolean wireframe = false;
-		// OpenGL Framebuffer objects we are using.
+		// Size of the viewport we are currently rendering to, in pixels.
+		glm::ivec2 viewport_size = glm::ivec2(0, 0);
+		// OpenGL framebuffer objects of the scene being rendered. The main one holds the
+		// final image, 0 for the screen. With MSAA the scene is drawn to the msaa one
+		// and resolved to the main one after drawing, otherwise msaa_fbo is 0.
 		GLuint main_fbo = 0;
 		GLuint msaa_fbo = 0;
 
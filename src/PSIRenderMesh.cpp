@@ -1,29 +1,74 @@
 #include "PSIRenderMesh.h"
 
 GLboolean PSIRenderMesh::init() {
-	// We need our GPU data
-	auto gpu_data = get_geometry_data();
+	// We need our GPU data, clones of GPU resident meshes read it back from the original.
+	auto gpu_data = get_cpu_geometry_data();
 	auto material = get_material();
 
+	// Shared geometry has no colors of its own, the material color is given
+	// as a constant attribute when drawing.
+	set_constant_color(gpu_data->shared);
+
 	// Update color data if we don't have it already
-	if (gpu_data->colors.size() == 0) {
+	if (gpu_data->shared == false && gpu_data->colors.size() == 0) {
 		generate_color_data(material, gpu_data);
 		material->set_needs_update(false);
 	}
 
-	// Create our mesh
-	auto mesh = create_gl_mesh(gpu_data);
+	// Create our mesh, or share the one already uploaded for this geometry and shader.
+	GLMeshSharedPtr mesh;
+	auto registry = get_mesh_registry();
+	if (gpu_data->shared == true && registry != nullptr) {
+		mesh = registry->get_mesh(gpu_data, get_shader()->get_program(), [this, &gpu_data]() {
+			return create_gl_mesh(gpu_data);
+		});
+	} else {
+		mesh = create_gl_mesh(gpu_data);
+	}
+
 	if (mesh != nullptr) {
 		set_gl_mesh(mesh);
 	} else {
 		return false;
 	}
 
+	// Everything is on the GPU now, so we can drop our copy.
+	if (is_gpu_resident() == true && gpu_data->shared == false) {
+		gpu_data->release_cpu_data();
+	}
+
 	psilog(PSILog::INIT, "Initialized PSIRenderMesh");
 
 	return true;
 }
 
+GLboolean PSIRenderMesh::init_cached(const std::string &cache_path,
+                                     const std::function<GeometryDataSharedPtr()> &create_func) {
+	assert(get_shader() != nullptr);
+
+	auto loaded = PSIMeshCache::load_gl_mesh(cache_path, get_shader()->get_program());
+	if (loaded.mesh == nullptr) {
+		auto gpu_data = create_func();
+		if (gpu_data == nullptr) {
+			return false;
+		}
+
+		// Failing to write the cache only costs us the next startup.
+		PSIMeshCache::write_geometry(cache_path, gpu_data);
+
+		set_geometry_data(gpu_data);
+		return init();
+	}
+
+	set_geometry_data(loaded.geometry_data);
+	set_gl_mesh(loaded.mesh);
+	set_constant_color(true);
+
+	psilog(PSILog::INIT, "Initialized PSIRenderMesh from cache '%s'", cache_path.c_str());
+
+	return true;
+}
+
 void PSIRenderMesh::generate_color_data(const GLMaterialSharedPtr &material, const GeometryDataSharedPtr &gpu_data) {
 	assert(gpu_data != nullptr);
 	assert(material != nullptr);
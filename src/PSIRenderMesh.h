@@ -5,6 +5,9 @@
 #pragma once
 
 #include "PSIRenderObj.h"
+#include "PSIMeshCache.h"
+
+#include <functional>
 
 class PSIRenderMesh;
 typedef shared_ptr<PSIRenderMesh> RenderMeshSharedPtr;
@@ -33,6 +36,11 @@ class PSIRenderMesh : public PSIRenderObj {
 		// Create mesh with geometry and material and add default uniforms.
 		GLboolean init();
 
+		// Create mesh from a binary mesh cache. When the cache is missing or outdated, creates the
+		// geometry data with create_func, writes it to the cache and initializes from that.
+		// Cached meshes are GPU resident and drawn with the material color as a constant color.
+		GLboolean init_cached(const std::string &cache_path, const std::function<GeometryDataSharedPtr()> &create_func);
+
 		// Create colors from the material color.
 		void generate_color_data(const GLMaterialSharedPtr &material, const GeometryDataSharedPtr &gpu_data);
 
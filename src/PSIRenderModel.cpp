@@ -0,0 +1,133 @@
+#include "PSIRenderModel.h"
+
+#include <algorithm>
+
+PSIRenderModel::~PSIRenderModel() {
+	if (_buffer_ids.empty() == false) {
+		glDeleteBuffers(_buffer_ids.size(), _buffer_ids.data());
+	}
+}
+
+void PSIRenderModel::sort_batches() {
+	std::stable_sort(_batches.begin(), _batches.end(), [](const draw_batch &a, const draw_batch &b) {
+		bool a_transparent = a.material->get_opacity() < 1.0f;
+		bool b_transparent = b.material->get_opacity() < 1.0f;
+		if (a_transparent != b_transparent) {
+			return b_transparent;
+		}
+
+		GLTextureSharedPtr a_texture = a.material->get_texture();
+		GLTextureSharedPtr b_texture = b.material->get_texture();
+		if (a_texture != b_texture) {
+			return a_texture < b_texture;
+		}
+		if (a.material != b.material) {
+			return a.material < b.material;
+		}
+
+		return a.mesh < b.mesh;
+	});
+
+	_needs_sort = false;
+}
+
+void PSIRenderModel::draw(const RenderContextSharedPtr &ctx) {
+	auto shader = get_shader();
+	assert(shader != nullptr);
+	auto material = get_material();
+	assert(material != nullptr);
+
+	if (_needs_sort == true) {
+		sort_batches();
+	}
+
+	// Are we rendering as wireframe ?
+	bool wireframe = (material->get_wireframe() == true) || ctx->wireframe;
+	if (wireframe == true) {
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	}
+
+	// Should this object be depth tested ?
+	GLboolean disable_depth_test = !is_depth_tested();
+	if (disable_depth_test == true) {
+		glDisable(GL_DEPTH_TEST);
+	}
+
+	GLboolean is_translated = is_translated_by_camera();
+	if (is_translated == false) {
+		STACK_PUSH(ctx->view);
+		ctx->view.top() = ctx->camera->get_looking_at_matrix_without_translation();
+	}
+
+	auto asset = get_render_asset();
+	auto render_transform = asset.transform;
+	if (get_interpolate_transform() == true) {
+		render_transform.interpolate_from(asset.p_transform, ctx->transform_interpolation);
+	}
+
+	// Matrices of the whole model, the batch node matrix is applied on top.
+	calc_model_view_projection(ctx, render_transform);
+	glm::mat4 model = get_model_matrix();
+	glm::mat4 view_projection = get_projection_matrix() * ctx->view.top();
+
+	GLint color_location = shader->get_attrib_location("a_color");
+	GLMaterialSharedPtr bound_material = nullptr;
+	GLTextureSharedPtr bound_texture = nullptr;
+
+	for (const auto &batch : _batches) {
+		// Batches are sorted by material, so state only changes between material groups.
+		if (batch.material != bound_material) {
+			GLTextureSharedPtr texture = batch.material->get_texture();
+			if (texture != bound_texture) {
+				if (texture != nullptr) {
+					glActiveTexture(GL_TEXTURE0);
+					shader->set_uniform("u_diffuse", 0);
+					texture->bind();
+				} else if (bound_texture != nullptr) {
+					bound_texture->unbind();
+				}
+				bound_texture = texture;
+			}
+			// Materials packed into the same array texture only change the layer.
+			if (texture != nullptr && batch.material->get_texture_layer() >= 0) {
+				shader->set_uniform("u_texture_layer", batch.material->get_texture_layer());
+			}
+
+			// Models have no color buffers unless the file has vertex colors,
+			// so the material color is given as a constant attribute.
+			if (color_location != PSIGLShader::AttribLocation::INVALID) {
+				shader->set_vertex_attrib(color_location, batch.material->get_color());
+			}
+
+			bound_material = batch.material;
+		}
+
+		glm::mat4 batch_model = model * batch.node_matrix;
+		shader->set_uniform("u_model_view_projection_matrix", view_projection * batch_model);
+		shader->set_uniform("u_normal_matrix", glm::inverseTranspose(glm::mat3(batch_model)));
+
+		if (batch.indexed == true) {
+			batch.mesh->draw_indexed();
+		} else {
+			batch.mesh->draw();
+		}
+	}
+
+	// Render children of this object, if any.
+	for (auto child : get_children()) {
+		child->draw(ctx);
+	}
+
+	if (bound_texture != nullptr) {
+		bound_texture->unbind();
+	}
+	if (disable_depth_test == true) {
+		glEnable(GL_DEPTH_TEST);
+	}
+	if (wireframe == true) {
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	}
+	if (is_translated == false) {
+		ctx->view.pop();
+	}
+}
@@ -0,0 +1,72 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Render object made of several meshes, each drawn as its own batch with its
+// own node transform and material. Used for models imported from glTF scenes.
+
+#pragma once
+
+#include "PSIRenderObj.h"
+
+class PSIRenderModel;
+typedef shared_ptr<PSIRenderModel> RenderModelSharedPtr;
+
+class PSIRenderModel : public PSIRenderObj {
+	public:
+		// One draw call of the model.
+		struct draw_batch {
+			GLMeshSharedPtr mesh;
+			GLMaterialSharedPtr material;
+			// Transform of the batch within the model.
+			glm::mat4 node_matrix = glm::mat4(1.0f);
+			// Draw with the index buffer of the mesh, or just the vertexes.
+			GLboolean indexed = true;
+		};
+
+		PSIRenderModel() = default;
+		virtual ~PSIRenderModel();
+
+		// The model owns GL buffers shared between its batch meshes, so it is not copyable.
+		PSIRenderModel(const PSIRenderModel &rhs) = delete;
+
+		static RenderModelSharedPtr create() {
+			return make_shared<PSIRenderModel>();
+		}
+
+		// Draw all batches with our transform.
+		void draw(const RenderContextSharedPtr &ctx) override;
+
+		// For differentating from PSIRenderObj.
+		void print_id() override {
+			std::cout << "PSIRenderModel" << std::endl;
+		}
+
+		void add_batch(const draw_batch &batch) {
+			_batches.push_back(batch);
+			_needs_sort = true;
+		}
+		std::vector<draw_batch>& get_batches() {
+			return _batches;
+		}
+		GLsizei get_batch_count() {
+			return _batches.size();
+		}
+
+		// Generate a GL buffer owned by the model, for data shared between batch meshes.
+		GLuint add_buffer() {
+			GLuint buffer_id = 0;
+			glGenBuffers(1, &buffer_id);
+			_buffer_ids.push_back(buffer_id);
+			return buffer_id;
+		}
+
+		// Sort batches to minimize state changes: opaque before transparent, then by texture,
+		// material and mesh.
+		void sort_batches();
+
+	private:
+		std::vector<draw_batch> _batches;
+		// Do the batches need sorting before the next draw ?
+		GLboolean _needs_sort = false;
+		// Buffers shared between the batch meshes.
+		std::vector<GLuint> _buffer_ids;
+};
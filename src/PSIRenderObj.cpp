@@ -1,17 +1,46 @@
 #include "PSIRenderObj.h"
+#include "PSIMeshSimplifier.h"
+
+#include <cfloat>
+
+const GLfloat PSIRenderObj::LOD_HYSTERESIS = 0.1f;
 
 PSIRenderObj::PSIRenderObj() {
 }
 
+// LOD levels are not copied, their color buffers follow the material of the original.
 PSIRenderObj::PSIRenderObj(const PSIRenderObj &rhs) :  _mvp(rhs._mvp),
 						      _render_asset(rhs._render_asset),
 						      _geometry_data(rhs._geometry_data),
+						      _mesh_registry(rhs._mesh_registry),
+						      _constant_color(rhs._constant_color),
+						      _gpu_resident(rhs._gpu_resident),
 						      _children(rhs._children),
 						      _depth_tested(rhs._depth_tested),
 						      _camera_translated(rhs._camera_translated),
 						      _visible(rhs._visible) 
 						      {}
 
+// Fill the color buffer of mesh with color.
+static void update_color_buffer(const GLMeshSharedPtr &mesh, const GeometryDataSharedPtr &geometry_data,
+                                const glm::vec4 &color) {
+	// Released geometry has no colors to keep in sync, so fill a temporary array for the upload.
+	std::vector<glm::vec4> released_colors;
+	std::vector<glm::vec4> &colors = (geometry_data->cpu_released == true) ? released_colors : geometry_data->colors;
+	if (geometry_data->cpu_released == true) {
+		released_colors.assign(geometry_data->get_vertex_count(), color);
+	} else {
+		std::fill(colors.begin(), colors.end(), color);
+	}
+
+	if (mesh != nullptr && colors.empty() == false) {
+		//psilog(PSILog::OPENGL, "Updating color data");
+		mesh->bind_vao();
+		mesh->bind_buffer(GL_ARRAY_BUFFER, PSIGLMesh::BufferName::COLOR);
+		mesh->buffer_sub_data(GL_ARRAY_BUFFER, 0, colors.size() * sizeof(glm::vec4), colors.data());
+	}
+}
+
 // Drawing method for drawing general render objects.
 void PSIRenderObj::draw(const RenderContextSharedPtr &ctx) {
 	auto shader = get_shader();
@@ -47,14 +76,13 @@ void PSIRenderObj::draw(const RenderContextSharedPtr &ctx) {
 		//psilog(PSILog::OPENGL, "Updating material with color %s", GLM_CSTR(color));
 		assert(_geometry_data != nullptr);
 		glm::vec4 color = material->get_color();
-		std::fill(_geometry_data->colors.begin(), _geometry_data->colors.end(), color);
 
-		auto mesh = get_gl_mesh();
-		if (mesh != nullptr) {
-			//psilog(PSILog::OPENGL, "Updating color data");
-			mesh->bind_vao();
-			mesh->bind_buffer(GL_ARRAY_BUFFER, PSIGLMesh::BufferName::COLOR);
-			mesh->buffer_sub_data(GL_ARRAY_BUFFER, 0, _geometry_data->colors.size() * sizeof(glm::vec4), &_geometry_data->colors[0]);
+		if (_constant_color == false) {
+			update_color_buffer(get_gl_mesh(), _geometry_data, color);
+		}
+
+		for (auto &lod : _lods) {
+			update_color_buffer(lod.mesh, lod.geometry_data, color);
 		}
 
 		material->set_needs_update(false);
@@ -69,6 +97,9 @@ void PSIRenderObj::draw(const RenderContextSharedPtr &ctx) {
 		// Update that we are using texture 0 for the material diffuse.
 		shader->set_uniform("u_diffuse", 0);
 		texture->bind();
+		if (material->get_texture_layer() >= 0) {
+			shader->set_uniform("u_texture_layer", material->get_texture_layer());
+		}
 	}
 
 	auto render_transform = asset.transform;
@@ -80,10 +111,21 @@ void PSIRenderObj::draw(const RenderContextSharedPtr &ctx) {
 	// Calculate mvp matrix for the shader.
 	calc_model_view_projection(ctx, render_transform);
 
+	// Pick the level of detail for our size on screen.
+	select_lod(ctx);
+
 	// Set uniforms specific for this render object.
 	shader->set_uniform("u_model_view_projection_matrix", get_model_view_projection_matrix());
 	shader->set_uniform("u_normal_matrix", get_normal_matrix());
 
+	// Shared meshes have no color buffer, so give the material color as a constant attribute.
+	if (_constant_color == true) {
+		GLint color_location = shader->get_attrib_location("a_color");
+		if (color_location != PSIGLShader::AttribLocation::INVALID) {
+			shader->set_vertex_attrib(color_location, material->get_color());
+		}
+	}
+
 	// Draw the mesh
 	draw_mesh();
 
@@ -118,28 +160,41 @@ void PSIRenderObj::calc_model_view_projection(const RenderContextSharedPtr &ctx,
 }
 
 void PSIRenderObj::init_buffers(const GLMeshSharedPtr &mesh, const GeometryDataSharedPtr &geometry_data) {
-	for (const auto &buffer : geometry_data->buffers) {
-		mesh->bind_buffer(buffer.target, buffer.name_id);
+	// Buffers without data, like the colors of shared geometry, are left out with their attributes.
+	GLuint skipped_buffers = 0;
 
-		const GLvoid *data_ptr;
+	for (const auto &buffer : geometry_data->buffers) {
+		const GLvoid *data_ptr = nullptr;
+		bool empty = false;
 		switch (buffer.name_id) {
 		case PSIGLMesh::BufferName::POSITION:
-			data_ptr = &geometry_data->positions[0];
+			data_ptr = geometry_data->positions.data();
+			empty = geometry_data->positions.empty();
 			break;
 		case PSIGLMesh::BufferName::COLOR:
-			data_ptr = &geometry_data->colors[0];
+			data_ptr = geometry_data->colors.data();
+			empty = geometry_data->colors.empty();
 			break;
 		case PSIGLMesh::BufferName::NORMAL:
-			data_ptr = &geometry_data->normals[0];
+			data_ptr = geometry_data->normals.data();
+			empty = geometry_data->normals.empty();
 			break;
 		case PSIGLMesh::BufferName::TEXCOORD:
-			data_ptr = &geometry_data->texcoords[0];
+			data_ptr = geometry_data->texcoords.data();
+			empty = geometry_data->texcoords.empty();
 			break;
 		case PSIGLMesh::BufferName::INDEX:
-			data_ptr = &geometry_data->indexes[0];
+			data_ptr = geometry_data->indexes.data();
+			empty = geometry_data->indexes.empty();
 			break;
 		}
 
+		if (empty == true) {
+			skipped_buffers |= 1 << buffer.name_id;
+			continue;
+		}
+
+		mesh->bind_buffer(buffer.target, buffer.name_id);
 		mesh->buffer_data(buffer.target, buffer.size, data_ptr, buffer.usage);
 		check_gl_error();
 
@@ -149,6 +204,10 @@ void PSIRenderObj::init_buffers(const GLMeshSharedPtr &mesh, const GeometryDataS
 
 	GLuint shader_prog = get_shader()->get_program();
 	for (const auto &attrib : geometry_data->attributes) {
+		if (skipped_buffers & (1 << attrib.buffer_name_id)) {
+			continue;
+		}
+
 		mesh->bind_buffer(GL_ARRAY_BUFFER, attrib.buffer_name_id);
 		mesh->enable_vertex_attrib(shader_prog, attrib.name, attrib.size, attrib.stride, attrib.pointer, attrib.type);
 		check_gl_error();
@@ -183,3 +242,252 @@ GLMeshSharedPtr PSIRenderObj::create_gl_mesh(const GeometryDataSharedPtr &gpu_da
 
 	return mesh;
 }
+
+GLboolean PSIRenderObj::add_lod(const GeometryDataSharedPtr &geometry_data, GLfloat max_screen_size) {
+	assert(geometry_data != nullptr);
+
+	if (geometry_data->buffers.empty()) {
+		psilog_err("LOD geometry data has no buffers");
+		return false;
+	}
+
+	// Colors come from the material, same as for the full detail mesh.
+	auto material = get_material();
+	if (geometry_data->colors.size() != geometry_data->positions.size() && material != nullptr) {
+		geometry_data->colors.assign(geometry_data->positions.size(), material->get_color());
+		for (auto &buffer : geometry_data->buffers) {
+			if (buffer.name_id == PSIGLMesh::BufferName::COLOR) {
+				buffer.size = geometry_data->colors.size() * sizeof(glm::vec4);
+			}
+		}
+	}
+
+	lod_level lod;
+	lod.mesh = create_gl_mesh(geometry_data);
+	if (lod.mesh == nullptr) {
+		return false;
+	}
+	lod.mesh->set_draw_mode(_render_asset.mesh != nullptr ? _render_asset.mesh->get_draw_mode() : GL_TRIANGLES);
+	lod.geometry_data = geometry_data;
+	lod.max_screen_size = max_screen_size;
+
+	if (_gpu_resident == true) {
+		geometry_data->release_cpu_data();
+	}
+
+	// Keep levels sorted from finest to coarsest.
+	auto pos = std::find_if(_lods.begin(), _lods.end(), [max_screen_size](const lod_level &l) {
+		return l.max_screen_size < max_screen_size;
+	});
+	_lods.insert(pos, lod);
+
+	psilog(PSILog::INIT, "Added LOD level with %d indexes below %.1f pixels",
+	       geometry_data->get_index_count(), max_screen_size);
+
+	return true;
+}
+
+GLint PSIRenderObj::generate_lods(GLint levels, GLfloat ratio, GLfloat max_screen_size) {
+	if (_geometry_data == nullptr) {
+		psilog_err("No geometry data to generate LOD levels from");
+		return 0;
+	}
+
+	auto chain = PSIGeometry::Simplifier::lod_chain(get_cpu_geometry_data(), levels, ratio);
+
+	GLint added = 0;
+	for (const auto &geometry_data : chain) {
+		if (add_lod(geometry_data, max_screen_size) == false) {
+			break;
+		}
+		max_screen_size *= 0.5f;
+		added++;
+	}
+
+	return added;
+}
+
+GLfloat PSIRenderObj::calc_screen_size(const RenderContextSharedPtr &ctx) {
+	if (_geometry_data == nullptr || ctx->viewport_size.y <= 0) {
+		return FLT_MAX;
+	}
+
+	if (_geometry_data->bounds_radius <= 0.0f) {
+		_geometry_data->calc_bounds();
+	}
+
+	// Bounding sphere in view space, scaled with the largest model axis scale.
+	glm::vec3 center = glm::vec3(_mvp.model_view * glm::vec4(_geometry_data->bounds_center, 1.0f));
+	GLfloat scale = std::max(glm::length(glm::vec3(_mvp.model[0])),
+	                std::max(glm::length(glm::vec3(_mvp.model[1])), glm::length(glm::vec3(_mvp.model[2]))));
+	GLfloat radius = _geometry_data->bounds_radius * scale;
+
+	// We are inside the sphere.
+	GLfloat distance = glm::length(center);
+	if (distance <= radius) {
+		return FLT_MAX;
+	}
+
+	// Projection [1][1] is 1 / tan(fov / 2), so this is the sphere diameter
+	// over the visible height at that distance, in pixels.
+	return radius * _mvp.projection[1][1] / distance * ctx->viewport_size.y;
+}
+
+GLint PSIRenderObj::select_lod(const RenderContextSharedPtr &ctx) {
+	if (_lods.empty()) {
+		return _lod_index = 0;
+	}
+
+	GLfloat size = calc_screen_size(ctx);
+
+	// Levels we are clearly below the size of, and levels we are at least near to.
+	GLint coarse = 0;
+	GLint fine = 0;
+	for (const auto &lod : _lods) {
+		if (size < lod.max_screen_size * (1.0f - LOD_HYSTERESIS)) {
+			coarse++;
+		}
+		if (size < lod.max_screen_size * (1.0f + LOD_HYSTERESIS)) {
+			fine++;
+		}
+	}
+
+	// Only switch once we are past the hysteresis band of the current level.
+	if (_lod_index < coarse) {
+		_lod_index = coarse;
+	} else if (_lod_index > fine) {
+		_lod_index = fine;
+	}
+
+	return _lod_index;
+}
+
+// Texcoords of mesh, from the GL buffer if the geometry data has been released.
+static GLboolean get_mesh_texcoords(const GLMeshSharedPtr &mesh, const GeometryDataSharedPtr &geometry_data,
+                                    std::vector<glm::vec2> &texcoords) {
+	if (geometry_data->cpu_released == false) {
+		texcoords = geometry_data->texcoords;
+		return true;
+	}
+
+	for (const auto &buffer : geometry_data->buffers) {
+		if (buffer.name_id == PSIGLMesh::BufferName::TEXCOORD && mesh != nullptr) {
+			texcoords.resize(buffer.size / sizeof(glm::vec2));
+			mesh->bind_vao();
+			mesh->bind_buffer(buffer.target, buffer.name_id);
+			mesh->get_buffer_sub_data(buffer.target, 0, buffer.size, texcoords.data());
+			return true;
+		}
+	}
+
+	return false;
+}
+
+GLboolean PSIRenderObj::remap_texcoords(const glm::vec4 &uv_rect) {
+	if (_geometry_data == nullptr || _geometry_data->shared == true) {
+		psilog_err("Can not remap texcoords of missing or shared geometry");
+		return false;
+	}
+
+	std::vector<GLMeshSharedPtr> meshes = { get_gl_mesh() };
+	std::vector<GeometryDataSharedPtr> geometry_datas = { _geometry_data };
+	for (const auto &lod : _lods) {
+		meshes.push_back(lod.mesh);
+		geometry_datas.push_back(lod.geometry_data);
+	}
+
+	// Check all levels before changing any of them.
+	std::vector<std::vector<glm::vec2>> texcoords(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++) {
+		if (get_mesh_texcoords(meshes[i], geometry_datas[i], texcoords[i]) == false) {
+			psilog_err("No texcoords to remap");
+			return false;
+		}
+		for (const auto &uv : texcoords[i]) {
+			if (uv.x < 0.0f || uv.x > 1.0f || uv.y < 0.0f || uv.y > 1.0f) {
+				psilog(PSILog::TEXTURE, "Texcoords outside 0..1, not remapping");
+				return false;
+			}
+		}
+	}
+
+	glm::vec2 offset(uv_rect.x, uv_rect.y);
+	glm::vec2 scale(uv_rect.z, uv_rect.w);
+	for (size_t i = 0; i < meshes.size(); i++) {
+		for (auto &uv : texcoords[i]) {
+			uv = offset + uv * scale;
+		}
+
+		if (meshes[i] != nullptr && texcoords[i].empty() == false) {
+			meshes[i]->bind_vao();
+			meshes[i]->bind_buffer(GL_ARRAY_BUFFER, PSIGLMesh::BufferName::TEXCOORD);
+			meshes[i]->buffer_sub_data(GL_ARRAY_BUFFER, 0, texcoords[i].size() * sizeof(glm::vec2),
+			                           texcoords[i].data());
+		}
+		if (geometry_datas[i]->cpu_released == false) {
+			geometry_datas[i]->texcoords = std::move(texcoords[i]);
+		}
+	}
+
+	return true;
+}
+
+GLboolean PSIRenderObj::read_back_geometry_data() {
+	if (_geometry_data == nullptr || _geometry_data->cpu_released == false) {
+		return true;
+	}
+
+	auto mesh = get_gl_mesh();
+	if (mesh == nullptr) {
+		psilog_err("No GL mesh to read geometry data back from");
+		return false;
+	}
+
+	// The element buffer binding is part of the vao.
+	mesh->bind_vao();
+
+	for (const auto &buffer : _geometry_data->buffers) {
+		GLvoid *data_ptr = nullptr;
+		switch (buffer.name_id) {
+		case PSIGLMesh::BufferName::POSITION:
+			_geometry_data->positions.resize(buffer.size / sizeof(glm::vec3));
+			data_ptr = _geometry_data->positions.data();
+			break;
+		case PSIGLMesh::BufferName::COLOR:
+			// Shared meshes have no color buffer.
+			if (_constant_color == true) {
+				continue;
+			}
+			_geometry_data->colors.resize(buffer.size / sizeof(glm::vec4));
+			data_ptr = _geometry_data->colors.data();
+			break;
+		case PSIGLMesh::BufferName::NORMAL:
+			_geometry_data->normals.resize(buffer.size / sizeof(glm::vec3));
+			data_ptr = _geometry_data->normals.data();
+			break;
+		case PSIGLMesh::BufferName::TEXCOORD:
+			_geometry_data->texcoords.resize(buffer.size / sizeof(glm::vec2));
+			data_ptr = _geometry_data->texcoords.data();
+			break;
+		case PSIGLMesh::BufferName::INDEX:
+			_geometry_data->indexes.resize(buffer.size / sizeof(GLuint));
+			data_ptr = _geometry_data->indexes.data();
+			break;
+		}
+
+		if (data_ptr == nullptr || buffer.size == 0) {
+			continue;
+		}
+
+		mesh->bind_buffer(buffer.target, buffer.name_id);
+		mesh->get_buffer_sub_data(buffer.target, 0, buffer.size, data_ptr);
+		check_gl_error();
+	}
+
+	_geometry_data->cpu_released = false;
+
+	psilog(PSILog::OPENGL, "Read back geometry data, positions.size() = %zu, indexes.size() = %zu",
+	       _geometry_data->positions.size(), _geometry_data->indexes.size());
+
+	return true;
+}
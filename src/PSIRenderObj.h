@@ -14,6 +14,7 @@
 #include "PSIGLTransform.h"
 #include "PSIRenderContext.h"
 #include "PSIGeometryData.h"
+#include "PSIMeshRegistry.h"
 #include "PSIAABB.h"
 
 class PSIRenderObj;
@@ -53,6 +54,14 @@ class PSIRenderObj {
 			glm::mat4 model_view_projection;
 		};
 
+		// A lower detail version of the render object mesh.
+		struct lod_level {
+			GLMeshSharedPtr mesh;
+			GeometryDataSharedPtr geometry_data;
+			// This level is used when the object is smaller than this on screen, in pixels.
+			GLfloat max_screen_size;
+		};
+
 		// Optional "modules" to pass to the shader.
 		// This is just a system for defining optional shader uniforms for now.
 		enum ModulesType {
@@ -61,6 +70,10 @@ class PSIRenderObj {
 			MODULES_ELAPSED_TIME = 1
 		};
 
+		// How far past a LOD level screen size we need to go before switching to or from it,
+		// as a fraction of the size. Keeps objects near the threshold from popping between levels.
+		static const GLfloat LOD_HYSTERESIS;
+
 		// Static creation method.
 		static RenderObjSharedPtr create() {
 			return make_shared<PSIRenderObj>();
@@ -104,10 +117,39 @@ class PSIRenderObj {
 		void calc_model_view_projection(const RenderContextSharedPtr &ctx,
 		                                PSIGLTransform &transform);
 
+		// Add a lower detail level, used when we are smaller than max_screen_size pixels on screen.
+		GLboolean add_lod(const GeometryDataSharedPtr &geometry_data, GLfloat max_screen_size);
+		// Generate up to levels LOD levels by simplifying our geometry data, each level with ratio
+		// of the triangles of the previous one. The first level is used below max_screen_size,
+		// and each next level below half the size of the previous. Returns the number of levels added.
+		GLint generate_lods(GLint levels, GLfloat ratio, GLfloat max_screen_size);
+		// Remove all LOD levels, drawing only the full detail mesh.
+		void clear_lods() {
+			_lods.clear();
+			_lod_index = 0;
+		}
+
+		// Projected diameter of our bounding sphere in pixels, using the current model view
+		// and projection matrices.
+		GLfloat calc_screen_size(const RenderContextSharedPtr &ctx);
+		// Select the LOD level to draw from our current screen size. 0 is full detail.
+		GLint select_lod(const RenderContextSharedPtr &ctx);
+
+		GLint get_lod_index() {
+			return _lod_index;
+		}
+		GLsizei get_lod_count() {
+			return _lods.size();
+		}
+
 		// Common methods shared between instances of PSIRenderObj.
 		void draw_mesh() {
 			//psilog(PSILog::FREQ, "Drawing mesh");
-			_render_asset.mesh->draw_indexed();
+			if (_lod_index > 0) {
+				_lods[_lod_index - 1].mesh->draw_indexed();
+			} else {
+				_render_asset.mesh->draw_indexed();
+			}
 		}
 
 		ShaderSharedPtr get_shader() {
@@ -150,6 +192,47 @@ class PSIRenderObj {
 			_modules = modules;
 		}
 
+		// Registry for sharing GL meshes of shared geometry between render objects.
+		void set_mesh_registry(const MeshRegistrySharedPtr &mesh_registry) {
+			_mesh_registry = mesh_registry;
+		}
+		MeshRegistrySharedPtr get_mesh_registry() {
+			return _mesh_registry;
+		}
+
+		// Draw with the material color as a constant color attribute, instead of per vertex colors.
+		void set_constant_color(GLboolean constant_color) {
+			_constant_color = constant_color;
+		}
+		GLboolean has_constant_color() {
+			return _constant_color;
+		}
+
+		// Release our CPU side geometry after uploading it, keeping only the GPU copy.
+		// Shared geometry is kept, as other render objects may still need to upload it.
+		void set_gpu_resident(GLboolean gpu_resident) {
+			_gpu_resident = gpu_resident;
+		}
+		GLboolean is_gpu_resident() {
+			return _gpu_resident;
+		}
+
+		// Read released geometry data back from our GL mesh buffers.
+		GLboolean read_back_geometry_data();
+		// Move our texcoords and those of our LOD levels into uv_rect, offset in xy and scale in zw,
+		// for drawing from a texture atlas. Texcoords outside 0..1 would wrap into other atlas
+		// images, so nothing is changed and false is returned if there are any, or if the
+		// geometry is shared.
+		GLboolean remap_texcoords(const glm::vec4 &uv_rect);
+		// Get geometry data with the CPU side arrays, reading them back from the GPU if released.
+		// Use this for anything editing or inspecting the vertexes of a GPU resident object.
+		GeometryDataSharedPtr get_cpu_geometry_data() {
+			if (_geometry_data != nullptr && _geometry_data->cpu_released == true) {
+				read_back_geometry_data();
+			}
+			return _geometry_data;
+		}
+
 		void set_geometry_data(const GeometryDataSharedPtr &geometry_data) {
 			_geometry_data = geometry_data;
 		}
@@ -283,12 +366,23 @@ class PSIRenderObj {
 		PSIRenderObj::render_asset _render_asset;
 		// Geometry data for this render obj.
 		GeometryDataSharedPtr _geometry_data;
+		// Registry for shared meshes, if we are sharing.
+		MeshRegistrySharedPtr _mesh_registry;
+		// Are we drawing without per vertex colors ?
+		GLboolean _constant_color = false;
+		// Do we release our CPU side geometry after upload ?
+		GLboolean _gpu_resident = false;
 		// Physics body for this render obj.
 		PSIRenderObj::physics_body _physics_body;
 
 		// Child render objs for this render obj.
 		std::vector<RenderObjSharedPtr> _children;
 
+		// Lower detail levels, from finest to coarsest.
+		std::vector<lod_level> _lods;
+		// Currently drawn LOD level, 0 is the full detail mesh and n is _lods[n - 1].
+		GLint _lod_index = 0;
+
 		// Should this object be tested for depth ?
 		GLboolean _depth_tested = true;
 		// Should this object be translated with the camera ?
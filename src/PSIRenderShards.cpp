@@ -0,0 +1,189 @@
+#include "PSIRenderShards.h"
+#include "PSIFileUtils.h"
+#include "PSIParallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+using namespace std::chrono;
+
+namespace PSIRenderShards {
+
+bool parse_args(int argc, char **argv, shard_range &range) {
+	for (int i = 1; i + 4 < argc; i++) {
+		if (strcmp(argv[i], SHARD_ARG) != 0) {
+			continue;
+		}
+
+		range.index = atoi(argv[i + 1]);
+		range.count = atoi(argv[i + 2]);
+		range.first_frame = atoi(argv[i + 3]);
+		range.frame_count = atoi(argv[i + 4]);
+
+		if (range.index < 0 || range.index >= range.count || range.frame_count <= 0) {
+			psilog_err("Invalid shard arguments");
+			return false;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void apply(const shard_range &range, PSIOfflineRenderer::render_options &options) {
+	options.first_frame = range.first_frame;
+	options.frame_count = range.frame_count;
+	options.manifest_path = get_shard_manifest_path(options, range.index);
+	options.resume_manifest_path = PSIOfflineRenderer::get_manifest_path(options);
+
+	// Share the cores with the other workers instead of each running a full pool.
+	size_t thread_count = PSIParallel::get_thread_count();
+	options.encode_threads = std::max<size_t>(thread_count / range.count, 1);
+}
+
+std::string get_shard_manifest_path(const PSIOfflineRenderer::render_options &options, GLint index) {
+	return options.output_dir + "/" + options.basename + ".shard" + std::to_string(index) + ".manifest";
+}
+
+GLint merge_manifests(const PSIOfflineRenderer::render_options &options, std::set<GLint> &written) {
+	std::string path = PSIOfflineRenderer::get_manifest_path(options);
+	PSIOfflineRenderer::read_manifest(path, options, written);
+
+	// The shard count may have changed since the shard manifests were written.
+	std::vector<std::string> shard_paths;
+	for (GLint i = 0; i < MAX_SHARDS; i++) {
+		std::string shard_path = get_shard_manifest_path(options, i);
+		if (PSIFileUtils::get_modified_time(shard_path) == -1) {
+			continue;
+		}
+
+		PSIOfflineRenderer::read_manifest(shard_path, options, written);
+		shard_paths.push_back(shard_path);
+	}
+
+	if (PSIOfflineRenderer::write_manifest(path, options, written) != 0) {
+		return -1;
+	}
+
+	// Only removed once their frames are in the main manifest.
+	for (const auto &shard_path : shard_paths) {
+		remove(shard_path.c_str());
+	}
+
+	return 0;
+}
+
+GLint run(int argc, char **argv, const PSIOfflineRenderer::render_options &options, GLint process_count) {
+#ifdef _WIN32
+	psilog_err("Rendering in multiple processes is not supported on this platform");
+	return -1;
+#else
+	auto start = steady_clock::now();
+
+	if (options.frame_count <= 0) {
+		psilog_err("No frames to render");
+		return -1;
+	}
+
+	if (process_count <= 0) {
+		process_count = std::max<GLint>(PSIParallel::get_thread_count() / 2, 1);
+	}
+	process_count = std::min(process_count, MAX_SHARDS);
+
+	std::set<GLint> written;
+	if (options.resume == false) {
+		// Shard manifests left by a killed run would be merged as written frames too.
+		remove(PSIOfflineRenderer::get_manifest_path(options).c_str());
+		for (GLint i = 0; i < MAX_SHARDS; i++) {
+			remove(get_shard_manifest_path(options, i).c_str());
+		}
+	}
+	if (merge_manifests(options, written) != 0) {
+		return -1;
+	}
+
+	GLint last_frame = options.first_frame + options.frame_count;
+	std::vector<GLint> remaining;
+	for (GLint frame = options.first_frame; frame < last_frame; frame++) {
+		if (written.count(frame) == 0) {
+			remaining.push_back(frame);
+		}
+	}
+
+	// Split by the frames left to render, so resumed renders stay balanced. The
+	// ranges cover the written frames between them too, the workers skip those.
+	size_t shard_count = std::min<size_t>(process_count, remaining.size());
+	std::vector<pid_t> pids;
+	for (size_t i = 0; i < shard_count; i++) {
+		GLint first = remaining[i * remaining.size() / shard_count];
+		GLint end = i + 1 < shard_count ? remaining[(i + 1) * remaining.size() / shard_count] : last_frame;
+
+		std::vector<std::string> args(argv, argv + argc);
+		args.push_back(SHARD_ARG);
+		args.push_back(std::to_string(i));
+		args.push_back(std::to_string(shard_count));
+		args.push_back(std::to_string(first));
+		args.push_back(std::to_string(end - first));
+
+		std::vector<char *> arg_ptrs;
+		for (auto &arg : args) {
+			arg_ptrs.push_back(&arg[0]);
+		}
+		arg_ptrs.push_back(nullptr);
+
+		pid_t pid;
+		if (posix_spawnp(&pid, argv[0], nullptr, nullptr, arg_ptrs.data(), environ) != 0) {
+			psilog_err("Failed starting worker for frames %d - %d", first, end - 1);
+			continue;
+		}
+
+		psilog(PSILog::EXPORT, "Started worker %d for frames %d - %d", (GLint)i, first, end - 1);
+		pids.push_back(pid);
+	}
+
+	GLint retval = 0;
+	for (pid_t pid : pids) {
+		int status;
+		if (waitpid(pid, &status, 0) == -1 || WIFEXITED(status) == false || WEXITSTATUS(status) != 0) {
+			psilog_err("Worker %d failed", (GLint)pid);
+			retval = -1;
+		}
+	}
+
+	written.clear();
+	if (merge_manifests(options, written) != 0) {
+		return -1;
+	}
+
+	GLint written_count = 0;
+	for (GLint frame : written) {
+		if (frame >= options.first_frame && frame < last_frame) {
+			written_count++;
+		}
+	}
+
+	double seconds = duration<double>(steady_clock::now() - start).count();
+	GLint rendered = written_count - (options.frame_count - (GLint)remaining.size());
+	psilog(PSILog::EXPORT, "Rendered %d frames with %d processes in %.2f s, %.2f fps, %d of %d frames written",
+	       rendered, (GLint)shard_count, seconds, seconds > 0.0 ? rendered / seconds : 0.0,
+	       written_count, options.frame_count);
+
+	if (written_count != options.frame_count) {
+		retval = -1;
+	}
+
+	return retval;
+#endif
+}
+
+} // namespace PSIRenderShards
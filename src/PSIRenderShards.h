@@ -0,0 +1,64 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Splitting an offline render over several local processes. The coordinator
+// starts the same executable once per shard with the shard arguments appended.
+// Each worker renders its own contiguous frame range with its own GL context,
+// seeking to its first frame by elapsed time. The coordinator merges the
+// workers' manifests into the main manifest when they finish.
+//
+// The workers load assets independently. Baked textures and meshes are memory
+// mapped, so the page cache is shared between them, and the shader binary cache
+// is written atomically, so whichever worker links a program first provides it
+// to the rest on later runs.
+//
+// In the application:
+//   PSIRenderShards::shard_range range;
+//   if (PSIRenderShards::parse_args(argc, argv, range) == false) {
+//       return PSIRenderShards::run(argc, argv, options);
+//   }
+//   PSIRenderShards::apply(range, options);
+//   ... create the window and scene, then PSIOfflineRenderer::render() with options.
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIOfflineRenderer.h"
+
+#include <set>
+#include <string>
+
+namespace PSIRenderShards {
+	// Followed by the shard index, shard count, first frame and frame count.
+	static const char *const SHARD_ARG = "--psi-shard";
+	static const GLint MAX_SHARDS = 256;
+
+	// Frames of one worker process.
+	struct shard_range {
+		GLint index = -1;
+		// Worker processes in total.
+		GLint count = 0;
+		GLint first_frame = 0;
+		GLint frame_count = 0;
+	};
+
+	// Returns true in a worker started by run(), with its frames in range.
+	bool parse_args(int argc, char **argv, shard_range &range);
+
+	// Set up options for rendering the shard. Sets its frame range and its share of
+	// the encoder threads. The shard writes its own manifest and resumes from the
+	// merged one.
+	void apply(const shard_range &range, PSIOfflineRenderer::render_options &options);
+
+	std::string get_shard_manifest_path(const PSIOfflineRenderer::render_options &options, GLint index);
+
+	// Merge the shard manifests into the main manifest and delete them. Fills
+	// written with the frames written so far. Returns -1 on failure.
+	GLint merge_manifests(const PSIOfflineRenderer::render_options &options, std::set<GLint> &written);
+
+	// Split the frames not written yet into process_count contiguous ranges and run
+	// a worker for each, then merge the manifests. With process_count 0, runs one
+	// worker per two hardware threads, as each also runs encoder threads. Call before
+	// creating the window, the coordinator needs no GL context. Returns 0 when all
+	// frames in the range are written.
+	GLint run(int argc, char **argv, const PSIOfflineRenderer::render_options &options, GLint process_count = 0);
+} // namespace PSIRenderShards
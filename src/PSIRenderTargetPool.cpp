@@ -0,0 +1,202 @@
+#include "PSIRenderTargetPool.h"
+#include "PSIGLUtils.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// Bytes per sample of the internal formats, for the memory estimates. Drivers pad
+// some formats, RGB8 and DEPTH_COMPONENT24 are usually stored in 4 bytes.
+static size_t get_format_bytes(GLenum format) {
+	switch (format) {
+	case 0:
+		return 0;
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGBA16F:
+	case GL_DEPTH32F_STENCIL8:
+		return 8;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+PSIRenderTarget::~PSIRenderTarget() {
+	// Deleting name 0 is ignored, so the buffers never created are fine here.
+	glDeleteFramebuffers(1, &_fbo);
+	glDeleteRenderbuffers(1, &_color_buffer);
+	glDeleteRenderbuffers(1, &_depth_buffer);
+}
+
+GLint PSIRenderTarget::init() {
+	glm::ivec2 size = _desc.size;
+	bool msaa = _desc.samples > 1;
+
+	glGenFramebuffers(1, &_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+
+	if (msaa == true) {
+		glGenRenderbuffers(1, &_color_buffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, _color_buffer);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, _desc.samples, _desc.color_format, size.x, size.y);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _color_buffer);
+	} else {
+		_texture = PSIGLTexture::create();
+		_texture->gen_texture_id(PSIGLTexture::TexType::TEX_2D);
+		_texture->bind();
+		// The pixel format and type only matter for uploads, there is no data here.
+		glTexImage2D(GL_TEXTURE_2D, 0, _desc.color_format, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		_texture->set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::LINEAR);
+		_texture->set_size(size);
+		_texture->unbind();
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture->get_id(), 0);
+	}
+
+	if (_desc.depth_format != 0) {
+		glGenRenderbuffers(1, &_depth_buffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, _depth_buffer);
+		if (msaa == true) {
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, _desc.samples, _desc.depth_format, size.x, size.y);
+		} else {
+			glRenderbufferStorage(GL_RENDERBUFFER, _desc.depth_format, size.x, size.y);
+		}
+
+		GLenum attachment = GL_DEPTH_ATTACHMENT;
+		if (_desc.depth_format == GL_DEPTH24_STENCIL8 || _desc.depth_format == GL_DEPTH32F_STENCIL8) {
+			attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+		}
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, _depth_buffer);
+	}
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	check_gl_error();
+
+	if (complete == false) {
+		psilog_err("Failed initializing %dx%d render target with %d samples", size.x, size.y, _desc.samples);
+		return -1;
+	}
+
+	psilog(PSILog::OPENGL, "Created render target, fbo=%d (%dx%d), %d sample(s)", _fbo, size.x, size.y,
+	       _desc.samples);
+
+	return 0;
+}
+
+void PSIRenderTarget::bind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glViewport(0, 0, _desc.size.x, _desc.size.y);
+}
+
+GLint PSIRenderTarget::resolve(const RenderTargetSharedPtr &dst) {
+	if (dst == nullptr || dst->get_samples() > 1 || (_desc.samples > 1 && _desc.size != dst->get_size())) {
+		psilog_err("Can only resolve to a single sampled render target of the same size");
+		return -1;
+	}
+
+	GLbitfield mask = GL_COLOR_BUFFER_BIT;
+	if (_desc.depth_format != 0 && _desc.depth_format == dst->get_desc().depth_format) {
+		mask |= GL_DEPTH_BUFFER_BIT;
+	}
+
+	// Depth and multisample blits must not filter, scaled color blits can.
+	GLenum filter = GL_NEAREST;
+	if (mask == GL_COLOR_BUFFER_BIT && _desc.size != dst->get_size()) {
+		filter = GL_LINEAR;
+	}
+
+	glm::ivec2 dst_size = dst->get_size();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, _fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst->get_fbo());
+	glBlitFramebuffer(0, 0, _desc.size.x, _desc.size.y, 0, 0, dst_size.x, dst_size.y, mask, filter);
+
+	// Leave the resolved target bound, as if rendered to directly.
+	glBindFramebuffer(GL_FRAMEBUFFER, dst->get_fbo());
+
+	return 0;
+}
+
+size_t PSIRenderTarget::estimate_bytes(const target_desc &desc) {
+	size_t pixel_bytes = get_format_bytes(desc.color_format) + get_format_bytes(desc.depth_format);
+	return (size_t)desc.size.x * desc.size.y * std::max(desc.samples, 1) * pixel_bytes;
+}
+
+RenderTargetSharedPtr PSIRenderTargetPool::acquire(const PSIRenderTarget::target_desc &desc) {
+	// Only the pool holds the free targets.
+	for (const auto &target : _targets) {
+		if (target.use_count() == 1 && target->get_desc() == desc) {
+			target->_last_used = _frame;
+			return target;
+		}
+	}
+
+	if (desc.size.x <= 0 || desc.size.y <= 0) {
+		psilog_err("Invalid render target size %dx%d", desc.size.x, desc.size.y);
+		return nullptr;
+	}
+
+	RenderTargetSharedPtr target = PSIRenderTarget::create(desc);
+	if (target->init() != 0) {
+		return nullptr;
+	}
+
+	target->_last_used = _frame;
+	_targets.push_back(target);
+
+	return target;
+}
+
+void PSIRenderTargetPool::end_frame() {
+	for (const auto &target : _targets) {
+		if (target.use_count() > 1) {
+			target->_last_used = _frame;
+		}
+	}
+
+	_frame++;
+	if (_frame > (uint64_t)_max_idle_frames) {
+		collect(_frame - _max_idle_frames);
+	}
+}
+
+void PSIRenderTargetPool::trim() {
+	collect(UINT64_MAX);
+}
+
+void PSIRenderTargetPool::clear() {
+	_targets.clear();
+}
+
+size_t PSIRenderTargetPool::get_bytes() {
+	size_t bytes = 0;
+	for (const auto &target : _targets) {
+		bytes += target->get_bytes();
+	}
+
+	return bytes;
+}
+
+void PSIRenderTargetPool::collect(uint64_t frame) {
+	std::vector<RenderTargetSharedPtr> kept;
+	for (auto &target : _targets) {
+		if (target.use_count() > 1 || target->_last_used >= frame) {
+			kept.push_back(std::move(target));
+			continue;
+		}
+
+		glm::ivec2 size = target->get_size();
+		psilog(PSILog::OPENGL, "Deleting unused render target, fbo=%d (%dx%d)", target->get_fbo(), size.x, size.y);
+	}
+
+	// The unused targets are deleted with the old list.
+	_targets.swap(kept);
+}
@@ -0,0 +1,155 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Pool of offscreen render targets, framebuffers with color and depth buffers,
+// handed out by size, formats and sample count. Targets are returned to the
+// pool when the last reference to them is dropped and reused by the next pass
+// asking for the same kind, so passes can acquire their targets every frame
+// without allocating GPU memory. Targets left unused for a few frames, such as
+// ones sized for the viewport before it was resized, are deleted.
+//
+// Single sampled targets render to a texture that can be sampled. Multisampled
+// targets render to renderbuffers, resolve them to a single sampled target with
+// resolve(). Used from the GL thread only.
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIOpenGL.h"
+#include "PSIGLTexture.h"
+
+#include <vector>
+
+class PSIRenderTarget;
+typedef shared_ptr<PSIRenderTarget> RenderTargetSharedPtr;
+
+class PSIRenderTargetPool;
+typedef shared_ptr<PSIRenderTargetPool> RenderTargetPoolSharedPtr;
+
+class PSIRenderTarget {
+	public:
+		struct target_desc {
+			glm::ivec2 size = glm::ivec2(0, 0);
+			// Sized internal format of the color buffer.
+			GLenum color_format = GL_RGBA8;
+			// Sized internal format of the depth buffer, 0 for none.
+			GLenum depth_format = GL_DEPTH_COMPONENT24;
+			// 1 for a single sampled target with a color texture.
+			GLint samples = 1;
+
+			bool operator==(const target_desc &rhs) const {
+				return size == rhs.size && color_format == rhs.color_format &&
+				       depth_format == rhs.depth_format && samples == rhs.samples;
+			}
+		};
+
+		PSIRenderTarget(const target_desc &desc) {
+			_desc = desc;
+		}
+		~PSIRenderTarget();
+
+		// Owns the GL objects, so it is not copyable.
+		PSIRenderTarget(const PSIRenderTarget &rhs) = delete;
+
+		static RenderTargetSharedPtr create(const target_desc &desc) {
+			return make_shared<PSIRenderTarget>(desc);
+		}
+
+		// Create the framebuffer and its buffers. Returns -1 if the framebuffer is not complete.
+		GLint init();
+
+		// Bind the framebuffer for drawing and set the viewport to cover it.
+		void bind();
+
+		// Blit the color, and the depth if both have it, to dst. Multisampled targets
+		// are resolved this way, to a single sampled target of the same size.
+		// Returns -1 if the targets can't be blitted.
+		GLint resolve(const RenderTargetSharedPtr &dst);
+
+		const target_desc &get_desc() {
+			return _desc;
+		}
+		glm::ivec2 get_size() {
+			return _desc.size;
+		}
+		GLint get_samples() {
+			return _desc.samples;
+		}
+		GLuint get_fbo() {
+			return _fbo;
+		}
+		// Color texture of single sampled targets, nullptr for multisampled ones.
+		GLTextureSharedPtr get_texture() {
+			return _texture;
+		}
+		// Color renderbuffer of multisampled targets, 0 for single sampled ones.
+		GLuint get_color_buffer() {
+			return _color_buffer;
+		}
+		GLuint get_depth_buffer() {
+			return _depth_buffer;
+		}
+
+		// Estimated GPU memory used by the buffers.
+		size_t get_bytes() {
+			return estimate_bytes(_desc);
+		}
+		// Estimated GPU memory of a target with desc.
+		static size_t estimate_bytes(const target_desc &desc);
+
+	private:
+		friend class PSIRenderTargetPool;
+
+		target_desc _desc;
+
+		GLuint _fbo = 0;
+		GLTextureSharedPtr _texture;
+		GLuint _color_buffer = 0;
+		GLuint _depth_buffer = 0;
+
+		// Pool frame the target was last held in.
+		uint64_t _last_used = 0;
+};
+
+class PSIRenderTargetPool {
+	public:
+		// Frames an unused target is kept for reuse before it is deleted.
+		static const GLint DEF_MAX_IDLE_FRAMES = 3;
+
+		PSIRenderTargetPool() = default;
+		~PSIRenderTargetPool() = default;
+
+		static RenderTargetPoolSharedPtr create() {
+			return make_shared<PSIRenderTargetPool>();
+		}
+
+		// Get a target not in use by anyone else matching desc, creating it if there
+		// is none. The target goes back to the pool when the returned reference and
+		// its copies are dropped. Returns nullptr if the target can't be created.
+		RenderTargetSharedPtr acquire(const PSIRenderTarget::target_desc &desc);
+
+		// Advance the frame and delete the targets unused for more than the idle frames.
+		// Call once per frame, after rendering.
+		void end_frame();
+		// Delete all targets not in use now, for example after a resize.
+		void trim();
+		// Drop all targets from the pool. Targets still in use are deleted when released.
+		void clear();
+
+		void set_max_idle_frames(GLint frames) {
+			_max_idle_frames = frames;
+		}
+
+		// Targets in the pool, in use or not, and their estimated GPU memory.
+		GLsizei get_count() {
+			return _targets.size();
+		}
+		size_t get_bytes();
+
+	private:
+		// Delete unused targets last used before frame.
+		void collect(uint64_t frame);
+
+		std::vector<RenderTargetSharedPtr> _targets;
+		uint64_t _frame = 0;
+		GLint _max_idle_frames = DEF_MAX_IDLE_FRAMES;
+};
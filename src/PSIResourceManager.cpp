@@ -1,49 +1,450 @@
 #include "PSIResourceManager.h"
+#include "PSIGLTFLoader.h"
+#include "PSIMeshCache.h"
+#include "PSIShaderCache.h"
+#include "PSIShaderPreprocessor.h"
+#include "PSITextureBaker.h"
+#include "PSIHelpers.h"
+#include "PSIRenderObj.h"
+
+#include <algorithm>
+
+const char *const PSIResourceManager::FEATURE_DEFINES[ShaderFeature_COUNT] = {
+	"PSI_LIT",
+	"PSI_TEXTURED",
+	"PSI_TEXTURE_ARRAY",
+	"PSI_WIREFRAME",
+	"PSI_ELAPSED_TIME"
+};
 
 ShaderSharedPtr PSIResourceManager::load_shader(std::string name,
                                                         std::string vert_shader_path,
                                                         std::string frag_shader_path,
                                                         std::string geom_shader_path) {
-	auto shader = PSIGLShader::create();
-	if (shader != nullptr) {
-		shader->set_name(name);
+	shader_sources sources;
+	if (read_shader_sources(vert_shader_path, frag_shader_path, geom_shader_path, sources) == false) {
+		return nullptr;
+	}
+
+	return create_shader(name, sources);
+}
+
+GLboolean PSIResourceManager::read_shader_sources(std::string vert_shader_path, std::string frag_shader_path,
+                                                  std::string geom_shader_path, shader_sources &sources) {
+	// Load vertex shader from file, with its includes.
+	if (PSIShaderPreprocessor::load(vert_shader_path, sources.vert) == false) {
+		fprintf(stderr, "Failed adding vertex shader from path '%s'\n", vert_shader_path.c_str());
+		return false;
+	}
+
+	// Load fragment shader from file.
+	if (PSIShaderPreprocessor::load(frag_shader_path, sources.frag) == false) {
+		fprintf(stderr, "Failed adding fragment shader from path '%s'\n", frag_shader_path.c_str());
+		return false;
+	}
+
+	// Load optional geometry shader from file.
+	if (!geom_shader_path.empty()) {
+		if (PSIShaderPreprocessor::load(geom_shader_path, sources.geom) == false) {
+			fprintf(stderr, "Failed adding geometry shader from path '%s'\n", geom_shader_path.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ShaderSharedPtr PSIResourceManager::create_shader(std::string name, const shader_sources &sources) {
+	return create_shaders({ name }, { sources }).front();
+}
+
+std::vector<ShaderSharedPtr> PSIResourceManager::create_shaders(const std::vector<std::string> &names,
+                                                                const std::vector<shader_sources> &sources) {
+	assert(names.size() == sources.size());
 
+	// Let the driver compile in as many threads as it likes.
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xffffffff);
+	}
+
+	bool use_cache = _shader_cache_dir.empty() == false && PSIShaderCache::is_supported() == true;
+	std::vector<ShaderSharedPtr> shaders(names.size());
+	std::vector<ShaderSharedPtr> linking(names.size());
+	std::vector<std::string> cache_paths(names.size());
+	std::vector<uint64_t> cache_keys(names.size(), 0);
+
+	// Start every compile and link before waiting for any of them.
+	for (size_t i = 0; i < names.size(); i++) {
+		// Try the binary cache first, falling back to compiling if it misses or the driver rejects it.
+		if (use_cache == true) {
+			cache_keys[i] = PSIShaderCache::get_key(sources[i].vert, sources[i].frag, sources[i].geom);
+			cache_paths[i] = PSIShaderCache::get_path(_shader_cache_dir, cache_keys[i]);
+			shaders[i] = PSIShaderCache::load(cache_paths[i], cache_keys[i], names[i]);
+			if (shaders[i] != nullptr) {
+				continue;
+			}
+		}
+
+		auto shader = PSIGLShader::create();
+		shader->set_name(names[i]);
 		if (shader->create_program() == PSIGLShader::ShaderDefs::INVALID_SHADER) {
-			return nullptr;
+			continue;
+		}
+		if (use_cache == true) {
+			shader->set_binary_retrievable(true);
 		}
 
-		// Load vertex shader from file.
-		if (shader->add_from_file(PSIGLShader::ShaderType::VERTEX, vert_shader_path) == false) {
-			fprintf(stderr, "Failed adding vertex shader from path '%s'\n", vert_shader_path.c_str());
-			return nullptr;
+		shader->add_source(PSIGLShader::ShaderType::VERTEX, sources[i].vert);
+		shader->add_source(PSIGLShader::ShaderType::FRAGMENT, sources[i].frag);
+		if (!sources[i].geom.empty()) {
+			shader->add_source(PSIGLShader::ShaderType::GEOMETRY, sources[i].geom);
 		}
+		shader->start_link();
+		linking[i] = shader;
+	}
 
-		// Load fragment shader from file.
-		if (shader->add_from_file(PSIGLShader::ShaderType::FRAGMENT, frag_shader_path) == false) {
-			fprintf(stderr, "Failed adding fragment shader from path '%s'\n", frag_shader_path.c_str());
-			return nullptr;
+	std::vector<size_t> pending;
+	for (size_t i = 0; i < names.size(); i++) {
+		if (linking[i] != nullptr) {
+			pending.push_back(i);
 		}
+	}
 
-		// Load optional geometry shader from file.
-		if (!geom_shader_path.empty()) {
-			if (shader->add_from_file(PSIGLShader::ShaderType::GEOMETRY, geom_shader_path) == false) {
-				fprintf(stderr, "Failed adding geometry shader from path '%s'\n", geom_shader_path.c_str());
-				return nullptr;
-			}
+	// Finish the programs in the order the driver completes them, so querying and caching
+	// one overlaps the links still running. When none is done yet, wait for the first.
+	while (pending.empty() == false) {
+		auto done = std::find_if(pending.begin(), pending.end(), [&linking](size_t i) {
+			return linking[i]->is_link_complete() == true;
+		});
+		if (done == pending.end()) {
+			done = pending.begin();
 		}
+		size_t i = *done;
+		pending.erase(done);
 
-		// Compile shader.
-		if (shader->compile() == PSIGLShader::ShaderDefs::INVALID_SHADER) {
-			fprintf(stderr, "Failed compiling shader '%s'\n", name.c_str());
-			return nullptr;
+		if (linking[i]->finish_link() == PSIGLShader::ShaderDefs::INVALID_SHADER) {
+			fprintf(stderr, "Failed compiling shader '%s'\n", names[i].c_str());
+			glDeleteProgram(linking[i]->get_program());
+			continue;
 		}
 
 		// Add our uniform locations from the active variables.
-		shader->add_uniforms();
+		linking[i]->add_uniforms();
+
+		if (use_cache == true) {
+			PSIShaderCache::write(cache_paths[i], cache_keys[i], linking[i]);
+		}
+		shaders[i] = linking[i];
+	}
+
+	// Add to our shader collection.
+	for (size_t i = 0; i < names.size(); i++) {
+		if (shaders[i] != nullptr) {
+			_shaders[names[i]] = shaders[i];
+		}
+	}
+
+	return shaders;
+}
+
+GLboolean PSIResourceManager::add_shader_variants(std::string name, std::string vert_shader_path,
+                                                  std::string frag_shader_path, std::string geom_shader_path) {
+	variant_sources variant;
+	if (read_shader_sources(vert_shader_path, frag_shader_path, geom_shader_path, variant.sources) == false) {
+		return false;
+	}
+
+	variant.hash = fnv1a_64(variant.sources.vert.data(), variant.sources.vert.size());
+	variant.hash = fnv1a_64(variant.sources.frag.data(), variant.sources.frag.size(), variant.hash);
+	variant.hash = fnv1a_64(variant.sources.geom.data(), variant.sources.geom.size(), variant.hash);
+	_variant_sources[name] = variant;
+
+	return true;
+}
+
+PSIResourceManager::shader_sources PSIResourceManager::get_variant_sources(const shader_sources &sources,
+                                                                           GLint features) {
+	std::vector<std::string> defines;
+	for (GLint i = 0; i < ShaderFeature_COUNT; i++) {
+		if (features & (1 << i)) {
+			defines.push_back(FEATURE_DEFINES[i]);
+		}
+	}
+
+	shader_sources variant;
+	variant.vert = PSIShaderPreprocessor::add_defines(sources.vert, defines);
+	variant.frag = PSIShaderPreprocessor::add_defines(sources.frag, defines);
+	if (!sources.geom.empty()) {
+		variant.geom = PSIShaderPreprocessor::add_defines(sources.geom, defines);
+	}
+
+	return variant;
+}
+
+std::string PSIResourceManager::get_variant_name(const std::string &name, GLint features) {
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), "#%x", features);
+
+	return name + suffix;
+}
+
+ShaderSharedPtr PSIResourceManager::get_shader_variant(std::string name, GLint features) {
+	auto sources = _variant_sources.find(name);
+	if (sources == _variant_sources.end()) {
+		psilog_err("No shader variants added with name '%s'", name.c_str());
+		return nullptr;
+	}
+
+	auto variant = _variants.find(std::make_pair(sources->second.hash, features));
+	if (variant != _variants.end()) {
+		return variant->second;
+	}
+
+	psilog(PSILog::LOAD, "Compiling shader variant '%s' on demand", get_variant_name(name, features).c_str());
+	compile_shader_variants(name, { features });
+
+	variant = _variants.find(std::make_pair(sources->second.hash, features));
+	return (variant != _variants.end()) ? variant->second : nullptr;
+}
+
+GLint PSIResourceManager::compile_shader_variants(std::string name, const std::vector<GLint> &feature_sets) {
+	auto sources = _variant_sources.find(name);
+	if (sources == _variant_sources.end()) {
+		psilog_err("No shader variants added with name '%s'", name.c_str());
+		return 0;
+	}
+
+	uint64_t hash = sources->second.hash;
+	std::vector<std::string> names;
+	std::vector<shader_sources> variant_sources;
+	std::vector<GLint> variant_features;
+	for (GLint features : feature_sets) {
+		if (_variants.count(std::make_pair(hash, features)) > 0 ||
+		    std::find(variant_features.begin(), variant_features.end(), features) != variant_features.end()) {
+			continue;
+		}
+		names.push_back(get_variant_name(name, features));
+		variant_sources.push_back(get_variant_sources(sources->second.sources, features));
+		variant_features.push_back(features);
+	}
 
-		// Add to our shader collection.
-		_shaders[name] = shader;
+	std::vector<ShaderSharedPtr> shaders = create_shaders(names, variant_sources);
+	GLint compiled = 0;
+	for (size_t i = 0; i < shaders.size(); i++) {
+		if (shaders[i] != nullptr) {
+			_variants[std::make_pair(hash, variant_features[i])] = shaders[i];
+			compiled++;
+		}
+	}
+
+	return compiled;
+}
+
+GLint PSIResourceManager::get_shader_features(const GLMaterialSharedPtr &material, GLint modules) {
+	GLint features = ShaderFeature::FEATURE_NONE;
+	if (material->is_lit() == true) {
+		features |= ShaderFeature::FEATURE_LIT;
+	}
+	if (material->get_texture() != nullptr) {
+		features |= ShaderFeature::FEATURE_TEXTURED;
+		if (material->get_texture_layer() >= 0) {
+			features |= ShaderFeature::FEATURE_TEXTURE_ARRAY;
+		}
+	}
+	if (material->get_wireframe() == true) {
+		features |= ShaderFeature::FEATURE_WIREFRAME;
+	}
+	if (modules & PSIRenderObj::ModulesType::MODULES_ELAPSED_TIME) {
+		features |= ShaderFeature::FEATURE_ELAPSED_TIME;
+	}
+
+	return features;
+}
+
+// Does path end with extension ?
+static bool has_extension(const std::string &path, const std::string &extension) {
+	return path.size() >= extension.size() &&
+	       path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+PSIResourceManager::TextureHandle PSIResourceManager::load_texture(const std::string &path) {
+	TextureHandle handle = _textures.acquire(path);
+	if (handle.is_valid() == true) {
+		return handle;
+	}
+
+	GLTextureSharedPtr texture;
+	size_t bytes = 0;
+	if (has_extension(path, ".psitex") == true) {
+		// Baked levels are uploaded as they are in the file.
+		PSIFileUtils::MappedFileSharedPtr file = PSITextureBaker::open(path);
+		if (file != nullptr) {
+			texture = PSITextureBaker::upload(file);
+			bytes = file->size;
+		}
+	} else {
+		PSIGLTexture::image_data image;
+		if (PSIGLTexture::decode_image(path, image) == true) {
+			PSIGLTexture::gen_cpu_mipmaps(image);
+			texture = PSIGLTexture::create();
+			texture->upload_image(image);
+
+			bytes = (size_t)image.width * image.height * image.channels;
+			for (const auto &level : image.mipmaps) {
+				bytes += level.pixels.size();
+			}
+		}
+	}
+
+	if (texture == nullptr) {
+		psilog_err("Failed loading texture '%s'", path.c_str());
+		return TextureHandle();
+	}
+
+	return _textures.add(path, texture, bytes);
+}
+
+PSIResourceManager::MeshHandle PSIResourceManager::load_mesh(const std::string &path,
+                                                             const ShaderSharedPtr &shader) {
+	// Named attribute locations depend on the program.
+	std::string key = path + "@" + shader->get_name();
+	MeshHandle handle = _meshes.acquire(key);
+	if (handle.is_valid() == true) {
+		return handle;
+	}
+
+	GLMeshSharedPtr mesh;
+	if (has_extension(path, ".psimesh") == true) {
+		mesh = PSIMeshCache::load_gl_mesh(path, shader->get_program()).mesh;
+	} else {
+		PSIGLTFLoader loader;
+		mesh = loader.load_gl_mesh(shader, path);
+	}
+
+	if (mesh == nullptr) {
+		psilog_err("Failed loading mesh '%s'", path.c_str());
+		return MeshHandle();
+	}
+
+	return _meshes.add(key, mesh, mesh->get_buffer_bytes());
+}
+
+PSIResourceManager::FontHandle PSIResourceManager::load_font(const std::string &path, GLint font_size,
+                                                             const std::string &charset, glm::vec2 atlas_size) {
+	std::string key = path + "@" + std::to_string(font_size);
+	FontHandle handle = _fonts.acquire(key);
+	if (handle.is_valid() == true) {
+		return handle;
+	}
+
+	FontAtlasSharedPtr font = PSIFontAtlas::create();
+	font->set_font_path(path);
+	font->set_font_size(font_size);
+	font->set_charset(charset);
+	font->set_size(atlas_size);
+	if (font->init() == false) {
+		return FontHandle();
+	}
+
+	// Atlases are RGB.
+	return _fonts.add(key, font, (size_t)atlas_size.x * atlas_size.y * 3);
+}
+
+size_t PSIResourceManager::get_memory_usage(GLint type) {
+	switch (type) {
+	case ResourceType::TEXTURE:
+		return _textures.get_bytes();
+	case ResourceType::MESH:
+		return _meshes.get_bytes();
+	case ResourceType::FONT:
+		return _fonts.get_bytes();
+	}
+
+	return 0;
+}
+
+size_t PSIResourceManager::evict(const std::vector<GLint> &types, size_t budget) {
+	size_t usage = 0;
+	for (GLint type : types) {
+		usage += get_memory_usage(type);
+	}
+	if (usage <= budget) {
+		return 0;
+	}
+
+	// Unused resources of all the types, in one least recently used order.
+	struct candidate {
+		GLint type;
+		GLuint index;
+		GLuint generation;
+		uint64_t last_used;
+	};
+	std::vector<candidate> candidates;
+	for (GLint type : types) {
+		auto add_candidates = [&](auto &pool) {
+			typedef typename std::remove_reference<decltype(pool)>::type::eviction_candidate pool_candidate;
+			std::vector<pool_candidate> pool_candidates;
+			pool.get_eviction_candidates(pool_candidates);
+			for (const auto &c : pool_candidates) {
+				candidates.push_back({ type, c.resource.index, c.resource.generation, c.last_used });
+			}
+		};
+		switch (type) {
+		case ResourceType::TEXTURE:
+			add_candidates(_textures);
+			break;
+		case ResourceType::MESH:
+			add_candidates(_meshes);
+			break;
+		case ResourceType::FONT:
+			add_candidates(_fonts);
+			break;
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const candidate &a, const candidate &b) {
+		return a.last_used < b.last_used;
+	});
+
+	size_t freed = 0;
+	for (const auto &c : candidates) {
+		if (usage - freed <= budget) {
+			break;
+		}
+		switch (c.type) {
+		case ResourceType::TEXTURE:
+			freed += _textures.evict({ c.index, c.generation });
+			break;
+		case ResourceType::MESH:
+			freed += _meshes.evict({ c.index, c.generation });
+			break;
+		case ResourceType::FONT:
+			freed += _fonts.evict({ c.index, c.generation });
+			break;
+		}
+	}
+
+	if (freed > 0) {
+		psilog(PSILog::LOAD, "Evicted %zu bytes of unused resources, %zu bytes over budget left",
+		       freed, (usage - freed > budget) ? usage - freed - budget : 0);
+	}
+
+	return freed;
+}
+
+void PSIResourceManager::update() {
+	_frame++;
+	_textures.set_clock(_frame);
+	_meshes.set_clock(_frame);
+	_fonts.set_clock(_frame);
+
+	if (_vram_budget > 0) {
+		evict({ ResourceType::TEXTURE, ResourceType::MESH }, _vram_budget);
+	}
+	if (_ram_budget > 0) {
+		evict({ ResourceType::FONT }, _ram_budget);
 	}
+}
 
-	return shader;
-}
\ No newline at end of file
+size_t PSIResourceManager::evict_unused() {
+	return evict({ ResourceType::TEXTURE, ResourceType::MESH, ResourceType::FONT }, 0);
+}
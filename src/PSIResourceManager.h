@@ -1,6 +1,10 @@
 // PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
 //
-// Resource loading. Currently only loads and holds shaders.
+// Resource loading. Holds shaders by name, with variants of shared sources
+// compiled per feature set, and textures, meshes and fonts in
+// pools with generational handles. Loads are deduplicated by path, and pooled
+// resources no one uses any more are evicted least recently used first when
+// over the VRAM or RAM budget.
 
 #pragma once
 
@@ -9,23 +13,194 @@
 
 #include "PSIGlobals.h"
 #include "PSIGLShader.h"
+#include "PSIGLMaterial.h"
+#include "PSIGLTexture.h"
+#include "PSIGLMesh.h"
+#include "PSITextRenderer.h"
+#include "PSIResourcePool.h"
 #include "PSIMath.h"
 
 class PSIResourceManager {
 	public:
+		// Shader source code, geom is empty without a geometry shader.
+		struct shader_sources {
+			std::string vert;
+			std::string frag;
+			std::string geom;
+		};
+
+		// Pooled resource types, for memory accounting.
+		enum ResourceType {
+			TEXTURE = 0,
+			MESH,
+			FONT,
+			ResourceType_MAX = FONT
+		};
+
+		// Shader variant features. Each feature defines a macro, from FEATURE_DEFINES, in the
+		// variant sources.
+		enum ShaderFeature {
+			FEATURE_NONE = 0,
+			FEATURE_LIT = 0x1,
+			FEATURE_TEXTURED = 0x2,
+			FEATURE_TEXTURE_ARRAY = 0x4,
+			FEATURE_WIREFRAME = 0x8,
+			FEATURE_ELAPSED_TIME = 0x10,
+			ShaderFeature_COUNT = 5
+		};
+		static const char *const FEATURE_DEFINES[ShaderFeature_COUNT];
+
+		typedef PSIResourcePool<PSIGLTexture>::handle TextureHandle;
+		typedef PSIResourcePool<PSIGLMesh>::handle MeshHandle;
+		typedef PSIResourcePool<PSIFontAtlas>::handle FontHandle;
+
 		PSIResourceManager() = default;
 		~PSIResourceManager() = default;
 
 		// Load shader from vertex, fragment and optional geometry shader files.
 		ShaderSharedPtr load_shader(std::string name, std::string vert_shader_path,
 		                                    std::string frag_shader_path, std::string geom_shader_path = "");
+		// Read shader sources from files. Does not touch GL, so it can be run on any thread.
+		static GLboolean read_shader_sources(std::string vert_shader_path, std::string frag_shader_path,
+		                                     std::string geom_shader_path, shader_sources &sources);
+		// Compile shader from sources and add it with name.
+		ShaderSharedPtr create_shader(std::string name, const shader_sources &sources);
+		// Compile shaders from sources and add them with names. All programs are compiled and
+		// linked before waiting for any of them, so drivers with parallel shader compile build
+		// them at the same time. Failed shaders are nullptr.
+		std::vector<ShaderSharedPtr> create_shaders(const std::vector<std::string> &names,
+		                                            const std::vector<shader_sources> &sources);
+
+		// Read shader sources to compile variants of with name. Variants are added as shaders
+		// named "name#features".
+		GLboolean add_shader_variants(std::string name, std::string vert_shader_path, std::string frag_shader_path,
+		                              std::string geom_shader_path = "");
+		// Get variant of shader name with features, compiling it if needed.
+		ShaderSharedPtr get_shader_variant(std::string name, GLint features);
+		// Compile the variants of shader name with each of feature_sets at once, like on startup
+		// to avoid compiling them when first drawn. Returns the number of variants compiled.
+		GLint compile_shader_variants(std::string name, const std::vector<GLint> &feature_sets);
+		// Features for drawing with material, and render object modules.
+		static GLint get_shader_features(const GLMaterialSharedPtr &material, GLint modules);
+		// Directory for caching linked shader program binaries, which are then loaded instead of
+		// compiling the shader. Empty, the default, disables the cache.
+		void set_shader_cache_dir(std::string shader_cache_dir) {
+			_shader_cache_dir = shader_cache_dir;
+		}
+		std::string get_shader_cache_dir() {
+			return _shader_cache_dir;
+		}
 		// Get shader with name.
 		ShaderSharedPtr get_shader(std::string name) {
 			assert(_shaders.count(name) > 0);
 			return _shaders[name];
 		}
 
+		// Load texture from an image or a baked .psitex file, or add a reference to it if
+		// already loaded. Invalid handle on failure.
+		TextureHandle load_texture(const std::string &path);
+		// Load GL mesh from a .psimesh cache or the first mesh of a glTF file, with named
+		// attributes from shader.
+		MeshHandle load_mesh(const std::string &path, const ShaderSharedPtr &shader);
+		// Load font with font_size pixel glyphs of charset into an atlas of atlas_size.
+		FontHandle load_font(const std::string &path, GLint font_size, const std::string &charset,
+		                     glm::vec2 atlas_size);
+
+		// Resources of stale handles, evicted or released, are nullptr. Getting marks the
+		// resource used, for the eviction order.
+		GLTextureSharedPtr get_texture(const TextureHandle &handle) {
+			return _textures.get(handle);
+		}
+		GLMeshSharedPtr get_mesh(const MeshHandle &handle) {
+			return _meshes.get(handle);
+		}
+		FontAtlasSharedPtr get_font(const FontHandle &handle) {
+			return _fonts.get(handle);
+		}
+
+		// Drop a reference from a load. Resources without references that are not held
+		// anywhere else, like in a material, can be evicted.
+		void release(const TextureHandle &handle) {
+			_textures.release(handle);
+		}
+		void release(const MeshHandle &handle) {
+			_meshes.release(handle);
+		}
+		void release(const FontHandle &handle) {
+			_fonts.release(handle);
+		}
+
+		// Pools, for adding resources created elsewhere and reference counting.
+		PSIResourcePool<PSIGLTexture>& get_textures() {
+			return _textures;
+		}
+		PSIResourcePool<PSIGLMesh>& get_meshes() {
+			return _meshes;
+		}
+		PSIResourcePool<PSIFontAtlas>& get_fonts() {
+			return _fonts;
+		}
+
+		// Budgets for GPU resources, textures and meshes, and CPU resources, fonts.
+		// 0 means unlimited.
+		void set_vram_budget(size_t bytes) {
+			_vram_budget = bytes;
+		}
+		size_t get_vram_budget() {
+			return _vram_budget;
+		}
+		void set_ram_budget(size_t bytes) {
+			_ram_budget = bytes;
+		}
+		size_t get_ram_budget() {
+			return _ram_budget;
+		}
+
+		// Bytes used by resources of type.
+		size_t get_memory_usage(GLint type);
+		size_t get_vram_usage() {
+			return get_memory_usage(ResourceType::TEXTURE) + get_memory_usage(ResourceType::MESH);
+		}
+		size_t get_ram_usage() {
+			return get_memory_usage(ResourceType::FONT);
+		}
+
+		// Advance the use clock and evict unused resources until within the budgets.
+		// Call once per frame.
+		void update();
+		// Evict every unused resource, returns the bytes freed.
+		size_t evict_unused();
+
 	private:
+		// Evict unused resources of types, least recently used first, until they use at most
+		// budget bytes. Returns the bytes freed.
+		size_t evict(const std::vector<GLint> &types, size_t budget);
+
 		// Collection of shaders, mapped by name.
 		std::unordered_map <std::string, ShaderSharedPtr> _shaders;
+		// Shader binary cache directory, empty when not caching.
+		std::string _shader_cache_dir;
+
+		// Sources of a shader with variants.
+		struct variant_sources {
+			shader_sources sources;
+			uint64_t hash;
+		};
+		// Variant sources, mapped by shader name.
+		std::unordered_map<std::string, variant_sources> _variant_sources;
+		// Compiled variants, by source hash and features.
+		std::map<std::pair<uint64_t, GLint>, ShaderSharedPtr> _variants;
+
+		// Sources of the variant of shader with features.
+		static shader_sources get_variant_sources(const shader_sources &sources, GLint features);
+		static std::string get_variant_name(const std::string &name, GLint features);
+
+		PSIResourcePool<PSIGLTexture> _textures;
+		PSIResourcePool<PSIGLMesh> _meshes;
+		PSIResourcePool<PSIFontAtlas> _fonts;
+
+		size_t _vram_budget = 0;
+		size_t _ram_budget = 0;
+		// Frames updated, the time stamp of resource use.
+		uint64_t _frame = 0;
 };
@@ -0,0 +1,184 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Pool of loaded resources of one type, addressed with generational handles.
+// Loads are deduplicated by key, and resources no one references any more can
+// be evicted, least recently used first. Used from the GL thread only.
+
+#pragma once
+
+#include "PSIGlobals.h"
+
+template <typename Type>
+class PSIResourcePool {
+	public:
+		typedef shared_ptr<Type> ResourceSharedPtr;
+
+		// Handle to a pool slot. The slot generation changes when its resource is evicted,
+		// so stale handles get nothing instead of whatever reuses the slot.
+		struct handle {
+			GLuint index = 0;
+			GLuint generation = 0;
+
+			bool is_valid() const {
+				return generation != 0;
+			}
+			bool operator==(const handle &rhs) const {
+				return index == rhs.index && generation == rhs.generation;
+			}
+			bool operator!=(const handle &rhs) const {
+				return !(*this == rhs);
+			}
+		};
+
+		// Unreferenced resource that can be evicted.
+		struct eviction_candidate {
+			handle resource;
+			uint64_t last_used;
+			size_t bytes;
+		};
+
+		PSIResourcePool() = default;
+		~PSIResourcePool() = default;
+
+		// Add resource with key and one reference.
+		handle add(const std::string &key, const ResourceSharedPtr &resource, size_t bytes) {
+			GLuint index;
+			if (_free_slots.empty() == false) {
+				index = _free_slots.back();
+				_free_slots.pop_back();
+			} else {
+				index = _slots.size();
+				_slots.push_back(slot());
+			}
+
+			slot &s = _slots[index];
+			s.resource = resource;
+			s.key = key;
+			s.bytes = bytes;
+			s.refs = 1;
+			s.last_used = _clock;
+			_keys[key] = index;
+			_bytes += bytes;
+
+			return { index, s.generation };
+		}
+
+		// Find resource loaded with key, adding a reference. Invalid handle if not loaded.
+		handle acquire(const std::string &key) {
+			auto it = _keys.find(key);
+			if (it == _keys.end()) {
+				return handle();
+			}
+
+			slot &s = _slots[it->second];
+			s.refs++;
+			s.last_used = _clock;
+
+			return { it->second, s.generation };
+		}
+
+		void add_ref(const handle &h) {
+			slot *s = get_slot(h);
+			if (s != nullptr) {
+				s->refs++;
+			}
+		}
+		// Drop a reference. The resource stays loaded until evicted.
+		void release(const handle &h) {
+			slot *s = get_slot(h);
+			if (s != nullptr && s->refs > 0) {
+				s->refs--;
+			}
+		}
+
+		// Get resource and mark it used, nullptr for stale handles.
+		ResourceSharedPtr get(const handle &h) {
+			slot *s = get_slot(h);
+			if (s == nullptr) {
+				return nullptr;
+			}
+
+			s->last_used = _clock;
+			return s->resource;
+		}
+
+		GLint get_ref_count(const handle &h) {
+			slot *s = get_slot(h);
+			return (s != nullptr) ? s->refs : 0;
+		}
+
+		// Bytes used by the loaded resources.
+		size_t get_bytes() {
+			return _bytes;
+		}
+		GLsizei get_count() {
+			return _keys.size();
+		}
+
+		// Time stamp for marking resources used, usually the frame number.
+		void set_clock(uint64_t clock) {
+			_clock = clock;
+		}
+
+		// Add resources without handle references, that no one else holds either.
+		void get_eviction_candidates(std::vector<eviction_candidate> &candidates) {
+			for (GLuint i = 0; i < _slots.size(); i++) {
+				const slot &s = _slots[i];
+				if (s.resource != nullptr && s.refs == 0 && s.resource.use_count() == 1) {
+					candidates.push_back({ { i, s.generation }, s.last_used, s.bytes });
+				}
+			}
+		}
+
+		// Drop resource from the pool, returns the bytes freed.
+		size_t evict(const handle &h) {
+			slot *s = get_slot(h);
+			if (s == nullptr) {
+				return 0;
+			}
+
+			size_t bytes = s->bytes;
+			_keys.erase(s->key);
+			_bytes -= bytes;
+			*s = slot(s->generation + 1);
+			_free_slots.push_back(h.index);
+
+			return bytes;
+		}
+
+		// Drop all resources, invalidating every handle.
+		void clear() {
+			for (GLuint i = 0; i < _slots.size(); i++) {
+				evict({ i, _slots[i].generation });
+			}
+		}
+
+	private:
+		struct slot {
+			slot(GLuint generation = 1) : generation((generation == 0) ? 1 : generation) {}
+
+			ResourceSharedPtr resource;
+			std::string key;
+			size_t bytes = 0;
+			// Generation 0 is reserved for invalid handles.
+			GLuint generation;
+			GLint refs = 0;
+			uint64_t last_used = 0;
+		};
+
+		slot *get_slot(const handle &h) {
+			if (h.index >= _slots.size() || _slots[h.index].generation != h.generation ||
+			    _slots[h.index].resource == nullptr) {
+				return nullptr;
+			}
+			return &_slots[h.index];
+		}
+
+		std::vector<slot> _slots;
+		// Evicted slots to reuse.
+		std::vector<GLuint> _free_slots;
+		// Slot of each loaded key.
+		std::unordered_map<std::string, GLuint> _keys;
+		size_t _bytes = 0;
+		uint64_t _clock = 0;
+};
@@ -0,0 +1,171 @@
+#include "PSIShaderCache.h"
+#include "PSIHelpers.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace PSIShaderCache {
+
+static_assert(sizeof(file_header) == 40, "Shader cache header layout changed");
+static_assert(sizeof(uniform_entry) == 16, "Shader cache uniform entry layout changed");
+
+static uint64_t hash_string(const char *str, uint64_t seed) {
+	// Hash the size too, so text moving between the strings changes the key.
+	uint64_t size = (str != nullptr) ? strlen(str) : 0;
+	seed = fnv1a_64(&size, sizeof(size), seed);
+	return (size == 0) ? seed : fnv1a_64(str, size, seed);
+}
+
+bool is_supported() {
+	GLint format_count = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+
+	return format_count > 0;
+}
+
+uint64_t get_key(const std::string &vert, const std::string &frag, const std::string &geom) {
+	uint64_t key = fnv1a_64(&VERSION, sizeof(VERSION));
+	key = hash_string(vert.c_str(), key);
+	key = hash_string(frag.c_str(), key);
+	key = hash_string(geom.c_str(), key);
+	key = hash_string((const char *)glGetString(GL_VENDOR), key);
+	key = hash_string((const char *)glGetString(GL_RENDERER), key);
+	key = hash_string((const char *)glGetString(GL_VERSION), key);
+
+	return key;
+}
+
+std::string get_path(const std::string &cache_dir, uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+
+	return cache_dir + "/" + name + EXTENSION;
+}
+
+bool write(const std::string &path, uint64_t key, const ShaderSharedPtr &shader) {
+	GLenum binary_format = 0;
+	std::vector<unsigned char> binary;
+	if (shader->get_binary(binary_format, binary) == false) {
+		psilog(PSILog::EXPORT, "No program binary for shader '%s', not caching", shader->get_name().c_str());
+		return false;
+	}
+
+	std::vector<uniform_entry> uniforms;
+	std::string names;
+	for (const auto &uniform : shader->get_uniforms()) {
+		uniform_entry entry = {};
+		entry.name_offset = names.size();
+		entry.name_size = uniform.first.size();
+		entry.location = (int32_t)uniform.second;
+		uniforms.push_back(entry);
+		names += uniform.first;
+	}
+
+	file_header header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.key = key;
+	header.binary_format = binary_format;
+	header.binary_size = binary.size();
+	header.uniform_count = uniforms.size();
+	header.names_size = names.size();
+	header.file_size = sizeof(file_header) + uniforms.size() * sizeof(uniform_entry) + names.size() + binary.size();
+
+	std::string tmp_path = path + ".tmp";
+	FILE *fp = fopen(tmp_path.c_str(), "wb");
+	if (fp == NULL) {
+		psilog_err("Failed opening shader cache '%s' for writing", tmp_path.c_str());
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (ok && uniforms.empty() == false) {
+		ok = fwrite(uniforms.data(), sizeof(uniform_entry), uniforms.size(), fp) == uniforms.size();
+	}
+	if (ok && names.empty() == false) {
+		ok = fwrite(names.data(), 1, names.size(), fp) == names.size();
+	}
+	if (ok) {
+		ok = fwrite(binary.data(), 1, binary.size(), fp) == binary.size();
+	}
+
+	ok = (fclose(fp) == 0) && ok;
+	if (ok == false || rename(tmp_path.c_str(), path.c_str()) != 0) {
+		psilog_err("Failed writing shader cache '%s'", path.c_str());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+	psilog(PSILog::EXPORT, "Wrote shader cache '%s', %d uniforms, %llu bytes", path.c_str(),
+	       header.uniform_count, (unsigned long long)header.file_size);
+
+	return true;
+}
+
+// Check the tables and names against the mapped file size.
+static bool validate(const std::string &path, const PSIFileUtils::MappedFileSharedPtr &file, uint64_t key) {
+	if (file->size < sizeof(file_header)) {
+		psilog_err("Shader cache '%s' is too small", path.c_str());
+		return false;
+	}
+
+	const file_header *header = reinterpret_cast<const file_header *>(file->data);
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION || header->key != key) {
+		psilog(PSILog::LOAD, "Shader cache '%s' has unknown format, version or key", path.c_str());
+		return false;
+	}
+
+	uint64_t size = sizeof(file_header) + (uint64_t)header->uniform_count * sizeof(uniform_entry) +
+	                header->names_size + header->binary_size;
+	if (header->file_size != file->size || size != file->size || header->binary_size == 0) {
+		psilog_err("Shader cache '%s' is truncated or corrupted", path.c_str());
+		return false;
+	}
+
+	const uniform_entry *uniforms = reinterpret_cast<const uniform_entry *>(file->data + sizeof(file_header));
+	for (uint32_t i = 0; i < header->uniform_count; i++) {
+		if (uniforms[i].name_offset > header->names_size ||
+		    uniforms[i].name_size > header->names_size - uniforms[i].name_offset) {
+			psilog_err("Shader cache '%s' has an invalid uniform %d", path.c_str(), i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ShaderSharedPtr load(const std::string &path, uint64_t key, const std::string &name) {
+	auto file = PSIFileUtils::map_file(path);
+	if (file == nullptr || validate(path, file, key) == false) {
+		return nullptr;
+	}
+
+	const file_header *header = reinterpret_cast<const file_header *>(file->data);
+	const uniform_entry *uniform_entries = reinterpret_cast<const uniform_entry *>(file->data + sizeof(file_header));
+	const char *names = reinterpret_cast<const char *>(uniform_entries + header->uniform_count);
+	const unsigned char *binary = reinterpret_cast<const unsigned char *>(names + header->names_size);
+
+	auto shader = PSIGLShader::create();
+	shader->set_name(name);
+	if (shader->create_program() == PSIGLShader::ShaderDefs::INVALID_SHADER) {
+		return nullptr;
+	}
+
+	if (shader->load_binary(header->binary_format, binary, header->binary_size) == false) {
+		glDeleteProgram(shader->get_program());
+		return nullptr;
+	}
+
+	std::unordered_map<std::string, GLuint> uniforms;
+	for (uint32_t i = 0; i < header->uniform_count; i++) {
+		uniforms[std::string(names + uniform_entries[i].name_offset, uniform_entries[i].name_size)] =
+			(GLuint)uniform_entries[i].location;
+	}
+	shader->set_uniforms(uniforms);
+
+	psilog(PSILog::LOAD, "Loaded shader '%s' from cache '%s'", name.c_str(), path.c_str());
+
+	return shader;
+}
+
+} // namespace PSIShaderCache
@@ -0,0 +1,57 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Shader program binary cache. Stores linked program binaries with their
+// uniform locations, keyed by a hash of the shader sources and the GL driver,
+// so later launches skip compiling and linking.
+//
+// File layout, little endian:
+//   file_header
+//   uniform_entry[uniform_count]
+//   uniform names, not null terminated
+//   program binary
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIGLShader.h"
+
+namespace PSIShaderCache {
+	static const char MAGIC[4] = { 'P', 'S', 'I', 'S' };
+	// Bump when the layout changes, older files are then rejected.
+	static const uint32_t VERSION = 1;
+	static const char *const EXTENSION = ".psishader";
+
+	struct file_header {
+		char magic[4];
+		uint32_t version;
+		// Key of the sources and driver the binary was built with.
+		uint64_t key;
+		uint32_t binary_format;
+		uint32_t binary_size;
+		uint32_t uniform_count;
+		uint32_t names_size;
+		uint64_t file_size;
+	};
+
+	struct uniform_entry {
+		uint32_t name_offset;
+		uint32_t name_size;
+		int32_t location;
+		uint32_t reserved;
+	};
+
+	// Does the driver support program binaries at all ?
+	bool is_supported();
+	// Key of shader sources for the current GL driver. Binaries are only valid for the driver,
+	// so its vendor, renderer and version strings are part of the key.
+	uint64_t get_key(const std::string &vert, const std::string &frag, const std::string &geom);
+	// Cache file path for key in cache_dir.
+	std::string get_path(const std::string &cache_dir, uint64_t key);
+
+	// Write the binary and uniforms of a linked shader to path. The shader needs to have been
+	// compiled with set_binary_retrievable. Written next to path first and moved in place.
+	bool write(const std::string &path, uint64_t key, const ShaderSharedPtr &shader);
+	// Create shader with name from the cached binary at path. Returns nullptr if the file is
+	// missing, broken, for another key, or if the driver rejects the binary.
+	ShaderSharedPtr load(const std::string &path, uint64_t key, const std::string &name);
+} // namespace PSIShaderCache
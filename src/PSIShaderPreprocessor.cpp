@@ -0,0 +1,123 @@
+#include "PSIShaderPreprocessor.h"
+#include "PSIFileUtils.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace PSIShaderPreprocessor {
+
+// Directory part of path, with the trailing slash.
+static std::string get_directory(const std::string &path) {
+	size_t slash = path.find_last_of("/\\");
+	return (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+}
+
+// Included file name if line is an #include "file" directive, empty if not.
+static std::string get_include(const std::string &line) {
+	size_t start = line.find_first_not_of(" \t");
+	if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+		return "";
+	}
+
+	size_t open = line.find('"', start + 8);
+	size_t close = (open == std::string::npos) ? std::string::npos : line.find('"', open + 1);
+	if (close == std::string::npos) {
+		return "";
+	}
+
+	return line.substr(open + 1, close - open - 1);
+}
+
+static GLboolean expand(const std::string &path, std::vector<std::string> &files, std::vector<std::string> &stack,
+                        std::string &out) {
+	if (std::find(stack.begin(), stack.end(), path) != stack.end()) {
+		psilog_err("Shader '%s' includes itself", path.c_str());
+		return false;
+	}
+
+	std::string source = PSIFileUtils::read_file_to_string(path);
+	if (source.empty()) {
+		psilog_err("Failed reading shader source '%s'", path.c_str());
+		return false;
+	}
+
+	GLint file_index = std::find(files.begin(), files.end(), path) - files.begin();
+	stack.push_back(path);
+
+	std::istringstream lines(source);
+	std::string line;
+	GLint line_number = 0;
+	while (std::getline(lines, line)) {
+		line_number++;
+
+		std::string include = get_include(line);
+		if (include.empty()) {
+			out += line;
+			out += '\n';
+			continue;
+		}
+
+		std::string include_path = get_directory(path) + include;
+		if (std::find(files.begin(), files.end(), include_path) == files.end()) {
+			files.push_back(include_path);
+			out += "#line 1 " + std::to_string(files.size() - 1) + "\n";
+			if (expand(include_path, files, stack, out) == false) {
+				return false;
+			}
+		} else if (std::find(stack.begin(), stack.end(), include_path) != stack.end()) {
+			psilog_err("Shader '%s' includes itself", include_path.c_str());
+			return false;
+		}
+		out += "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_index) + "\n";
+	}
+
+	stack.pop_back();
+
+	return true;
+}
+
+GLboolean load(const std::string &path, std::string &source, std::vector<std::string> *files) {
+	std::vector<std::string> included = { path };
+	std::vector<std::string> stack;
+
+	source.clear();
+	if (expand(path, included, stack, source) == false) {
+		return false;
+	}
+
+	if (files != nullptr) {
+		*files = included;
+	}
+
+	return true;
+}
+
+std::string add_defines(const std::string &source, const std::vector<std::string> &defines) {
+	if (defines.empty() == true) {
+		return source;
+	}
+
+	// #version has to stay the first directive.
+	size_t insert_at = 0;
+	GLint version_line = 0;
+	size_t version = source.find("#version");
+	if (version != std::string::npos) {
+		size_t end = source.find('\n', version);
+		insert_at = (end == std::string::npos) ? source.size() : end + 1;
+		version_line = std::count(source.begin(), source.begin() + version, '\n') + 1;
+	}
+
+	std::string block;
+	if (insert_at == source.size() && insert_at > 0 && source.back() != '\n') {
+		block += '\n';
+	}
+	for (const auto &define : defines) {
+		block += "#define " + define + "\n";
+	}
+	// Keep the line numbers of the rest as they were.
+	block += "#line " + std::to_string(version_line + 1) + " 0\n";
+
+	return source.substr(0, insert_at) + block + source.substr(insert_at);
+}
+
+} // namespace PSIShaderPreprocessor
@@ -0,0 +1,20 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// GLSL source preprocessing done before handing the source to the driver.
+// Resolves #include "file" directives and injects #define sets, so shader
+// variants can share one source file.
+
+#pragma once
+
+#include "PSIGlobals.h"
+
+namespace PSIShaderPreprocessor {
+	// Load shader source from path, replacing #include "file" lines with the file, relative to
+	// the including file. Each file is included once. #line directives keep compile errors
+	// pointing to the right line, with files numbered in the order they were first included,
+	// the shader itself being 0. Returns false if a file is missing or includes itself.
+	GLboolean load(const std::string &path, std::string &source, std::vector<std::string> *files = nullptr);
+
+	// Insert #define lines after the #version line of source, or at the beginning without one.
+	std::string add_defines(const std::string &source, const std::vector<std::string> &defines);
+} // namespace PSIShaderPreprocessor
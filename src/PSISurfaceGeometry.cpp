@@ -0,0 +1,403 @@
+#include "PSISurfaceGeometry.h"
+#include "PSIParallel.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace PSIGeometry {
+namespace Surface {
+
+// Evaluate vertex rows on multiple threads only when there are at least this many vertexes per thread.
+static const size_t PARALLEL_MIN_VERTEXES = 16384;
+
+// A vertex position on the grid, in quads.
+struct grid_point {
+	GLint x;
+	GLint y;
+};
+
+GLsizei grid_vertex_count(GLint cols, GLint rows) {
+	return (cols + 1) * (rows + 1);
+}
+
+GLsizei grid_index_count(GLint cols, GLint rows) {
+	// Two triangles per quad.
+	return 6 * cols * rows;
+}
+
+void write_grid_vertexes(const surface_func &surface, GLint cols, GLint rows, const grid_output &out) {
+	size_t min_batch_rows = std::max<size_t>(1, PARALLEL_MIN_VERTEXES / (cols + 1));
+
+	PSIParallel::for_range(rows + 1, min_batch_rows, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			GLfloat v = (GLfloat)y / rows;
+			size_t row_offset = y * (cols + 1);
+
+			for (GLint x = 0; x <= cols; x++) {
+				surface_point point = surface((GLfloat)x / cols, v);
+				size_t i = row_offset + x;
+
+				out.positions[i] = point.position;
+				if (out.normals != nullptr) {
+					out.normals[i] = point.normal;
+				}
+				if (out.texcoords != nullptr) {
+					out.texcoords[i] = point.texcoord;
+				}
+			}
+		}
+	});
+}
+
+void write_grid_indexes(GLint cols, GLint rows, GLuint *indexes, GLuint base_vertex) {
+	GLuint row_stride = cols + 1;
+
+	// Two counter clockwise triangles per quad, sharing the row vertexes.
+	//
+	//   3 ______ 2
+	//    |     /|
+	//    |   /  |
+	//    | /    |
+	//    '------'
+	//   0        1
+	//
+	for (GLint y = 0; y < rows; y++) {
+		GLuint row = base_vertex + y * row_stride;
+
+		for (GLint x = 0; x < cols; x++) {
+			GLuint i0 = row + x;
+			GLuint i1 = i0 + 1;
+			GLuint i2 = i1 + row_stride;
+			GLuint i3 = i0 + row_stride;
+
+			*indexes++ = i0;
+			*indexes++ = i1;
+			*indexes++ = i2;
+			*indexes++ = i0;
+			*indexes++ = i2;
+			*indexes++ = i3;
+		}
+	}
+}
+
+// Allocate geometry data and evaluate the full vertex grid for it.
+static GeometryDataSharedPtr create_grid_data(const surface_func &surface, GLint cols, GLint rows) {
+	if (!surface) {
+		psilog_err("No surface function given");
+		return nullptr;
+	}
+
+	if (cols < 1 || rows < 1) {
+		psilog_err("Invalid surface grid size %d x %d", cols, rows);
+		return nullptr;
+	}
+
+	GeometryDataSharedPtr geom = PSIGeometryData::create();
+	if (geom == nullptr) {
+		return nullptr;
+	}
+
+	GLsizei vertex_count = grid_vertex_count(cols, rows);
+	geom->positions.resize(vertex_count);
+	geom->normals.resize(vertex_count);
+	geom->texcoords.resize(vertex_count);
+
+	grid_output out = { geom->positions.data(), geom->normals.data(), geom->texcoords.data(), nullptr };
+	write_grid_vertexes(surface, cols, rows, out);
+
+	return geom;
+}
+
+GeometryDataSharedPtr grid(const surface_func &surface, GLint cols, GLint rows) {
+	GeometryDataSharedPtr geom = create_grid_data(surface, cols, rows);
+	if (geom == nullptr) {
+		return nullptr;
+	}
+
+	geom->indexes.resize(grid_index_count(cols, rows));
+	write_grid_indexes(cols, rows, geom->indexes.data());
+
+	return geom;
+}
+
+// Lower the LOD level until it evenly divides the patch and leaves at least 2 x 2 quads.
+static GLint clamp_lod(GLint level, GLint patch_quads) {
+	level = std::max(level, 0);
+	while (level > 0 && ((patch_quads % (1 << level)) != 0 || (patch_quads >> level) < 2)) {
+		level--;
+	}
+
+	return level;
+}
+
+// Vertex step of the patch at px, py, or 0 if it is outside the grid.
+static GLint patch_stride(GLint px, GLint py, GLint patches_x, GLint patches_y, GLint patch_quads,
+                          const std::vector<GLint> &lod_levels) {
+	if (px < 0 || py < 0 || px >= patches_x || py >= patches_y) {
+		return 0;
+	}
+
+	size_t i = py * patches_x + px;
+	GLint level = (i < lod_levels.size()) ? lod_levels[i] : 0;
+
+	return 1 << clamp_lod(level, patch_quads);
+}
+
+// One border of a patch. Points are at origin + along * t + inward * depth.
+struct patch_side {
+	grid_point origin;
+	grid_point along;
+	grid_point inward;
+	// Which neighbour shares this side.
+	GLint neighbour_dx;
+	GLint neighbour_dy;
+};
+
+static void patch_sides(GLint px, GLint py, GLint n, std::array<patch_side, 4> &sides) {
+	GLint x = px * n;
+	GLint y = py * n;
+
+	sides[0] = {{ x,     y     }, { 1, 0 }, {  0,  1 },  0, -1 }; // Bottom.
+	sides[1] = {{ x,     y + n }, { 1, 0 }, {  0, -1 },  0,  1 }; // Top.
+	sides[2] = {{ x,     y     }, { 0, 1 }, {  1,  0 }, -1,  0 }; // Left.
+	sides[3] = {{ x + n, y     }, { 0, 1 }, { -1,  0 },  1,  0 }; // Right.
+}
+
+static inline grid_point side_point(const patch_side &side, GLint t, GLint depth) {
+	return {
+		side.origin.x + side.along.x * t + side.inward.x * depth,
+		side.origin.y + side.along.y * t + side.inward.y * depth,
+	};
+}
+
+// Write a triangle, fixing the winding to counter clockwise on the grid.
+static inline GLuint *write_tri(GLuint *out, GLuint row_stride, grid_point a, grid_point b, grid_point c) {
+	GLint area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (area < 0) {
+		std::swap(b, c);
+	}
+
+	*out++ = a.y * row_stride + a.x;
+	*out++ = b.y * row_stride + b.x;
+	*out++ = c.y * row_stride + c.x;
+
+	return out;
+}
+
+GLsizei patch_index_count(GLint patches_x, GLint patches_y, GLint patch_quads,
+                          const std::vector<GLint> &lod_levels) {
+	if (patch_quads < 2) {
+		return grid_index_count(patches_x * patch_quads, patches_y * patch_quads);
+	}
+
+	std::array<patch_side, 4> sides;
+	GLsizei count = 0;
+
+	for (GLint py = 0; py < patches_y; py++) {
+		for (GLint px = 0; px < patches_x; px++) {
+			GLint stride = patch_stride(px, py, patches_x, patches_y, patch_quads, lod_levels);
+			GLint n = patch_quads / stride;
+
+			// Inner quads.
+			count += 6 * (n - 2) * (n - 2);
+
+			// Border strips, one triangle per outer and inner segment.
+			patch_sides(px, py, patch_quads, sides);
+			for (const patch_side &side : sides) {
+				GLint neighbour = patch_stride(px + side.neighbour_dx, py + side.neighbour_dy,
+				                               patches_x, patches_y, patch_quads, lod_levels);
+				GLint edge_stride = std::max(stride, neighbour);
+
+				count += 3 * (patch_quads / edge_stride + n - 2);
+			}
+		}
+	}
+
+	return count;
+}
+
+GLsizei write_patch_indexes(GLint patches_x, GLint patches_y, GLint patch_quads,
+                            const std::vector<GLint> &lod_levels, GLuint *indexes) {
+	// Single quad patches have no room for LOD.
+	if (patch_quads < 2) {
+		GLint cols = patches_x * patch_quads;
+		GLint rows = patches_y * patch_quads;
+		write_grid_indexes(cols, rows, indexes);
+		return grid_index_count(cols, rows);
+	}
+
+	GLuint row_stride = patches_x * patch_quads + 1;
+	GLuint *out = indexes;
+	std::array<patch_side, 4> sides;
+
+	for (GLint py = 0; py < patches_y; py++) {
+		for (GLint px = 0; px < patches_x; px++) {
+			GLint s = patch_stride(px, py, patches_x, patches_y, patch_quads, lod_levels);
+			GLint n = patch_quads;
+			GLint x0 = px * n;
+			GLint y0 = py * n;
+
+			// Inner quads, leaving a ring of one step for stitching to the neighbours.
+			for (GLint y = s; y < n - s; y += s) {
+				for (GLint x = s; x < n - s; x += s) {
+					grid_point p0 = { x0 + x,     y0 + y     };
+					grid_point p1 = { x0 + x + s, y0 + y     };
+					grid_point p2 = { x0 + x + s, y0 + y + s };
+					grid_point p3 = { x0 + x,     y0 + y + s };
+
+					out = write_tri(out, row_stride, p0, p1, p2);
+					out = write_tri(out, row_stride, p0, p2, p3);
+				}
+			}
+
+			// Zip each border between its outer edge and the inner ring.
+			// The outer edge uses the coarser step of this patch and the neighbour,
+			// so both patches see the same vertexes on the shared edge.
+			patch_sides(px, py, n, sides);
+			for (const patch_side &side : sides) {
+				GLint neighbour = patch_stride(px + side.neighbour_dx, py + side.neighbour_dy,
+				                               patches_x, patches_y, patch_quads, lod_levels);
+				GLint edge_stride = std::max(s, neighbour);
+
+				GLint outer_count = n / edge_stride;
+				GLint inner_count = n / s - 2;
+				GLint i = 0;
+				GLint j = 0;
+
+				while (i < outer_count || j < inner_count) {
+					GLint outer_next = (i + 1) * edge_stride;
+					GLint inner_next = (j + 2) * s;
+
+					grid_point outer = side_point(side, i * edge_stride, 0);
+					grid_point inner = side_point(side, (j + 1) * s, s);
+
+					if (j == inner_count || (i < outer_count && outer_next <= inner_next)) {
+						out = write_tri(out, row_stride, outer, side_point(side, outer_next, 0), inner);
+						i++;
+					} else {
+						out = write_tri(out, row_stride, outer, side_point(side, inner_next, s), inner);
+						j++;
+					}
+				}
+			}
+		}
+	}
+
+	return out - indexes;
+}
+
+GeometryDataSharedPtr patch_grid(const surface_func &surface, GLint patches_x, GLint patches_y,
+                                 GLint patch_quads, const std::vector<GLint> &lod_levels) {
+	if (patches_x < 1 || patches_y < 1 || patch_quads < 1) {
+		psilog_err("Invalid surface patch grid %d x %d with %d quads", patches_x, patches_y, patch_quads);
+		return nullptr;
+	}
+
+	GeometryDataSharedPtr geom = create_grid_data(surface, patches_x * patch_quads, patches_y * patch_quads);
+	if (geom == nullptr) {
+		return nullptr;
+	}
+
+	geom->indexes.resize(patch_index_count(patches_x, patches_y, patch_quads, lod_levels));
+	GLsizei written = write_patch_indexes(patches_x, patches_y, patch_quads, lod_levels, geom->indexes.data());
+	assert(written == (GLsizei)geom->indexes.size());
+	(void)written;
+
+	return geom;
+}
+
+surface_func plane_surface(GLfloat texture_repeat) {
+	return [texture_repeat](GLfloat u, GLfloat v) {
+		surface_point point;
+		point.position = glm::vec3(u - 0.5f, v - 0.5f, 0.0f);
+		point.normal   = glm::vec3(0.0f, 0.0f, 1.0f);
+		// Images are stored top row first, so flip v.
+		point.texcoord = glm::vec2(u, 1.0f - v) * texture_repeat;
+
+		return point;
+	};
+}
+
+surface_func height_field_surface(const std::vector<GLfloat> &heights, GLint width, GLint height,
+                                  GLfloat height_scale) {
+	if (width < 2 || height < 2 || heights.size() < (size_t)(width * height)) {
+		psilog_err("Invalid height field of %d x %d with %zu samples", width, height, heights.size());
+		return nullptr;
+	}
+
+	// Copy the samples, the surface function can outlive the caller data.
+	auto samples = make_shared<std::vector<GLfloat>>(heights.begin(), heights.begin() + width * height);
+
+	// Bilinear sample at u, v.
+	auto sample = [samples, width, height](GLfloat u, GLfloat v) {
+		GLfloat gx = glm::clamp(u, 0.0f, 1.0f) * (width - 1);
+		GLfloat gy = glm::clamp(v, 0.0f, 1.0f) * (height - 1);
+		GLint x0 = std::min((GLint)gx, width - 2);
+		GLint y0 = std::min((GLint)gy, height - 2);
+		GLfloat fx = gx - x0;
+		GLfloat fy = gy - y0;
+
+		const GLfloat *row0 = samples->data() + y0 * width + x0;
+		const GLfloat *row1 = row0 + width;
+
+		GLfloat h0 = row0[0] + (row0[1] - row0[0]) * fx;
+		GLfloat h1 = row1[0] + (row1[1] - row1[0]) * fx;
+
+		return h0 + (h1 - h0) * fy;
+	};
+
+	GLfloat du = 1.0f / (width - 1);
+	GLfloat dv = 1.0f / (height - 1);
+
+	return [sample, du, dv, height_scale](GLfloat u, GLfloat v) {
+		// Slopes from central differences of one sample, one sided at the borders.
+		GLfloat u0 = std::max(u - du, 0.0f);
+		GLfloat u1 = std::min(u + du, 1.0f);
+		GLfloat v0 = std::max(v - dv, 0.0f);
+		GLfloat v1 = std::min(v + dv, 1.0f);
+
+		GLfloat dh_du = (sample(u1, v) - sample(u0, v)) / (u1 - u0) * height_scale;
+		GLfloat dh_dv = (sample(u, v1) - sample(u, v0)) / (v1 - v0) * height_scale;
+
+		surface_point point;
+		point.position = glm::vec3(u - 0.5f, v - 0.5f, sample(u, v) * height_scale);
+		// cross((1, 0, dh_du), (0, 1, dh_dv)).
+		point.normal   = glm::normalize(glm::vec3(-dh_du, -dh_dv, 1.0f));
+		point.texcoord = glm::vec2(u, 1.0f - v);
+
+		return point;
+	};
+}
+
+surface_func sphere_surface(GLfloat radius) {
+	return [radius](GLfloat u, GLfloat v) {
+		GLfloat theta = u * TWO_PI;
+		GLfloat phi   = v * M_PI - HALF_PI;
+
+		surface_point point;
+		point.normal   = glm::vec3(cosf(phi) * sinf(theta), sinf(phi), cosf(phi) * cosf(theta));
+		point.position = point.normal * radius;
+		point.texcoord = glm::vec2(u, 1.0f - v);
+
+		return point;
+	};
+}
+
+surface_func torus_surface(GLfloat major_radius, GLfloat minor_radius) {
+	return [major_radius, minor_radius](GLfloat u, GLfloat v) {
+		GLfloat theta = u * TWO_PI;
+		GLfloat phi   = v * TWO_PI;
+
+		glm::vec3 center = glm::vec3(sinf(theta), 0.0f, cosf(theta)) * major_radius;
+
+		surface_point point;
+		point.normal   = glm::vec3(cosf(phi) * sinf(theta), sinf(phi), cosf(phi) * cosf(theta));
+		point.position = center + point.normal * minor_radius;
+		point.texcoord = glm::vec2(u, 1.0f - v);
+
+		return point;
+	};
+}
+
+} // namespace Surface
+} // namespace PSIGeometry
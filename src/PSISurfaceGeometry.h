@@ -0,0 +1,85 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Parametric surface geometry. Generates shared-vertex grids for planes,
+// height fields, spheres and toruses, with optional per-patch LOD levels.
+
+#pragma once
+
+#include <functional>
+
+#include "PSIGeometryData.h"
+#include "PSIMath.h"
+
+namespace PSIGeometry {
+	namespace Surface {
+		// A single point on a parametric surface.
+		struct surface_point {
+			glm::vec3 position;
+			glm::vec3 normal;
+			glm::vec2 texcoord;
+		};
+
+		// Maps the surface parameters u and v in range 0 .. 1 to a point on the surface.
+		// Triangles are wound counter clockwise in (u, v), so the front face points towards
+		// cross(dP/du, dP/dv). Called from multiple threads for large grids.
+		typedef std::function<surface_point(GLfloat u, GLfloat v)> surface_func;
+
+		// Preallocated destination arrays for writing surface data.
+		// Normals, texcoords and indexes can be left null if they are not wanted.
+		struct grid_output {
+			glm::vec3 *positions;
+			glm::vec3 *normals;
+			glm::vec2 *texcoords;
+			GLuint *indexes;
+		};
+
+		// Vertex count for a grid of cols x rows quads.
+		GLsizei grid_vertex_count(GLint cols, GLint rows);
+		// Index count for a grid of cols x rows quads, all in full detail.
+		GLsizei grid_index_count(GLint cols, GLint rows);
+
+		// Evaluate surface vertexes for a grid of cols x rows quads into out.
+		void write_grid_vertexes(const surface_func &surface, GLint cols, GLint rows, const grid_output &out);
+		// Write full detail triangle indexes for a grid of cols x rows quads into out.
+		// Indexes are offset by base_vertex.
+		void write_grid_indexes(GLint cols, GLint rows, GLuint *indexes, GLuint base_vertex = 0);
+
+		// Create geometry data for a grid of cols x rows quads.
+		GeometryDataSharedPtr grid(const surface_func &surface, GLint cols, GLint rows);
+
+		// Patched grids.
+		//
+		// The grid is split into patches_x * patches_y patches of patch_quads x patch_quads quads.
+		// All patches share one full detail vertex grid, LOD only changes the indexes.
+		// A patch at LOD level n uses every 2^n:th vertex. Where neighbouring patches have
+		// different levels, the shared edge uses the coarser spacing on both sides and the
+		// finer patch is stitched to it, so there are no cracks between patches.
+		//
+		// lod_levels has one level per patch, in row order. Levels are clamped so that
+		// each patch has at least 2 x 2 quads.
+
+		// Index count for the patched grid with the given LOD levels.
+		GLsizei patch_index_count(GLint patches_x, GLint patches_y, GLint patch_quads,
+		                          const std::vector<GLint> &lod_levels);
+		// Write patched grid indexes into preallocated output. Returns the number of indexes written.
+		GLsizei write_patch_indexes(GLint patches_x, GLint patches_y, GLint patch_quads,
+		                            const std::vector<GLint> &lod_levels, GLuint *indexes);
+		// Create geometry data for a patched grid with the given LOD levels.
+		GeometryDataSharedPtr patch_grid(const surface_func &surface, GLint patches_x, GLint patches_y,
+		                                 GLint patch_quads, const std::vector<GLint> &lod_levels);
+
+		// Surface functions.
+
+		// Unit plane in the xy plane, centered at origin, facing +z.
+		// Texture coordinates are multiplied by texture_repeat, repeating needs REPEAT wrap mode.
+		surface_func plane_surface(GLfloat texture_repeat = 1.0f);
+		// Unit plane displaced along +z by bilinearly sampled heights.
+		// heights has width x height samples in row order, row 0 at v = 0.
+		surface_func height_field_surface(const std::vector<GLfloat> &heights, GLint width, GLint height,
+		                                  GLfloat height_scale);
+		// Sphere with radius, u goes around the y axis and v from the south to the north pole.
+		surface_func sphere_surface(GLfloat radius);
+		// Torus around the y axis, with the tube center at major_radius.
+		surface_func torus_surface(GLfloat major_radius, GLfloat minor_radius);
+	}
+}
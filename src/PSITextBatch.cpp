@@ -0,0 +1,284 @@
+#include "PSITextBatch.h"
+#include "PSIGLUtils.h"
+
+#include <algorithm>
+#include <cstddef>
+
+const GLsizei PSITextBatch::DEF_GLYPH_CAPACITY = 1024;
+
+#define VERTEXES_PER_QUAD 4
+#define INDEXES_PER_QUAD 6
+
+// Texts without a material are drawn white.
+static glm::vec4 get_text_color(PSITextRenderer &text) {
+	GLMaterialSharedPtr material = text.get_material();
+	return (material != nullptr) ? material->get_color() : glm::vec4(1.0f);
+}
+
+PSITextBatch::~PSITextBatch() {
+	// Deleting name 0 is ignored, so a batch never initialized is fine here.
+	glDeleteVertexArrays(1, &_vao);
+	glDeleteBuffers(1, &_vertex_buffer);
+	glDeleteBuffers(1, &_index_buffer);
+}
+
+GLboolean PSITextBatch::init() {
+	auto shader = get_shader();
+	assert(shader != nullptr);
+
+	GLint position_location = shader->get_attrib_location("a_position");
+	GLint texcoord_location = shader->get_attrib_location("a_texcoord");
+	_color_location = shader->get_attrib_location("a_color");
+	if (position_location == PSIGLShader::AttribLocation::INVALID ||
+	    texcoord_location == PSIGLShader::AttribLocation::INVALID) {
+		psilog_err("Text batch shader %s has no a_position or a_texcoord", shader->get_info_str().c_str());
+		return false;
+	}
+
+	glGenVertexArrays(1, &_vao);
+	glGenBuffers(1, &_vertex_buffer);
+	glGenBuffers(1, &_index_buffer);
+
+	glBindVertexArray(_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _index_buffer);
+
+	GLsizei stride = sizeof(glyph_vertex);
+	glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, stride,
+	                      (const GLvoid *)offsetof(glyph_vertex, position));
+	glEnableVertexAttribArray(position_location);
+	glVertexAttribPointer(texcoord_location, 2, GL_FLOAT, GL_FALSE, stride,
+	                      (const GLvoid *)offsetof(glyph_vertex, texcoord));
+	glEnableVertexAttribArray(texcoord_location);
+	if (_color_location != PSIGLShader::AttribLocation::INVALID) {
+		glVertexAttribPointer(_color_location, 4, GL_FLOAT, GL_FALSE, stride,
+		                      (const GLvoid *)offsetof(glyph_vertex, color));
+		glEnableVertexAttribArray(_color_location);
+	}
+
+	glBindVertexArray(0);
+
+	if (reserve(DEF_GLYPH_CAPACITY) == false) {
+		return false;
+	}
+
+	check_gl_error();
+
+	return true;
+}
+
+GLboolean PSITextBatch::reserve(GLsizei glyph_count) {
+	if (glyph_count <= _capacity) {
+		return true;
+	}
+
+	GLsizei capacity = std::max(glyph_count, _capacity * 2);
+
+	// The index buffer is bound in the VAO.
+	glBindVertexArray(_vao);
+
+	// Vertexes are written again every frame, only allocate them here.
+	glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * VERTEXES_PER_QUAD * sizeof(glyph_vertex),
+	             NULL, GL_STREAM_DRAW);
+
+	// Glyph quads always use the same indexes, so they are only uploaded when growing.
+	std::vector<GLuint> indexes;
+	indexes.reserve(capacity * INDEXES_PER_QUAD);
+	for (GLsizei i = 0; i < capacity; i++) {
+		std::array<GLuint, 6> quad_indexes = PSIGeometry::Quad::calc_quad_indexes(i);
+		indexes.insert(indexes.end(), quad_indexes.begin(), quad_indexes.end());
+	}
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexes.size() * sizeof(GLuint), indexes.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+
+	if (check_gl_error() == true) {
+		psilog_err("Failed allocating text batch buffers for %d glyphs", capacity);
+		return false;
+	}
+
+	psilog(PSILog::OPENGL, "Text batch buffers for %d glyphs", capacity);
+	_capacity = capacity;
+
+	return true;
+}
+
+void PSITextBatch::add_text(const TextRendererSharedPtr &text) {
+	if (text != nullptr) {
+		_texts.push_back(text);
+	}
+}
+
+void PSITextBatch::remove_text(const TextRendererSharedPtr &text) {
+	_texts.erase(std::remove(_texts.begin(), _texts.end(), text), _texts.end());
+}
+
+void PSITextBatch::logic(const RenderContextSharedPtr &ctx) {
+	for (const auto &text : _texts) {
+		text->logic(ctx);
+	}
+}
+
+GLsizei PSITextBatch::write_text(const RenderContextSharedPtr &ctx, PSITextRenderer &text, glyph_vertex *out) {
+	GLsizei offset, count;
+	text.get_draw_range(offset, count);
+
+	// Same views as PSIRenderObj::draw, texts not translated by the camera only turn with it.
+	glm::mat4 view = (text.is_translated_by_camera() == true) ?
+	                 ctx->view.top() : ctx->camera->get_looking_at_matrix_without_translation();
+	glm::mat4 model_view = view * text.get_transform().get_model() * ctx->model.top();
+	glm::vec4 color = get_text_color(text);
+
+	// Glyphs lie on the xy plane of the text, so the corners are the origin moved along
+	// the x and y axes, without a full matrix multiply per vertex.
+	glm::vec3 origin = glm::vec3(model_view[3]);
+	glm::vec3 axis_x = glm::vec3(model_view[0]);
+	glm::vec3 axis_y = glm::vec3(model_view[1]);
+
+	const auto &quads = text.get_glyph_quads();
+	for (GLsizei i = 0; i < count; i++) {
+		const PSITextRenderer::glyph_quad &quad = quads[offset + i];
+
+		glm::vec3 x0 = origin + axis_x * quad.pos0.x;
+		glm::vec3 x1 = origin + axis_x * quad.pos1.x;
+		glm::vec3 y0 = axis_y * quad.pos0.y;
+		glm::vec3 y1 = axis_y * quad.pos1.y;
+
+		// Corners in the order of the text meshes, for the quad indexes.
+		out[0] = { x0 + y0, quad.tex0, color };
+		out[1] = { x0 + y1, glm::vec2(quad.tex0.x, quad.tex1.y), color };
+		out[2] = { x1 + y1, quad.tex1, color };
+		out[3] = { x1 + y0, glm::vec2(quad.tex1.x, quad.tex0.y), color };
+		out += VERTEXES_PER_QUAD;
+	}
+
+	return count;
+}
+
+void PSITextBatch::draw(const RenderContextSharedPtr &ctx) {
+	_glyph_count = 0;
+	_draw_call_count = 0;
+
+	if (_vao == 0) {
+		return;
+	}
+
+	// Visible texts, grouped by font atlas and otherwise in the order added.
+	_draw_texts.clear();
+	for (const auto &text : _texts) {
+		if (text->is_visible() == true && text->get_font_atlas() != nullptr &&
+		    text->get_glyph_quads().empty() == false) {
+			_draw_texts.push_back(text.get());
+		}
+	}
+	std::stable_sort(_draw_texts.begin(), _draw_texts.end(), [](PSITextRenderer *a, PSITextRenderer *b) {
+		return a->get_font_atlas().get() < b->get_font_atlas().get();
+	});
+
+	GLsizei glyph_count = 0;
+	for (PSITextRenderer *text : _draw_texts) {
+		GLsizei offset, count;
+		text->get_draw_range(offset, count);
+		glyph_count += count;
+	}
+
+	if (glyph_count == 0 || reserve(glyph_count) == false) {
+		return;
+	}
+
+	// Invalidating the buffer lets the driver give us new storage to write, while the
+	// GPU may still be drawing the last frame from the old one.
+	glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+	glyph_vertex *vertexes = (glyph_vertex *)glMapBufferRange(GL_ARRAY_BUFFER, 0,
+		(GLsizeiptr)glyph_count * VERTEXES_PER_QUAD * sizeof(glyph_vertex),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (vertexes == nullptr) {
+		psilog_err("Failed mapping text batch vertex buffer");
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	GLsizei written = 0;
+	for (PSITextRenderer *text : _draw_texts) {
+		written += write_text(ctx, *text, vertexes + written * VERTEXES_PER_QUAD);
+	}
+
+	// The contents can be lost while mapped, drawn again next frame then.
+	GLboolean unmapped = glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (unmapped == GL_FALSE) {
+		psilog_err("Text batch vertex buffer was corrupted while mapped");
+		return;
+	}
+
+	auto shader = get_shader();
+	assert(shader != nullptr);
+	shader->use_program();
+
+	// The glyphs are in view space already.
+	shader->set_uniform("u_diffuse", 0);
+	shader->set_uniform("u_model_view_projection_matrix", ctx->projection.top());
+
+	// With per vertex colors u_color must not tint them, without them it is set per draw.
+	GLboolean color_uniform = shader->get_uniforms().count("u_color") > 0;
+	GLboolean vertex_color = _color_location != PSIGLShader::AttribLocation::INVALID;
+	if (vertex_color == true && color_uniform == true) {
+		shader->set_uniform("u_color", glm::vec4(1.0f));
+	}
+
+	GLboolean disable_depth_test = !is_depth_tested();
+	if (disable_depth_test == true) {
+		glDisable(GL_DEPTH_TEST);
+	}
+
+	glBindVertexArray(_vao);
+
+	// One draw per font atlas, split where the color changes without per vertex colors.
+	GLTextureSharedPtr texture;
+	GLsizei first = 0;
+	size_t i = 0;
+	while (i < _draw_texts.size()) {
+		FontAtlasSharedPtr atlas = _draw_texts[i]->get_font_atlas();
+		glm::vec4 color = get_text_color(*_draw_texts[i]);
+
+		GLsizei count = 0;
+		for (; i < _draw_texts.size(); i++) {
+			PSITextRenderer *text = _draw_texts[i];
+			if (text->get_font_atlas() != atlas ||
+			    (vertex_color == false && get_text_color(*text) != color)) {
+				break;
+			}
+
+			GLsizei text_offset, text_count;
+			text->get_draw_range(text_offset, text_count);
+			count += text_count;
+		}
+
+		if (count == 0) {
+			continue;
+		}
+
+		texture = atlas->get_texture();
+		texture->bind();
+		if (vertex_color == false && color_uniform == true) {
+			shader->set_uniform("u_color", color);
+		}
+
+		glDrawElements(GL_TRIANGLES, count * INDEXES_PER_QUAD, GL_UNSIGNED_INT,
+		               (const GLvoid *)((size_t)first * INDEXES_PER_QUAD * sizeof(GLuint)));
+		first += count;
+		_draw_call_count++;
+	}
+
+	glBindVertexArray(0);
+
+	if (texture != nullptr) {
+		texture->unbind();
+	}
+	if (disable_depth_test == true) {
+		glEnable(GL_DEPTH_TEST);
+	}
+
+	_glyph_count = glyph_count;
+}
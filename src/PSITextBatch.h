@@ -0,0 +1,91 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Draws many texts with one draw call per font atlas. Each frame the glyph quads
+// of all the texts are written into one streaming vertex buffer, already moved
+// into view space, so texts with their own transforms and colors, translated by
+// the camera or not, share the draw of their atlas.
+//
+// The batch is added to the scene in place of its texts. Texts in a batch need a
+// font atlas and text, but no init(), material or mesh of their own. The shader
+// of the batch is a text shader, sampling u_diffuse with a_texcoord, taking its
+// color from a_color. With u_color instead, the draws split where the color of
+// the texts changes.
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIOpenGL.h"
+#include "PSIRenderObj.h"
+#include "PSITextRenderer.h"
+
+#include <vector>
+
+class PSITextBatch;
+typedef shared_ptr<PSITextBatch> TextBatchSharedPtr;
+
+class PSITextBatch : public PSIRenderObj {
+	public:
+		// Interleaved vertex of a glyph quad.
+		struct glyph_vertex {
+			glm::vec3 position;
+			glm::vec2 texcoord;
+			glm::vec4 color;
+		};
+
+		// Glyphs the buffers are first created for, they grow when more are drawn.
+		static const GLsizei DEF_GLYPH_CAPACITY;
+
+		PSITextBatch() = default;
+		~PSITextBatch();
+
+		// Owns the GL buffers, so it is not copyable.
+		PSITextBatch(const PSITextBatch &rhs) = delete;
+
+		static TextBatchSharedPtr create() {
+			return make_shared<PSITextBatch>();
+		}
+
+		// Create the buffers, after setting a material with the shader.
+		GLboolean init();
+
+		void logic(const RenderContextSharedPtr &ctx);
+		void draw(const RenderContextSharedPtr &ctx);
+
+		// Texts are drawn in the order added within their font atlas.
+		void add_text(const TextRendererSharedPtr &text);
+		void remove_text(const TextRendererSharedPtr &text);
+		void clear_texts() {
+			_texts.clear();
+		}
+		GLsizei get_text_count() {
+			return _texts.size();
+		}
+
+		// Glyphs and draw calls of the last frame.
+		GLsizei get_glyph_count() {
+			return _glyph_count;
+		}
+		GLsizei get_draw_call_count() {
+			return _draw_call_count;
+		}
+
+	private:
+		// Grow the buffers to hold glyph_count glyphs.
+		GLboolean reserve(GLsizei glyph_count);
+		// Write the glyphs of text into out, returns the glyphs written.
+		GLsizei write_text(const RenderContextSharedPtr &ctx, PSITextRenderer &text, glyph_vertex *out);
+
+		std::vector<TextRendererSharedPtr> _texts;
+		// Visible texts of the frame, ordered by font atlas.
+		std::vector<PSITextRenderer *> _draw_texts;
+
+		GLuint _vao = 0;
+		GLuint _vertex_buffer = 0;
+		GLuint _index_buffer = 0;
+		GLsizei _capacity = 0;
+		// Location of a_color, INVALID when the shader takes u_color.
+		GLint _color_location = PSIGLShader::AttribLocation::INVALID;
+
+		GLsizei _glyph_count = 0;
+		GLsizei _draw_call_count = 0;
+};
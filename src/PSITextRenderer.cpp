@@ -1,5 +1,7 @@
 #include "PSITextRenderer.h"
 
+#include <algorithm>
+
 // PSIFontAtlas implementation.
 GLboolean PSIFontAtlas::init() {
 	assert(_font_path.size() > 0);
@@ -39,33 +41,62 @@ texture_atlas_t *PSIFontAtlas::create_atlas(GLsizei width, GLsizei height) {
 	return atlas;
 }
 
-// PSITextRenderer implementation.
-GLboolean PSITextRenderer::init() {
-	assert(get_shader() != nullptr);
-	assert(_font_atlas != nullptr);
+GLTextureSharedPtr PSIFontAtlas::get_texture() {
+	if (_texture != nullptr) {
+		// Glyphs outside the charset are loaded into the atlas when a text first uses them.
+		if (_atlas->used != _uploaded_used) {
+			_texture->bind();
+			upload_atlas();
+			_texture->unbind();
+		}
 
-	update_mesh();
+		return _texture;
+	}
 
 	// Create our texture for storing the font atlas.
 	GLTextureSharedPtr texture = PSIGLTexture::create();
 	assert(texture != nullptr);
 
-	// Assign our texture for the font atlas we are using
 	GLuint atlas_id = texture->gen_texture_id(PSIGLTexture::TexType::TEX_2D);
+	_texture = texture;
 	texture->bind();
-		texture->set_size(_font_atlas->get_size());
+		texture->set_size(_size);
 		texture->set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::LINEAR);
 		texture->set_format(PSIGLTexture::TexFormat::RGB);
-		texture->set_data(_font_atlas->get_atlas()->data);
-		_font_atlas->set_atlas_texture_id(atlas_id);
+		upload_atlas();
+		set_atlas_texture_id(atlas_id);
 	texture->unbind();
 
-	get_material()->set_texture(texture);
+	return _texture;
+}
+
+void PSIFontAtlas::upload_atlas() {
+	// Rows of the RGB atlas are only 4 byte aligned for some widths.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	_texture->set_data(_atlas->data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	_uploaded_used = _atlas->used;
+
+	psilog(PSILog::OPENGL, "Uploaded font atlas %s, %zu pixels used", _font_path.c_str(), _uploaded_used);
+}
 
+// PSITextRenderer implementation.
+PSITextRenderer::PSITextRenderer() {
 	// Scale down to same distance as other engine is using.
 	// Approximate one meter cube equals size of dot in font or something like that :)
 	glm::vec3 scaling = { 0.01f, 0.01f, 0.01f };
 	get_transform().set_scaling(scaling);
+}
+
+GLboolean PSITextRenderer::init() {
+	assert(get_shader() != nullptr);
+	assert(_font_atlas != nullptr);
+
+	update_mesh();
+
+	// Texts using the same font atlas share its texture.
+	get_material()->set_texture(_font_atlas->get_texture());
 
 	return true;
 }
@@ -74,13 +105,11 @@ void PSITextRenderer::update_mesh() {
 	auto shader = get_shader();
 	assert(shader != nullptr);
 
-	if (_text.size() == 0) {
+	if (_glyph_quads.size() == 0) {
 		return;
 	}
 
-	// Bake our text into GPU data.
-	// Load the glyphs for this text.
-	unique_data geom = bake_text(_font_atlas, _text);
+	unique_data geom = create_geometry_data();
 	auto mesh = get_gl_mesh();
 
 	// We don't have a mesh yet, create it.
@@ -148,46 +177,55 @@ void PSITextRenderer::set_text(std::string text) {
 		_text = text;
 		// Text should be able to be set before initializing, font atlas would be null then.
 		if (_font_atlas != nullptr) {
+			bake_text(_font_atlas, _text);
+		}
+		// The mesh is created in init(), texts drawn by a PSITextBatch have none.
+		if (get_gl_mesh() != nullptr) {
 			update_mesh();
 		}
 	}
 }
 
-#define INDEXES_PER_QUAD 6
-
-// Bake the data for text rendered with specified font, color and position.
-PSITextRenderer::unique_data PSITextRenderer::bake_text(const FontAtlasSharedPtr &atlas, std::string text) {
-	assert(atlas != nullptr);
-	assert(text.size() > 0);
+void PSITextRenderer::set_font_atlas(FontAtlasSharedPtr font_atlas) {
+	_font_atlas = font_atlas;
+	if (_font_atlas != nullptr) {
+		bake_text(_font_atlas, _text);
+	}
+	if (get_gl_mesh() != nullptr) {
+		update_mesh();
+	}
+}
 
-	const char *text_str = text.c_str();
+void PSITextRenderer::get_draw_range(GLsizei &offset, GLsizei &count) {
+	GLsizei quad_count = _glyph_quads.size();
 
-	unique_data data = make_unique<PSIGeometryData>();
-	if (data == nullptr) {
-		return nullptr;
+	offset = (_draw_offset == (GLuint)-1) ? 0 : std::min((GLsizei)_draw_offset, quad_count);
+	count = quad_count - offset;
+	if (_draw_count != (GLuint)-1) {
+		count = std::min((GLsizei)_draw_count, count);
 	}
+}
 
-	// Number of characters.
-	GLint text_len = strlen(text_str);
-	// Number of vertexes (4 vertices per char/quad).
-	GLint vertex_count = text_len * 4;
+#define INDEXES_PER_QUAD 6
+
+// Lay out the glyph quads for text rendered with specified font.
+void PSITextRenderer::bake_text(const FontAtlasSharedPtr &atlas, const std::string &text) {
+	assert(atlas != nullptr);
 
-	// Reserve GPU data.
-	data->texcoords.reserve(vertex_count);
-	data->positions.reserve(vertex_count);
-	data->indexes.reserve  (text_len * INDEXES_PER_QUAD);
+	// Number of characters.
+	GLint text_len = text.size();
 
-	// TODO: fix this when baking multiple times.
+	_glyph_quads.clear();
+	_glyph_quads.reserve(text_len);
+	_glyph_dimensions.clear();
 	_glyph_dimensions.reserve(text_len);
 
 	// Store dimensions for the text.
 	_dimensions.x = 0.0f;
 	glm::vec2 pos = glm::vec2(0.0f, 0.0f);
 
-	psilog(PSILog::OPENGL, "Baking text '%s' (len=%d)", _text.c_str(), text_len);
+	psilog(PSILog::OPENGL, "Baking text '%s' (len=%d)", text.c_str(), text_len);
 
-	// TODO: should sort these in reverse order ?
-	const GLfloat z_offset = 0.0f;
 	texture_font_t *font = atlas->get_font();
 
 	for(int i=0; i<text_len; ++i) {
@@ -210,33 +248,15 @@ PSITextRenderer::unique_data PSITextRenderer::bake_text(const FontAtlasSharedPtr
 			// Store the glyph dimensions.
 			_glyph_dimensions.push_back(glm::vec2(glyph->width, glyph->height));
 
-			// Glyph quad vertexes.
-			std::vector<glm::vec3> vertexes = {
-				glm::vec3(x0, y0, z_offset),
-				glm::vec3(x0, y1, z_offset),
-				glm::vec3(x1, y1, z_offset),
-				glm::vec3(x1, y0, z_offset)
-			};
-
-			// Texture coordinates.
-			// These specify where in our texture map we have the exact texture for these triangles.
-			// So when we render the triangle, we are rendering the glyph from our texture map over that triangle.
-			std::vector<glm::vec2> texcoords = {
+			// Texture coordinates specify where in our texture map we have the exact texture
+			// for the glyph, so the quad is drawn with the glyph from the texture map over it.
+			_glyph_quads.push_back({
+				glm::vec2(x0, y0),
+				glm::vec2(x1, y1),
 				glm::vec2(glyph->s0, glyph->t0),
-				glm::vec2(glyph->s0, glyph->t1),
-				glm::vec2(glyph->s1, glyph->t1),
-				glm::vec2(glyph->s1, glyph->t0)
-			};
-
-			// Colors.
-			// Same color for each point.
-			data->positions.insert(data->positions.end(), vertexes.begin(),  vertexes.end());
-			data->texcoords.insert(data->texcoords.end(), texcoords.begin(), texcoords.end());
-
-			// Indexes.
-			std::array<GLuint, 6> char_quad_indexes = PSIGeometry::Quad::calc_quad_indexes(i);
-			data->indexes.insert  (data->indexes.end(), char_quad_indexes.begin(), char_quad_indexes.end());
-			
+				glm::vec2(glyph->s1, glyph->t1)
+			});
+
 			// We don't want to offset the glyphs for a timer usecase where we only want to display
 			// one character at a time, from an offsetted texture position.
 			if (_offset_glyphs == true) {
@@ -249,20 +269,51 @@ PSITextRenderer::unique_data PSITextRenderer::bake_text(const FontAtlasSharedPtr
 	}
 
 	_dimensions.y = 0.0f;
+}
+
+// Mesh data for the glyph quads, written straight into the reserved arrays.
+PSITextRenderer::unique_data PSITextRenderer::create_geometry_data() {
+	unique_data data = make_unique<PSIGeometryData>();
+	if (data == nullptr) {
+		return nullptr;
+	}
+
+	GLsizei quad_count = _glyph_quads.size();
+	data->positions.reserve(quad_count * 4);
+	data->texcoords.reserve(quad_count * 4);
+	data->indexes.reserve(quad_count * INDEXES_PER_QUAD);
+
+	for (GLsizei i = 0; i < quad_count; i++) {
+		const glyph_quad &quad = _glyph_quads[i];
+
+		data->positions.emplace_back(quad.pos0.x, quad.pos0.y, 0.0f);
+		data->positions.emplace_back(quad.pos0.x, quad.pos1.y, 0.0f);
+		data->positions.emplace_back(quad.pos1.x, quad.pos1.y, 0.0f);
+		data->positions.emplace_back(quad.pos1.x, quad.pos0.y, 0.0f);
+
+		data->texcoords.emplace_back(quad.tex0.x, quad.tex0.y);
+		data->texcoords.emplace_back(quad.tex0.x, quad.tex1.y);
+		data->texcoords.emplace_back(quad.tex1.x, quad.tex1.y);
+		data->texcoords.emplace_back(quad.tex1.x, quad.tex0.y);
+
+		std::array<GLuint, 6> quad_indexes = PSIGeometry::Quad::calc_quad_indexes(i);
+		data->indexes.insert(data->indexes.end(), quad_indexes.begin(), quad_indexes.end());
+	}
 
 	return data;
 }
 
 void PSITextRenderer::draw(const RenderContextSharedPtr &ctx) {
 	// Empty string, don't draw.
-	if (_text.size() == 0) {
+	if (_glyph_quads.size() == 0) {
 		return;
 	}
 
 	auto shader = get_shader();
 	auto mesh = get_gl_mesh();
 	auto material = get_material();
-	auto texture = material->get_texture();
+	// From the atlas, so glyphs loaded since the last upload are drawn too.
+	auto texture = _font_atlas->get_texture();
 
 	// TODO: are these required ?
 	assert(shader != nullptr);
@@ -294,10 +345,10 @@ void PSITextRenderer::draw(const RenderContextSharedPtr &ctx) {
 		} else {
 			// Offset text by offset.
 			// only draw count amount of characters.
-			GLint char_offset = INDEXES_PER_QUAD * _draw_offset;
-			GLint char_count  = INDEXES_PER_QUAD * _draw_count;
+			GLsizei offset, count;
+			get_draw_range(offset, count);
 
-			mesh->draw_indexed(char_offset, char_count);
+			mesh->draw_indexed(INDEXES_PER_QUAD * offset, INDEXES_PER_QUAD * count);
 		}
 	ctx->model.pop();
 
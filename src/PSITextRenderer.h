@@ -12,6 +12,7 @@
 #include "PSIMath.h"
 #include "PSIGeometry.h"
 #include "PSIRenderObj.h"
+#include "PSIGLTexture.h"
 #include "PSIString.h"
 
 #include "ext/freetype-gl/freetype-gl.h"
@@ -68,6 +69,10 @@ class PSIFontAtlas {
 			_atlas->id = id;
 		}
 
+		// Texture of the atlas, shared by all texts using the atlas. Uploaded on the first call,
+		// and again when glyphs have been loaded into the atlas since.
+		GLTextureSharedPtr get_texture();
+
 		void set_font_color(glm::vec4 font_color) {
 			_font_color = font_color;
 		}
@@ -97,9 +102,15 @@ class PSIFontAtlas {
 		std::string _font_path;
 		// Character set that this atlas contains in it's texture.
 		std::string _charset;
+		// Uploaded atlas texture.
+		GLTextureSharedPtr _texture;
+		// Atlas area used at the last upload, grows when glyphs are loaded.
+		size_t _uploaded_used = 0;
 
 		// Create texture atlas.
 		texture_atlas_t *create_atlas(GLsizei width, GLsizei height);
+		// Upload the atlas data to our bound texture.
+		void upload_atlas();
 };
 
 class PSITextRenderer;
@@ -109,7 +120,15 @@ class PSITextRenderer : public PSIRenderObj {
 	using unique_data = unique_ptr<PSIGeometryData>;
 
 	public:
-		PSITextRenderer() = default;
+		// Quad of one baked glyph in pixels, and its texture coordinates in the atlas.
+		struct glyph_quad {
+			glm::vec2 pos0;
+			glm::vec2 pos1;
+			glm::vec2 tex0;
+			glm::vec2 tex1;
+		};
+
+		PSITextRenderer();
 		~PSITextRenderer() = default;
 
 		static TextRendererSharedPtr create() {
@@ -133,6 +152,13 @@ class PSITextRenderer : public PSIRenderObj {
 			_draw_count = draw_count;
 		}
 
+		// Range of glyph quads selected with the draw offset and count, clamped to the text.
+		void get_draw_range(GLsizei &offset, GLsizei &count);
+
+		// Glyph quads of the current text, baked when the text or font atlas is set.
+		const std::vector<glyph_quad> &get_glyph_quads() {
+			return _glyph_quads;
+		}
 
 		glm::vec2 get_dimensions() {
 			return _dimensions;
@@ -146,9 +172,7 @@ class PSITextRenderer : public PSIRenderObj {
 			return _font_atlas;
 		}
 
-		void set_font_atlas(FontAtlasSharedPtr font_atlas) {
-			_font_atlas = font_atlas;
-		}
+		void set_font_atlas(FontAtlasSharedPtr font_atlas);
 
 	private:
 		// The font data this text is using.
@@ -158,6 +182,8 @@ class PSITextRenderer : public PSIRenderObj {
 		glm::vec2 _dimensions = glm::vec2(0.0f, 0.0f);
 		// Individual glyph dimensions for currently baked text.
 		std::vector<glm::vec2> _glyph_dimensions;
+		// Glyph quads for currently baked text.
+		std::vector<glyph_quad> _glyph_quads;
 		// Our text string in wide UTF format.
 		std::string _text = "";
 
@@ -169,8 +195,10 @@ class PSITextRenderer : public PSIRenderObj {
 		// How many characters to draw from that offset.
 		GLuint _draw_count = -1;
 
-		// Bake current text into a mesh.
-		unique_data bake_text(const FontAtlasSharedPtr &atlas, std::string text);
+		// Lay out the glyph quads of text with the font in atlas.
+		void bake_text(const FontAtlasSharedPtr &atlas, const std::string &text);
+		// Geometry for the baked glyph quads.
+		unique_data create_geometry_data();
 		// Update current text mesh.
 		void update_mesh();
 };
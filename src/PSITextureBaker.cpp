@@ -0,0 +1,517 @@
+#include "PSITextureBaker.h"
+#include "PSIMipGenerator.h"
+#include "PSIParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace PSITextureBaker {
+
+static_assert(sizeof(file_header) == 40, "Baked texture header layout changed");
+static_assert(sizeof(level_entry) == 24, "Baked texture level entry layout changed");
+
+static inline uint64_t align_up(uint64_t offset) {
+	return (offset + LEVEL_ALIGNMENT - 1) & ~(LEVEL_ALIGNMENT - 1);
+}
+
+size_t get_level_size(GLint format, GLint width, GLint height) {
+	if (format == Format::RGBA8) {
+		return (size_t)width * height * 4;
+	}
+
+	size_t blocks = (size_t)std::max((width + 3) / 4, 1) * std::max((height + 3) / 4, 1);
+	return blocks * ((format == Format::BC3) ? BC3_BLOCK_SIZE : BC1_BLOCK_SIZE);
+}
+
+static const char *get_format_name(GLint format) {
+	switch (format) {
+	case Format::BC1:
+		return "BC1";
+	case Format::BC3:
+		return "BC3";
+	case Format::RGBA8:
+		return "RGBA8";
+	}
+
+	return "unknown";
+}
+
+//
+// Block encoding.
+//
+
+static inline uint16_t pack_565(const float *c) {
+	int r = (int)(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static inline void unpack_565(uint16_t c, int *out) {
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+// Pick the nearest of the four palette colors for each pixel. Returns the total squared error.
+static int select_color_indexes(const unsigned char *rgba, uint16_t c0, uint16_t c1, uint32_t &indexes) {
+	int palette[4][3];
+	unpack_565(c0, palette[0]);
+	unpack_565(c1, palette[1]);
+	for (int i = 0; i < 3; i++) {
+		palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+		palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+	}
+
+	int error = 0;
+	indexes = 0;
+	for (int p = 0; p < 16; p++) {
+		const unsigned char *px = rgba + p * 4;
+		int best = 0;
+		int best_dist = INT32_MAX;
+		for (int i = 0; i < 4; i++) {
+			int dr = px[0] - palette[i][0];
+			int dg = px[1] - palette[i][1];
+			int db = px[2] - palette[i][2];
+			int dist = dr * dr + dg * dg + db * db;
+			if (dist < best_dist) {
+				best_dist = dist;
+				best = i;
+			}
+		}
+		indexes |= (uint32_t)best << (p * 2);
+		error += best_dist;
+	}
+
+	return error;
+}
+
+// Order the endpoints for four color mode, c0 > c1, fixing up the indexes to match.
+static void order_endpoints(uint16_t &c0, uint16_t &c1, uint32_t &indexes) {
+	if (c0 < c1) {
+		std::swap(c0, c1);
+		// Swap 0 <-> 1 and 2 <-> 3, which is flipping the low bit of each index.
+		indexes ^= 0x55555555;
+	} else if (c0 == c1) {
+		indexes = 0;
+	}
+}
+
+// Least squares fit of the endpoints to the pixels with the given indexes.
+static bool refine_endpoints(const unsigned char *rgba, uint32_t indexes, float *end0, float *end1) {
+	// Weight of c0 for each index.
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[3] = {}, bx[3] = {};
+	for (int p = 0; p < 16; p++) {
+		float a = weights[(indexes >> (p * 2)) & 3];
+		float b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int i = 0; i < 3; i++) {
+			ax[i] += a * rgba[p * 4 + i];
+			bx[i] += b * rgba[p * 4 + i];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f) {
+		return false;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		end0[i] = (ax[i] * bb - bx[i] * ab) / det;
+		end1[i] = (bx[i] * aa - ax[i] * ab) / det;
+	}
+
+	return true;
+}
+
+// Encode the color part of a block, endpoints along the principal axis of the colors.
+static void encode_color_block(const unsigned char *rgba, unsigned char *out) {
+	float mean[3] = {};
+	for (int p = 0; p < 16; p++) {
+		for (int i = 0; i < 3; i++) {
+			mean[i] += rgba[p * 4 + i];
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		mean[i] /= 16.0f;
+	}
+
+	// Covariance of the colors.
+	float cov[6] = {};
+	for (int p = 0; p < 16; p++) {
+		float r = rgba[p * 4 + 0] - mean[0];
+		float g = rgba[p * 4 + 1] - mean[1];
+		float b = rgba[p * 4 + 2] - mean[2];
+		cov[0] += r * r;
+		cov[1] += r * g;
+		cov[2] += r * b;
+		cov[3] += g * g;
+		cov[4] += g * b;
+		cov[5] += b * b;
+	}
+
+	// Principal axis with power iteration.
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iter = 0; iter < 8; iter++) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float len = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+		if (len < 1e-6f) {
+			break;
+		}
+		axis[0] = x / len;
+		axis[1] = y / len;
+		axis[2] = z / len;
+	}
+
+	// Extremes of the colors along the axis.
+	float min_t = FLT_MAX;
+	float max_t = -FLT_MAX;
+	for (int p = 0; p < 16; p++) {
+		float t = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			t += (rgba[p * 4 + i] - mean[i]) * axis[i];
+		}
+		min_t = std::min(min_t, t);
+		max_t = std::max(max_t, t);
+	}
+
+	float len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float end0[3], end1[3];
+	for (int i = 0; i < 3; i++) {
+		end0[i] = mean[i] + axis[i] * max_t / len2;
+		end1[i] = mean[i] + axis[i] * min_t / len2;
+	}
+
+	uint16_t c0 = pack_565(end0);
+	uint16_t c1 = pack_565(end1);
+	uint32_t indexes;
+	int error = select_color_indexes(rgba, c0, c1, indexes);
+
+	// One least squares refinement, kept if it lowers the error.
+	if (error > 0 && refine_endpoints(rgba, indexes, end0, end1) == true) {
+		uint16_t r0 = pack_565(end0);
+		uint16_t r1 = pack_565(end1);
+		uint32_t refined_indexes;
+		if (select_color_indexes(rgba, r0, r1, refined_indexes) < error) {
+			c0 = r0;
+			c1 = r1;
+			indexes = refined_indexes;
+		}
+	}
+
+	order_endpoints(c0, c1, indexes);
+
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++) {
+		out[4 + i] = (indexes >> (i * 8)) & 0xff;
+	}
+}
+
+// Encode the alpha part of a BC3 block, with the eight value palette between min and max.
+static void encode_alpha_block(const unsigned char *rgba, unsigned char *out) {
+	int a0 = 0;
+	int a1 = 255;
+	for (int p = 0; p < 16; p++) {
+		a0 = std::max(a0, (int)rgba[p * 4 + 3]);
+		a1 = std::min(a1, (int)rgba[p * 4 + 3]);
+	}
+
+	out[0] = a0;
+	out[1] = a1;
+
+	uint64_t indexes = 0;
+	if (a0 > a1) {
+		int palette[8];
+		palette[0] = a0;
+		palette[1] = a1;
+		for (int i = 1; i < 7; i++) {
+			palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+		}
+
+		for (int p = 0; p < 16; p++) {
+			int a = rgba[p * 4 + 3];
+			int best = 0;
+			int best_dist = INT32_MAX;
+			for (int i = 0; i < 8; i++) {
+				int dist = abs(a - palette[i]);
+				if (dist < best_dist) {
+					best_dist = dist;
+					best = i;
+				}
+			}
+			indexes |= (uint64_t)best << (p * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; i++) {
+		out[2 + i] = (indexes >> (i * 8)) & 0xff;
+	}
+}
+
+void encode_bc1_block(const unsigned char *rgba, unsigned char *out) {
+	encode_color_block(rgba, out);
+}
+
+void encode_bc3_block(const unsigned char *rgba, unsigned char *out) {
+	encode_alpha_block(rgba, out);
+	encode_color_block(rgba, out + 8);
+}
+
+// Encode RGBA level in parallel over rows of blocks. Edge blocks repeat the last pixels.
+static void encode_level(const unsigned char *rgba, GLint width, GLint height, GLint format, unsigned char *out) {
+	GLint blocks_x = std::max((width + 3) / 4, 1);
+	GLint blocks_y = std::max((height + 3) / 4, 1);
+	size_t block_size = (format == Format::BC3) ? BC3_BLOCK_SIZE : BC1_BLOCK_SIZE;
+
+	PSIParallel::for_range(blocks_y, 4, [&](size_t begin, size_t end) {
+		unsigned char block[16 * 4];
+		for (size_t by = begin; by < end; by++) {
+			for (GLint bx = 0; bx < blocks_x; bx++) {
+				for (GLint y = 0; y < 4; y++) {
+					GLint py = std::min((GLint)by * 4 + y, height - 1);
+					for (GLint x = 0; x < 4; x++) {
+						GLint px = std::min(bx * 4 + x, width - 1);
+						memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)py * width + px) * 4, 4);
+					}
+				}
+
+				unsigned char *block_out = out + (by * blocks_x + bx) * block_size;
+				if (format == Format::BC3) {
+					encode_bc3_block(block, block_out);
+				} else {
+					encode_bc1_block(block, block_out);
+				}
+			}
+		}
+	});
+}
+
+//
+// Writing.
+//
+
+bool bake_image(const PSIGLTexture::image_data &image, const std::string &path, const bake_options &options) {
+	if (image.pixels == nullptr || image.channels != 4 || image.width <= 0 || image.height <= 0) {
+		psilog_err("Can only bake RGBA images, baking '%s'", path.c_str());
+		return false;
+	}
+
+	const unsigned char *rgba = image.pixels.get();
+	GLint format = options.format;
+	if (format == Format::AUTO) {
+		format = Format::BC1;
+		for (size_t i = 3; i < (size_t)image.width * image.height * 4; i += 4) {
+			if (rgba[i] < 255) {
+				format = Format::BC3;
+				break;
+			}
+		}
+	}
+
+	std::vector<PSIMipGenerator::mip_level> mips;
+	if (options.mipmaps == true) {
+		PSIMipGenerator::mip_options mip_options;
+		mip_options.filter = options.mip_filter;
+		mip_options.srgb = options.srgb;
+		mips = PSIMipGenerator::generate(rgba, image.width, image.height, 4, mip_options);
+	}
+
+	// Encode all levels.
+	GLint level_count = mips.size() + 1;
+	std::vector<level_entry> levels(level_count);
+	std::vector<std::vector<unsigned char>> level_data(level_count);
+	uint64_t offset = sizeof(file_header) + level_count * sizeof(level_entry);
+	for (GLint i = 0; i < level_count; i++) {
+		const unsigned char *level_rgba = (i == 0) ? rgba : mips[i - 1].pixels.data();
+		GLint width = (i == 0) ? image.width : mips[i - 1].width;
+		GLint height = (i == 0) ? image.height : mips[i - 1].height;
+
+		level_data[i].resize(get_level_size(format, width, height));
+		if (format == Format::RGBA8) {
+			memcpy(level_data[i].data(), level_rgba, level_data[i].size());
+		} else {
+			encode_level(level_rgba, width, height, format, level_data[i].data());
+		}
+
+		offset = align_up(offset);
+		levels[i] = {};
+		levels[i].width = width;
+		levels[i].height = height;
+		levels[i].offset = offset;
+		levels[i].size = level_data[i].size();
+		offset += levels[i].size;
+	}
+
+	file_header header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.format = format;
+	header.flags = (options.srgb == true) ? Flags::FLAG_SRGB : 0;
+	header.width = image.width;
+	header.height = image.height;
+	header.level_count = level_count;
+	header.file_size = offset;
+
+	std::string tmp_path = path + ".tmp";
+	FILE *fp = fopen(tmp_path.c_str(), "wb");
+	if (fp == NULL) {
+		psilog_err("Failed opening baked texture '%s' for writing", tmp_path.c_str());
+		return false;
+	}
+
+	static const unsigned char padding[LEVEL_ALIGNMENT] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+	          fwrite(levels.data(), sizeof(level_entry), levels.size(), fp) == levels.size();
+
+	uint64_t written = sizeof(file_header) + levels.size() * sizeof(level_entry);
+	for (size_t i = 0; ok && i < levels.size(); i++) {
+		uint64_t pad = levels[i].offset - written;
+		ok = (pad == 0 || fwrite(padding, 1, pad, fp) == pad) &&
+		     fwrite(level_data[i].data(), 1, levels[i].size, fp) == levels[i].size;
+		written = levels[i].offset + levels[i].size;
+	}
+
+	ok = (fclose(fp) == 0) && ok;
+	if (ok == false || rename(tmp_path.c_str(), path.c_str()) != 0) {
+		psilog_err("Failed writing baked texture '%s'", path.c_str());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+	psilog(PSILog::EXPORT, "Baked texture '%s' [%dx%d] %s, %d levels, %llu bytes", path.c_str(),
+	       image.width, image.height, get_format_name(format), level_count,
+	       (unsigned long long)header.file_size);
+
+	return true;
+}
+
+bool bake(const std::string &image_path, const std::string &path, const bake_options &options) {
+	PSIGLTexture::image_data image;
+	if (PSIGLTexture::decode_image(image_path, image, 4) == false) {
+		return false;
+	}
+
+	return bake_image(image, path, options);
+}
+
+//
+// Loading.
+//
+
+PSIFileUtils::MappedFileSharedPtr open(const std::string &path) {
+	PSIFileUtils::MappedFileSharedPtr file = PSIFileUtils::map_file(path);
+	if (file == nullptr) {
+		psilog_err("Could not open baked texture '%s'", path.c_str());
+		return nullptr;
+	}
+
+	if (file->size < sizeof(file_header)) {
+		psilog_err("Baked texture '%s' is too small", path.c_str());
+		return nullptr;
+	}
+
+	const file_header *header = reinterpret_cast<const file_header *>(file->data);
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION) {
+		psilog(PSILog::LOAD, "Baked texture '%s' has unknown format or version", path.c_str());
+		return nullptr;
+	}
+
+	if (header->file_size != file->size || header->level_count == 0 ||
+	    (header->format != Format::BC1 && header->format != Format::BC3 && header->format != Format::RGBA8) ||
+	    sizeof(file_header) + header->level_count * sizeof(level_entry) > file->size) {
+		psilog_err("Baked texture '%s' is broken", path.c_str());
+		return nullptr;
+	}
+
+	const level_entry *levels = reinterpret_cast<const level_entry *>(file->data + sizeof(file_header));
+	for (uint32_t i = 0; i < header->level_count; i++) {
+		if (levels[i].offset + levels[i].size > file->size ||
+		    levels[i].size != get_level_size(header->format, levels[i].width, levels[i].height)) {
+			psilog_err("Baked texture '%s' level %d is out of range", path.c_str(), i);
+			return nullptr;
+		}
+	}
+
+	return file;
+}
+
+GLboolean upload(const PSIFileUtils::MappedFileSharedPtr &file, PSIGLTexture &texture) {
+	if (file == nullptr) {
+		return false;
+	}
+
+	const file_header *header = reinterpret_cast<const file_header *>(file->data);
+	const level_entry *levels = reinterpret_cast<const level_entry *>(file->data + sizeof(file_header));
+	bool srgb = (header->flags & Flags::FLAG_SRGB) != 0;
+
+	GLenum internal_format;
+	GLint tex_format;
+	if (header->format == Format::RGBA8) {
+		internal_format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		tex_format = PSIGLTexture::TexFormat::RGBA;
+	} else if (header->format == Format::BC3) {
+		internal_format = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		tex_format = PSIGLTexture::TexFormat::DXT5;
+	} else {
+		internal_format = srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		tex_format = PSIGLTexture::TexFormat::DXT1;
+	}
+
+	texture.set_format(srgb ? (tex_format | PSIGLTexture::TexFormat::SRGB) : tex_format);
+	texture.set_size(glm::vec2(header->width, header->height));
+	texture.gen_texture_id(PSIGLTexture::TexType::TEX_2D);
+	texture.bind();
+
+	// All the levels are in the file, nothing to generate.
+	GLenum target = texture.get_target();
+	for (uint32_t i = 0; i < header->level_count; i++) {
+		if (header->format == Format::RGBA8) {
+			glTexImage2D(target, i, internal_format, levels[i].width, levels[i].height, 0, GL_RGBA,
+			             GL_UNSIGNED_BYTE, file->data + levels[i].offset);
+		} else {
+			glCompressedTexImage2D(target, i, internal_format, levels[i].width, levels[i].height, 0,
+			                       levels[i].size, file->data + levels[i].offset);
+		}
+	}
+	glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, header->level_count - 1);
+
+	texture.set_sample_mode(PSIGLTexture::TexSampleMode::CLAMP | PSIGLTexture::TexSampleMode::ANISOTROPIC);
+	texture.unbind();
+
+	psilog(PSILog::TEXTURE, "Uploaded baked texture [%dx%d] %s, %d levels, id = %d", header->width,
+	       header->height, get_format_name(header->format), header->level_count, texture.get_id());
+
+	return true;
+}
+
+GLTextureSharedPtr upload(const PSIFileUtils::MappedFileSharedPtr &file) {
+	GLTextureSharedPtr texture = PSIGLTexture::create();
+	if (upload(file, *texture) == false) {
+		return nullptr;
+	}
+
+	return texture;
+}
+
+GLTextureSharedPtr load_texture(const std::string &path) {
+	return upload(open(path));
+}
+
+} // namespace PSITextureBaker
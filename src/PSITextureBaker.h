@@ -0,0 +1,93 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Offline texture baking. Compresses images to BC1 (DXT1) or BC3 (DXT5), or
+// stores them as raw RGBA8, with a precomputed, gamma correct mip chain, and
+// loads the baked files by uploading every level straight from the memory
+// mapped file.
+//
+// File layout, little endian:
+//   file_header
+//   level_entry[level_count], largest level first
+//   level data, each level aligned to LEVEL_ALIGNMENT bytes.
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIGLTexture.h"
+#include "PSIFileUtils.h"
+
+namespace PSITextureBaker {
+	static const char MAGIC[4] = { 'P', 'S', 'I', 'T' };
+	// Bump when the layout changes, older files are then rejected.
+	static const uint32_t VERSION = 1;
+	static const uint64_t LEVEL_ALIGNMENT = 16;
+	// Bytes per 4x4 block.
+	static const size_t BC1_BLOCK_SIZE = 8;
+	static const size_t BC3_BLOCK_SIZE = 16;
+
+	enum Format {
+		// Pick BC3 for images with alpha, BC1 otherwise.
+		AUTO = -1,
+		// Opaque RGB, 4 bits per pixel.
+		BC1 = 0,
+		// RGBA with interpolated alpha, 8 bits per pixel.
+		BC3 = 1,
+		// Uncompressed RGBA, 32 bits per pixel. For images block compression would
+		// damage, still loaded without any decoding.
+		RGBA8 = 2
+	};
+
+	enum Flags {
+		// Color data is sRGB encoded, sampled as sRGB textures.
+		FLAG_SRGB = 0x1
+	};
+
+	struct file_header {
+		char magic[4];
+		uint32_t version;
+		uint32_t format;
+		uint32_t flags;
+		uint32_t width;
+		uint32_t height;
+		uint32_t level_count;
+		uint32_t reserved;
+		uint64_t file_size;
+	};
+
+	struct level_entry {
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct bake_options {
+		GLint format = Format::AUTO;
+		// Filter the mips in linear space and mark the texture as sRGB.
+		GLboolean srgb = true;
+		GLboolean mipmaps = true;
+		GLint mip_filter = PSIMipGenerator::Filter::BOX;
+	};
+
+	// Stored size of a width x height level.
+	size_t get_level_size(GLint format, GLint width, GLint height);
+
+	// Encode 4x4 block of RGBA pixels, in rows, into out.
+	void encode_bc1_block(const unsigned char *rgba, unsigned char *out);
+	void encode_bc3_block(const unsigned char *rgba, unsigned char *out);
+
+	// Bake RGBA image to path. The file is written next to path first and moved in place.
+	bool bake_image(const PSIGLTexture::image_data &image, const std::string &path, const bake_options &options);
+	// Decode image file and bake it to path.
+	bool bake(const std::string &image_path, const std::string &path, const bake_options &options = bake_options());
+
+	// Map baked texture file and check it. Does not touch GL, so it can be run on any thread.
+	// Returns nullptr if the file is missing, from another version or broken.
+	PSIFileUtils::MappedFileSharedPtr open(const std::string &path);
+	// Create texture from a file opened with open, uploading all levels.
+	GLTextureSharedPtr upload(const PSIFileUtils::MappedFileSharedPtr &file);
+	// Upload all levels of a file opened with open into texture, replacing its contents.
+	GLboolean upload(const PSIFileUtils::MappedFileSharedPtr &file, PSIGLTexture &texture);
+	// Open and upload baked texture.
+	GLTextureSharedPtr load_texture(const std::string &path);
+} // namespace PSITextureBaker
@@ -0,0 +1,267 @@
+#include "PSITexturePacker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+const GLint PSITexturePacker::MAX_ARRAY_LAYERS = 256;
+
+GLint PSITexturePacker::add_image(const PSIGLTexture::image_data &image) {
+	if (image.pixels == nullptr || image.width <= 0 || image.height <= 0 ||
+	    (image.channels != 3 && image.channels != 4)) {
+		psilog_err("Can only pack RGB and RGBA images");
+		return -1;
+	}
+
+	_images.push_back(image);
+
+	return _images.size() - 1;
+}
+
+GLint PSITexturePacker::find_position(const atlas_page &page, GLint page_size, GLint width, GLint height,
+                                      glm::ivec2 &position) {
+	GLint best_node = -1;
+	GLint best_top = page_size + 1;
+	for (size_t i = 0; i < page.skyline.size(); i++) {
+		GLint x = page.skyline[i].x;
+		if (x + width > page_size) {
+			break;
+		}
+
+		// Rest on the highest node under the rect.
+		GLint y = 0;
+		for (size_t j = i; j < page.skyline.size() && page.skyline[j].x < x + width; j++) {
+			y = std::max(y, page.skyline[j].y);
+		}
+
+		if (y + height <= page_size && y + height < best_top) {
+			best_node = i;
+			best_top = y + height;
+			position = glm::ivec2(x, y);
+		}
+	}
+
+	return best_node;
+}
+
+void PSITexturePacker::add_to_skyline(atlas_page &page, GLint node, const glm::ivec2 &position, GLint width,
+                                      GLint height) {
+	std::vector<skyline_node> &skyline = page.skyline;
+	skyline.insert(skyline.begin() + node, { position.x, position.y + height, width });
+
+	// Cut the nodes now under the rect.
+	GLint right = position.x + width;
+	size_t i = node + 1;
+	while (i < skyline.size() && skyline[i].x < right) {
+		GLint node_right = skyline[i].x + skyline[i].width;
+		if (node_right <= right) {
+			skyline.erase(skyline.begin() + i);
+		} else {
+			skyline[i].width = node_right - right;
+			skyline[i].x = right;
+			break;
+		}
+	}
+
+	// Merge neighbours at the same height.
+	for (i = 1; i < skyline.size();) {
+		if (skyline[i - 1].y == skyline[i].y) {
+			skyline[i - 1].width += skyline[i].width;
+			skyline.erase(skyline.begin() + i);
+		} else {
+			i++;
+		}
+	}
+}
+
+PSIGLTexture::image_data PSITexturePacker::build_page_image(const atlas_page &page, GLint padding) {
+	PSIGLTexture::image_data page_image;
+	page_image.channels = page.channels;
+	for (size_t i = 0; i < page.images.size(); i++) {
+		const PSIGLTexture::image_data &image = _images[page.images[i]];
+		page_image.width = std::max(page_image.width, page.positions[i].x + image.width + padding * 2);
+		page_image.height = std::max(page_image.height, page.positions[i].y + image.height + padding * 2);
+	}
+
+	size_t pitch = (size_t)page_image.width * page.channels;
+	page_image.pixels = shared_ptr<unsigned char>(new unsigned char[pitch * page_image.height](),
+	                                              std::default_delete<unsigned char[]>());
+
+	GLint channels = page.channels;
+	for (size_t i = 0; i < page.images.size(); i++) {
+		const PSIGLTexture::image_data &image = _images[page.images[i]];
+		const glm::ivec2 &position = page.positions[i];
+		size_t image_pitch = (size_t)image.width * channels;
+
+		for (GLint y = -padding; y < image.height + padding; y++) {
+			const unsigned char *src = image.pixels.get() + std::min(std::max(y, 0), image.height - 1) * image_pitch;
+			unsigned char *dst = page_image.pixels.get() + (position.y + padding + y) * pitch +
+			                     (size_t)position.x * channels;
+			for (GLint x = 0; x < padding; x++) {
+				memcpy(dst + x * channels, src, channels);
+				memcpy(dst + (padding + image.width + x) * channels, src + image_pitch - channels, channels);
+			}
+			memcpy(dst + padding * channels, src, image_pitch);
+		}
+	}
+
+	return page_image;
+}
+
+GLboolean PSITexturePacker::pack(const pack_options &options) {
+	_packed.assign(_images.size(), packed_image());
+	_textures.clear();
+
+	// Padding of at least two keeps one mipmap level.
+	GLint padding = std::max(options.padding, 2);
+	PSIMipGenerator::mip_options mip_options;
+	mip_options.srgb = options.srgb;
+
+	// Group same sized images for array textures.
+	std::vector<GLint> atlas_images;
+	std::map<std::tuple<GLint, GLint, GLint>, std::vector<GLint>> groups;
+	for (size_t i = 0; i < _images.size(); i++) {
+		const PSIGLTexture::image_data &image = _images[i];
+		groups[std::make_tuple(image.width, image.height, image.channels)].push_back(i);
+	}
+
+	for (const auto &group : groups) {
+		const std::vector<GLint> &images = group.second;
+		if (options.use_arrays == false || (GLint)images.size() < options.min_array_layers) {
+			atlas_images.insert(atlas_images.end(), images.begin(), images.end());
+			continue;
+		}
+
+		for (size_t first = 0; first < images.size(); first += MAX_ARRAY_LAYERS) {
+			packed_texture texture;
+			texture.array = true;
+			size_t last = std::min(first + MAX_ARRAY_LAYERS, images.size());
+			for (size_t i = first; i < last; i++) {
+				PSIGLTexture::image_data layer = _images[images[i]];
+				PSIGLTexture::gen_cpu_mipmaps(layer, mip_options);
+				texture.images.push_back(layer);
+
+				_packed[images[i]].texture = _textures.size();
+				_packed[images[i]].layer = i - first;
+			}
+			_textures.push_back(texture);
+		}
+	}
+
+	// Pack the rest tallest first, which keeps the skyline flat.
+	std::sort(atlas_images.begin(), atlas_images.end(), [this](GLint a, GLint b) {
+		if (_images[a].height != _images[b].height) {
+			return _images[a].height > _images[b].height;
+		}
+		return _images[a].width > _images[b].width;
+	});
+
+	std::vector<atlas_page> pages;
+	for (GLint index : atlas_images) {
+		const PSIGLTexture::image_data &image = _images[index];
+		GLint width = image.width + padding * 2;
+		GLint height = image.height + padding * 2;
+		if (width > options.page_size || height > options.page_size) {
+			psilog(PSILog::TEXTURE, "Image %d [%dx%d] does not fit a page, not packing", index, image.width,
+			       image.height);
+			continue;
+		}
+
+		glm::ivec2 position;
+		GLint node = -1;
+		size_t page_index = 0;
+		for (; page_index < pages.size(); page_index++) {
+			if (pages[page_index].channels == image.channels) {
+				node = find_position(pages[page_index], options.page_size, width, height, position);
+				if (node >= 0) {
+					break;
+				}
+			}
+		}
+
+		if (node < 0) {
+			atlas_page page;
+			page.skyline.push_back({ 0, 0, options.page_size });
+			page.channels = image.channels;
+			pages.push_back(page);
+			page_index = pages.size() - 1;
+			node = find_position(pages[page_index], options.page_size, width, height, position);
+		}
+
+		atlas_page &page = pages[page_index];
+		add_to_skyline(page, node, position, width, height);
+		page.images.push_back(index);
+		page.positions.push_back(position);
+	}
+
+	// Stop the mipmaps before the padding runs out.
+	GLint mip_levels = 0;
+	while ((2 << mip_levels) <= padding) {
+		mip_levels++;
+	}
+	mip_options.max_levels = mip_levels;
+
+	for (const auto &page : pages) {
+		packed_texture texture;
+		texture.images.push_back(build_page_image(page, padding));
+		PSIGLTexture::gen_cpu_mipmaps(texture.images.back(), mip_options);
+
+		const PSIGLTexture::image_data &page_image = texture.images.back();
+		for (size_t i = 0; i < page.images.size(); i++) {
+			const PSIGLTexture::image_data &image = _images[page.images[i]];
+			packed_image &packed = _packed[page.images[i]];
+			packed.texture = _textures.size();
+			packed.uv_rect = glm::vec4((GLfloat)(page.positions[i].x + padding) / page_image.width,
+			                           (GLfloat)(page.positions[i].y + padding) / page_image.height,
+			                           (GLfloat)image.width / page_image.width,
+			                           (GLfloat)image.height / page_image.height);
+		}
+		_textures.push_back(texture);
+	}
+
+	psilog(PSILog::TEXTURE, "Packed %d images into %d textures", (int)_images.size(), (int)_textures.size());
+
+	return true;
+}
+
+void PSITexturePacker::upload() {
+	for (auto &texture : _textures) {
+		if (texture.texture != nullptr) {
+			continue;
+		}
+
+		texture.texture = PSIGLTexture::create();
+		if (texture.array == true) {
+			texture.texture->upload_array(texture.images);
+		} else {
+			texture.texture->upload_image(texture.images.front());
+		}
+		texture.images.clear();
+	}
+}
+
+GLboolean PSITexturePacker::apply(GLint image, const GLMaterialSharedPtr &material) {
+	if (image < 0 || image >= (GLint)_packed.size() || _packed[image].texture < 0) {
+		return false;
+	}
+
+	const packed_image &packed = _packed[image];
+	material->set_texture(_textures[packed.texture].texture);
+	material->set_texture_layer(packed.layer);
+
+	return true;
+}
+
+GLboolean PSITexturePacker::apply(GLint image, const RenderObjSharedPtr &render_obj) {
+	if (image < 0 || image >= (GLint)_packed.size() || _packed[image].texture < 0) {
+		return false;
+	}
+
+	const packed_image &packed = _packed[image];
+	if (packed.layer < 0 && render_obj->remap_texcoords(packed.uv_rect) == false) {
+		return false;
+	}
+
+	return apply(image, render_obj->get_material());
+}
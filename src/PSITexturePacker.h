@@ -0,0 +1,122 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Packs many small textures into a few, to cut texture binds between draws.
+// Images of the same size become layers of array textures, the rest are packed
+// into atlas pages with a skyline packer. Materials are then pointed at the
+// packed texture, with their array layer or atlas texcoords.
+
+#pragma once
+
+#include "PSIGlobals.h"
+#include "PSIGLTexture.h"
+#include "PSIGLMaterial.h"
+#include "PSIRenderObj.h"
+
+class PSITexturePacker;
+typedef shared_ptr<PSITexturePacker> TexturePackerSharedPtr;
+
+class PSITexturePacker {
+	public:
+		struct pack_options {
+			// Largest atlas page size, pages are shrunk to what they use.
+			GLint page_size = 2048;
+			// Edge pixels repeated around atlas images, so filtering does not bleed between them.
+			// Atlas mipmaps stop at the level where the padding runs out, log2(padding).
+			GLint padding = 8;
+			// Pack images of the same size into array textures.
+			GLboolean use_arrays = true;
+			// Fewest images of the same size for an array texture.
+			GLint min_array_layers = 2;
+			// Are the images sRGB encoded ? Used for filtering the mipmaps.
+			GLboolean srgb = true;
+		};
+
+		// Where an image ended up.
+		struct packed_image {
+			// Index of the packed texture, -1 if the image was not packed.
+			GLint texture = -1;
+			// Layer in an array texture, -1 for atlases.
+			GLint layer = -1;
+			// Area of the image in the atlas, offset in xy and scale in zw.
+			glm::vec4 uv_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		};
+
+		// Layers in one array texture, the minimum all GL 3 drivers support.
+		static const GLint MAX_ARRAY_LAYERS;
+
+		PSITexturePacker() = default;
+		~PSITexturePacker() = default;
+
+		static TexturePackerSharedPtr create() {
+			return make_shared<PSITexturePacker>();
+		}
+
+		// Add RGB or RGBA image to pack, returns its index or -1 if it can not be packed.
+		GLint add_image(const PSIGLTexture::image_data &image);
+		GLsizei get_image_count() {
+			return _images.size();
+		}
+
+		// Pack the added images and build the texture images with their mipmaps. Does not touch
+		// GL, so it can be run on any thread. Images larger than a page are left unpacked.
+		GLboolean pack(const pack_options &options);
+		GLboolean pack() {
+			return pack(pack_options());
+		}
+		// Upload the packed textures, releasing their CPU copies.
+		void upload();
+
+		const packed_image& get_packed_image(GLint index) {
+			return _packed.at(index);
+		}
+		GLTextureSharedPtr get_texture(GLint index) {
+			return _textures.at(index).texture;
+		}
+		GLsizei get_texture_count() {
+			return _textures.size();
+		}
+
+		// Point material at the packed texture of image. Atlas images also need their
+		// texcoords remapped, see the render object version.
+		GLboolean apply(GLint image, const GLMaterialSharedPtr &material);
+		// Point the material of render_obj at the packed texture of image, remapping its
+		// texcoords for atlas images. Returns false and leaves the object as it was if the
+		// image was not packed or the texcoords can not be remapped.
+		GLboolean apply(GLint image, const RenderObjSharedPtr &render_obj);
+
+	private:
+		// Top edge of the packed area, from x to x + width.
+		struct skyline_node {
+			GLint x;
+			GLint y;
+			GLint width;
+		};
+
+		struct atlas_page {
+			std::vector<skyline_node> skyline;
+			GLint channels;
+			// Images packed to this page, with their padded positions.
+			std::vector<GLint> images;
+			std::vector<glm::ivec2> positions;
+		};
+
+		// Packed texture, either one atlas image or array layers.
+		struct packed_texture {
+			GLboolean array = false;
+			std::vector<PSIGLTexture::image_data> images;
+			GLTextureSharedPtr texture;
+		};
+
+		// Find the lowest place for a width x height rect on page, returns the skyline node index
+		// to place it at, or -1 if it does not fit.
+		static GLint find_position(const atlas_page &page, GLint page_size, GLint width, GLint height,
+		                           glm::ivec2 &position);
+		static void add_to_skyline(atlas_page &page, GLint node, const glm::ivec2 &position, GLint width,
+		                           GLint height);
+		// Copy the pages images to one image, repeating their edges into the padding.
+		PSIGLTexture::image_data build_page_image(const atlas_page &page, GLint padding);
+
+		std::vector<PSIGLTexture::image_data> _images;
+		std::vector<packed_image> _packed;
+		std::vector<packed_texture> _textures;
+};
@@ -10,16 +10,25 @@
 #include "PSIAudio.h"
 #include "PSIGLUtils.h"
 #include "PSIGLRenderer.h"
+#include "PSIFrameCapture.h"
+#include "PSIOfflineRenderer.h"
+#include "PSIRenderShards.h"
+#include "PSIRenderTargetPool.h"
+#include "PSIFrameGraph.h"
 #include "PSIGLTexture.h"
+#include "PSITextureBaker.h"
+#include "PSITexturePacker.h"
 #include "PSIAABB.h"
 #include "PSICamera.h"
 
 #include "PSIResourceManager.h"
+#include "PSIAssetLoader.h"
 #include "PSIFileUtils.h"
 
 #include "PSIRenderScene.h"
 #include "PSIRenderObj.h"
 #include "PSIRenderMesh.h"
+#include "PSIRenderModel.h"
 
 #include "PSIGeometry.h"
 #include "PSIGeometryData.h"
@@ -35,4 +44,5 @@
 #include "PSILight.h"
 
 #include "PSITextRenderer.h"
+#include "PSITextBatch.h"
 #include "PSIGLTFLoader.h"
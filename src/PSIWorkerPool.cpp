@@ -0,0 +1,71 @@
+#include "PSIWorkerPool.h"
+#include "PSIParallel.h"
+
+#include <algorithm>
+
+PSIWorkerPool::PSIWorkerPool(size_t thread_count) {
+	if (thread_count == 0) {
+		thread_count = std::max<size_t>(PSIParallel::get_thread_count() - 1, 1);
+	}
+
+	_threads.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; i++) {
+		_threads.emplace_back(&PSIWorkerPool::worker_loop, this);
+	}
+}
+
+PSIWorkerPool::~PSIWorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_task_cond.notify_all();
+
+	for (auto &thread : _threads) {
+		thread.join();
+	}
+}
+
+void PSIWorkerPool::submit(task_func task) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push_back(std::move(task));
+	}
+	_task_cond.notify_one();
+}
+
+void PSIWorkerPool::wait_pending(size_t max_pending) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle_cond.wait(lock, [this, max_pending]() {
+		return _tasks.size() + _running <= max_pending;
+	});
+}
+
+size_t PSIWorkerPool::get_pending_count() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _tasks.size() + _running;
+}
+
+void PSIWorkerPool::worker_loop() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_task_cond.wait(lock, [this]() {
+			return _stopping || _tasks.empty() == false;
+		});
+		// Drain the queue before stopping, dropped tasks would leave their waiters hanging.
+		if (_tasks.empty() == true) {
+			return;
+		}
+
+		task_func task = std::move(_tasks.front());
+		_tasks.pop_front();
+		_running++;
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		_running--;
+		_idle_cond.notify_all();
+	}
+}
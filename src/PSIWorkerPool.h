@@ -0,0 +1,78 @@
+// PSIEngine Copyright (c) 2021 Sakari Lehtonen <sakari@psitriangle.net>
+//
+// Pool of long running worker threads, for running tasks like file loading
+// and decoding in the background.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PSIWorkerPool;
+typedef std::shared_ptr<PSIWorkerPool> WorkerPoolSharedPtr;
+
+class PSIWorkerPool {
+	public:
+		typedef std::function<void()> task_func;
+
+		// With thread_count 0, uses one thread less than we can run concurrently,
+		// leaving one for the render thread.
+		PSIWorkerPool(size_t thread_count = 0);
+		// Tasks still in the queue are run before the workers stop, so every queued
+		// task, and the future of every async(), is completed.
+		~PSIWorkerPool();
+
+		static WorkerPoolSharedPtr create(size_t thread_count = 0) {
+			return std::make_shared<PSIWorkerPool>(thread_count);
+		}
+
+		// Queue task to run on one of the workers.
+		void submit(task_func task);
+
+		// Queue func to run on one of the workers, returning a future for its result.
+		template <typename F>
+		auto async(F func) -> std::future<decltype(func())> {
+			typedef decltype(func()) result_type;
+			auto task = std::make_shared<std::packaged_task<result_type()>>(std::move(func));
+			std::future<result_type> future = task->get_future();
+			submit([task]() {
+				(*task)();
+			});
+
+			return future;
+		}
+
+		// Block until the queue is empty and no task is running.
+		void wait_idle() {
+			wait_pending(0);
+		}
+		// Block until at most max_pending tasks are queued or running. Used to hold back
+		// producers that would queue faster than the workers can run the tasks.
+		void wait_pending(size_t max_pending);
+
+		// Tasks queued or running.
+		size_t get_pending_count();
+		size_t get_thread_count() {
+			return _threads.size();
+		}
+
+	private:
+		void worker_loop();
+
+		std::vector<std::thread> _threads;
+		std::deque<task_func> _tasks;
+		std::mutex _mutex;
+		// Signaled when tasks are queued or we are stopping.
+		std::condition_variable _task_cond;
+		// Signaled when a task finishes.
+		std::condition_variable _idle_cond;
+		// Tasks being run right now.
+		size_t _running = 0;
+		bool _stopping = false;
+};